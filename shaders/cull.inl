@@ -0,0 +1,89 @@
+#ifndef GLSL_CULL_INCLUDE_
+#define GLSL_CULL_INCLUDE_
+
+// Bindings and helpers shared by the culling stages, cull.comp and occlusion_cull.comp.
+
+// One instance of one shape. Matches VulkanGraphicsApp::GpuCullRecord.
+struct DrawRecord {
+    uint indexCount;
+    uint instanceCount;
+    uint firstIndex;
+    int vertexOffset;
+    uint firstInstance;
+    float centerX; // Bounding sphere in model space
+    float centerY;
+    float centerZ;
+    float radius;
+};
+
+// Matches VkDrawIndexedIndirectCommand
+struct DrawCommand {
+    uint indexCount;
+    uint instanceCount;
+    uint firstIndex;
+    int vertexOffset;
+    uint firstInstance;
+};
+
+struct Transform {
+    mat4 Model;
+};
+
+// Matches VulkanGraphicsApp::GpuCullFrustum
+layout(binding = 0) uniform CullFrustum {
+    vec4 planes[6]; // Inside where dot(plane.xyz, p) + plane.w >= 0
+    mat4 viewProjection;
+    vec2 depthSize; // Size of the depth buffer the pyramid was built from
+    uint recordCount;
+    uint compact;
+    uint pyramidLevels;
+} uFrustum;
+
+layout(std430, binding = 1) readonly buffer DrawRecords {
+    DrawRecord data[];
+} sRecords;
+
+layout(std430, binding = 2) readonly buffer Transforms {
+    Transform data[];
+} sModel;
+
+layout(std430, binding = 3) writeonly buffer DrawCommands {
+    DrawCommand data[];
+} sDraws;
+
+layout(std430, binding = 4) buffer DrawCount {
+    uint count;
+    uint occluded; // Instances within the frustum found hidden behind the depth pyramid
+} sCount;
+
+/// World space bounding sphere of 'record' under the same instance data the vertex shader reads through gl_InstanceIndex
+void worldSphere(DrawRecord record, out vec3 center, out float radius){
+    mat4 Model = sModel.data[record.firstInstance].Model;
+    center = (Model * vec4(record.centerX, record.centerY, record.centerZ, 1.0)).xyz;
+    // The largest axis scale keeps the sphere enclosing the shape under non-uniform scaling
+    float scale = max(length(Model[0].xyz), max(length(Model[1].xyz), length(Model[2].xyz)));
+    radius = record.radius * scale;
+}
+
+bool inFrustum(vec3 center, float radius){
+    bool inside = true;
+    for(int i = 0; i < 6; i++){
+        inside = inside && (dot(uFrustum.planes[i].xyz, center) + uFrustum.planes[i].w >= -radius);
+    }
+    return(inside);
+}
+
+/// With 'compact' set, drawn records are packed to the front of the draw buffer and counted for vkCmdDrawIndexedIndirectCount.
+/// Otherwise every record keeps its own slot, and records which aren't drawn are written with an instance count of zero.
+void writeDraw(uint recordIndex, DrawRecord record, bool draw){
+    DrawCommand command = DrawCommand(record.indexCount, draw ? record.instanceCount : 0u, record.firstIndex, record.vertexOffset, record.firstInstance);
+    if(uFrustum.compact != 0u){
+        if(draw){
+            sDraws.data[atomicAdd(sCount.count, 1u)] = command;
+        }
+    }else{
+        sDraws.data[recordIndex] = command;
+    }
+}
+
+#endif
@@ -26,10 +26,11 @@ layout(binding = 2) uniform AnimShadeData {
     uint textureIndex;
 } uAnimShade;
 
-layout(binding = 3) uniform sampler2D texSampler[TEXTURE_ARRAY_SIZE];
+layout(set = 1, binding = 0) uniform sampler2D texSampler[TEXTURE_TABLE_SIZE];
 
 
 void main(){
+    // The index comes from this draw's uniform data, so it is dynamically uniform and needs no nonuniformEXT
     vec4 texColor = texture(texSampler[uAnimShade.textureIndex + 1], texCoord);
 
     float brightnessCoefficient = 2.0f / LIGHTS;
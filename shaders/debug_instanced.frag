@@ -0,0 +1,5 @@
+#version 450 core
+#extension GL_ARB_separate_shader_objects : enable
+
+// For devices without non-uniform indexing, which keep the fixed size texture table
+#include "debug_instanced.inl"
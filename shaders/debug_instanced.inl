@@ -0,0 +1,107 @@
+#ifndef GLSL_DEBUG_INSTANCED_INCLUDE_
+#define GLSL_DEBUG_INSTANCED_INCLUDE_
+#include "shading.inl" // Vulkan pre-compiled glsl allows include statements!
+
+// Body of debug_instanced.frag and debug_instanced_nonuniform.frag. The texture index is read per instance, so it
+// isn't dynamically uniform and may only index the texture table directly with non-uniform indexing.
+
+
+layout(location = 0) in vec3 W_fragNor;
+layout(location = 1) in vec3 W_fragPos;
+layout(location = 2) in vec2 texCoord;
+layout(location = 3) in vec3 W_lightDir[LIGHTS];
+layout(location = 11) flat in uint instanceIndex;
+
+
+layout(location = 0) out vec4 fragColor;
+
+layout(binding = 0) uniform WorldInfo { 
+    mat4 V;
+    mat4 P;
+    vec4 lightPos[LIGHTS];
+} uWorld;
+
+struct AnimShadeData {
+    vec4 diffuseData;
+    vec4 ambientData;
+    vec4 specularData;
+    float shininess;
+    uint shadingLayer;
+    uint textureIndex;
+};
+
+layout(std430, binding = 2) readonly buffer AnimShadeBuffer {
+    AnimShadeData data[];
+} sAnimShade;
+
+layout(set = 1, binding = 0) uniform sampler2D texSampler[TEXTURE_TABLE_SIZE];
+
+#ifdef NONUNIFORM_TEXTURE_INDEX
+vec4 sampleTexture(uint index, vec2 uv){
+    return(texture(texSampler[nonuniformEXT(index)], uv));
+}
+#else
+// Only the loop counter indexes the table, and the gradients are taken before branching on it
+vec4 sampleTexture(uint index, vec2 uv){
+    vec2 dx = dFdx(uv);
+    vec2 dy = dFdy(uv);
+    vec4 color = vec4(0.0);
+    for(uint i = 0; i < TEXTURE_TABLE_SIZE; i++){
+        if(i == index){
+            color = textureGrad(texSampler[i], uv, dx, dy);
+        }
+    }
+    return(color);
+}
+#endif
+
+void main(){
+    // Same as debug.frag, but per-object data comes from the instance's storage buffer element
+    AnimShadeData uAnimShade = sAnimShade.data[instanceIndex];
+    vec4 texColor = sampleTexture(uAnimShade.textureIndex + 1, texCoord);
+
+    float brightnessCoefficient = 2.0f / LIGHTS;
+    vec3 normal = normalize(W_fragNor);
+
+    vec3 diffuse[LIGHTS];
+    vec3 specular[LIGHTS];
+    vec3 H[LIGHTS];
+    vec3 viewDir = normalize(vec3(uWorld.V * vec4(W_fragPos, 1.0f)));
+    
+    for(int i = 0; i < LIGHTS; i++){
+        diffuse[i] = brightnessCoefficient * uAnimShade.diffuseData.xyz * shadeConstantDiffuse(normal, W_lightDir[i]);
+        H[i] = normalize(normalize(uWorld.lightPos[i].xyz + viewDir));
+        specular[i] = brightnessCoefficient * uAnimShade.specularData.xyz * shadeConstantSpecular(H[i],normal,uAnimShade.shininess);
+    }
+    vec3 diffuseCombined = vec3(0.0f);
+    vec3 specularCombined = vec3(0.0f);
+    for(int i = 0; i < LIGHTS; i++){
+        diffuseCombined += diffuse[i];
+        specularCombined += specular[i];
+    }
+    
+    vec3 color = diffuseCombined + specularCombined + vec3(uAnimShade.ambientData);
+    //note: don't do this normally. 
+    //As for why, the above code is only necessary for BLINN_PHONG and TEXTURED_SHADED modes, but it runs anyway.
+    //This might be able to be "fixed" by moving it into a function in shading.inl, but a much cleaner and extensible
+    //future version of this code will separate these into their own shader modules.
+    switch(uAnimShade.shadingLayer){
+        case BLINN_PHONG:
+            fragColor = vec4(color, 1.0);
+            break;
+        case NORMAL_MAP:
+            fragColor = vec4(normal, 1.0); //post-model transformation
+            break;
+        case TEXTURE_MAP:
+            fragColor = vec4(texCoord, 0.0, 1.0); //y is reversed as compared to OpenGL. This is corrected(?) in the vertex shader.
+            break;
+        case TEXTURED_FLAT:
+            fragColor = texColor;
+            break;
+        case TEXTURED_SHADED:
+            fragColor = texColor * vec4(color, 1.0);
+            break;
+    }
+}
+
+#endif
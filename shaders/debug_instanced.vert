@@ -0,0 +1,43 @@
+#version 450 core
+#include "shading.inl" // Vulkan pre-compiled glsl allows include statements!
+
+// Same as debug.vert, but per-object data is read from a storage buffer indexed by gl_InstanceIndex.
+
+layout(location = 0) in vec4 vertPos;
+layout(location = 1) in vec4 vertNor;
+layout(location = 2) in vec2 W_texCoord;
+
+layout(location = 0) out vec3 W_fragNor;
+layout(location = 1) out vec4 W_fragPos;
+layout(location = 2) out vec2 texCoord;
+layout(location = 3) out vec3 W_lightDir[LIGHTS];
+layout(location = 11) flat out uint instanceIndex;
+
+layout(binding = 0) uniform WorldInfo {
+    mat4 V;
+    mat4 P;
+    vec4 lightPos[LIGHTS];
+} uWorld;
+
+struct Transform {
+    mat4 Model;
+};
+
+layout(std430, binding = 1) readonly buffer Transforms {
+    Transform data[];
+} sModel;
+
+void main(){
+    // gl_InstanceIndex already includes the firstInstance of the draw
+    instanceIndex = gl_InstanceIndex;
+    mat4 Model = sModel.data[gl_InstanceIndex].Model;
+
+    texCoord = vec2(W_texCoord.x, -W_texCoord.y); //Vulkan, in its infinite wisdom, inverts the y-coordinate.
+    W_fragPos = Model * vertPos; // Fragment position in world space
+    W_fragNor = mat3(Model) * vertNor.xyz; // Fragment normal in world space
+    
+    for (int i = 0; i < LIGHTS; i++){
+        W_lightDir[i] = (uWorld.lightPos[i].xyz - W_fragPos.xyz); // light vector
+    }
+    gl_Position = uWorld.P * uWorld.V * W_fragPos; // p*v*m
+}
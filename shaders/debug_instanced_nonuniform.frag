@@ -0,0 +1,7 @@
+#version 450 core
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_EXT_nonuniform_qualifier : require
+
+// For devices with bindless textures, which index the texture table with a different value per instance
+#define NONUNIFORM_TEXTURE_INDEX
+#include "debug_instanced.inl"
@@ -2,7 +2,8 @@
 #define GLSL_SHADING_INCLUDE_
 
 const uint LIGHTS = 8;
-const uint TEXTURE_ARRAY_SIZE = 16;
+// Size of the texture table, specialized by the application. 16 unless bindless textures are supported.
+layout(constant_id = 0) const uint TEXTURE_TABLE_SIZE = 16;
 //enums
 const uint BLINN_PHONG     = 0;
 const uint NORMAL_MAP      = 1;
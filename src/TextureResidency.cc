@@ -0,0 +1,162 @@
+#include "TextureResidency.h"
+#include <algorithm>
+#include <cmath>
+
+void TextureResidency::addTexture(size_t aTexture, const std::vector<uint64_t>& aLevelBytes, uint32_t aBaseMip){
+    if(aTexture >= mEntries.size()){
+        mEntries.resize(aTexture + 1);
+    }
+    Entry& entry = mEntries[aTexture];
+    entry = Entry();
+    entry.levelBytes = aLevelBytes;
+    entry.residentBase = std::min(aBaseMip, static_cast<uint32_t>(aLevelBytes.size()));
+    entry.lastUsedFrame = mFrame;
+}
+
+void TextureResidency::markUsed(size_t aTexture, uint32_t aWantedMip){
+    if(!isManaged(aTexture)){
+        return;
+    }
+    Entry& entry = mEntries[aTexture];
+    aWantedMip = std::min(aWantedMip, static_cast<uint32_t>(entry.levelBytes.size()) - 1);
+    entry.wantedBase = entry.usedThisFrame ? std::min(entry.wantedBase, aWantedMip) : aWantedMip;
+    entry.usedThisFrame = true;
+    entry.lastUsedFrame = mFrame;
+}
+
+std::vector<TextureResidency::Change> TextureResidency::endFrame(){
+    // Drawn textures ask for their wanted levels, everything else stays as it is unless the budget is exceeded
+    std::vector<uint32_t> targets(mEntries.size(), 0);
+    uint64_t total = 0;
+    for(size_t i = 0; i < mEntries.size(); ++i){
+        const Entry& entry = mEntries[i];
+        if(entry.levelBytes.empty()){
+            continue;
+        }
+        if(entry.pending){
+            targets[i] = chargedBase(entry);
+        }else if(entry.usedThisFrame){
+            targets[i] = std::min(entry.residentBase, entry.wantedBase);
+        }else{
+            targets[i] = entry.residentBase;
+        }
+        total += bytesFrom(entry, targets[i]);
+    }
+
+    if(mBudget != 0 && total > mBudget){
+        // Textures which weren't drawn this frame give up their levels first, least recently used first
+        std::vector<size_t> idle;
+        for(size_t i = 0; i < mEntries.size(); ++i){
+            const Entry& entry = mEntries[i];
+            if(!entry.levelBytes.empty() && !entry.pending && !entry.usedThisFrame && targets[i] < entry.levelBytes.size()){
+                idle.push_back(i);
+            }
+        }
+        std::sort(idle.begin(), idle.end(), [this](size_t a, size_t b){
+            return(mEntries[a].lastUsedFrame < mEntries[b].lastUsedFrame);
+        });
+        for(size_t i : idle){
+            const Entry& entry = mEntries[i];
+            while(total > mBudget && targets[i] < entry.levelBytes.size()){
+                total -= entry.levelBytes[targets[i]++];
+            }
+            if(total <= mBudget){
+                break;
+            }
+        }
+
+        // Then drawn textures lose their most detailed level, largest first. They always keep their smallest level.
+        while(total > mBudget){
+            size_t largest = mEntries.size();
+            for(size_t i = 0; i < mEntries.size(); ++i){
+                const Entry& entry = mEntries[i];
+                if(entry.levelBytes.empty() || entry.pending || !entry.usedThisFrame || targets[i] + 1 >= entry.levelBytes.size()){
+                    continue;
+                }
+                if(largest == mEntries.size() || entry.levelBytes[targets[i]] > mEntries[largest].levelBytes[targets[largest]]){
+                    largest = i;
+                }
+            }
+            if(largest == mEntries.size()){
+                break;
+            }
+            total -= mEntries[largest].levelBytes[targets[largest]++];
+        }
+    }
+
+    std::vector<Change> changes;
+    size_t pendingLoads = 0;
+    std::vector<size_t> loads;
+    for(size_t i = 0; i < mEntries.size(); ++i){
+        Entry& entry = mEntries[i];
+        if(entry.levelBytes.empty()){
+            continue;
+        }
+        if(entry.pending){
+            pendingLoads += entry.pendingBase < entry.residentBase ? 1 : 0;
+        }else if(targets[i] > entry.residentBase){
+            changes.push_back(Change{i, targets[i]});
+            entry.pending = true;
+            entry.pendingBase = targets[i];
+        }else if(targets[i] < entry.residentBase){
+            loads.push_back(i);
+        }
+    }
+
+    // The textures missing the most levels are loaded first
+    std::stable_sort(loads.begin(), loads.end(), [this, &targets](size_t a, size_t b){
+        return(mEntries[a].residentBase - targets[a] > mEntries[b].residentBase - targets[b]);
+    });
+    for(size_t i : loads){
+        if(pendingLoads >= mMaxPendingLoads){
+            break;
+        }
+        changes.push_back(Change{i, targets[i]});
+        mEntries[i].pending = true;
+        mEntries[i].pendingBase = targets[i];
+        ++pendingLoads;
+    }
+
+    for(Entry& entry : mEntries){
+        entry.usedThisFrame = false;
+    }
+    ++mFrame;
+    return(changes);
+}
+
+void TextureResidency::setResident(size_t aTexture, uint32_t aBaseMip){
+    if(!isManaged(aTexture)){
+        return;
+    }
+    Entry& entry = mEntries[aTexture];
+    entry.residentBase = std::min(aBaseMip, static_cast<uint32_t>(entry.levelBytes.size()));
+    entry.pending = false;
+}
+
+uint64_t TextureResidency::residentBytes() const{
+    uint64_t total = 0;
+    for(const Entry& entry : mEntries){
+        total += bytesFrom(entry, chargedBase(entry));
+    }
+    return(total);
+}
+
+uint32_t TextureResidency::mipForScreenSize(uint32_t aWidth, uint32_t aHeight, float aScreenPixels){
+    float ratio = static_cast<float>(std::max(aWidth, aHeight)) / std::max(aScreenPixels, 1.0f);
+    if(ratio <= 1.0f){
+        return(0);
+    }
+    return(static_cast<uint32_t>(std::floor(std::log2(ratio))));
+}
+
+uint64_t TextureResidency::bytesFrom(const Entry& aEntry, uint32_t aBaseMip){
+    uint64_t total = 0;
+    for(size_t level = aBaseMip; level < aEntry.levelBytes.size(); ++level){
+        total += aEntry.levelBytes[level];
+    }
+    return(total);
+}
+
+uint32_t TextureResidency::chargedBase(const Entry& aEntry){
+    return(aEntry.pending ? std::min(aEntry.residentBase, aEntry.pendingBase) : aEntry.residentBase);
+}
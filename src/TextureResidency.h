@@ -0,0 +1,71 @@
+#ifndef VULKAN_TEXTURE_RESIDENCY_H_
+#define VULKAN_TEXTURE_RESIDENCY_H_
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/** Decides which mip levels of streamed textures stay in device memory. Each frame the textures being drawn are
+ * marked with the most detailed level they need. endFrame() then asks for those levels to be loaded, and keeps the
+ * resident bytes under the budget by dropping the most detailed levels of the least recently used textures first.
+ * It only plans, the texture loader performs the changes and reports back through setResident(). */
+class TextureResidency
+{
+ public:
+    /// A texture whose resident levels should become [baseMip, level count). A baseMip equal to the
+    /// level count evicts the texture completely.
+    struct Change {
+        size_t texture;
+        uint32_t baseMip;
+    };
+
+    /// 'aBudget' of 0 never evicts anything
+    explicit TextureResidency(uint64_t aBudget = 0) : mBudget(aBudget) {}
+
+    void setBudget(uint64_t aBudget) {mBudget = aBudget;}
+    uint64_t getBudget() const {return(mBudget);}
+    /// Loads lowering a texture's base level which may be pending at once. Evictions aren't limited.
+    void setMaxPendingLoads(size_t aCount) {mMaxPendingLoads = aCount;}
+
+    /// Start managing texture 'aTexture', which has 'aLevelBytes[i]' bytes in level i and is resident from 'aBaseMip'.
+    /// Textures which aren't added are never changed.
+    void addTexture(size_t aTexture, const std::vector<uint64_t>& aLevelBytes, uint32_t aBaseMip = 0);
+    bool isManaged(size_t aTexture) const {return(aTexture < mEntries.size() && !mEntries[aTexture].levelBytes.empty());}
+
+    /// Record that the current frame draws 'aTexture' and needs its levels from 'aWantedMip' on.
+    void markUsed(size_t aTexture, uint32_t aWantedMip);
+    /// Ends the frame and returns the changes to make. Textures with a change are pending until setResident().
+    std::vector<Change> endFrame();
+    /// Report that the levels of 'aTexture' from 'aBaseMip' on are now resident.
+    void setResident(size_t aTexture, uint32_t aBaseMip);
+
+    uint32_t residentBaseMip(size_t aTexture) const {return(mEntries[aTexture].residentBase);}
+    bool isPending(size_t aTexture) const {return(mEntries[aTexture].pending);}
+    /// Bytes of every managed level which is resident or being loaded
+    uint64_t residentBytes() const;
+
+    /// The most detailed level worth sampling for a texture covering about 'aScreenPixels' pixels on screen
+    static uint32_t mipForScreenSize(uint32_t aWidth, uint32_t aHeight, float aScreenPixels);
+
+ protected:
+    struct Entry {
+        std::vector<uint64_t> levelBytes;
+        uint32_t residentBase = 0;
+        uint32_t pendingBase = 0;
+        bool pending = false;
+        uint32_t wantedBase = 0;
+        uint64_t lastUsedFrame = 0;
+        bool usedThisFrame = false;
+    };
+
+    /// Bytes of levels [aBaseMip, level count) of 'aEntry'
+    static uint64_t bytesFrom(const Entry& aEntry, uint32_t aBaseMip);
+    /// Levels counted against the budget. A pending change holds both its old and new levels until it completes.
+    static uint32_t chargedBase(const Entry& aEntry);
+
+    std::vector<Entry> mEntries;
+    uint64_t mBudget = 0;
+    uint64_t mFrame = 0;
+    size_t mMaxPendingLoads = 4;
+};
+
+#endif
@@ -5,12 +5,15 @@
 #include "utils/map_merge.h"
 #include "utils/BufferedTimer.h"
 #include "vkutils/VmaHost.h"
+#include "utils/ThreadPool.h"
+#include <glm/gtc/type_ptr.hpp>
 #include <glm/glm.hpp>
 #include <iostream>
 #include <cassert>
 #include <chrono>
 #include <thread>
 #include <numeric>
+#include <cstring>
 
 void VulkanGraphicsApp::init(){
     if(mCoreProvider == nullptr){
@@ -19,10 +22,13 @@ void VulkanGraphicsApp::init(){
 
     initCommandPool();
     initTransferCmdBuffer();
+    buildIndirectDraws();
     transferGeometry();
+    initGpuCullStage();
     initTextures();
     initUniformResources();
     initRenderPipeline();
+    initGpuCullResources();
     initFramebuffers(0); //use the frame buffers initialized in the first render pipeline creation.
     for (int i = 0; i < mNumRenderPipelines; i++) { //initialize command buffers. One for each swapchain image, for each pipeline. Bind the ith pipeline and draw with it.
         initCommands(i);
@@ -34,6 +40,7 @@ void VulkanGraphicsApp::init(){
 //This is why this is called before initializing descriptor sets/layouts, and not during main.
 //The order in which you create these matters, see TextureLoader::getDescriptorImageInfos()
 //and its usage in VulkanGraphicsApp:writeDescriptorSets().
+//Identical images share one texture, so use the indices createTextures() returns when the list may repeat an image.
 //Might rework TextureLoader into using a map again, using same naming as main's objects.
 //The code currently uses array textures, with up to 16 textures per array supported, from what I could find on their minimum support.
 //TODO add fallback for any graphics devices that don't support array textures (query in device setup)
@@ -41,12 +48,25 @@ void VulkanGraphicsApp::initTextures() {
     //give the command pool handle to use in submitting vkCmdCopyBufferToImage command, for one-time transfer to GPU memory
     textureLoader.setup(mCommandPool);
     
-    textureLoader.createTexture(STRIFY(ASSET_DIR) "/ballTex.png");
-    textureLoader.createTexture(STRIFY(ASSET_DIR) "crate.jpg");
-    textureLoader.createTexture(STRIFY(ASSET_DIR) "flower.jpg");
-    textureLoader.createTexture(STRIFY(ASSET_DIR) "Lantern/Lantern_emissive.png");
-    textureLoader.createTexture(STRIFY(ASSET_DIR) "Lantern/Lantern_baseColor.png");
-    textureLoader.createTexture(STRIFY(ASSET_DIR) "CesiumMilkTruck/CesiumMilkTruck.jpg");
+    textureLoader.createTextures({
+        STRIFY(ASSET_DIR) "/ballTex.png",
+        STRIFY(ASSET_DIR) "crate.jpg",
+        STRIFY(ASSET_DIR) "flower.jpg",
+        STRIFY(ASSET_DIR) "Lantern/Lantern_emissive.png",
+        STRIFY(ASSET_DIR) "Lantern/Lantern_baseColor.png",
+        STRIFY(ASSET_DIR) "CesiumMilkTruck/CesiumMilkTruck.jpg"
+    });
+    //writes every texture into one table per swapchain image, uploading the debug texture queued by setup()
+    textureLoader.initDescriptorTable(mSwapchainProvider->getSwapchainBundle().images.size());
+}
+
+void VulkanGraphicsApp::commitTextures(){
+    textureLoader.updateDescriptorTable();
+    // A fixed size texture array was rewritten, which invalidates the command buffers binding it
+    if(!textureLoader.isBindless() && !mCommandBuffers.empty()){
+        vkDeviceWaitIdle(getPrimaryDeviceBundle().logicalDevice.handle());
+        rerecordCommands();
+    }
 }
 
 const VkExtent2D& VulkanGraphicsApp::getFramebufferSize() const{
@@ -75,27 +95,136 @@ void VulkanGraphicsApp::setFragmentShader(const std::string& aShaderName, const
     }
 }
 
-void VulkanGraphicsApp::initMultis(const UniformDataLayoutSet& aUniformLayout){
+void VulkanGraphicsApp::initMultis(const UniformDataLayoutSet& aUniformLayout, MultiInstanceUniformBuffer::BufferMode aMode){
     mMultiUniformBuffer = std::make_shared<MultiInstanceUniformBuffer>(
         getPrimaryDeviceBundle(),
         aUniformLayout,
         0, // Instances to start with
-        16 // Capacity to start with
+        16, // Capacity to start with
+        VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+        aMode
     );
 }
 
 
+/// The model transform among a shape's uniform data, or nullptr if it has none. Its binding is written to 'aBindingOut'.
+static UniformTransformDataPtr find_transform(const UniformDataInterfaceSet& aUniformData, std::optional<uint32_t>& aBindingOut){
+    for(const std::pair<const uint32_t, UniformDataInterfacePtr>& binding : aUniformData){
+        UniformTransformDataPtr transform = std::dynamic_pointer_cast<UniformTransformData>(binding.second);
+        if(transform != nullptr){
+            aBindingOut = binding.first;
+            return(transform);
+        }
+    }
+    return(nullptr);
+}
+
 void VulkanGraphicsApp::addMultiShapeObject(const ObjMultiShapeGeometry& mObject, const std::vector<UniformDataInterfaceSet>& aUniformData){
-    mMultiShapeObjects.emplace_back(mObject);
     if(mMultiUniformBuffer == nullptr){
         throw std::runtime_error("initMultiShapeUniformBuffer() must be called before addMultiShapeObject()!");
     }
+    if(mTransferCmdBuffer != VK_NULL_HANDLE){
+        // Growing the uniform buffer replaces the one frames in flight read from. This also covers refreshSceneResources().
+        vkDeviceWaitIdle(getPrimaryDeviceBundle().logicalDevice.handle());
+    }
+    mMultiShapeObjects.emplace_back(mObject);
+    mMultiShapeInstanceCounts.emplace_back(1U);
+    mMultiShapeMeshIds.emplace_back(mGeometryPool.addMesh(mObject.getVertices(), mObject.mIndicesConcat));
+    // With one set of uniform data per shape, each shape can be culled by its own transform
+    std::vector<UniformTransformDataPtr> transforms;
     for (const auto& instanceData : aUniformData) {
         mMultiUniformBuffer->pushBackInstance(instanceData);
+        transforms.push_back(find_transform(instanceData, mTransformBinding));
+    }
+    if(transforms.size() != mObject.shapeCount()){
+        transforms.clear();
+    }
+    mMultiShapeTransforms.emplace_back(transforms);
+    mOccluderMeshes.clear();
+    if(mTransferCmdBuffer != VK_NULL_HANDLE){
+        refreshSceneResources();
+    }
+}
+
+void VulkanGraphicsApp::addInstancedMultiShapeObject(const ObjMultiShapeGeometry& aObject, uint32_t aInstanceCount, const std::vector<UniformDataInterfaceSet>& aUniformData){
+    if(mMultiUniformBuffer == nullptr){
+        throw std::runtime_error("initMultiShapeUniformBuffer() must be called before addInstancedMultiShapeObject()!");
+    }
+    if(mMultiUniformBuffer->getBufferMode() != MultiInstanceUniformBuffer::BufferMode::INSTANCE_STORAGE){
+        throw std::runtime_error("addInstancedMultiShapeObject() requires multi-shape uniforms to be initialized in INSTANCE_STORAGE mode!");
+    }
+    if(aUniformData.size() != aObject.shapeCount() * aInstanceCount){
+        throw std::runtime_error("addInstancedMultiShapeObject() expects one set of uniform data per shape per instance!");
+    }
+
+    if(!aObject.descriptorSetPositions().empty()){
+        throw std::runtime_error("addInstancedMultiShapeObject() assigns descriptor set positions, but the object already has some!");
+    }
+    if(mTransferCmdBuffer != VK_NULL_HANDLE){
+        // Growing the uniform buffer replaces the one frames in flight read from. This also covers refreshSceneResources().
+        vkDeviceWaitIdle(getPrimaryDeviceBundle().logicalDevice.handle());
+    }
+
+    // Instances of each shape are contiguous, so each shape draws all of them starting at its firstInstance
+    ObjMultiShapeGeometry object = aObject;
+    size_t firstInstance = mMultiUniformBuffer->getInstanceCount();
+    for(size_t shapeIdx = 0; shapeIdx < object.shapeCount(); ++shapeIdx){
+        object.setDescriptorSetPosition(firstInstance + shapeIdx * aInstanceCount);
+    }
+    for(const UniformDataInterfaceSet& instanceData : aUniformData){
+        mMultiUniformBuffer->pushBackInstance(instanceData);
+        find_transform(instanceData, mTransformBinding);
     }
+    mMultiShapeObjects.emplace_back(object);
+    mMultiShapeInstanceCounts.emplace_back(aInstanceCount);
+    // Instances of a shape share one draw, so they are only culled one by one on the GPU
+    mMultiShapeTransforms.emplace_back();
+    mMultiShapeMeshIds.emplace_back(mGeometryPool.addMesh(object.getVertices(), object.mIndicesConcat));
+    mOccluderMeshes.clear();
+
     if(mTransferCmdBuffer != VK_NULL_HANDLE){
-        transferGeometry();
-        reinitUniformResources();
+        refreshSceneResources();
+    }
+}
+
+void VulkanGraphicsApp::removeMultiShapeObject(size_t aObjectIndex){
+    if(aObjectIndex >= mMultiShapeObjects.size()){
+        throw std::runtime_error("removeMultiShapeObject() Error: Object " + std::to_string(aObjectIndex) + " does not exist!");
+    }
+    if(mTransferCmdBuffer != VK_NULL_HANDLE){
+        // refreshSceneResources() replaces resources that frames in flight read from
+        vkDeviceWaitIdle(getPrimaryDeviceBundle().logicalDevice.handle());
+    }
+    mGeometryPool.removeMesh(mMultiShapeMeshIds[aObjectIndex]);
+    mMultiShapeObjects.erase(mMultiShapeObjects.begin() + aObjectIndex);
+    mMultiShapeInstanceCounts.erase(mMultiShapeInstanceCounts.begin() + aObjectIndex);
+    mMultiShapeMeshIds.erase(mMultiShapeMeshIds.begin() + aObjectIndex);
+    mMultiShapeTransforms.erase(mMultiShapeTransforms.begin() + aObjectIndex);
+    // Occluders are indexed by shape over all objects, so they're simplified again on the next cull
+    mOccluderMeshes.clear();
+
+    if(mTransferCmdBuffer != VK_NULL_HANDLE){
+        refreshSceneResources();
+    }
+}
+
+void VulkanGraphicsApp::refreshSceneResources(){
+    buildIndirectDraws();
+    // Pooled geometry buffers may be replaced by the upload
+    transferGeometry();
+    // New instances may have grown the uniform buffer, which the descriptor sets point into
+    reinitUniformResources();
+    // Culling buffers are sized by the number of draw records
+    cleanupGpuCullResources();
+    initGpuCullResources();
+    rerecordCommands();
+}
+
+void VulkanGraphicsApp::rerecordCommands(){
+    vkFreeCommandBuffers(getPrimaryDeviceBundle().logicalDevice.handle(), mCommandPool, mCommandBuffers.size(), mCommandBuffers.data());
+    mCommandBuffers.clear();
+    for(int i = 0; i < mNumRenderPipelines; i++){
+        initCommands(i);
     }
 }
 
@@ -132,23 +261,36 @@ void VulkanGraphicsApp::resetRenderSetup(){
     mSwapchainProvider->cleanupSwapchain();
 
     mSwapchainProvider->initSwapchain();
+    textureLoader.setTableCount(mSwapchainProvider->getSwapchainBundle().images.size());
     initUniformResources();
     initRenderPipeline();
+    initGpuCullResources();
     initFramebuffers(0);
     for (int i = 0; i < mNumRenderPipelines; i++) {
         initCommands(i);
     }
     initSync();
 
-    SwapchainProvider::sWindowFlags[mSwapchainProvider->getWindowPtr()].resized = false;
+    if(!isHeadless()){
+        SwapchainProvider::sWindowFlags[mSwapchainProvider->getWindowPtr()].resized = false;
+    }
 }
 
 void VulkanGraphicsApp::render(int currentPipeline){
     uint32_t targetImageIndex = 0;
     size_t syncObjectIndex = mFrameNumber % IN_FLIGHT_FRAME_LIMIT;
 
+    // Swap in streamed texture levels before anything is recorded for this frame. Each image's texture table
+    // takes them once the frames using that table have finished, see refreshTextureTable().
+    textureLoader.updateResidency();
+
     vkWaitForFences(getPrimaryDeviceBundle().logicalDevice.handle(), 1, &mInFlightFences[syncObjectIndex], VK_TRUE, std::numeric_limits<uint64_t>::max());
 
+    if(isHeadless()){
+        renderHeadless(currentPipeline, syncObjectIndex);
+        return;
+    }
+
     VkResult result = vkAcquireNextImageKHR(getPrimaryDeviceBundle().logicalDevice.handle(),
         mSwapchainProvider->getSwapchainBundle().swapchain, std::numeric_limits<uint64_t>::max(),
         mImageAvailableSemaphores[syncObjectIndex], VK_NULL_HANDLE, &targetImageIndex
@@ -165,19 +307,33 @@ void VulkanGraphicsApp::render(int currentPipeline){
         throw std::runtime_error("Failed to get next image in swapchain!");
     }
 
+    // Uniform data is kept in one frame slot per swapchain image. Images may be acquired out of order,
+    // so make sure the last frame which rendered to this image (and read its slot) has finished. 
+    if(mImagesInFlight[targetImageIndex] != VK_NULL_HANDLE){
+        vkWaitForFences(getPrimaryDeviceBundle().logicalDevice.handle(), 1, &mImagesInFlight[targetImageIndex], VK_TRUE, std::numeric_limits<uint64_t>::max());
+    }
+    mImagesInFlight[targetImageIndex] = mInFlightFences[syncObjectIndex];
+    readOcclusionStats(targetImageIndex);
+    refreshTextureTable(targetImageIndex);
+
+    // Culled or parallel frames are recorded now, otherwise the commands recorded by initCommands() are reused
+    VkCommandBuffer commandBuffer = recordsEachFrame() ? recordFrame(currentPipeline, targetImageIndex, syncObjectIndex) :
+        mCommandBuffers[targetImageIndex + (mSwapchainFramebuffers.size() * currentPipeline)];
+
     const static VkPipelineStageFlags waitStages = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
     VkSubmitInfo submitInfo = {
         VK_STRUCTURE_TYPE_SUBMIT_INFO, nullptr,
         1, &mImageAvailableSemaphores[syncObjectIndex], &waitStages,
-        1, &mCommandBuffers[targetImageIndex + (mSwapchainFramebuffers.size() * currentPipeline) ],
+        1, &commandBuffer,
         1, &mRenderFinishSemaphores[syncObjectIndex]
     };
 
     vkResetFences(getPrimaryDeviceBundle().logicalDevice.handle(), 1, &mInFlightFences[syncObjectIndex]);
     
-    mMultiUniformBuffer->updateDevice();
-    mSingleUniformBuffer.updateDevice();
-    //write an updateDevice for TextureLoader if you want to update textures on-device
+    // Only the slot read by this frame is written. Slots of frames still in flight are left alone.
+    mMultiUniformBuffer->updateDevice(targetImageIndex);
+    mSingleUniformBuffer.updateDevice(targetImageIndex);
+    updateGpuCullFrustum(targetImageIndex);
 
     if(vkQueueSubmit(getPrimaryDeviceBundle().logicalDevice.getGraphicsQueue(), 1, &submitInfo, mInFlightFences[syncObjectIndex]) != VK_SUCCESS){
         throw std::runtime_error("Submit to graphics queue failed!");
@@ -199,17 +355,52 @@ void VulkanGraphicsApp::render(int currentPipeline){
     ++mFrameNumber;
 }
 
+void VulkanGraphicsApp::renderHeadless(int currentPipeline, size_t aSyncObjectIndex){
+    // There is nothing to acquire from or present to. Images in the offscreen ring are used in 
+    // order, and the ring holds one image per in-flight frame so the fence waited on in render() 
+    // guarantees the target image is no longer in use. 
+    uint32_t targetImageIndex = static_cast<uint32_t>(mFrameNumber % mSwapchainFramebuffers.size());
+    readOcclusionStats(targetImageIndex);
+    refreshTextureTable(targetImageIndex);
+
+    VkCommandBuffer commandBuffer = recordsEachFrame() ? recordFrame(currentPipeline, targetImageIndex, aSyncObjectIndex) :
+        mCommandBuffers[targetImageIndex + (mSwapchainFramebuffers.size() * currentPipeline)];
+
+    VkSubmitInfo submitInfo = vkutils::sSingleSubmitTemplate;
+    submitInfo.pCommandBuffers = &commandBuffer;
+
+    vkResetFences(getPrimaryDeviceBundle().logicalDevice.handle(), 1, &mInFlightFences[aSyncObjectIndex]);
+
+    mMultiUniformBuffer->updateDevice(targetImageIndex);
+    mSingleUniformBuffer.updateDevice(targetImageIndex);
+    updateGpuCullFrustum(targetImageIndex);
+
+    if(vkQueueSubmit(getPrimaryDeviceBundle().logicalDevice.getGraphicsQueue(), 1, &submitInfo, mInFlightFences[aSyncObjectIndex]) != VK_SUCCESS){
+        throw std::runtime_error("Submit to graphics queue failed!");
+    }
+
+    ++mFrameNumber;
+}
+
 void VulkanGraphicsApp::initCore(){
     mCoreProvider = std::make_shared<VulkanSetupCore>();
     CoreLink::mCoreProvider = mCoreProvider.get();
-    mSwapchainProvider = std::make_shared<SwapchainProvider>();
+    if(isHeadless()){
+        std::shared_ptr<HeadlessProvider> headless = std::make_shared<HeadlessProvider>();
+        // One offscreen image per in-flight frame, so the in-flight fence also guards image reuse.
+        headless->setImageCount(IN_FLIGHT_FRAME_LIMIT);
+        mSwapchainProvider = headless;
+    }else{
+        std::shared_ptr<SwapchainProvider> swapchain = std::make_shared<SwapchainProvider>();
+        swapchain->initGlfw();
+        mSwapchainProvider = swapchain;
+    }
 
     mCoreProvider->linkHostApp(this);
 
     mSwapchainProvider->setCoreProvider(mCoreProvider.get());
     mCoreProvider->linkPresentationProvider(mSwapchainProvider.get());
     
-    mSwapchainProvider->initGlfw();
     mCoreProvider->initVkInstance();
     mCoreProvider->initVkPhysicalDevice();
     mSwapchainProvider->initPresentationSurface();
@@ -217,6 +408,9 @@ void VulkanGraphicsApp::initCore(){
     mSwapchainProvider->initSwapchain();
 
     mSingleUniformBuffer.updateDevice(getPrimaryDeviceBundle());
+    mGeometryPool.initDevice(getPrimaryDeviceBundle());
+    mIndirectDrawBuffer.initDevice(getPrimaryDeviceBundle());
+    mCullRecordBuffer.initDevice(getPrimaryDeviceBundle());
     textureLoader = TextureLoader(getPrimaryDeviceBundle());
 }
 
@@ -224,7 +418,8 @@ void VulkanGraphicsApp::initCommandPool(){
     VkCommandPoolCreateInfo poolInfo;{
         poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
         poolInfo.pNext = nullptr;
-        poolInfo.flags = 0;
+        // Commands of a single image are recorded again when streaming rewrites its texture table
+        poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
         poolInfo.queueFamilyIndex = *getPrimaryDeviceBundle().physicalDevice.mGraphicsIdx;
     }
 
@@ -236,6 +431,27 @@ void VulkanGraphicsApp::initCommandPool(){
     assert(mCommandPool != VK_NULL_HANDLE);
 }
 
+/// Create a render pass from the attachments of 'aCtorSet', as VulkanBasicRasterPipelineBuilder::build() does
+static VkRenderPass create_render_pass(VkDevice aDevice, const vkutils::RenderPassConstructionSet& aCtorSet){
+    std::array<VkAttachmentDescription, 2> attachments = {aCtorSet.mColorAttachment, aCtorSet.mDepthAttachment};
+    VkRenderPassCreateInfo renderPassInfo;{
+        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+        renderPassInfo.pNext = nullptr;
+        renderPassInfo.flags = 0;
+        renderPassInfo.attachmentCount = attachments.size();
+        renderPassInfo.pAttachments = attachments.data();
+        renderPassInfo.subpassCount = 1;
+        renderPassInfo.pSubpasses = &aCtorSet.mSubpass;
+        renderPassInfo.dependencyCount = 1;
+        renderPassInfo.pDependencies = &aCtorSet.mDependency;
+    }
+    VkRenderPass renderPass = VK_NULL_HANDLE;
+    if(vkCreateRenderPass(aDevice, &renderPassInfo, nullptr, &renderPass) != VK_SUCCESS){
+        throw std::runtime_error("Failed to create render pass!");
+    }
+    return(renderPass);
+}
+
 void VulkanGraphicsApp::initRenderPipeline(){
     if(mVertexKey.empty()){
         throw std::runtime_error("Error! No vertex shader has been set! A vertex shader must be set using setVertexShader()!");
@@ -248,7 +464,9 @@ void VulkanGraphicsApp::initRenderPipeline(){
     for (int i = 0; i < mNumRenderPipelines; i++) {
         ctorSets.emplace_back(mRenderPipelines[i].setupConstructionSet(VulkanDeviceHandlePair(getPrimaryDeviceBundle()), &mSwapchainProvider->getSwapchainBundle()));
     }
-    ctorSets[1].mDepthBundle = ctorSets[0].mDepthBundle = vkutils::VulkanBasicRasterPipelineBuilder::autoCreateDepthBuffer(ctorSets[0]);
+    // The depth pyramid is built by sampling the depth buffer
+    VkImageUsageFlags depthUsage = useOcclusionCulling() ? VK_IMAGE_USAGE_SAMPLED_BIT : 0;
+    ctorSets[1].mDepthBundle = ctorSets[0].mDepthBundle = vkutils::VulkanBasicRasterPipelineBuilder::autoCreateDepthBuffer(ctorSets[0], depthUsage);
     mDepthBundle = ctorSets[0].mDepthBundle;
     for (int i = 0; i < mNumRenderPipelines; i++) {
         vkutils::VulkanBasicRasterPipelineBuilder::prepareFixedStages(ctorSets[i]);
@@ -286,6 +504,15 @@ void VulkanGraphicsApp::initRenderPipeline(){
         vertStageInfo.pName = "main";
         vertStageInfo.pSpecializationInfo = nullptr;
     }
+    // Specialization constant 0 sizes the fragment shader's texture table
+    uint32_t textureTableSize = textureLoader.capacity();
+    VkSpecializationMapEntry textureTableEntry = {0, 0, sizeof(uint32_t)};
+    VkSpecializationInfo fragSpecialization;{
+        fragSpecialization.mapEntryCount = 1;
+        fragSpecialization.pMapEntries = &textureTableEntry;
+        fragSpecialization.dataSize = sizeof(uint32_t);
+        fragSpecialization.pData = &textureTableSize;
+    }
     VkPipelineShaderStageCreateInfo fragStageInfo;{
         fragStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
         fragStageInfo.pNext = nullptr;
@@ -293,9 +520,11 @@ void VulkanGraphicsApp::initRenderPipeline(){
         fragStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
         fragStageInfo.module = fragShader;
         fragStageInfo.pName = "main";
-        fragStageInfo.pSpecializationInfo = nullptr;
+        fragStageInfo.pSpecializationInfo = &fragSpecialization;
     }
 
+    // Set 0 holds the uniform data, set 1 the texture table
+    std::array<VkDescriptorSetLayout, 2> setLayouts = {mUniformDescriptorSetLayout, textureLoader.getDescriptorSetLayout()};
     for (int i = 0; i < mNumRenderPipelines; i++) {
         ctorSets[i].mProgrammableStages.emplace_back(vertStageInfo);
         ctorSets[i].mProgrammableStages.emplace_back(fragStageInfo);
@@ -308,13 +537,17 @@ void VulkanGraphicsApp::initRenderPipeline(){
         ctorSets[i].mPipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
         ctorSets[i].mPipelineLayoutInfo.pNext = 0;
         ctorSets[i].mPipelineLayoutInfo.flags = 0;
-        ctorSets[i].mPipelineLayoutInfo.setLayoutCount = 1;
-        ctorSets[i].mPipelineLayoutInfo.pSetLayouts = &mUniformDescriptorSetLayout;
+        ctorSets[i].mPipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(setLayouts.size());
+        ctorSets[i].mPipelineLayoutInfo.pSetLayouts = setLayouts.data();
         ctorSets[i].mPipelineLayoutInfo.pushConstantRangeCount = 0;
         ctorSets[i].mPipelineLayoutInfo.pPushConstantRanges = nullptr;
 
         vkutils::VulkanBasicRasterPipelineBuilder::prepareViewport(ctorSets[i]);
         vkutils::VulkanBasicRasterPipelineBuilder::prepareRenderPass(ctorSets[i]);
+        if(isHeadless()){
+            // PRESENT_SRC_KHR is only valid with VK_KHR_swapchain. Leave offscreen images ready to be copied out instead.
+            ctorSets[i].mRenderpassCtorSet.mColorAttachment.finalLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        }
     }
     
 
@@ -322,6 +555,27 @@ void VulkanGraphicsApp::initRenderPipeline(){
     //set the polygon fill mode to do wireframe for the second pipeline.
     ctorSets[1].mRasterInfo.polygonMode = VK_POLYGON_MODE_LINE;
     mRenderPipelines[1].build(ctorSets[1]);
+
+    if(useOcclusionCulling()){
+        // Only the load and store behaviour differs, so both stay compatible with the pipelines' render pass
+        vkutils::RenderPassConstructionSet firstPass = ctorSets[0].mRenderpassCtorSet;
+        firstPass.mColorAttachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        // The depth buffer is cleared over the last frame's second pass and depth pyramid
+        firstPass.mDependency.srcStageMask |= VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+        firstPass.mDependency.dstStageMask |= VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+        firstPass.mDependency.srcAccessMask |= VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        firstPass.mDependency.dstAccessMask |= VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        mOcclusionRenderPasses[0] = create_render_pass(getPrimaryDeviceBundle().logicalDevice.handle(), firstPass);
+
+        vkutils::RenderPassConstructionSet secondPass = ctorSets[0].mRenderpassCtorSet;
+        secondPass.mColorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+        secondPass.mColorAttachment.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        secondPass.mDepthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+        secondPass.mDepthAttachment.initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+        // Draws over the color of the first pass. The depth buffer is handed back by recordOcclusionPass().
+        secondPass.mDependency.srcAccessMask |= VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        mOcclusionRenderPasses[1] = create_render_pass(getPrimaryDeviceBundle().logicalDevice.handle(), secondPass);
+    }
 }
 
 void VulkanGraphicsApp::initCommands(int currentRenderPipeline){
@@ -339,88 +593,383 @@ void VulkanGraphicsApp::initCommands(int currentRenderPipeline){
         throw std::runtime_error("Failed to allocate command buffers!");
     }
     mCommandBuffers.insert(mCommandBuffers.end(), buffers.begin(), buffers.end());
-    for(size_t i = mSwapchainFramebuffers.size() * currentRenderPipeline; i < mSwapchainFramebuffers.size() * (currentRenderPipeline + 1); ++i){
-        size_t totalShapeIdx = 0;
-        VkCommandBufferBeginInfo beginInfo = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO, nullptr, 0 , nullptr};
-        if(vkBeginCommandBuffer(mCommandBuffers[i], &beginInfo) != VK_SUCCESS){
-            throw std::runtime_error("Failed to begin command recording!");
+    for(size_t image = 0; image < mSwapchainFramebuffers.size(); ++image){
+        recordImageCommands(currentRenderPipeline, image);
+    }
+}
+
+void VulkanGraphicsApp::recordImageCommands(int aPipeline, size_t aImageIndex){
+    size_t i = aImageIndex + mSwapchainFramebuffers.size() * aPipeline;
+    // Beginning a recorded command buffer resets it
+    VkCommandBufferBeginInfo beginInfo = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO, nullptr, 0 , nullptr};
+    if(vkBeginCommandBuffer(mCommandBuffers[i], &beginInfo) != VK_SUCCESS){
+        throw std::runtime_error("Failed to begin command recording!");
+    }
+    recordGpuCull(mCommandBuffers[i], aImageIndex);
+    recordDrawCommands(mCommandBuffers[i], aPipeline, aImageIndex, nullptr);
+    recordOcclusionPass(mCommandBuffers[i], aPipeline, aImageIndex);
+    if(vkEndCommandBuffer(mCommandBuffers[i]) != VK_SUCCESS){
+        throw std::runtime_error("Failed to end command buffer " + std::to_string(i));
+    }
+}
+
+void VulkanGraphicsApp::refreshTextureTable(size_t aImageIndex){
+    // A fixed size array written after recording invalidates the commands of every pipeline binding it.
+    // They aren't pending, since the last frame rendered to this image has finished.
+    if(textureLoader.refreshTable(aImageIndex) && !textureLoader.isBindless()){
+        for(int pipeline = 0; pipeline < mNumRenderPipelines; ++pipeline){
+            recordImageCommands(pipeline, aImageIndex);
         }
+    }
+}
+
+void VulkanGraphicsApp::recordDrawCommands(VkCommandBuffer aCmdBuffer, int aPipeline, size_t aImageIndex, const std::vector<uint8_t>* aVisibleShapes){
+    VkRenderPassBeginInfo renderBegin = renderPassBegin(aPipeline, aImageIndex);
+    vkCmdBeginRenderPass(aCmdBuffer, &renderBegin, VK_SUBPASS_CONTENTS_INLINE);
+    recordDrawRange(aCmdBuffer, aPipeline, aImageIndex, 0, totalShapeCount(), aVisibleShapes);
+    vkCmdEndRenderPass(aCmdBuffer);
+}
+
+/// Color and depth values every frame starts from
+static const std::array<VkClearValue, 2>& clear_values(){
+    static const std::array<VkClearValue, 2> sClearValues = [](){
+        std::array<VkClearValue, 2> values;
         //the background
-        std::array<VkClearValue, 2> clearValues;
-        clearValues[0].color = {{0.7f, 0.7f, 0.7f, 1.0f}};
-        clearValues[1].depthStencil = {1.0f, 0};
-
-        VkRenderPassBeginInfo renderBegin;{
-            renderBegin.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-            renderBegin.pNext = nullptr;
-            renderBegin.renderPass = mRenderPipelines[currentRenderPipeline].getRenderpass();
-            renderBegin.framebuffer = mSwapchainFramebuffers[i % mSwapchainFramebuffers.size()];
-            renderBegin.renderArea = {{0,0}, mSwapchainProvider->getSwapchainBundle().extent};
-            renderBegin.clearValueCount = clearValues.size();
-            renderBegin.pClearValues = clearValues.data();
-        }
-
-        vkCmdBeginRenderPass(mCommandBuffers[i], &renderBegin, VK_SUBPASS_CONTENTS_INLINE);
-        vkCmdBindPipeline(mCommandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, mRenderPipelines[currentRenderPipeline].handle());
-        
-        for(size_t objIdx = 0; objIdx < mMultiShapeObjects.size(); ++objIdx){
+        values[0].color = {{0.7f, 0.7f, 0.7f, 1.0f}};
+        values[1].depthStencil = {1.0f, 0};
+        return(values);
+    }();
+    return(sClearValues);
+}
+
+VkRenderPassBeginInfo VulkanGraphicsApp::renderPassBegin(int aPipeline, size_t aImageIndex) const{
+    VkRenderPassBeginInfo renderBegin;{
+        renderBegin.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+        renderBegin.pNext = nullptr;
+        // With occlusion culling this is the first of two passes
+        renderBegin.renderPass = useOcclusionCulling() ? mOcclusionRenderPasses[0] : mRenderPipelines[aPipeline].getRenderpass();
+        renderBegin.framebuffer = mSwapchainFramebuffers[aImageIndex];
+        renderBegin.renderArea = {{0,0}, mSwapchainProvider->getSwapchainBundle().extent};
+        renderBegin.clearValueCount = clear_values().size();
+        renderBegin.pClearValues = clear_values().data();
+    }
+    return(renderBegin);
+}
 
-            // Bind vertex buffer for object
-            vkCmdBindVertexBuffers(mCommandBuffers[i], 0, 1U, &mMultiShapeObjects[objIdx].getVertexBuffer(), std::array<VkDeviceSize, 1>{0}.data());
+size_t VulkanGraphicsApp::totalShapeCount() const{
+    size_t shapeTotal = 0;
+    for(const ObjMultiShapeGeometry& object : mMultiShapeObjects){
+        shapeTotal += object.shapeCount();
+    }
+    return(shapeTotal);
+}
 
-            // Bind uniforms to graphics pipeline if they exist with correct dynamic offset for this object instance
-            
+void VulkanGraphicsApp::recordDrawRange(VkCommandBuffer aCmdBuffer, int aPipeline, size_t aImageIndex, size_t aFirstShape, size_t aEndShape, const std::vector<uint8_t>* aVisibleShapes, uint32_t aCullList) const{
+    // Nothing is inherited by secondary command buffers, so every range binds its own state
+    vkCmdBindPipeline(aCmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, mRenderPipelines[aPipeline].handle());
+
+    // Each swapchain image has its own texture table, shared by every draw
+    VkDescriptorSet textureTable = textureLoader.getDescriptorSet(aImageIndex);
+    vkCmdBindDescriptorSets(
+        aCmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, mRenderPipelines[aPipeline].getLayout(),
+        1, 1, &textureTable, 0, nullptr
+    );
 
-            // Bind index buffer for each shape and issue draw command.
-            // The previous version of this code bound the index buffer with an offset of
-            // mMultiShapeObjects[objIdx].getShapeRange(shapeIdx), and left the first index
-            // of vkCmdDrawIndexed at 0. Now, the whole index buffer is bound, and the first index of the draw
-            // is offset based on this amount. Now the bind command only has to be run once for each object,
-            // rather than once for each shape in each object.
-            vkCmdBindIndexBuffer(
-            /*command buffer*/   mCommandBuffers[i],
-            /*index buffer*/     mMultiShapeObjects[objIdx].getIndexBuffer(),
-            /*offset*/           0U,
-            /*index type*/       VK_INDEX_TYPE_UINT32);
-            for(size_t shapeIdx = 0; shapeIdx < mMultiShapeObjects[objIdx].shapeCount(); ++shapeIdx){
-                auto val1 = mMultiUniformBuffer->dynamicOffsetCount();
-                auto val2 = mMultiUniformBuffer->getDynamicOffsets(objIdx);
-
-
-                // the dynamic offset argument is equivalent to 
-                // the index of the shape of the current model, plus all of the shapes that were drawn before it in this render pass. 
-                // It is used to index into the descriptor set for that particular shape, and bind it before drawing.
-                if (mMultiUniformBuffer->boundLayoutCount() > 0 || mSingleUniformBuffer.boundInterfaceCount() > 0) {
-                    vkCmdBindDescriptorSets(
-                        /*command buffer to bind to*/  mCommandBuffers[i],
-                        /*pipeline bind point*/        VK_PIPELINE_BIND_POINT_GRAPHICS,
-                        /*vkpipelinelayout obj*/       mRenderPipelines[currentRenderPipeline].getLayout(),
-                        /*firstSet*/                   0,
-                        /*descriptorset count*/        1,
-                        /*pDescriptorSets*/            &mUniformDescriptorSets[i % mSwapchainFramebuffers.size()],
-                        /*dynamic offset count*/       mMultiUniformBuffer->dynamicOffsetCount(),
-                        /*dynamic offsets array*/      mMultiUniformBuffer->getDynamicOffsets(mMultiShapeObjects[objIdx].descriptorSetPositions()[shapeIdx])
+    // Storage buffer instance data is indexed in the shaders, so the whole scene shares one bind.
+    bool instanceStorage = mMultiUniformBuffer->getBufferMode() == MultiInstanceUniformBuffer::BufferMode::INSTANCE_STORAGE;
+    if(instanceStorage){
+        vkCmdBindDescriptorSets(
+            aCmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, mRenderPipelines[aPipeline].getLayout(),
+            0, 1, &mUniformDescriptorSets[aImageIndex], 0, nullptr
+        );
+    }
+
+    const VulkanPhysicalDevice& physicalDevice = getPrimaryDeviceBundle().physicalDevice;
+    bool indirectDraws = useIndirectDraws();
+    uint32_t maxIndirectDrawCount = physicalDevice.mFeatures.multiDrawIndirect ? physicalDevice.mProperties.limits.maxDrawIndirectCount : 1U;
+
+    // All objects live in the pooled buffers and are selected by vertex offset and first index,
+    // so the geometry is bound only once per range.
+    vkCmdBindVertexBuffers(aCmdBuffer, 0, 1U, &mGeometryPool.getVertexBuffer(), std::array<VkDeviceSize, 1>{0}.data());
+    vkCmdBindIndexBuffer(
+    /*command buffer*/   aCmdBuffer,
+    /*index buffer*/     mGeometryPool.getIndexBuffer(),
+    /*offset*/           0U,
+    /*index type*/       VK_INDEX_TYPE_UINT32);
+
+    // With GPU culling the draws written for this image by the culling stage are drawn all at once,
+    // with their count read on the device where possible.
+    if(indirectDraws && useGpuCulling()){
+        if(aFirstShape == 0 && mCullOutputBuffer != VK_NULL_HANDLE){
+            VkDeviceSize countOffset = cullOutputOffset(aImageIndex, aCullList);
+            VkDeviceSize drawOffset = countOffset + mCullCountStride;
+            if(mDrawIndexedIndirectCount != nullptr){
+                mDrawIndexedIndirectCount(aCmdBuffer, mCullOutputBuffer, drawOffset, mCullOutputBuffer, countOffset, std::min(mCullRecordCount, maxIndirectDrawCount), sizeof(VkDrawIndexedIndirectCommand));
+            }else{
+                for(uint32_t first = 0; first < mCullRecordCount; first += maxIndirectDrawCount){
+                    vkCmdDrawIndexedIndirect(
+                        aCmdBuffer, mCullOutputBuffer, drawOffset + first * sizeof(VkDrawIndexedIndirectCommand),
+                        std::min(maxIndirectDrawCount, mCullRecordCount - first), sizeof(VkDrawIndexedIndirectCommand)
                     );
                 }
+            }
+        }
+    }else if(indirectDraws){
+        // Otherwise every shape of every object comes from its prebuilt command in mIndirectDrawBuffer.
+        // Without multiDrawIndirect each indirect call is limited to a single command.
+        // When shapes are culled, each run of consecutive visible shapes is drawn by its own calls.
+        uint32_t first = static_cast<uint32_t>(aFirstShape);
+        uint32_t end = static_cast<uint32_t>(std::min<size_t>(aEndShape, mIndirectDrawCount));
+        while(first < end){
+            if(aVisibleShapes != nullptr && !(*aVisibleShapes)[first]){
+                ++first;
+                continue;
+            }
+            uint32_t count = 1;
+            while(first + count < end && count < maxIndirectDrawCount && (aVisibleShapes == nullptr || (*aVisibleShapes)[first + count])){
+                ++count;
+            }
+            vkCmdDrawIndexedIndirect(
+            /*command buffer*/   aCmdBuffer,
+            /*indirect buffer*/  mIndirectDrawBuffer.getBuffer(),
+            /*offset*/           first * sizeof(VkDrawIndexedIndirectCommand),
+            /*draw count*/       count,
+            /*stride*/           sizeof(VkDrawIndexedIndirectCommand));
+            first += count;
+        }
+    }
 
+    // Otherwise each shape is drawn directly
+    size_t totalShapeIdx = 0;
+    size_t directDrawObjectCount = indirectDraws ? 0 : mMultiShapeObjects.size();
+    for(size_t objIdx = 0; objIdx < directDrawObjectCount; ++objIdx){
+        if(totalShapeIdx >= aEndShape){
+            break;
+        }
+        const ObjGeometryPool::MeshRange& mesh = mGeometryPool.getMesh(mMultiShapeMeshIds[objIdx]);
+
+        for(size_t shapeIdx = 0; shapeIdx < mMultiShapeObjects[objIdx].shapeCount(); ++shapeIdx){
+            size_t globalShapeIdx = totalShapeIdx + shapeIdx;
+            if(globalShapeIdx < aFirstShape || globalShapeIdx >= aEndShape || (aVisibleShapes != nullptr && !(*aVisibleShapes)[globalShapeIdx])){
+                continue;
+            }
 
-                vkCmdDrawIndexed(
-                /*command buffer*/   mCommandBuffers[i],
-                /*index count*/      mMultiShapeObjects[objIdx].getShapeRange(shapeIdx),
-                /*instance count*/   1,
-                /*first index*/      mMultiShapeObjects[objIdx].getShapeOffset(shapeIdx), //base index within the index buffer
-                /*vertex offset*/    0U, //the value added to the vertex index before indexing into the vertex buffer
-                /*first instance*/   0U); //instance id of the first instance to draw.
+            // the dynamic offset argument is equivalent to 
+            // the index of the shape of the current model, plus all of the shapes that were drawn before it in this render pass. 
+            // It is used to index into the descriptor set for that particular shape, and bind it before drawing.
+            if (!instanceStorage && (mMultiUniformBuffer->boundLayoutCount() > 0 || mSingleUniformBuffer.boundInterfaceCount() > 0)) {
+                vkCmdBindDescriptorSets(
+                    /*command buffer to bind to*/  aCmdBuffer,
+                    /*pipeline bind point*/        VK_PIPELINE_BIND_POINT_GRAPHICS,
+                    /*vkpipelinelayout obj*/       mRenderPipelines[aPipeline].getLayout(),
+                    /*firstSet*/                   0,
+                    /*descriptorset count*/        1,
+                    /*pDescriptorSets*/            &mUniformDescriptorSets[aImageIndex],
+                    /*dynamic offset count*/       mMultiUniformBuffer->dynamicOffsetCount(),
+                    /*dynamic offsets array*/      mMultiUniformBuffer->getDynamicOffsets(mMultiShapeObjects[objIdx].descriptorSetPositions()[shapeIdx])
+                );
             }
-            totalShapeIdx += mMultiShapeObjects[objIdx].shapeCount();
+
+
+            vkCmdDrawIndexed(
+            /*command buffer*/   aCmdBuffer,
+            /*index count*/      mMultiShapeObjects[objIdx].getShapeRange(shapeIdx),
+            /*instance count*/   instanceStorage ? mMultiShapeInstanceCounts[objIdx] : 1U,
+            /*first index*/      mesh.mFirstIndex + mMultiShapeObjects[objIdx].getShapeOffset(shapeIdx), //base index within the pooled index buffer
+            /*vertex offset*/    static_cast<int32_t>(mesh.mVertexOffset), //the value added to the vertex index before indexing into the pooled vertex buffer
+            /*first instance*/   instanceStorage ? static_cast<uint32_t>(mMultiShapeObjects[objIdx].descriptorSetPositions()[shapeIdx]) : 0U); //instance id of the first instance to draw. Indexes storage buffer instance data.
         }
+        totalShapeIdx += mMultiShapeObjects[objIdx].shapeCount();
+    }
+}
 
-        vkCmdEndRenderPass(mCommandBuffers[i]);
+void VulkanGraphicsApp::setFrustumCulling(bool aEnabled){
+    mFrustumCulling = aEnabled;
+}
 
-        if(vkEndCommandBuffer(mCommandBuffers[i]) != VK_SUCCESS){
-            throw std::runtime_error("Failed to end command buffer " + std::to_string(i));
+void VulkanGraphicsApp::cullShapes(){
+    size_t shapeTotal = totalShapeCount();
+    // Shapes without a model transform or bounds are always drawn
+    mShapeVisibility.assign(shapeTotal, 1);
+    mFrustumCuller.clear();
+    mFrustumCuller.reserve(shapeTotal);
+    mFrustumCuller.setViewProjection(glm::value_ptr(mCullViewProjection));
+
+    std::vector<size_t> sphereShapes;
+    sphereShapes.reserve(shapeTotal);
+    size_t totalShapeIdx = 0;
+    for(size_t objIdx = 0; objIdx < mMultiShapeObjects.size(); ++objIdx){
+        const ObjMultiShapeGeometry& object = mMultiShapeObjects[objIdx];
+        const std::vector<UniformTransformDataPtr>& transforms = mMultiShapeTransforms[objIdx];
+        for(size_t shapeIdx = 0; shapeIdx < object.shapeCount(); ++shapeIdx, ++totalShapeIdx){
+            if(shapeIdx >= transforms.size() || transforms[shapeIdx] == nullptr || shapeIdx >= object.shapeBounds().size()){
+                continue;
+            }
+            const ShapeBounds& bounds = object.shapeBounds()[shapeIdx];
+            const glm::mat4& model = transforms[shapeIdx]->getStruct().Model;
+            glm::vec3 center = glm::vec3(model * glm::vec4(bounds.mCenter, 1.0f));
+            // The largest axis scale keeps the sphere enclosing the shape under non-uniform scaling
+            float scale = std::max({glm::length(glm::vec3(model[0])), glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))});
+            mFrustumCuller.addSphere(center.x, center.y, center.z, bounds.mRadius * scale);
+            sphereShapes.push_back(totalShapeIdx);
         }
     }
+
+    std::vector<uint8_t> sphereVisibility;
+    mFrustumCuller.cull(sphereVisibility);
+    for(size_t i = 0; i < sphereShapes.size(); ++i){
+        mShapeVisibility[sphereShapes[i]] = sphereVisibility[i];
+    }
+    mCullStats.mOccluded = mOcclusionRasterizing ? occludeShapes() : 0;
+
+    mCullStats.mCulled = 0;
+    for(uint8_t visible : mShapeVisibility){
+        mCullStats.mCulled += visible ? 0 : 1;
+    }
+    mCullStats.mVisible = shapeTotal - mCullStats.mCulled;
+}
+
+size_t VulkanGraphicsApp::occludeShapes(){
+    size_t shapeTotal = totalShapeCount();
+    if(mOccluderMeshes.empty()){
+        // Objects were added or removed since the occluders were last built
+        mOccluderMeshes.assign(shapeTotal, OcclusionRasterizer::OccluderMesh());
+        std::vector<float> positions;
+        size_t totalShapeIdx = 0;
+        for(size_t objIdx = 0; objIdx < mMultiShapeObjects.size(); ++objIdx){
+            const ObjMultiShapeGeometry& object = mMultiShapeObjects[objIdx];
+            positions.clear();
+            positions.reserve(object.getVertices().size() * 3);
+            for(const ObjVertex& vertex : object.getVertices()){
+                positions.insert(positions.end(), {vertex.position.x, vertex.position.y, vertex.position.z});
+            }
+            for(size_t shapeIdx = 0; shapeIdx < object.shapeCount(); ++shapeIdx, ++totalShapeIdx){
+                if(shapeIdx >= mMultiShapeTransforms[objIdx].size() || object.getShapeRange(shapeIdx) == 0){
+                    continue;
+                }
+                mOccluderMeshes[totalShapeIdx] = OcclusionRasterizer::simplifyOccluder(positions.data(),
+                    object.mIndicesConcat.data() + object.getShapeOffset(shapeIdx), object.getShapeRange(shapeIdx), MAX_OCCLUDER_TRIANGLES);
+            }
+        }
+    }
+
+    // Every shape still visible is both an occluder and tested against the others
+    std::vector<size_t> candidateShapes;
+    std::vector<const ShapeBounds*> candidateBounds;
+    std::vector<glm::mat4> candidateTransforms;
+    mOcclusionRasterizer.clear();
+    size_t totalShapeIdx = 0;
+    for(size_t objIdx = 0; objIdx < mMultiShapeObjects.size(); ++objIdx){
+        const ObjMultiShapeGeometry& object = mMultiShapeObjects[objIdx];
+        const std::vector<UniformTransformDataPtr>& transforms = mMultiShapeTransforms[objIdx];
+        for(size_t shapeIdx = 0; shapeIdx < object.shapeCount(); ++shapeIdx, ++totalShapeIdx){
+            if(!mShapeVisibility[totalShapeIdx] || shapeIdx >= transforms.size() || transforms[shapeIdx] == nullptr || shapeIdx >= object.shapeBounds().size()){
+                continue;
+            }
+            candidateShapes.push_back(totalShapeIdx);
+            candidateBounds.push_back(&object.shapeBounds()[shapeIdx]);
+            candidateTransforms.push_back(mCullViewProjection * transforms[shapeIdx]->getStruct().Model);
+            mOcclusionRasterizer.addOccluder(glm::value_ptr(candidateTransforms.back()), mOccluderMeshes[totalShapeIdx]);
+        }
+    }
+    mOcclusionRasterizer.rasterize(&ThreadPool::shared());
+
+    // A shape's own occluder is never nearer than the nearest corner of its bounds, so it can't hide itself
+    size_t occludedCount = 0;
+    for(size_t i = 0; i < candidateShapes.size(); ++i){
+        if(mOcclusionRasterizer.isOccluded(glm::value_ptr(candidateTransforms[i]), glm::value_ptr(candidateBounds[i]->mMin), glm::value_ptr(candidateBounds[i]->mMax))){
+            mShapeVisibility[candidateShapes[i]] = 0;
+            ++occludedCount;
+        }
+    }
+    return(occludedCount);
+}
+
+VkCommandBuffer VulkanGraphicsApp::recordFrame(int aPipeline, uint32_t aImageIndex, size_t aSyncObjectIndex){
+    VkDevice device = getPrimaryDeviceBundle().logicalDevice.handle();
+    // One recording slot per worker and the calling thread
+    size_t recorderCount = ThreadPool::shared().threadCount() + 1;
+    if(mFrameCommandPools.empty()){
+        // Transient pools, since everything allocated from them is reset every frame.
+        // Each frame slot has a primary pool, and a pool per recorder for its secondary buffer. 
+        VkCommandPoolCreateInfo poolInfo = {
+            VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO, nullptr,
+            VK_COMMAND_POOL_CREATE_TRANSIENT_BIT, *getPrimaryDeviceBundle().physicalDevice.mGraphicsIdx
+        };
+        mFrameCommandPools.resize(IN_FLIGHT_FRAME_LIMIT, VK_NULL_HANDLE);
+        mFrameCommandBuffers.resize(IN_FLIGHT_FRAME_LIMIT, VK_NULL_HANDLE);
+        mSecondaryCommandPools.resize(IN_FLIGHT_FRAME_LIMIT * recorderCount, VK_NULL_HANDLE);
+        mSecondaryCommandBuffers.resize(IN_FLIGHT_FRAME_LIMIT * recorderCount, VK_NULL_HANDLE);
+        for(size_t i = 0; i < mFrameCommandPools.size() + mSecondaryCommandPools.size(); ++i){
+            bool primary = i < mFrameCommandPools.size();
+            VkCommandPool& pool = primary ? mFrameCommandPools[i] : mSecondaryCommandPools[i - mFrameCommandPools.size()];
+            VkCommandBuffer& buffer = primary ? mFrameCommandBuffers[i] : mSecondaryCommandBuffers[i - mFrameCommandPools.size()];
+            if(vkCreateCommandPool(device, &poolInfo, nullptr, &pool) != VK_SUCCESS){
+                throw std::runtime_error("Failed to create per-frame command pool!");
+            }
+            VkCommandBufferAllocateInfo allocInfo = {
+                VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO, nullptr,
+                pool, primary ? VK_COMMAND_BUFFER_LEVEL_PRIMARY : VK_COMMAND_BUFFER_LEVEL_SECONDARY, 1
+            };
+            if(vkAllocateCommandBuffers(device, &allocInfo, &buffer) != VK_SUCCESS){
+                throw std::runtime_error("Failed to allocate per-frame command buffer!");
+            }
+        }
+    }
+
+    const std::vector<uint8_t>* visibleShapes = nullptr;
+    if(mFrustumCulling || mOcclusionRasterizing){
+        cullShapes();
+        visibleShapes = &mShapeVisibility;
+    }
+
+    // The in-flight fence of this frame slot was waited on, so its last commands have finished
+    vkResetCommandPool(device, mFrameCommandPools[aSyncObjectIndex], 0);
+    VkCommandBuffer commandBuffer = mFrameCommandBuffers[aSyncObjectIndex];
+    VkCommandBufferBeginInfo beginInfo = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO, nullptr, VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT, nullptr};
+    if(vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS){
+        throw std::runtime_error("Failed to begin command recording!");
+    }
+
+    // Small scenes aren't worth waking the workers for. Rounding down gives every chunk at least the minimum.
+    size_t shapeTotal = totalShapeCount();
+    size_t chunkCount = std::min(recorderCount, shapeTotal / PARALLEL_RECORD_MIN_SHAPES);
+    if(!mParallelRecording || chunkCount <= 1){
+        recordDrawCommands(commandBuffer, aPipeline, aImageIndex, visibleShapes);
+    }else{
+        VkRenderPassBeginInfo renderBegin = renderPassBegin(aPipeline, aImageIndex);
+        VkCommandBufferInheritanceInfo inheritance = {
+            VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO, nullptr,
+            renderBegin.renderPass, 0, renderBegin.framebuffer, VK_FALSE, 0, 0
+        };
+        VkCommandBuffer* secondaries = &mSecondaryCommandBuffers[aSyncObjectIndex * recorderCount];
+        VkCommandPool* secondaryPools = &mSecondaryCommandPools[aSyncObjectIndex * recorderCount];
+
+        // Chunks are contiguous shape ranges, each recorded by one thread into the buffer of its own pool
+        ThreadPool::shared().parallelFor(chunkCount, [&](size_t aChunk){
+            vkResetCommandPool(device, secondaryPools[aChunk], 0);
+            VkCommandBufferBeginInfo secondaryBegin = {
+                VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO, nullptr,
+                VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT, &inheritance
+            };
+            if(vkBeginCommandBuffer(secondaries[aChunk], &secondaryBegin) != VK_SUCCESS){
+                throw std::runtime_error("Failed to begin secondary command recording!");
+            }
+            recordDrawRange(secondaries[aChunk], aPipeline, aImageIndex, shapeTotal * aChunk / chunkCount, shapeTotal * (aChunk + 1) / chunkCount, visibleShapes);
+            if(vkEndCommandBuffer(secondaries[aChunk]) != VK_SUCCESS){
+                throw std::runtime_error("Failed to end secondary command buffer!");
+            }
+        });
+
+        vkCmdBeginRenderPass(commandBuffer, &renderBegin, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+        vkCmdExecuteCommands(commandBuffer, static_cast<uint32_t>(chunkCount), secondaries);
+        vkCmdEndRenderPass(commandBuffer);
+    }
+
+    if(vkEndCommandBuffer(commandBuffer) != VK_SUCCESS){
+        throw std::runtime_error("Failed to end per-frame command buffer!");
+    }
+    return(commandBuffer);
 }
 
 void VulkanGraphicsApp::initFramebuffers(int currentRenderPipeline){
@@ -463,10 +1012,13 @@ void VulkanGraphicsApp::initSync(){
         throw std::runtime_error("Failed to create semaphores!");
     }
 
+    mImagesInFlight.assign(mSwapchainFramebuffers.size(), VK_NULL_HANDLE);
+
 }
 
 void VulkanGraphicsApp::cleanupSwapchainDependents(){
     vkDestroyDescriptorPool(getPrimaryDeviceBundle().logicalDevice, mResourceDescriptorPool, nullptr);
+    cleanupGpuCullResources();
 
     for(size_t i = 0; i < IN_FLIGHT_FRAME_LIMIT; ++i){
         vkDestroySemaphore(getPrimaryDeviceBundle().logicalDevice.handle(), mImageAvailableSemaphores[i], nullptr);
@@ -486,6 +1038,12 @@ void VulkanGraphicsApp::cleanupSwapchainDependents(){
     for (auto& pipeline : mRenderPipelines) {
         pipeline.destroy();
     }
+    for(VkRenderPass& renderPass : mOcclusionRenderPasses){
+        if(renderPass != VK_NULL_HANDLE){
+            vkDestroyRenderPass(getPrimaryDeviceBundle().logicalDevice, renderPass, nullptr);
+            renderPass = VK_NULL_HANDLE;
+        }
+    }
     
     if(mUniformDescriptorSetLayout != VK_NULL_HANDLE){
         vkDestroyDescriptorSetLayout(getPrimaryDeviceBundle().logicalDevice, mUniformDescriptorSetLayout, nullptr);
@@ -509,10 +1067,14 @@ void VulkanGraphicsApp::initTransferCmdBuffer(){
 void VulkanGraphicsApp::transferGeometry(){
     VkCommandBufferBeginInfo beginInfo = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO, nullptr, 0, nullptr};
     ASSERT_VK_SUCCESS(vkBeginCommandBuffer(mTransferCmdBuffer, &beginInfo));
-    for(ObjMultiShapeGeometry& geo : mMultiShapeObjects){
-        if(geo.awaitingUploadTransfer()){
-            geo.recordUploadTransferCommand(mTransferCmdBuffer);
-        }
+    if(mGeometryPool.awaitingUploadTransfer()){
+        mGeometryPool.recordUploadTransferCommand(mTransferCmdBuffer);
+    }
+    if(mIndirectDrawBuffer.awaitingUploadTransfer()){
+        mIndirectDrawBuffer.recordUploadTransferCommand(mTransferCmdBuffer);
+    }
+    if(mCullRecordBuffer.awaitingUploadTransfer()){
+        mCullRecordBuffer.recordUploadTransferCommand(mTransferCmdBuffer);
     }
     ASSERT_VK_SUCCESS(vkEndCommandBuffer(mTransferCmdBuffer));
 
@@ -526,11 +1088,608 @@ void VulkanGraphicsApp::transferGeometry(){
     }
     vkQueueWaitIdle(transferQueue);
 
-    for(ObjMultiShapeGeometry& geo : mMultiShapeObjects){
-        geo.freeStagingBuffer();
+    mGeometryPool.freeStagingBuffer();
+    mIndirectDrawBuffer.freeStagingBuffer();
+    mCullRecordBuffer.freeStagingBuffer();
+}
+
+void VulkanGraphicsApp::buildIndirectDraws(){
+    mIndirectDrawCount = 0;
+    if(!useIndirectDraws()) return;
+
+    std::vector<VkDrawIndexedIndirectCommand> commands;
+    for(size_t objIdx = 0; objIdx < mMultiShapeObjects.size(); ++objIdx){
+        const ObjMultiShapeGeometry& object = mMultiShapeObjects[objIdx];
+        const ObjGeometryPool::MeshRange& mesh = mGeometryPool.getMesh(mMultiShapeMeshIds[objIdx]);
+        for(size_t shapeIdx = 0; shapeIdx < object.shapeCount(); ++shapeIdx){
+            commands.emplace_back(VkDrawIndexedIndirectCommand{
+                /* indexCount = */ static_cast<uint32_t>(object.getShapeRange(shapeIdx)),
+                /* instanceCount = */ mMultiShapeInstanceCounts[objIdx],
+                /* firstIndex = */ mesh.mFirstIndex + static_cast<uint32_t>(object.getShapeOffset(shapeIdx)),
+                /* vertexOffset = */ static_cast<int32_t>(mesh.mVertexOffset),
+                /* firstInstance = */ static_cast<uint32_t>(object.descriptorSetPositions()[shapeIdx]) // Selects the shape's instance data
+            });
+        }
+    }
+
+    mIndirectDrawCount = static_cast<uint32_t>(commands.size());
+    if(!commands.empty()){
+        mIndirectDrawBuffer.stageDataForUpload(reinterpret_cast<const uint8_t*>(commands.data()), commands.size() * sizeof(VkDrawIndexedIndirectCommand));
+    }
+
+    // The culling stage tests instances one by one, so each instance of a shape gets its own record
+    mCullRecordCount = 0;
+    if(!mGpuCulling || !mTransformBinding) return;
+    static_assert(sizeof(GpuCullRecord) == 36, "GpuCullRecord must match DrawRecord in shaders/cull.comp");
+    std::vector<GpuCullRecord> records;
+    size_t commandIdx = 0;
+    for(size_t objIdx = 0; objIdx < mMultiShapeObjects.size(); ++objIdx){
+        const ObjMultiShapeGeometry& object = mMultiShapeObjects[objIdx];
+        for(size_t shapeIdx = 0; shapeIdx < object.shapeCount(); ++shapeIdx, ++commandIdx){
+            GpuCullRecord record = {commands[commandIdx], {0.0f, 0.0f, 0.0f}, std::numeric_limits<float>::infinity()}; // Drawn if it has no bounds
+            if(shapeIdx < object.shapeBounds().size()){
+                const ShapeBounds& bounds = object.shapeBounds()[shapeIdx];
+                record.mCenter[0] = bounds.mCenter.x;
+                record.mCenter[1] = bounds.mCenter.y;
+                record.mCenter[2] = bounds.mCenter.z;
+                record.mRadius = bounds.mRadius;
+            }
+            record.mCommand.instanceCount = 1;
+            for(uint32_t instance = 0; instance < mMultiShapeInstanceCounts[objIdx]; ++instance){
+                record.mCommand.firstInstance = commands[commandIdx].firstInstance + instance;
+                records.push_back(record);
+            }
+        }
+    }
+
+    mCullRecordCount = static_cast<uint32_t>(records.size());
+    if(!records.empty()){
+        mCullRecordBuffer.stageDataForUpload(reinterpret_cast<const uint8_t*>(records.data()), records.size() * sizeof(GpuCullRecord));
+    }
+}
+
+bool VulkanGraphicsApp::useIndirectDraws() const {
+    return(
+        mMultiUniformBuffer != nullptr &&
+        mMultiUniformBuffer->getBufferMode() == MultiInstanceUniformBuffer::BufferMode::INSTANCE_STORAGE &&
+        getPrimaryDeviceBundle().physicalDevice.mFeatures.drawIndirectFirstInstance
+    );
+}
+
+/// Names of the culling and depth pyramid stages within mComputeProvider
+static const std::string sCullStageId = "frustum_cull";
+static const std::string sPyramidStageId = "depth_pyramid";
+
+bool VulkanGraphicsApp::useGpuCulling() const {
+    return(mComputeProvider != nullptr && mComputeProvider->hasRegisteredStage(sCullStageId));
+}
+
+bool VulkanGraphicsApp::useOcclusionCulling() const {
+    return(useGpuCulling() && mComputeProvider->hasRegisteredStage(sPyramidStageId));
+}
+
+/// Aspects of a depth buffer format which take part in its layout transitions
+static VkImageAspectFlags depth_aspects(VkFormat aFormat){
+    bool hasStencil = aFormat >= VK_FORMAT_D16_UNORM_S8_UINT;
+    return(VK_IMAGE_ASPECT_DEPTH_BIT | (hasStencil ? VK_IMAGE_ASPECT_STENCIL_BIT : 0));
+}
+
+void VulkanGraphicsApp::initGpuCullStage(){
+    if(!mGpuCulling || useGpuCulling()) return;
+    if(!useIndirectDraws() || !mTransformBinding){
+        std::cerr << "Warning! GPU culling requires indirect draws from INSTANCE_STORAGE data with model transforms. Drawing without it." << std::endl;
+        return;
+    }
+    VkDevice device = getPrimaryDeviceBundle().logicalDevice.handle();
+    const VulkanPhysicalDevice& physicalDevice = getPrimaryDeviceBundle().physicalDevice;
+
+    // The depth pyramid is built by sampling the depth buffer
+    bool occlusion = mOcclusionCulling;
+    if(occlusion){
+        VkFormatProperties depthProps;
+        vkGetPhysicalDeviceFormatProperties(physicalDevice.handle(), vkutils::select_depth_format(physicalDevice.handle()), &depthProps);
+        if(!(depthProps.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT)){
+            std::cerr << "Warning! Occlusion culling requires a depth format which can be sampled. Culling against the frustum only." << std::endl;
+            occlusion = false;
+        }
+    }
+
+    mComputeProvider = std::make_shared<ComputeProvider>();
+    mComputeProvider->setCoreProvider(mCoreProvider.get());
+    mComputeProvider->init();
+
+    // Frustum, draw records, model transforms, draws out and the draw counts.
+    // Occlusion culling adds the visibility of the last frame and the depth pyramid.
+    std::array<VkDescriptorSetLayoutBinding, 7> bindings = {{
+        {0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr},
+        {1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr},
+        {2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr},
+        {3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr},
+        {4, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr},
+        {5, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr},
+        {6, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr}
+    }};
+    VkDescriptorSetLayoutCreateInfo layoutInfo = {VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO, nullptr, 0, occlusion ? 7U : 5U, bindings.data()};
+    if(vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &mCullSetLayout) != VK_SUCCESS){
+        throw std::runtime_error("Failed to create descriptor set layout for GPU culling!");
+    }
+
+    // Destroyed along with the graphics shaders
+    std::string cullShaderName = occlusion ? "occlusion_cull.comp" : "cull.comp";
+    VkShaderModule cullShader = vkutils::load_shader_module(device, STRIFY(SHADER_DIR) "/" + cullShaderName + ".spv");
+    mShaderModules[cullShaderName] = cullShader;
+
+    // Occlusion culling is dispatched once per phase, with the phase pushed ahead of each
+    VkPushConstantRange phaseRange = {VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(uint32_t)};
+    vkutils::VulkanComputePipelineBuilder builder;
+    vkutils::VulkanComputePipelineBuilder::prepareUnspecialized(builder.getConstructionSet(), cullShader);
+    builder.getConstructionSet().mLayoutInfo.setLayoutCount = 1;
+    builder.getConstructionSet().mLayoutInfo.pSetLayouts = &mCullSetLayout;
+    if(occlusion){
+        builder.getConstructionSet().mLayoutInfo.pushConstantRangeCount = 1;
+        builder.getConstructionSet().mLayoutInfo.pPushConstantRanges = &phaseRange;
+    }
+    vkutils::ComputeStage& stage = mComputeProvider->registerComputeStage(sCullStageId);
+    stage.shaderModule = cullShader;
+    stage.pipeline = builder.build(device);
+
+    if(occlusion){
+        // The level before, or the depth buffer, and the level written
+        std::array<VkDescriptorSetLayoutBinding, 2> pyramidBindings = {{
+            {0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr},
+            {1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr}
+        }};
+        VkDescriptorSetLayoutCreateInfo pyramidLayoutInfo = {VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO, nullptr, 0, static_cast<uint32_t>(pyramidBindings.size()), pyramidBindings.data()};
+        if(vkCreateDescriptorSetLayout(device, &pyramidLayoutInfo, nullptr, &mPyramidSetLayout) != VK_SUCCESS){
+            throw std::runtime_error("Failed to create descriptor set layout for the depth pyramid!");
+        }
+
+        VkShaderModule pyramidShader = vkutils::load_shader_module(device, STRIFY(SHADER_DIR) "/depth_pyramid.comp.spv");
+        mShaderModules["depth_pyramid.comp"] = pyramidShader;
+
+        vkutils::VulkanComputePipelineBuilder pyramidBuilder;
+        vkutils::VulkanComputePipelineBuilder::prepareUnspecialized(pyramidBuilder.getConstructionSet(), pyramidShader);
+        pyramidBuilder.getConstructionSet().mLayoutInfo.setLayoutCount = 1;
+        pyramidBuilder.getConstructionSet().mLayoutInfo.pSetLayouts = &mPyramidSetLayout;
+        vkutils::ComputeStage& pyramidStage = mComputeProvider->registerComputeStage(sPyramidStageId);
+        pyramidStage.shaderModule = pyramidShader;
+        pyramidStage.pipeline = pyramidBuilder.build(device);
+
+        // The depth buffer and pyramid are only read texel by texel
+        VkSamplerCreateInfo samplerInfo = {};
+        {
+            samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+            samplerInfo.magFilter = VK_FILTER_NEAREST;
+            samplerInfo.minFilter = VK_FILTER_NEAREST;
+            samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+            samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+            samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+            samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+            samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+        }
+        if(vkCreateSampler(device, &samplerInfo, nullptr, &mDepthPyramidSampler) != VK_SUCCESS){
+            throw std::runtime_error("Failed to create the depth pyramid sampler!");
+        }
+    }
+
+    // Counted draws can only go past a single draw with multiDrawIndirect
+    if(physicalDevice.supportsDrawIndirectCount() && physicalDevice.mFeatures.multiDrawIndirect){
+        // Same signature under either name. Only the one matching how the device enabled it is loaded.
+        const char* name = physicalDevice.mDrawIndirectCountCore ? "vkCmdDrawIndexedIndirectCount" : "vkCmdDrawIndexedIndirectCountKHR";
+        mDrawIndexedIndirectCount = reinterpret_cast<PFN_vkCmdDrawIndexedIndirectCountKHR>(vkGetDeviceProcAddr(device, name));
+    }
+}
+
+void VulkanGraphicsApp::initGpuCullResources(){
+    if(!useGpuCulling() || mCullRecordCount == 0) return;
+    VkDevice device = getPrimaryDeviceBundle().logicalDevice.handle();
+    VmaAllocator allocator = VmaHost::getAllocator(getPrimaryDeviceBundle());
+    const VkPhysicalDeviceLimits& limits = getPrimaryDeviceBundle().physicalDevice.mProperties.limits;
+    uint32_t imageCount = static_cast<uint32_t>(mTotalUniformDescriptorSetCount);
+    bool occlusion = useOcclusionCulling();
+    uint32_t setCount = imageCount * cullListCount();
+    if(occlusion){
+        initDepthPyramids(imageCount);
+    }
+
+    // Frames in flight cull at the same time, so every image gets its own draws and frustum.
+    const VkDeviceSize storageAlignment = limits.minStorageBufferOffsetAlignment;
+    const VkDeviceSize uniformAlignment = limits.minUniformBufferOffsetAlignment;
+    mCullCountStride = (2 * sizeof(uint32_t) + storageAlignment - 1) / storageAlignment * storageAlignment;
+    mCullOutputStride = mCullCountStride + mCullRecordCount * sizeof(VkDrawIndexedIndirectCommand);
+    mCullOutputStride = (mCullOutputStride + storageAlignment - 1) / storageAlignment * storageAlignment;
+    mCullFrustumStride = (sizeof(GpuCullFrustum) + uniformAlignment - 1) / uniformAlignment * uniformAlignment;
+
+    VkBufferCreateInfo bufferInfo = {};
+    {
+        bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        bufferInfo.size = mCullOutputStride * setCount;
+        bufferInfo.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+        bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    }
+    VmaAllocationCreateInfo allocInfo = {};
+    allocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+    if(vmaCreateBuffer(allocator, &bufferInfo, &allocInfo, &mCullOutputBuffer, &mCullOutputAllocation, nullptr) != VK_SUCCESS){
+        throw std::runtime_error("Failed to allocate the GPU culling draw buffer!");
+    }
+
+    bufferInfo.size = mCullFrustumStride * imageCount;
+    bufferInfo.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
+    allocInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+    allocInfo.usage = VMA_MEMORY_USAGE_CPU_TO_GPU;
+    allocInfo.requiredFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+    if(vmaCreateBuffer(allocator, &bufferInfo, &allocInfo, &mCullFrustumBuffer, &mCullFrustumAllocation, &mCullFrustumAllocInfo) != VK_SUCCESS){
+        throw std::runtime_error("Failed to allocate the GPU culling frustum buffer!");
+    }
+
+    if(occlusion){
+        // Each image reads back the visibility of the last frame drawn to it, like its uniform frame slot
+        mCullVisibilityStride = (mCullRecordCount * sizeof(uint32_t) + storageAlignment - 1) / storageAlignment * storageAlignment;
+        bufferInfo.size = mCullVisibilityStride * imageCount;
+        bufferInfo.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+        allocInfo = {};
+        allocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+        if(vmaCreateBuffer(allocator, &bufferInfo, &allocInfo, &mCullVisibilityBuffer, &mCullVisibilityAllocation, nullptr) != VK_SUCCESS){
+            throw std::runtime_error("Failed to allocate the occlusion culling visibility buffer!");
+        }
+
+        // Nothing was visible before the first frame, so its first phase draws nothing and its second draws
+        // everything within the frustum
+        VkCommandBufferBeginInfo beginInfo = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO, nullptr, 0, nullptr};
+        ASSERT_VK_SUCCESS(vkBeginCommandBuffer(mTransferCmdBuffer, &beginInfo));
+        vkCmdFillBuffer(mTransferCmdBuffer, mCullVisibilityBuffer, 0, VK_WHOLE_SIZE, 0U);
+        ASSERT_VK_SUCCESS(vkEndCommandBuffer(mTransferCmdBuffer));
+        VkQueue transferQueue = getPrimaryDeviceBundle().logicalDevice.getTransferQueue();
+        VkSubmitInfo submitInfo = vkutils::sSingleSubmitTemplate;
+        submitInfo.pCommandBuffers = &mTransferCmdBuffer;
+        if(vkQueueSubmit(transferQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS){
+            throw std::runtime_error("Failed to clear the occlusion culling visibility buffer!");
+        }
+        vkQueueWaitIdle(transferQueue);
+
+        bufferInfo.size = imageCount * sizeof(uint32_t);
+        bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+        allocInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+        allocInfo.usage = VMA_MEMORY_USAGE_GPU_TO_CPU;
+        allocInfo.requiredFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+        if(vmaCreateBuffer(allocator, &bufferInfo, &allocInfo, &mOcclusionReadbackBuffer, &mOcclusionReadbackAllocation, &mOcclusionReadbackAllocInfo) != VK_SUCCESS){
+            throw std::runtime_error("Failed to allocate the occlusion culling readback buffer!");
+        }
+        // Images which haven't been drawn to yet report nothing occluded
+        std::memset(mOcclusionReadbackAllocInfo.pMappedData, 0, bufferInfo.size);
+        vmaFlushAllocation(allocator, mOcclusionReadbackAllocation, 0, bufferInfo.size);
+    }
+
+    VkDescriptorPoolSize poolSizes[3] = {
+        {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, setCount},
+        {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, (occlusion ? 5 : 4) * setCount},
+        {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, setCount}
+    };
+    VkDescriptorPoolCreateInfo poolInfo = {VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO, nullptr, 0, setCount, occlusion ? 3U : 2U, poolSizes};
+    if(vkCreateDescriptorPool(device, &poolInfo, nullptr, &mCullDescriptorPool) != VK_SUCCESS){
+        throw std::runtime_error("Failed to create descriptor pool for GPU culling!");
+    }
+    std::vector<VkDescriptorSetLayout> layouts(setCount, mCullSetLayout);
+    VkDescriptorSetAllocateInfo setInfo = {VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO, nullptr, mCullDescriptorPool, setCount, layouts.data()};
+    mCullDescriptorSets.resize(setCount);
+    if(vkAllocateDescriptorSets(device, &setInfo, mCullDescriptorSets.data()) != VK_SUCCESS){
+        throw std::runtime_error("Failed to allocate descriptor sets for GPU culling!");
+    }
+
+    // The sets of image 'i' read frame slot 'i' of the instance data, like the uniform descriptor sets.
+    // Each list of an image has its own draws and counts.
+    for(uint32_t i = 0; i < imageCount; ++i){
+        VkDescriptorImageInfo pyramidInfo = {mDepthPyramidSampler, occlusion ? mDepthPyramids[i].mView : VK_NULL_HANDLE, VK_IMAGE_LAYOUT_GENERAL};
+        for(uint32_t list = 0; list < cullListCount(); ++list){
+            VkDescriptorSet set = mCullDescriptorSets[i * cullListCount() + list];
+            std::array<VkDescriptorBufferInfo, 6> infos = {{
+                {mCullFrustumBuffer, i * mCullFrustumStride, sizeof(GpuCullFrustum)},
+                {mCullRecordBuffer.getBuffer(), 0, mCullRecordCount * sizeof(GpuCullRecord)},
+                mMultiUniformBuffer->getDescriptorBufferInfos(i).at(*mTransformBinding),
+                {mCullOutputBuffer, cullOutputOffset(i, list) + mCullCountStride, mCullRecordCount * sizeof(VkDrawIndexedIndirectCommand)},
+                {mCullOutputBuffer, cullOutputOffset(i, list), 2 * sizeof(uint32_t)},
+                {mCullVisibilityBuffer, i * mCullVisibilityStride, mCullRecordCount * sizeof(uint32_t)}
+            }};
+            std::array<VkWriteDescriptorSet, 7> writes;
+            uint32_t writeCount = occlusion ? 7U : 5U;
+            for(uint32_t binding = 0; binding < writeCount; ++binding){
+                writes[binding] = VkWriteDescriptorSet{
+                    VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET, nullptr, set, binding, 0, 1,
+                    binding == 0 ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                    nullptr, binding < infos.size() ? &infos[binding] : nullptr, nullptr
+                };
+            }
+            if(occlusion){
+                writes[6].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+                writes[6].pImageInfo = &pyramidInfo;
+            }
+            vkUpdateDescriptorSets(device, writeCount, writes.data(), 0, nullptr);
+        }
+    }
+}
+
+void VulkanGraphicsApp::initDepthPyramids(uint32_t aImageCount){
+    VkDevice device = getPrimaryDeviceBundle().logicalDevice.handle();
+    VmaAllocator allocator = VmaHost::getAllocator(getPrimaryDeviceBundle());
+    const VkExtent2D& extent = mSwapchainProvider->getSwapchainBundle().extent;
+
+    // Level 0 is half the depth buffer, rounded up to powers of two so every level halves exactly
+    // and a texel of level 'n' always covers the same 2^(n+1) square of depth texels.
+    mDepthPyramidExtent = {1, 1};
+    while(mDepthPyramidExtent.width < (extent.width + 1) / 2){
+        mDepthPyramidExtent.width *= 2;
+    }
+    while(mDepthPyramidExtent.height < (extent.height + 1) / 2){
+        mDepthPyramidExtent.height *= 2;
+    }
+    mDepthPyramidLevels = 1;
+    while((std::max(mDepthPyramidExtent.width, mDepthPyramidExtent.height) >> mDepthPyramidLevels) > 0){
+        ++mDepthPyramidLevels;
+    }
+
+    VkImageCreateInfo imageInfo = {};
+    {
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT;
+        imageInfo.extent = VkExtent3D{mDepthPyramidExtent.width, mDepthPyramidExtent.height, 1};
+        imageInfo.format = VK_FORMAT_R32_SFLOAT;
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        imageInfo.mipLevels = mDepthPyramidLevels;
+        imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        imageInfo.arrayLayers = 1;
+    }
+    VmaAllocationCreateInfo allocInfo = {};
+    allocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+
+    VkImageViewCreateInfo viewInfo;
+    {
+        viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        viewInfo.pNext = nullptr;
+        viewInfo.flags = 0;
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.format = VK_FORMAT_R32_SFLOAT;
+        viewInfo.components = {VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY};
+    }
+
+    uint32_t setCount = aImageCount * mDepthPyramidLevels;
+    VkDescriptorPoolSize poolSizes[2] = {
+        {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, setCount},
+        {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, setCount}
+    };
+    VkDescriptorPoolCreateInfo poolInfo = {VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO, nullptr, 0, setCount, 2, poolSizes};
+    if(vkCreateDescriptorPool(device, &poolInfo, nullptr, &mPyramidDescriptorPool) != VK_SUCCESS){
+        throw std::runtime_error("Failed to create descriptor pool for the depth pyramids!");
+    }
+    std::vector<VkDescriptorSetLayout> layouts(mDepthPyramidLevels, mPyramidSetLayout);
+    VkDescriptorSetAllocateInfo setInfo = {VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO, nullptr, mPyramidDescriptorPool, mDepthPyramidLevels, layouts.data()};
+
+    mDepthPyramids.resize(aImageCount);
+    for(DepthPyramid& pyramid : mDepthPyramids){
+        if(vmaCreateImage(allocator, &imageInfo, &allocInfo, &pyramid.mImage, &pyramid.mAllocation, nullptr) != VK_SUCCESS){
+            throw std::runtime_error("Failed to create the depth pyramid!");
+        }
+
+        viewInfo.image = pyramid.mImage;
+        viewInfo.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, mDepthPyramidLevels, 0, 1};
+        if(vkCreateImageView(device, &viewInfo, nullptr, &pyramid.mView) != VK_SUCCESS){
+            throw std::runtime_error("Failed to create image view for the depth pyramid!");
+        }
+        pyramid.mLevelViews.assign(mDepthPyramidLevels, VK_NULL_HANDLE);
+        for(uint32_t level = 0; level < mDepthPyramidLevels; ++level){
+            viewInfo.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, level, 1, 0, 1};
+            if(vkCreateImageView(device, &viewInfo, nullptr, &pyramid.mLevelViews[level]) != VK_SUCCESS){
+                throw std::runtime_error("Failed to create image view for depth pyramid level " + std::to_string(level));
+            }
+        }
+
+        pyramid.mDescriptorSets.resize(mDepthPyramidLevels);
+        if(vkAllocateDescriptorSets(device, &setInfo, pyramid.mDescriptorSets.data()) != VK_SUCCESS){
+            throw std::runtime_error("Failed to allocate descriptor sets for the depth pyramid!");
+        }
+        for(uint32_t level = 0; level < mDepthPyramidLevels; ++level){
+            VkDescriptorImageInfo source = level == 0 ?
+                VkDescriptorImageInfo{mDepthPyramidSampler, mDepthBundle.depthImageView, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL} :
+                VkDescriptorImageInfo{mDepthPyramidSampler, pyramid.mLevelViews[level - 1], VK_IMAGE_LAYOUT_GENERAL};
+            VkDescriptorImageInfo target = {VK_NULL_HANDLE, pyramid.mLevelViews[level], VK_IMAGE_LAYOUT_GENERAL};
+            std::array<VkWriteDescriptorSet, 2> writes = {{
+                {VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET, nullptr, pyramid.mDescriptorSets[level], 0, 0, 1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, &source, nullptr, nullptr},
+                {VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET, nullptr, pyramid.mDescriptorSets[level], 1, 0, 1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, &target, nullptr, nullptr}
+            }};
+            vkUpdateDescriptorSets(device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+        }
     }
 }
 
+void VulkanGraphicsApp::cleanupGpuCullResources(){
+    VkDevice device = getPrimaryDeviceBundle().logicalDevice.handle();
+    VmaAllocator allocator = VmaHost::getAllocator(getPrimaryDeviceBundle());
+    if(mCullDescriptorPool != VK_NULL_HANDLE){
+        vkDestroyDescriptorPool(device, mCullDescriptorPool, nullptr);
+        mCullDescriptorPool = VK_NULL_HANDLE;
+        mCullDescriptorSets.clear();
+    }
+    if(mCullOutputBuffer != VK_NULL_HANDLE){
+        vmaDestroyBuffer(allocator, mCullOutputBuffer, mCullOutputAllocation);
+        mCullOutputBuffer = VK_NULL_HANDLE;
+    }
+    if(mCullFrustumBuffer != VK_NULL_HANDLE){
+        vmaDestroyBuffer(allocator, mCullFrustumBuffer, mCullFrustumAllocation);
+        mCullFrustumBuffer = VK_NULL_HANDLE;
+    }
+    if(mCullVisibilityBuffer != VK_NULL_HANDLE){
+        vmaDestroyBuffer(allocator, mCullVisibilityBuffer, mCullVisibilityAllocation);
+        mCullVisibilityBuffer = VK_NULL_HANDLE;
+    }
+    if(mOcclusionReadbackBuffer != VK_NULL_HANDLE){
+        vmaDestroyBuffer(allocator, mOcclusionReadbackBuffer, mOcclusionReadbackAllocation);
+        mOcclusionReadbackBuffer = VK_NULL_HANDLE;
+    }
+
+    if(mPyramidDescriptorPool != VK_NULL_HANDLE){
+        vkDestroyDescriptorPool(device, mPyramidDescriptorPool, nullptr);
+        mPyramidDescriptorPool = VK_NULL_HANDLE;
+    }
+    for(DepthPyramid& pyramid : mDepthPyramids){
+        for(VkImageView view : pyramid.mLevelViews){
+            vkDestroyImageView(device, view, nullptr);
+        }
+        if(pyramid.mView != VK_NULL_HANDLE){
+            vkDestroyImageView(device, pyramid.mView, nullptr);
+        }
+        if(pyramid.mImage != VK_NULL_HANDLE){
+            vmaDestroyImage(allocator, pyramid.mImage, pyramid.mAllocation);
+        }
+    }
+    mDepthPyramids.clear();
+    mDepthPyramidLevels = 0;
+}
+
+void VulkanGraphicsApp::recordGpuCull(VkCommandBuffer aCmdBuffer, size_t aImageIndex) const{
+    if(!useGpuCulling() || mCullOutputBuffer == VK_NULL_HANDLE) return;
+    const vkutils::ComputeStage& stage = mComputeProvider->getComputeStage(sCullStageId);
+
+    // Draws and occlusions are counted from zero every frame. With occlusion culling this also waits for
+    // the last frame's second phase to write the visibility read by the first.
+    for(uint32_t list = 0; list < cullListCount(); ++list){
+        vkCmdFillBuffer(aCmdBuffer, mCullOutputBuffer, cullOutputOffset(aImageIndex, list), 2 * sizeof(uint32_t), 0U);
+    }
+    VkMemoryBarrier clearBarrier = {VK_STRUCTURE_TYPE_MEMORY_BARRIER, nullptr, VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT};
+    vkCmdPipelineBarrier(aCmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &clearBarrier, 0, nullptr, 0, nullptr);
+
+    vkCmdBindPipeline(aCmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, stage.pipeline.handle());
+    vkCmdBindDescriptorSets(aCmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, stage.pipeline.getLayout(), 0, 1, &mCullDescriptorSets[aImageIndex * cullListCount()], 0, nullptr);
+    if(useOcclusionCulling()){
+        uint32_t phase = 1;
+        vkCmdPushConstants(aCmdBuffer, stage.pipeline.getLayout(), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(phase), &phase);
+    }
+    vkCmdDispatch(aCmdBuffer, (mCullRecordCount + GPU_CULL_GROUP_SIZE - 1) / GPU_CULL_GROUP_SIZE, 1, 1);
+
+    VkMemoryBarrier drawBarrier = {VK_STRUCTURE_TYPE_MEMORY_BARRIER, nullptr, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT};
+    vkCmdPipelineBarrier(aCmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0, 1, &drawBarrier, 0, nullptr, 0, nullptr);
+}
+
+void VulkanGraphicsApp::recordOcclusionPass(VkCommandBuffer aCmdBuffer, int aPipeline, size_t aImageIndex) const{
+    if(!useOcclusionCulling() || mCullOutputBuffer == VK_NULL_HANDLE) return;
+    const vkutils::ComputeStage& stage = mComputeProvider->getComputeStage(sCullStageId);
+
+    recordDepthPyramid(aCmdBuffer, aImageIndex);
+
+    // Test everything within the frustum against the pyramid. The counts were cleared by recordGpuCull().
+    uint32_t phase = 2;
+    vkCmdBindPipeline(aCmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, stage.pipeline.handle());
+    vkCmdBindDescriptorSets(aCmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, stage.pipeline.getLayout(), 0, 1, &mCullDescriptorSets[aImageIndex * cullListCount() + 1], 0, nullptr);
+    vkCmdPushConstants(aCmdBuffer, stage.pipeline.getLayout(), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(phase), &phase);
+    vkCmdDispatch(aCmdBuffer, (mCullRecordCount + GPU_CULL_GROUP_SIZE - 1) / GPU_CULL_GROUP_SIZE, 1, 1);
+
+    VkMemoryBarrier drawBarrier = {VK_STRUCTURE_TYPE_MEMORY_BARRIER, nullptr, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT};
+    vkCmdPipelineBarrier(aCmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &drawBarrier, 0, nullptr, 0, nullptr);
+
+    // The occluded count is read on the host by readOcclusionStats() once the frame has finished
+    VkBufferCopy countCopy = {cullOutputOffset(aImageIndex, 1) + sizeof(uint32_t), aImageIndex * sizeof(uint32_t), sizeof(uint32_t)};
+    vkCmdCopyBuffer(aCmdBuffer, mCullOutputBuffer, mOcclusionReadbackBuffer, 1, &countCopy);
+    VkMemoryBarrier readbackBarrier = {VK_STRUCTURE_TYPE_MEMORY_BARRIER, nullptr, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_HOST_READ_BIT};
+    vkCmdPipelineBarrier(aCmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &readbackBarrier, 0, nullptr, 0, nullptr);
+
+    // Draw what the first render pass skipped over its color and depth
+    VkRenderPassBeginInfo renderBegin = renderPassBegin(aPipeline, aImageIndex);
+    renderBegin.renderPass = mOcclusionRenderPasses[1];
+    vkCmdBeginRenderPass(aCmdBuffer, &renderBegin, VK_SUBPASS_CONTENTS_INLINE);
+    recordDrawRange(aCmdBuffer, aPipeline, aImageIndex, 0, totalShapeCount(), nullptr, 1);
+    vkCmdEndRenderPass(aCmdBuffer);
+}
+
+void VulkanGraphicsApp::recordDepthPyramid(VkCommandBuffer aCmdBuffer, size_t aImageIndex) const{
+    const vkutils::ComputeStage& stage = mComputeProvider->getComputeStage(sPyramidStageId);
+    const DepthPyramid& pyramid = mDepthPyramids[aImageIndex];
+
+    // Read the depth of the first render pass. The whole pyramid is rebuilt, so what the last frame drawn to this
+    // image left in it is dropped once that frame's second phase is done reading it.
+    std::array<VkImageMemoryBarrier, 2> readBarriers = {{
+        {
+            VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER, nullptr,
+            VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+            VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL,
+            VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED,
+            mDepthBundle.depthImage, {depth_aspects(mDepthBundle.format), 0, 1, 0, 1}
+        },
+        {
+            VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER, nullptr,
+            0, VK_ACCESS_SHADER_WRITE_BIT,
+            VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL,
+            VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED,
+            pyramid.mImage, {VK_IMAGE_ASPECT_COLOR_BIT, 0, mDepthPyramidLevels, 0, 1}
+        }
+    }};
+    vkCmdPipelineBarrier(
+        aCmdBuffer,
+        VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr,
+        static_cast<uint32_t>(readBarriers.size()), readBarriers.data()
+    );
+
+    vkCmdBindPipeline(aCmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, stage.pipeline.handle());
+    for(uint32_t level = 0; level < mDepthPyramidLevels; ++level){
+        uint32_t width = std::max(1U, mDepthPyramidExtent.width >> level);
+        uint32_t height = std::max(1U, mDepthPyramidExtent.height >> level);
+        vkCmdBindDescriptorSets(aCmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, stage.pipeline.getLayout(), 0, 1, &pyramid.mDescriptorSets[level], 0, nullptr);
+        vkCmdDispatch(aCmdBuffer, (width + DEPTH_PYRAMID_GROUP_SIZE - 1) / DEPTH_PYRAMID_GROUP_SIZE, (height + DEPTH_PYRAMID_GROUP_SIZE - 1) / DEPTH_PYRAMID_GROUP_SIZE, 1);
+
+        // Read by the next level, and after the last by the culling stage
+        VkMemoryBarrier levelBarrier = {VK_STRUCTURE_TYPE_MEMORY_BARRIER, nullptr, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT};
+        vkCmdPipelineBarrier(aCmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &levelBarrier, 0, nullptr, 0, nullptr);
+    }
+
+    // Hand the depth buffer back to the second render pass
+    VkImageMemoryBarrier attachmentBarrier = {
+        VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER, nullptr,
+        0, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+        VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+        VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED,
+        mDepthBundle.depthImage, {depth_aspects(mDepthBundle.format), 0, 1, 0, 1}
+    };
+    vkCmdPipelineBarrier(
+        aCmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+        0, 0, nullptr, 0, nullptr, 1, &attachmentBarrier
+    );
+}
+
+void VulkanGraphicsApp::updateGpuCullFrustum(size_t aImageIndex){
+    if(mCullFrustumBuffer == VK_NULL_HANDLE) return;
+    static_assert(sizeof(GpuCullFrustum) == 180, "GpuCullFrustum must match CullFrustum in shaders/cull.inl");
+
+    GpuCullFrustum frustum;
+    mFrustumCuller.setViewProjection(glm::value_ptr(mCullViewProjection));
+    for(size_t plane = 0; plane < 6; ++plane){
+        std::memcpy(frustum.mPlanes[plane], mFrustumCuller.getPlane(plane), sizeof(frustum.mPlanes[plane]));
+    }
+    std::memcpy(frustum.mViewProjection, glm::value_ptr(mCullViewProjection), sizeof(frustum.mViewProjection));
+    const VkExtent2D& extent = mSwapchainProvider->getSwapchainBundle().extent;
+    frustum.mDepthSize[0] = static_cast<float>(extent.width);
+    frustum.mDepthSize[1] = static_cast<float>(extent.height);
+    frustum.mRecordCount = mCullRecordCount;
+    frustum.mCompact = mDrawIndexedIndirectCount != nullptr ? 1U : 0U;
+    frustum.mPyramidLevels = mDepthPyramidLevels;
+
+    VkDeviceSize offset = aImageIndex * mCullFrustumStride;
+    std::memcpy(static_cast<uint8_t*>(mCullFrustumAllocInfo.pMappedData) + offset, &frustum, sizeof(frustum));
+    vmaFlushAllocation(VmaHost::getAllocator(getPrimaryDeviceBundle()), mCullFrustumAllocation, offset, sizeof(frustum));
+}
+
+void VulkanGraphicsApp::readOcclusionStats(size_t aImageIndex){
+    if(mOcclusionReadbackBuffer == VK_NULL_HANDLE) return;
+
+    VkDeviceSize offset = aImageIndex * sizeof(uint32_t);
+    vmaInvalidateAllocation(VmaHost::getAllocator(getPrimaryDeviceBundle()), mOcclusionReadbackAllocation, offset, sizeof(uint32_t));
+    uint32_t occluded = 0;
+    std::memcpy(&occluded, static_cast<const uint8_t*>(mOcclusionReadbackAllocInfo.pMappedData) + offset, sizeof(occluded));
+    mOcclusionStats.mInstances = mCullRecordCount;
+    mOcclusionStats.mOccluded = occluded;
+}
+
 void VulkanGraphicsApp::cleanup(){
     for(ObjMultiShapeGeometry& obj : mMultiShapeObjects){
         obj.freeAndReset();
@@ -540,7 +1699,22 @@ void VulkanGraphicsApp::cleanup(){
         vkDestroyShaderModule(getPrimaryDeviceBundle().logicalDevice.handle(), module.second, nullptr);
     }
     textureLoader.cleanup();
+    mIndirectDrawBuffer.freeAndReset();
+    mCullRecordBuffer.freeAndReset();
+    mGeometryPool.freeAndReset();
     cleanupSwapchainDependents();
+    if(mComputeProvider != nullptr){
+        mComputeProvider->cleanup();
+        mComputeProvider = nullptr;
+        vkDestroyDescriptorSetLayout(getPrimaryDeviceBundle().logicalDevice, mCullSetLayout, nullptr);
+        mCullSetLayout = VK_NULL_HANDLE;
+        if(mPyramidSetLayout != VK_NULL_HANDLE){
+            vkDestroyDescriptorSetLayout(getPrimaryDeviceBundle().logicalDevice, mPyramidSetLayout, nullptr);
+            vkDestroySampler(getPrimaryDeviceBundle().logicalDevice, mDepthPyramidSampler, nullptr);
+            mPyramidSetLayout = VK_NULL_HANDLE;
+            mDepthPyramidSampler = VK_NULL_HANDLE;
+        }
+    }
 
     mMultiUniformBuffer->freeAndReset();
     mMultiUniformBuffer = nullptr;
@@ -548,6 +1722,16 @@ void VulkanGraphicsApp::cleanup(){
     mSingleUniformBuffer.freeAndReset();
 
     vkDestroyCommandPool(getPrimaryDeviceBundle().logicalDevice.handle(), mCommandPool, nullptr);
+    for(VkCommandPool pool : mFrameCommandPools){
+        vkDestroyCommandPool(getPrimaryDeviceBundle().logicalDevice.handle(), pool, nullptr);
+    }
+    mFrameCommandPools.clear();
+    mFrameCommandBuffers.clear();
+    for(VkCommandPool pool : mSecondaryCommandPools){
+        vkDestroyCommandPool(getPrimaryDeviceBundle().logicalDevice.handle(), pool, nullptr);
+    }
+    mSecondaryCommandPools.clear();
+    mSecondaryCommandBuffers.clear();
 
     mSwapchainProvider->cleanup();
     mCoreProvider->cleanup();
@@ -564,15 +1748,21 @@ void VulkanGraphicsApp::initUniformResources() {
 
     mTotalUniformDescriptorSetCount = mSwapchainProvider->getSwapchainBundle().images.size();
 
-    // Create layout from merged set of bindings from both the multi instance and single instance buffers
+    // Each descriptor set reads its own frame slot of the uniform buffers
+    mMultiUniformBuffer->setFrameSlotCount(static_cast<uint32_t>(mTotalUniformDescriptorSetCount));
+    mSingleUniformBuffer.setFrameSlotCount(static_cast<uint32_t>(mTotalUniformDescriptorSetCount));
+    if(mSingleUniformBuffer.boundInterfaceCount() > 0){
+        mSingleUniformBuffer.updateDevice();
+    }
+
+    // Create layout from merged set of bindings from both the multi instance and single instance buffers.
+    // Textures live in their own descriptor set, owned by textureLoader.
     const std::vector<VkDescriptorSetLayoutBinding>& multiBindings = mMultiUniformBuffer->getDescriptorSetLayoutBindings();
     const std::vector<VkDescriptorSetLayoutBinding>& singleBindings = mSingleUniformBuffer.getDescriptorSetLayoutBindings();
-    const std::vector<VkDescriptorSetLayoutBinding>& samplerBindings = textureLoader.getDescriptorSetLayoutBindings(multiBindings.size() + singleBindings.size());
     std::vector<VkDescriptorSetLayoutBinding> mergedBindings;
-    mergedBindings.reserve(multiBindings.size() + singleBindings.size() + samplerBindings.size());
+    mergedBindings.reserve(multiBindings.size() + singleBindings.size());
     mergedBindings.insert(mergedBindings.end(), multiBindings.begin(), multiBindings.end());
     mergedBindings.insert(mergedBindings.end(), singleBindings.begin(), singleBindings.end());
-    mergedBindings.insert(mergedBindings.end(), samplerBindings.begin(), samplerBindings.end());
     VkDescriptorSetLayoutCreateInfo layoutInfo = {};
     {
         layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
@@ -594,10 +1784,9 @@ void VulkanGraphicsApp::initUniformResources() {
 void VulkanGraphicsApp::initUniformDescriptorPool() {
     uint32_t dynamicPoolSize = mTotalUniformDescriptorSetCount*mMultiUniformBuffer->boundLayoutCount();
     uint32_t staticPoolSize = mTotalUniformDescriptorSetCount*mSingleUniformBuffer.boundInterfaceCount();
-    VkDescriptorPoolSize poolSizes[3] = {
-        {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, dynamicPoolSize},
-        {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, staticPoolSize},
-        {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, dynamicPoolSize * TextureLoader::TEXTURE_ARRAY_SIZE}
+    VkDescriptorPoolSize poolSizes[2] = {
+        {mMultiUniformBuffer->getDescriptorType(), dynamicPoolSize},
+        {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, staticPoolSize}
     };
 
     VkDescriptorPoolCreateInfo createInfo;
@@ -606,7 +1795,7 @@ void VulkanGraphicsApp::initUniformDescriptorPool() {
         createInfo.pNext = nullptr;
         createInfo.flags = 0;
         createInfo.maxSets = static_cast<uint32_t>(mTotalUniformDescriptorSetCount);
-        createInfo.poolSizeCount = 3;
+        createInfo.poolSizeCount = 2;
         createInfo.pPoolSizes = poolSizes;
     }
 
@@ -637,19 +1826,22 @@ void VulkanGraphicsApp::allocateDescriptorSets() {
 }
 
 void VulkanGraphicsApp::writeDescriptorSets(){
-    std::map<uint32_t, VkDescriptorBufferInfo> bufferInfos = merge(mSingleUniformBuffer.getDescriptorBufferInfos(), mMultiUniformBuffer->getDescriptorBufferInfos());
-    uint32_t imageDescriptorNumber = bufferInfos.size();
-
-    std::array<VkDescriptorImageInfo, TextureLoader::TEXTURE_ARRAY_SIZE> imageInfos = textureLoader.getDescriptorImageInfos();
+    // Descriptor set 'i' points at frame slot 'i' of both uniform buffers. 
+    std::vector<std::map<uint32_t, VkDescriptorBufferInfo>> bufferInfoSets;
+    bufferInfoSets.reserve(mUniformDescriptorSets.size());
+    for(uint32_t slot = 0; slot < mUniformDescriptorSets.size(); ++slot){
+        bufferInfoSets.emplace_back(merge(mSingleUniformBuffer.getDescriptorBufferInfos(slot), mMultiUniformBuffer->getDescriptorBufferInfos(slot)));
+    }
     std::vector<VkWriteDescriptorSet> setWriters;
 
-    setWriters.reserve(mUniformDescriptorSets.size() * (bufferInfos.size() + imageInfos.size()));
+    setWriters.reserve(mUniformDescriptorSets.size() * bufferInfoSets.front().size());
     
     VkBuffer staticUB = mSingleUniformBuffer.handle();
-    for(VkDescriptorSet descriptorSet : mUniformDescriptorSets){
+    for(size_t setIdx = 0; setIdx < mUniformDescriptorSets.size(); ++setIdx){
+        VkDescriptorSet descriptorSet = mUniformDescriptorSets[setIdx];
         
         //emplace all of the VkDescriptorBufferInfos.
-        for(const auto& info : bufferInfos){
+        for(const auto& info : bufferInfoSets[setIdx]){
             
             setWriters.emplace_back(
                 VkWriteDescriptorSet{
@@ -659,28 +1851,13 @@ void VulkanGraphicsApp::writeDescriptorSets(){
                     /* dstBinding = */ info.first,
                     /* dstArrayElement = */ 0,
                     /* descriptorCount = */ 1,
-                    /* descriptorType = */ (info.second.buffer == staticUB) ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+                    /* descriptorType = */ (info.second.buffer == staticUB) ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : mMultiUniformBuffer->getDescriptorType(),
                     /* pImageInfo = */ nullptr,
                     /* pBufferInfo = */ &info.second,
                     /* pTexelBufferView = */ nullptr
                 }
             );
         }
-        //finally, emplace the VkDescriptorImageInfo.
-        setWriters.emplace_back(
-            VkWriteDescriptorSet{
-                /* sType = */ VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-                /* pNext = */ nullptr,
-                /* dstSet = */ descriptorSet,
-                /* dstBinding = */ imageDescriptorNumber,
-                /* dstArrayElement = */ 0,
-                /* descriptorCount = */ TextureLoader::TEXTURE_ARRAY_SIZE,
-                /* descriptorType = */ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-                /* pImageInfo = */ imageInfos.data(),
-                /* pBufferInfo = */nullptr,
-                /* pTexelBufferView = */ nullptr
-            }
-        );
     }
     vkUpdateDescriptorSets(getPrimaryDeviceBundle().logicalDevice, setWriters.size(), setWriters.data(), 0, nullptr);
 }
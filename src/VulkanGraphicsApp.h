@@ -2,7 +2,9 @@
 #define VULKAN_GRAPHICS_APP_H_
 #include "application/VulkanSetupCore.h"
 #include "application/SwapchainProvider.h"
+#include "application/HeadlessProvider.h"
 #include "application/RenderProvider.h"
+#include "application/ComputeProvider.h"
 #include "vkutils/vkutils.h"
 #include "data/VertexGeometry.h"
 #include "data/UniformBuffer.h"
@@ -11,8 +13,12 @@
 #include "load_obj.h"
 #include "load_texture.h"
 #include "utils/common.h"
+#include "utils/FrustumCuller.h"
+#include "utils/OcclusionRasterizer.h"
+#include <array>
 #include <map>
 #include <memory>
+#include <optional>
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 // The code below defines the types and formatting for uniform data used in our shaders. 
@@ -73,23 +79,40 @@ using UniformAnimShadeDataPtr = std::shared_ptr<UniformAnimShadeData>;
 
 class VulkanGraphicsApp : virtual public VulkanAppInterface, public CoreLink{
  public:
+    /// Selects between rendering to a window through a swapchain or to an offscreen image ring.
+    enum class PresentationMode {WINDOWED, HEADLESS};
+
     /// Default constructor runs full initCore() immediately. Use protected no-init constructor
     /// it this is undesirable. 
     VulkanGraphicsApp() {initCore();}
+    /// Runs full initCore() immediately using the given presentation mode. 
+    explicit VulkanGraphicsApp(PresentationMode aMode) : mPresentationMode(aMode) {initCore();}
 
     void init();
     void render(int currentPipeline);
     void cleanup();
     
+    /// Returns nullptr when running headless
     GLFWwindow* getWindowPtr() const {return(mSwapchainProvider->getWindowPtr());}
+    bool isHeadless() const {return(mPresentationMode == PresentationMode::HEADLESS);}
     const VkExtent2D& getFramebufferSize() const;
     size_t getFrameNumber() const {return(mFrameNumber);}
 
     /// Setup the uniform buffer that will be used by all MultiShape objects in the scene
     /// 'aUniformLayout' specifies the layout of uniform data available to all instances.
-    void initMultis(const UniformDataLayoutSet& aUniformLayout);
+    /// With 'INSTANCE_STORAGE' the per-object data is read from storage buffers indexed by gl_InstanceIndex,
+    /// the descriptor set is bound once per frame, and shaders must declare the bindings as buffer blocks.
+    void initMultis(const UniformDataLayoutSet& aUniformLayout, MultiInstanceUniformBuffer::BufferMode aMode = MultiInstanceUniformBuffer::BufferMode::DYNAMIC_UNIFORM);
     /// Add loaded obj and a set of interfaces for its uniform data
     void addMultiShapeObject(const ObjMultiShapeGeometry& mObject, const std::vector<UniformDataInterfaceSet>& aUniformData);
+    /// Add 'aInstanceCount' copies of a loaded obj which are drawn together with one instanced draw per shape.
+    /// 'aUniformData' holds shapeCount() * aInstanceCount sets ordered by shape, then instance.
+    /// Descriptor set positions of 'aObject' are assigned by this call. Requires INSTANCE_STORAGE mode. 
+    void addInstancedMultiShapeObject(const ObjMultiShapeGeometry& aObject, uint32_t aInstanceCount, const std::vector<UniformDataInterfaceSet>& aUniformData);
+    /// Remove the object at 'aObjectIndex' in the order objects were added, returning its geometry to the pool.
+    /// Later objects move down one index. Its uniform data instances stay allocated, since the descriptor set
+    /// positions of other objects index the instances after them.
+    void removeMultiShapeObject(size_t aObjectIndex);
 
     void addSingleInstanceUniform(uint32_t aBindPoint, const UniformDataInterfacePtr& aUniformInterface);
 
@@ -98,7 +121,58 @@ class VulkanGraphicsApp : virtual public VulkanAppInterface, public CoreLink{
 
 
 
+    /// Shapes visible and culled in the last frame recorded with frustum culling
+    struct CullStats {
+        size_t mVisible = 0;
+        size_t mCulled = 0;
+        /// Those of the culled shapes within the frustum but hidden behind rasterized occluders
+        size_t mOccluded = 0;
+    };
+
+    /// When enabled, commands are recorded every frame and only shapes whose bounding spheres
+    /// intersect the view frustum are drawn. Otherwise the commands recorded by init() are reused.
+    void setFrustumCulling(bool aEnabled);
+    bool isFrustumCulling() const {return(mFrustumCulling);}
+    /// The view-projection matrix the per-shape model transforms are culled against
+    void setCullingViewProjection(const glm::mat4& aViewProjection) {mCullViewProjection = aViewProjection;}
+    const CullStats& getCullStats() const {return(mCullStats);}
+
+    /// When enabled, commands are recorded every frame with frustum culling, and the shapes within the frustum are
+    /// then rasterized as occluders into a small depth buffer on the CPU across ThreadPool::shared(). Shapes whose
+    /// bounds are behind it everywhere are skipped. Each occluder is the largest triangles of its shape.
+    void setOcclusionRasterizing(bool aEnabled) {mOcclusionRasterizing = aEnabled;}
+    bool isOcclusionRasterizing() const {return(mOcclusionRasterizing);}
+
+    /// When enabled, commands are recorded every frame with the scene split into contiguous ranges of shapes,
+    /// each recorded into a secondary command buffer on a ThreadPool::shared() worker and executed by the primary.
+    void setParallelRecording(bool aEnabled) {mParallelRecording = aEnabled;}
+    bool isParallelRecording() const {return(mParallelRecording);}
+
+    /// When enabled before init(), a compute stage culls every instance of every shape against the frustum of
+    /// setCullingViewProjection() and writes the surviving draws for the render pass, so the CPU cost of a frame
+    /// doesn't grow with the scene. Requires indirect draws and a Transforms storage binding, and takes
+    /// precedence over CPU culling and parallel recording. 
+    void setGpuCulling(bool aEnabled) {mGpuCulling = aEnabled;}
+    bool isGpuCulling() const {return(useGpuCulling());}
+
+    /// Instances tested against the depth pyramid, and those found hidden, in the last frame read back
+    struct OcclusionStats {
+        size_t mInstances = 0;
+        size_t mOccluded = 0;
+    };
+
+    /// When enabled before init() along with GPU culling, instances are also culled against a depth pyramid in
+    /// two phases. Those visible last frame are drawn first, the pyramid is built from their depth, and everything
+    /// else within the frustum is tested against it before a second render pass draws what became visible.
+    /// Requires a depth format which can be sampled.
+    void setOcclusionCulling(bool aEnabled) {mOcclusionCulling = aEnabled;}
+    bool isOcclusionCulling() const {return(useOcclusionCulling());}
+    /// Read back from the last frame which finished rendering to the current image, so it lags a few frames behind
+    const OcclusionStats& getOcclusionStats() const {return(mOcclusionStats);}
+
     const VkCommandPool getCommandPool() const { return mCommandPool; }
+    /// Make textures created through textureLoader after init() visible to shaders.
+    void commitTextures();
     TextureLoader textureLoader;
  protected:
     friend class VulkanProviderInterface;
@@ -133,13 +207,78 @@ class VulkanGraphicsApp : virtual public VulkanAppInterface, public CoreLink{
     void initRenderPipeline();
     void initFramebuffers(int currentRenderPipeline);
     void initCommands(int currentRenderPipeline);
+    /// Record the commands of 'aPipeline' drawing to swapchain image 'aImageIndex', once allocated by initCommands()
+    void recordImageCommands(int aPipeline, size_t aImageIndex);
+    /// Write texture streaming's swapped entries into the table of image 'aImageIndex', whose last frame must have
+    /// finished, and record its commands again if the table isn't bindless
+    void refreshTextureTable(size_t aImageIndex);
+    /// Record the render pass drawing the scene to swapchain image 'aImageIndex' into the begun 'aCmdBuffer'.
+    /// Shapes with a zero entry in 'aVisibleShapes', indexed in object order, are skipped. Null draws everything.
+    void recordDrawCommands(VkCommandBuffer aCmdBuffer, int aPipeline, size_t aImageIndex, const std::vector<uint8_t>* aVisibleShapes);
+    /// Bind the scene's state and draw the shapes in [aFirstShape, aEndShape) inside a begun render pass.
+    /// Only reads the app, so ranges can be recorded into different command buffers at once.
+    /// With GPU culling, 'aCullList' selects the draws of the first or second occlusion culling phase.
+    void recordDrawRange(VkCommandBuffer aCmdBuffer, int aPipeline, size_t aImageIndex, size_t aFirstShape, size_t aEndShape, const std::vector<uint8_t>* aVisibleShapes, uint32_t aCullList = 0) const;
+    VkRenderPassBeginInfo renderPassBegin(int aPipeline, size_t aImageIndex) const;
+    /// Number of shapes over all entries of mMultiShapeObjects
+    size_t totalShapeCount() const;
+    /// Fill mShapeVisibility by testing every shape's bounds under its model transform against mCullViewProjection
+    void cullShapes();
+    /// Clear shapes of mShapeVisibility hidden behind the visible shapes rasterized as occluders. Returns the count.
+    size_t occludeShapes();
+    /// True if commands are recorded by recordFrame() every frame instead of reusing those from initCommands()
+    bool recordsEachFrame() const {return(!useGpuCulling() && (mFrustumCulling || mOcclusionRasterizing || mParallelRecording));}
+    /// Cull the scene if enabled and record this frame's commands into the pools of frame slot 'aSyncObjectIndex'
+    VkCommandBuffer recordFrame(int aPipeline, uint32_t aImageIndex, size_t aSyncObjectIndex);
     void initSync();
 
+    void renderHeadless(int currentPipeline, size_t aSyncObjectIndex);
+
     void resetRenderSetup();
+    /// Upload the geometry and draws of objects added or removed after init, and record the commands again.
+    /// Unlike resetRenderSetup() the swapchain, pipelines and framebuffers are kept. The device must be idle.
+    void refreshSceneResources();
+    /// Free and record every command buffer from initCommands() again, after what they bind or draw changed.
+    /// The device must be idle.
+    void rerecordCommands();
     void cleanupSwapchainDependents();
 
     void initTransferCmdBuffer();
     void transferGeometry();
+    /// Stage one VkDrawIndexedIndirectCommand per shape of every object. Uploaded by transferGeometry().
+    /// Must run after the objects' meshes were added to mGeometryPool.
+    void buildIndirectDraws();
+    /// True if shapes are drawn from mIndirectDrawBuffer instead of one vkCmdDrawIndexed per shape.
+    /// Requires instance storage data and support for non-zero firstInstance in indirect draws.
+    bool useIndirectDraws() const;
+
+    /// True once initGpuCullStage() registered the culling stage. Draws then come from mCullOutputBuffer.
+    bool useGpuCulling() const;
+    /// Build the culling compute stage if GPU culling was requested and is supported. Runs once from init().
+    void initGpuCullStage();
+    /// Create the draw output and frustum buffers, and the culling descriptor set, of every swapchain image
+    void initGpuCullResources();
+    void cleanupGpuCullResources();
+    /// Record resetting the draw count of swapchain image 'aImageIndex', the culling dispatch, and the barrier
+    /// making its draws visible to the render pass. Must be recorded outside of the render pass.
+    void recordGpuCull(VkCommandBuffer aCmdBuffer, size_t aImageIndex) const;
+    /// Write the frustum of mCullViewProjection for the next frame drawn to swapchain image 'aImageIndex'
+    void updateGpuCullFrustum(size_t aImageIndex);
+    /// Number of draw lists written by the culling stage for each swapchain image, one per culling phase
+    uint32_t cullListCount() const {return(useOcclusionCulling() ? 2U : 1U);}
+    /// Offset of the draw count of list 'aList' of swapchain image 'aImageIndex' in mCullOutputBuffer
+    VkDeviceSize cullOutputOffset(size_t aImageIndex, uint32_t aList) const {return((aImageIndex * cullListCount() + aList) * mCullOutputStride);}
+
+    /// True once initGpuCullStage() registered the depth pyramid stage along with the two phase culling stage
+    bool useOcclusionCulling() const;
+    /// Create a depth pyramid for the current depth buffer for every swapchain image, with a view and descriptor set for every level
+    void initDepthPyramids(uint32_t aImageCount);
+    /// Record building the depth pyramid from what the first render pass drew, culling the rest against it,
+    /// and the second render pass drawing what became visible. Must follow the first render pass.
+    void recordOcclusionPass(VkCommandBuffer aCmdBuffer, int aPipeline, size_t aImageIndex) const;
+    void recordDepthPyramid(VkCommandBuffer aCmdBuffer, size_t aImageIndex) const;
+    /// Update mOcclusionStats from the last frame drawn to swapchain image 'aImageIndex', which must have finished
+    void readOcclusionStats(size_t aImageIndex);
 
     void initUniformResources();
     void initUniformDescriptorPool();
@@ -150,13 +289,16 @@ class VulkanGraphicsApp : virtual public VulkanAppInterface, public CoreLink{
     size_t mFrameNumber = 0;
 
     std::shared_ptr<VulkanSetupCore> mCoreProvider = nullptr; // Shadows CoreLink::mCoreProvider 
-    std::shared_ptr<SwapchainProvider> mSwapchainProvider = nullptr;
+    std::shared_ptr<PresentationProviderInterface> mSwapchainProvider = nullptr;
+    PresentationMode mPresentationMode = PresentationMode::WINDOWED;
 
     const static int IN_FLIGHT_FRAME_LIMIT = 2;
     std::vector<VkFramebuffer> mSwapchainFramebuffers;
     std::vector<VkSemaphore> mImageAvailableSemaphores;
     std::vector<VkSemaphore> mRenderFinishSemaphores;
     std::vector<VkFence> mInFlightFences;
+    /// Fence of the last frame submitted for each swapchain image. Guards that image's uniform frame slot.
+    std::vector<VkFence> mImagesInFlight;
 
     std::vector<vkutils::VulkanBasicRasterPipelineBuilder> mRenderPipelines;
     const int mNumRenderPipelines = 2;
@@ -172,6 +314,119 @@ class VulkanGraphicsApp : virtual public VulkanAppInterface, public CoreLink{
     std::string mFragmentKey;
 
     std::vector<ObjMultiShapeGeometry> mMultiShapeObjects;
+    /// Number of instances drawn for each entry of mMultiShapeObjects
+    std::vector<uint32_t> mMultiShapeInstanceCounts;
+    /// Shared vertex and index buffers holding the geometry of every entry of mMultiShapeObjects
+    ObjGeometryPool mGeometryPool;
+    /// Mesh in mGeometryPool for each entry of mMultiShapeObjects
+    std::vector<ObjGeometryPool::mesh_id_t> mMultiShapeMeshIds;
+    /// Indirect draw commands for every shape of every object, in object order
+    UploadTransferBackedBuffer mIndirectDrawBuffer = UploadTransferBackedBuffer(VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT);
+    uint32_t mIndirectDrawCount = 0;
+    /// Model transform of each shape of each entry of mMultiShapeObjects. Empty for objects which can't be culled on the CPU.
+    std::vector<std::vector<UniformTransformDataPtr>> mMultiShapeTransforms;
+    /// Binding of the model transforms within the multi-shape uniform data, if any object has one
+    std::optional<uint32_t> mTransformBinding;
+
+    bool mFrustumCulling = false;
+    glm::mat4 mCullViewProjection = glm::mat4(1.0f);
+    FrustumCuller mFrustumCuller;
+    /// One entry per shape in object order, 1 if it was visible in the last culled frame
+    std::vector<uint8_t> mShapeVisibility;
+    CullStats mCullStats;
+
+    const static size_t MAX_OCCLUDER_TRIANGLES = 256;
+    bool mOcclusionRasterizing = false;
+    OcclusionRasterizer mOcclusionRasterizer;
+    /// Simplified occluder of each shape in object order, empty for shapes which can't be culled.
+    /// Cleared whenever objects are added or removed, and built again by the next occludeShapes().
+    std::vector<OcclusionRasterizer::OccluderMesh> mOccluderMeshes;
+    /// Reset and rerecorded every frame by recordFrame(), one pool per frame in flight
+    std::vector<VkCommandPool> mFrameCommandPools;
+    std::vector<VkCommandBuffer> mFrameCommandBuffers;
+
+    bool mParallelRecording = false;
+    /// Fewest shapes given to each secondary command buffer. Scenes below twice this are recorded inline.
+    const static size_t PARALLEL_RECORD_MIN_SHAPES = 64;
+    /// One pool and secondary buffer per recording thread for each frame in flight, indexed [frame slot * recorders + chunk]
+    std::vector<VkCommandPool> mSecondaryCommandPools;
+    std::vector<VkCommandBuffer> mSecondaryCommandBuffers;
+
+    /// One instance of one shape as read by shaders/cull.comp, with its bounding sphere in model space
+    struct GpuCullRecord {
+        VkDrawIndexedIndirectCommand mCommand;
+        float mCenter[3];
+        float mRadius;
+    };
+    /// Frustum read by shaders/cull.inl, laid out as its std140 uniform block
+    struct GpuCullFrustum {
+        float mPlanes[6][4];
+        float mViewProjection[16];
+        float mDepthSize[2];
+        uint32_t mRecordCount;
+        uint32_t mCompact; // Non-zero if visible draws are packed and counted for vkCmdDrawIndexedIndirectCount
+        uint32_t mPyramidLevels;
+    };
+    const static uint32_t GPU_CULL_GROUP_SIZE = 64; // local_size_x of shaders/cull.comp
+
+    bool mGpuCulling = false;
+    /// Owns the culling compute stage
+    std::shared_ptr<ComputeProvider> mComputeProvider = nullptr;
+    /// One GpuCullRecord per instance of every shape, in object order
+    UploadTransferBackedBuffer mCullRecordBuffer = UploadTransferBackedBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+    uint32_t mCullRecordCount = 0;
+    /// For every list of every swapchain image, the draw and occluded counts followed by one draw command per record
+    VkBuffer mCullOutputBuffer = VK_NULL_HANDLE;
+    VmaAllocation mCullOutputAllocation = VK_NULL_HANDLE;
+    VkDeviceSize mCullOutputStride = 0;
+    /// Space taken by the counts ahead of the draw commands of each list
+    VkDeviceSize mCullCountStride = 0;
+    /// A GpuCullFrustum for every swapchain image, persistently mapped
+    VkBuffer mCullFrustumBuffer = VK_NULL_HANDLE;
+    VmaAllocation mCullFrustumAllocation = VK_NULL_HANDLE;
+    VmaAllocationInfo mCullFrustumAllocInfo = {};
+    VkDeviceSize mCullFrustumStride = 0;
+    VkDescriptorSetLayout mCullSetLayout = VK_NULL_HANDLE;
+    VkDescriptorPool mCullDescriptorPool = VK_NULL_HANDLE;
+    /// One set per list of every swapchain image, indexed like cullOutputOffset()
+    std::vector<VkDescriptorSet> mCullDescriptorSets;
+    /// vkCmdDrawIndexedIndirectCount or its KHR alias, or null if the draw count can't be read on the device.
+    /// Culled draws then keep their slots with an instance count of zero.
+    PFN_vkCmdDrawIndexedIndirectCountKHR mDrawIndexedIndirectCount = nullptr;
+
+    bool mOcclusionCulling = false;
+    const static uint32_t DEPTH_PYRAMID_GROUP_SIZE = 8; // local_size_x and local_size_y of shaders/depth_pyramid.comp
+    /// The first clears and leaves its attachments to be drawn over, the second loads them and presents.
+    /// Compatible with the render passes of mRenderPipelines, so they share pipelines and framebuffers.
+    std::array<VkRenderPass, 2> mOcclusionRenderPasses = {VK_NULL_HANDLE, VK_NULL_HANDLE};
+    struct DepthPyramid {
+        VkImage mImage = VK_NULL_HANDLE;
+        VmaAllocation mAllocation = VK_NULL_HANDLE;
+        /// Every level, as read by the culling stage
+        VkImageView mView = VK_NULL_HANDLE;
+        /// One view per level, as written by shaders/depth_pyramid.comp and read to build the next level
+        std::vector<VkImageView> mLevelViews;
+        /// Set 'i' reads level i - 1, or the depth buffer, and writes level i
+        std::vector<VkDescriptorSet> mDescriptorSets;
+    };
+    /// One pyramid per swapchain image, so frames in flight don't build over one another's
+    std::vector<DepthPyramid> mDepthPyramids;
+    /// Half the size of mDepthBundle rounded up to powers of two at level 0, down to 1x1
+    VkExtent2D mDepthPyramidExtent = {0, 0};
+    uint32_t mDepthPyramidLevels = 0;
+    VkSampler mDepthPyramidSampler = VK_NULL_HANDLE;
+    VkDescriptorSetLayout mPyramidSetLayout = VK_NULL_HANDLE;
+    VkDescriptorPool mPyramidDescriptorPool = VK_NULL_HANDLE;
+    /// One entry per record for every swapchain image, non-zero if it was visible in the second phase of the
+    /// last frame drawn to that image. Cleared at creation, so the first frame draws everything in its second phase.
+    VkBuffer mCullVisibilityBuffer = VK_NULL_HANDLE;
+    VmaAllocation mCullVisibilityAllocation = VK_NULL_HANDLE;
+    VkDeviceSize mCullVisibilityStride = 0;
+    /// The occluded count of every swapchain image's last frame, persistently mapped
+    VkBuffer mOcclusionReadbackBuffer = VK_NULL_HANDLE;
+    VmaAllocation mOcclusionReadbackAllocation = VK_NULL_HANDLE;
+    VmaAllocationInfo mOcclusionReadbackAllocInfo = {};
+    OcclusionStats mOcclusionStats;
 
     
     std::shared_ptr<MultiInstanceUniformBuffer> mMultiUniformBuffer = nullptr;
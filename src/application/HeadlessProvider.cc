@@ -0,0 +1,86 @@
+#include "HeadlessProvider.h"
+#include "vkutils/VmaHost.h"
+
+void HeadlessProvider::initSwapchain(){
+    mSwapchainBundle.swapchain = VK_NULL_HANDLE;
+    mSwapchainBundle.surface_format = {sColorFormat, VK_COLOR_SPACE_SRGB_NONLINEAR_KHR};
+    mSwapchainBundle.presentation_mode = VK_PRESENT_MODE_IMMEDIATE_KHR;
+    mSwapchainBundle.extent = mViewportExtent;
+    mSwapchainBundle.requested_image_count = mImageCount;
+    mSwapchainBundle.image_count = mImageCount;
+    mSwapchainBundle.images.resize(mImageCount, VK_NULL_HANDLE);
+    mImageAllocations.resize(mImageCount, VK_NULL_HANDLE);
+
+    VkImageCreateInfo imageInfo = {};
+    {
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.pNext = nullptr;
+        imageInfo.flags = 0;
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.format = sColorFormat;
+        imageInfo.extent = VkExtent3D{mViewportExtent.width, mViewportExtent.height, 1};
+        imageInfo.mipLevels = 1;
+        imageInfo.arrayLayers = 1;
+        imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        // Transfer source so rendered frames can be copied out for inspection
+        imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        imageInfo.queueFamilyIndexCount = 0;
+        imageInfo.pQueueFamilyIndices = nullptr;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    }
+
+    VmaAllocationCreateInfo allocInfo = {};
+    {
+        allocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+    }
+
+    VmaAllocator allocator = VmaHost::getAllocator(getPrimaryDeviceBundle());
+    for(size_t i = 0; i < mImageCount; ++i){
+        if(vmaCreateImage(allocator, &imageInfo, &allocInfo, &mSwapchainBundle.images[i], &mImageAllocations[i], nullptr) != VK_SUCCESS){
+            throw std::runtime_error("Failed to create offscreen color image " + std::to_string(i));
+        }
+    }
+
+    initSwapchainViews();
+}
+
+void HeadlessProvider::initSwapchainViews(){
+    mSwapchainBundle.views.resize(mSwapchainBundle.image_count);
+    for(size_t i = 0; i < mSwapchainBundle.image_count; ++i){
+        VkImageViewCreateInfo createInfo;
+        {
+            createInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+            createInfo.pNext = nullptr;
+            createInfo.flags = 0;
+            createInfo.image = mSwapchainBundle.images[i];
+            createInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+            createInfo.format = mSwapchainBundle.surface_format.format;
+            createInfo.components = {VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY};
+            createInfo.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+        }
+        if(vkCreateImageView(getPrimaryDeviceBundle().logicalDevice.handle(), &createInfo, nullptr, &mSwapchainBundle.views[i]) != VK_SUCCESS){
+            throw std::runtime_error("Failed to create image view for offscreen image " + std::to_string(i));
+        }
+    }
+}
+
+void HeadlessProvider::cleanupSwapchain(){
+    for(const VkImageView& view : mSwapchainBundle.views){
+        vkDestroyImageView(getPrimaryDeviceBundle().logicalDevice.handle(), view, nullptr);
+    }
+    mSwapchainBundle.views.clear();
+
+    VmaAllocator allocator = VmaHost::getAllocator(getPrimaryDeviceBundle());
+    for(size_t i = 0; i < mSwapchainBundle.images.size(); ++i){
+        vmaDestroyImage(allocator, mSwapchainBundle.images[i], mImageAllocations[i]);
+    }
+    mSwapchainBundle.images.clear();
+    mImageAllocations.clear();
+    mSwapchainBundle.image_count = 0;
+}
+
+void HeadlessProvider::cleanup(){
+    cleanupSwapchain();
+}
@@ -0,0 +1,55 @@
+#ifndef VULKAN_HEADLESS_PROVIDER_H_
+#define VULKAN_HEADLESS_PROVIDER_H_
+
+#define GLFW_INCLUDE_NONE
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+#include <vulkan/vulkan.h>
+#include <vector>
+#include "vkutils/vkutils.h"
+#include "VulkanAppInterface.h"
+#include "vkutils/VulkanDevices.h"
+
+/** Presentation provider which renders into a ring of offscreen color images instead of a
+ *  swapchain. No window, surface, or VK_KHR_swapchain is required, so it runs on machines
+ *  without a display (e.g. CI with a software ICD such as lavapipe).
+ *  The ring is exposed through a VulkanSwapchainBundle whose 'swapchain' handle is always
+ *  VK_NULL_HANDLE, which lets framebuffer and command setup treat it like a real swapchain.
+ */
+class HeadlessProvider : virtual public PresentationProviderInterface {
+ public:
+
+    virtual ~HeadlessProvider() = default;
+
+    /// Nothing to do. There is no surface when running headless.
+    virtual void initPresentationSurface() override {}
+    /// Create the ring of offscreen color images and their views.
+    virtual void initSwapchain() override;
+    virtual void initSwapchainViews() override;
+
+    virtual void cleanup() override;
+    virtual void cleanupSwapchain() override;
+
+    virtual void setPresentationExtent(const VkExtent2D& aExtent) {mViewportExtent = aExtent;}
+    /// Set the number of images in the offscreen ring. Takes effect on the next initSwapchain().
+    void setImageCount(uint32_t aImageCount) {mImageCount = aImageCount;}
+
+    virtual const vkutils::VulkanSwapchainBundle& getSwapchainBundle() const override {return(mSwapchainBundle);}
+    virtual GLFWwindow* getWindowPtr() const override {return(nullptr);}
+    virtual const VkExtent2D& getPresentationExtent() const override {return(mViewportExtent);}
+
+    /// Format of the offscreen color images. Matches the format preferred by SwapchainProvider.
+    const static VkFormat sColorFormat = VK_FORMAT_B8G8R8A8_UNORM;
+
+ protected:
+
+    virtual VkQueueFlags getRequiredQueueFlags() const override {return(VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT | VK_QUEUE_TRANSFER_BIT);}
+
+    VkExtent2D mViewportExtent = {854, 480};
+    uint32_t mImageCount = 2;
+
+    vkutils::VulkanSwapchainBundle mSwapchainBundle;
+    std::vector<VmaAllocation> mImageAllocations;
+};
+
+#endif
@@ -32,9 +32,8 @@ std::vector<std::string> VulkanSetupCore::gatherInstanceExtensions(){
     const std::vector<std::string>& selfRequested = getRequestedInstanceExtensions();
     std::set<std::string> required(selfRequired.begin(), selfRequired.end());
     std::set<std::string> requested(selfRequested.begin(), selfRequested.end());
-    #ifdef __arm64__
-        requested.emplace("VK_KHR_get_physical_device_properties2");
-    #endif
+    // Lets extension features such as descriptor indexing be queried on Vulkan 1.0
+    requested.emplace(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
     
     for(const VulkanProviderInterface* dependent : _mDependentProviders){
         const std::vector<std::string>& dRequested = dependent->getRequestedInstanceExtensions();
@@ -226,7 +225,7 @@ void VulkanSetupCore::initVkPhysicalDevice(){
     std::cout << "Selected physical device '" << props.deviceName << "'(" << std::hex << props.deviceID << ")" << std::dec << std::endl;    
 
     // Wrap physical device with utility class. 
-    mDeviceBundle.physicalDevice = VulkanPhysicalDevice(selectedDevice);
+    mDeviceBundle.physicalDevice = VulkanPhysicalDevice(selectedDevice, mVkInstance);
 }
 
 void VulkanSetupCore::initVkLogicalDevice(){
@@ -0,0 +1,529 @@
+#include "cook_texture.h"
+#include "utils/ThreadPool.h"
+#include "stb_image.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+namespace {
+
+//the 565 endpoint color closest to 'color', given as 0-255 floats
+uint16_t pack_565(const float* color) {
+    int r = static_cast<int>(std::lround(std::clamp(color[0], 0.0f, 255.0f) * 31.0f / 255.0f));
+    int g = static_cast<int>(std::lround(std::clamp(color[1], 0.0f, 255.0f) * 63.0f / 255.0f));
+    int b = static_cast<int>(std::lround(std::clamp(color[2], 0.0f, 255.0f) * 31.0f / 255.0f));
+    return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+}
+
+void unpack_565(uint16_t packed, int* color) {
+    int r = (packed >> 11) & 31;
+    int g = (packed >> 5) & 63;
+    int b = packed & 31;
+    color[0] = (r << 3) | (r >> 2);
+    color[1] = (g << 2) | (g >> 4);
+    color[2] = (b << 3) | (b >> 2);
+}
+
+//color half of BC1 and BC3 blocks. The endpoints are the texels furthest apart along the principal axis of the
+//block's colors, and always in four color mode since BC3 can't use the three color mode.
+void encode_color_block(const unsigned char* rgba, unsigned char* out) {
+    float mean[3] = {0.0f, 0.0f, 0.0f};
+    for (int i = 0; i < 16; i++) {
+        for (int c = 0; c < 3; c++) {
+            mean[c] += rgba[i * 4 + c] / 16.0f;
+        }
+    }
+    float covariance[3][3] = {};
+    for (int i = 0; i < 16; i++) {
+        float d[3] = {rgba[i * 4] - mean[0], rgba[i * 4 + 1] - mean[1], rgba[i * 4 + 2] - mean[2]};
+        for (int a = 0; a < 3; a++) {
+            for (int b = 0; b < 3; b++) {
+                covariance[a][b] += d[a] * d[b];
+            }
+        }
+    }
+    //a few power iterations are plenty to find the dominant axis of 16 colors
+    float axis[3] = {1.0f, 1.0f, 1.0f};
+    for (int iteration = 0; iteration < 8; iteration++) {
+        float next[3];
+        for (int a = 0; a < 3; a++) {
+            next[a] = covariance[a][0] * axis[0] + covariance[a][1] * axis[1] + covariance[a][2] * axis[2];
+        }
+        float length = std::max({std::fabs(next[0]), std::fabs(next[1]), std::fabs(next[2])});
+        if (length < 1e-6f) {
+            break; //every texel has the same color
+        }
+        for (int a = 0; a < 3; a++) {
+            axis[a] = next[a] / length;
+        }
+    }
+
+    int minTexel = 0;
+    int maxTexel = 0;
+    float minProjection = 0.0f;
+    float maxProjection = 0.0f;
+    for (int i = 0; i < 16; i++) {
+        float projection = rgba[i * 4] * axis[0] + rgba[i * 4 + 1] * axis[1] + rgba[i * 4 + 2] * axis[2];
+        if (i == 0 || projection < minProjection) {
+            minProjection = projection;
+            minTexel = i;
+        }
+        if (i == 0 || projection > maxProjection) {
+            maxProjection = projection;
+            maxTexel = i;
+        }
+    }
+    float endpoint0[3] = {float(rgba[maxTexel * 4]), float(rgba[maxTexel * 4 + 1]), float(rgba[maxTexel * 4 + 2])};
+    float endpoint1[3] = {float(rgba[minTexel * 4]), float(rgba[minTexel * 4 + 1]), float(rgba[minTexel * 4 + 2])};
+    uint16_t color0 = pack_565(endpoint0);
+    uint16_t color1 = pack_565(endpoint1);
+    if (color0 < color1) {
+        std::swap(color0, color1);
+    }
+
+    uint32_t indices = 0;
+    if (color0 != color1) {
+        int palette[4][3];
+        unpack_565(color0, palette[0]);
+        unpack_565(color1, palette[1]);
+        for (int c = 0; c < 3; c++) {
+            palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+        }
+        for (int i = 0; i < 16; i++) {
+            int best = 0;
+            int bestDistance = -1;
+            for (int p = 0; p < 4; p++) {
+                int distance = 0;
+                for (int c = 0; c < 3; c++) {
+                    int d = rgba[i * 4 + c] - palette[p][c];
+                    distance += d * d;
+                }
+                if (bestDistance < 0 || distance < bestDistance) {
+                    bestDistance = distance;
+                    best = p;
+                }
+            }
+            indices |= static_cast<uint32_t>(best) << (2 * i);
+        }
+    }
+
+    out[0] = color0 & 0xFF;
+    out[1] = color0 >> 8;
+    out[2] = color1 & 0xFF;
+    out[3] = color1 >> 8;
+    for (int i = 0; i < 4; i++) {
+        out[4 + i] = (indices >> (8 * i)) & 0xFF;
+    }
+}
+
+VkFormat bc1_format(bool srgb) { return srgb ? VK_FORMAT_BC1_RGB_SRGB_BLOCK : VK_FORMAT_BC1_RGB_UNORM_BLOCK; }
+VkFormat bc3_format(bool srgb) { return srgb ? VK_FORMAT_BC3_SRGB_BLOCK : VK_FORMAT_BC3_UNORM_BLOCK; }
+
+bool is_srgb(VkFormat format) {
+    return format == VK_FORMAT_BC1_RGB_SRGB_BLOCK || format == VK_FORMAT_BC3_SRGB_BLOCK;
+}
+
+float srgb_to_linear(unsigned char value) {
+    static const std::vector<float> table = []() {
+        std::vector<float> values(256);
+        for (int i = 0; i < 256; i++) {
+            float c = i / 255.0f;
+            values[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+        }
+        return values;
+    }();
+    return table[value];
+}
+
+unsigned char linear_to_srgb(float value) {
+    float c = value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+    return static_cast<unsigned char>(std::lround(std::clamp(c, 0.0f, 1.0f) * 255.0f));
+}
+
+std::vector<unsigned char> encode_level(const std::vector<unsigned char>& rgba, uint32_t width, uint32_t height, VkFormat format) {
+    const uint32_t blockBytes = bc_block_bytes(format);
+    const uint32_t blocksWide = (width + 3) / 4;
+    const uint32_t blocksHigh = (height + 3) / 4;
+    std::vector<unsigned char> blocks(bc_level_bytes(format, width, height));
+    ThreadPool::shared().parallelFor(blocksHigh, [&](size_t blockY) {
+        unsigned char texels[64];
+        for (uint32_t blockX = 0; blockX < blocksWide; blockX++) {
+            //texels past the edges repeat the last row or column, so they don't pull the endpoints off
+            for (uint32_t i = 0; i < 16; i++) {
+                uint32_t x = std::min(blockX * 4 + i % 4, width - 1);
+                uint32_t y = std::min(static_cast<uint32_t>(blockY) * 4 + i / 4, height - 1);
+                memcpy(&texels[i * 4], &rgba[(static_cast<size_t>(y) * width + x) * 4], 4);
+            }
+            unsigned char* out = &blocks[(blockY * blocksWide + blockX) * blockBytes];
+            switch (format) {
+            case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+            case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+                encode_bc1_block(texels, out);
+                break;
+            case VK_FORMAT_BC3_UNORM_BLOCK:
+            case VK_FORMAT_BC3_SRGB_BLOCK:
+                encode_bc3_block(texels, out);
+                break;
+            case VK_FORMAT_BC4_UNORM_BLOCK:
+                encode_bc4_block(texels, 0, out);
+                break;
+            default:
+                encode_bc5_block(texels, out);
+                break;
+            }
+        }
+    });
+    return blocks;
+}
+
+const unsigned char KTX2_IDENTIFIER[12] = {0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A};
+const size_t KTX2_HEADER_BYTES = 80;
+const size_t KTX2_LEVEL_INDEX_ENTRY_BYTES = 24;
+
+void put_u32(std::vector<unsigned char>& bytes, size_t offset, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        bytes[offset + i] = (value >> (8 * i)) & 0xFF;
+    }
+}
+
+void put_u64(std::vector<unsigned char>& bytes, size_t offset, uint64_t value) {
+    for (int i = 0; i < 8; i++) {
+        bytes[offset + i] = (value >> (8 * i)) & 0xFF;
+    }
+}
+
+uint32_t get_u32(const std::vector<unsigned char>& bytes, size_t offset) {
+    uint32_t value = 0;
+    for (int i = 0; i < 4; i++) {
+        value |= static_cast<uint32_t>(bytes[offset + i]) << (8 * i);
+    }
+    return value;
+}
+
+uint64_t get_u64(const std::vector<unsigned char>& bytes, size_t offset) {
+    uint64_t value = 0;
+    for (int i = 0; i < 8; i++) {
+        value |= static_cast<uint64_t>(bytes[offset + i]) << (8 * i);
+    }
+    return value;
+}
+
+//basic data format descriptor of a BC format, see the Khronos Data Format Specification
+std::vector<unsigned char> make_dfd(VkFormat format) {
+    struct Sample {
+        uint32_t bitOffset;
+        uint32_t channel;
+        bool linear;
+    };
+    uint32_t colorModel;
+    std::vector<Sample> samples;
+    const bool srgb = is_srgb(format);
+    switch (format) {
+    case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+        colorModel = 128; //KHR_DF_MODEL_BC1A
+        samples = {{0, 0, false}};
+        break;
+    case VK_FORMAT_BC3_UNORM_BLOCK:
+    case VK_FORMAT_BC3_SRGB_BLOCK:
+        colorModel = 130; //KHR_DF_MODEL_BC3
+        samples = {{0, 15, srgb}, {64, 0, false}}; //alpha is never sRGB encoded
+        break;
+    case VK_FORMAT_BC4_UNORM_BLOCK:
+        colorModel = 131; //KHR_DF_MODEL_BC4
+        samples = {{0, 0, false}};
+        break;
+    default:
+        colorModel = 132; //KHR_DF_MODEL_BC5
+        samples = {{0, 0, false}, {64, 1, false}};
+        break;
+    }
+
+    const uint32_t blockSize = 24 + 16 * static_cast<uint32_t>(samples.size());
+    std::vector<unsigned char> dfd(4 + blockSize, 0);
+    put_u32(dfd, 0, static_cast<uint32_t>(dfd.size()));
+    put_u32(dfd, 4, 0); //Khronos vendor, basic descriptor type
+    put_u32(dfd, 8, 2 | (blockSize << 16)); //version 2
+    put_u32(dfd, 12, colorModel | (1 << 8) | ((srgb ? 2u : 1u) << 16)); //BT709 primaries, sRGB or linear transfer
+    put_u32(dfd, 16, 3 | (3 << 8)); //4x4 texel blocks
+    put_u32(dfd, 20, bc_block_bytes(format));
+    for (size_t i = 0; i < samples.size(); i++) {
+        size_t offset = 28 + 16 * i;
+        put_u32(dfd, offset, samples[i].bitOffset | (63u << 16) | (samples[i].channel << 24) | (samples[i].linear ? (1u << 28) : 0u));
+        put_u32(dfd, offset + 8, 0);
+        put_u32(dfd, offset + 12, 0xFFFFFFFF);
+    }
+    return dfd;
+}
+
+} // namespace
+
+uint32_t bc_block_bytes(VkFormat format) {
+    switch (format) {
+    case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+    case VK_FORMAT_BC4_UNORM_BLOCK:
+        return 8;
+    case VK_FORMAT_BC3_UNORM_BLOCK:
+    case VK_FORMAT_BC3_SRGB_BLOCK:
+    case VK_FORMAT_BC5_UNORM_BLOCK:
+        return 16;
+    default:
+        return 0;
+    }
+}
+
+size_t bc_level_bytes(VkFormat format, uint32_t width, uint32_t height) {
+    return static_cast<size_t>((width + 3) / 4) * ((height + 3) / 4) * bc_block_bytes(format);
+}
+
+std::vector<unsigned char> downsample_texels(const std::vector<unsigned char>& texels, uint32_t width, uint32_t height, int channels, bool srgb) {
+    //alpha is the last channel of grey+alpha and RGBA texels, and is never sRGB encoded
+    const int alphaChannel = (channels == 2 || channels == 4) ? channels - 1 : -1;
+    const uint32_t nextWidth = std::max(width / 2, 1u);
+    const uint32_t nextHeight = std::max(height / 2, 1u);
+    std::vector<unsigned char> next(static_cast<size_t>(nextWidth) * nextHeight * channels);
+    ThreadPool::shared().parallelFor(nextHeight, [&](size_t y) {
+        //odd texels at the right and bottom edges are folded into the last texel
+        uint32_t y0 = static_cast<uint32_t>(y) * 2;
+        uint32_t y1 = (y + 1 == nextHeight) ? height : y0 + 2;
+        for (uint32_t x = 0; x < nextWidth; x++) {
+            uint32_t x0 = x * 2;
+            uint32_t x1 = (x + 1 == nextWidth) ? width : x0 + 2;
+            float sum[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+            for (uint32_t sy = y0; sy < y1; sy++) {
+                for (uint32_t sx = x0; sx < x1; sx++) {
+                    const unsigned char* texel = &texels[(static_cast<size_t>(sy) * width + sx) * channels];
+                    for (int c = 0; c < channels; c++) {
+                        sum[c] += (srgb && c != alphaChannel) ? srgb_to_linear(texel[c]) : texel[c] / 255.0f;
+                    }
+                }
+            }
+            float count = static_cast<float>((y1 - y0) * (x1 - x0));
+            unsigned char* out = &next[(y * nextWidth + x) * channels];
+            for (int c = 0; c < channels; c++) {
+                float average = sum[c] / count;
+                out[c] = (srgb && c != alphaChannel) ? linear_to_srgb(average) : static_cast<unsigned char>(std::lround(average * 255.0f));
+            }
+        }
+    });
+    return next;
+}
+
+VkFormat select_bc_format(const unsigned char* rgba, uint32_t width, uint32_t height, int numChannels, bool srgb) {
+    bool opaque = true;
+    if (numChannels == 2 || numChannels == 4) {
+        size_t texelCount = static_cast<size_t>(width) * height;
+        for (size_t i = 0; i < texelCount && opaque; i++) {
+            opaque = rgba[i * 4 + 3] == 255;
+        }
+    }
+    switch (numChannels) {
+    case 1:
+        return srgb ? bc1_format(true) : VK_FORMAT_BC4_UNORM_BLOCK;
+    case 2:
+        if (!srgb) {
+            return VK_FORMAT_BC5_UNORM_BLOCK;
+        }
+        return opaque ? bc1_format(true) : bc3_format(true);
+    case 3:
+        return bc1_format(srgb);
+    default:
+        return opaque ? bc1_format(srgb) : bc3_format(srgb);
+    }
+}
+
+void encode_bc1_block(const unsigned char* rgba, unsigned char* out) {
+    encode_color_block(rgba, out);
+}
+
+void encode_bc3_block(const unsigned char* rgba, unsigned char* out) {
+    encode_bc4_block(rgba, 3, out);
+    encode_color_block(rgba, out + 8);
+}
+
+void encode_bc4_block(const unsigned char* rgba, int channel, unsigned char* out) {
+    int minValue = 255;
+    int maxValue = 0;
+    for (int i = 0; i < 16; i++) {
+        minValue = std::min<int>(minValue, rgba[i * 4 + channel]);
+        maxValue = std::max<int>(maxValue, rgba[i * 4 + channel]);
+    }
+    //endpoint 0 above endpoint 1 selects the mode with six interpolated values
+    uint64_t indices = 0;
+    if (maxValue != minValue) {
+        int palette[8] = {maxValue, minValue};
+        for (int k = 1; k <= 6; k++) {
+            palette[k + 1] = ((7 - k) * maxValue + k * minValue) / 7;
+        }
+        for (int i = 0; i < 16; i++) {
+            int value = rgba[i * 4 + channel];
+            int best = 0;
+            for (int p = 1; p < 8; p++) {
+                if (std::abs(value - palette[p]) < std::abs(value - palette[best])) {
+                    best = p;
+                }
+            }
+            indices |= static_cast<uint64_t>(best) << (3 * i);
+        }
+    }
+    out[0] = static_cast<unsigned char>(maxValue);
+    out[1] = static_cast<unsigned char>(minValue);
+    for (int i = 0; i < 6; i++) {
+        out[2 + i] = (indices >> (8 * i)) & 0xFF;
+    }
+}
+
+void encode_bc5_block(const unsigned char* rgba, unsigned char* out) {
+    encode_bc4_block(rgba, 0, out);
+    encode_bc4_block(rgba, 3, out + 8);
+}
+
+CookedTexture cook_texture(const unsigned char* rgba, uint32_t width, uint32_t height, VkFormat format) {
+    if (bc_block_bytes(format) == 0) {
+        throw std::runtime_error("cook_texture: unsupported format " + std::to_string(format));
+    }
+    CookedTexture cooked;
+    cooked.format = format;
+    cooked.width = width;
+    cooked.height = height;
+
+    std::vector<unsigned char> level(rgba, rgba + static_cast<size_t>(width) * height * 4);
+    uint32_t levelWidth = width;
+    uint32_t levelHeight = height;
+    while (true) {
+        cooked.levels.push_back(encode_level(level, levelWidth, levelHeight, format));
+        if (levelWidth == 1 && levelHeight == 1) {
+            break;
+        }
+        level = downsample_texels(level, levelWidth, levelHeight, 4, is_srgb(format));
+        levelWidth = std::max(levelWidth / 2, 1u);
+        levelHeight = std::max(levelHeight / 2, 1u);
+    }
+    return cooked;
+}
+
+void write_ktx2(const std::string& path, const CookedTexture& texture) {
+    const uint32_t blockBytes = bc_block_bytes(texture.format);
+    if (blockBytes == 0 || texture.levels.empty()) {
+        throw std::runtime_error("write_ktx2: " + path + " isn't a cooked BC texture");
+    }
+    const uint32_t levelCount = static_cast<uint32_t>(texture.levels.size());
+    const std::vector<unsigned char> dfd = make_dfd(texture.format);
+    const size_t dfdOffset = KTX2_HEADER_BYTES + KTX2_LEVEL_INDEX_ENTRY_BYTES * levelCount;
+
+    //level data follows the descriptor, smallest level first, each aligned to a whole block
+    std::vector<size_t> levelOffsets(levelCount);
+    size_t fileSize = dfdOffset + dfd.size();
+    for (uint32_t level = levelCount; level-- > 0;) {
+        fileSize = (fileSize + blockBytes - 1) / blockBytes * blockBytes;
+        levelOffsets[level] = fileSize;
+        fileSize += texture.levels[level].size();
+    }
+
+    std::vector<unsigned char> bytes(fileSize, 0);
+    memcpy(bytes.data(), KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER));
+    put_u32(bytes, 12, static_cast<uint32_t>(texture.format));
+    put_u32(bytes, 16, 1); //typeSize of block compressed formats
+    put_u32(bytes, 20, texture.width);
+    put_u32(bytes, 24, texture.height);
+    put_u32(bytes, 28, 0); //depth, 2D
+    put_u32(bytes, 32, 0); //layer count, not an array
+    put_u32(bytes, 36, 1); //face count
+    put_u32(bytes, 40, levelCount);
+    put_u32(bytes, 44, 0); //no supercompression
+    put_u32(bytes, 48, static_cast<uint32_t>(dfdOffset));
+    put_u32(bytes, 52, static_cast<uint32_t>(dfd.size()));
+    //no key/value data or supercompression global data, which leaves the rest of the index zero
+    for (uint32_t level = 0; level < levelCount; level++) {
+        size_t entry = KTX2_HEADER_BYTES + KTX2_LEVEL_INDEX_ENTRY_BYTES * level;
+        put_u64(bytes, entry, levelOffsets[level]);
+        put_u64(bytes, entry + 8, texture.levels[level].size());
+        put_u64(bytes, entry + 16, texture.levels[level].size());
+        memcpy(&bytes[levelOffsets[level]], texture.levels[level].data(), texture.levels[level].size());
+    }
+    memcpy(&bytes[dfdOffset], dfd.data(), dfd.size());
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file || !file.write(reinterpret_cast<const char*>(bytes.data()), bytes.size())) {
+        throw std::runtime_error("write_ktx2: failed to write " + path);
+    }
+}
+
+CookedTexture read_ktx2(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        throw std::runtime_error("read_ktx2: failed to open " + path);
+    }
+    std::vector<unsigned char> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    if (bytes.size() < KTX2_HEADER_BYTES || memcmp(bytes.data(), KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) != 0) {
+        throw std::runtime_error("read_ktx2: " + path + " isn't a KTX2 file");
+    }
+
+    CookedTexture texture;
+    texture.format = static_cast<VkFormat>(get_u32(bytes, 12));
+    texture.width = get_u32(bytes, 20);
+    texture.height = get_u32(bytes, 24);
+    const uint32_t levelCount = get_u32(bytes, 40);
+    if (bc_block_bytes(texture.format) == 0 || texture.width == 0 || texture.height == 0
+        || get_u32(bytes, 28) != 0 || get_u32(bytes, 32) > 1 || get_u32(bytes, 36) != 1 || get_u32(bytes, 44) != 0
+        || levelCount == 0 || levelCount > 32) {
+        throw std::runtime_error("read_ktx2: " + path + " isn't a single 2D BC texture with its mips");
+    }
+    if (bytes.size() < KTX2_HEADER_BYTES + KTX2_LEVEL_INDEX_ENTRY_BYTES * levelCount) {
+        throw std::runtime_error("read_ktx2: " + path + " is truncated");
+    }
+
+    texture.levels.resize(levelCount);
+    for (uint32_t level = 0; level < levelCount; level++) {
+        size_t entry = KTX2_HEADER_BYTES + KTX2_LEVEL_INDEX_ENTRY_BYTES * level;
+        uint64_t offset = get_u64(bytes, entry);
+        uint64_t length = get_u64(bytes, entry + 8);
+        size_t expected = bc_level_bytes(texture.format, std::max(texture.width >> level, 1u), std::max(texture.height >> level, 1u));
+        if (length != expected || offset > bytes.size() || length > bytes.size() - offset) {
+            throw std::runtime_error("read_ktx2: level " + std::to_string(level) + " of " + path + " is malformed");
+        }
+        texture.levels[level].assign(bytes.begin() + offset, bytes.begin() + offset + length);
+    }
+    return texture;
+}
+
+std::string cooked_texture_path(const std::string& sourcePath) {
+    return sourcePath + ".ktx2";
+}
+
+bool has_current_cooked_texture(const std::string& sourcePath) {
+    namespace fs = std::filesystem;
+    std::error_code error;
+    fs::file_time_type cookedTime = fs::last_write_time(cooked_texture_path(sourcePath), error);
+    if (error) {
+        return false;
+    }
+    fs::file_time_type sourceTime = fs::last_write_time(sourcePath, error);
+    //a cache without its source is still current
+    return error || cookedTime >= sourceTime;
+}
+
+void cook_texture_file(const std::string& sourcePath, const std::string& cookedPath, bool srgb) {
+    int width, height, numChannels;
+    stbi_uc* pixels = stbi_load(sourcePath.c_str(), &width, &height, &numChannels, STBI_rgb_alpha);
+    if (!pixels) {
+        throw std::runtime_error("cook_texture_file: failed to load " + sourcePath);
+    }
+    CookedTexture cooked;
+    try {
+        VkFormat format = select_bc_format(pixels, width, height, numChannels, srgb);
+        cooked = cook_texture(pixels, width, height, format);
+    }
+    catch (...) {
+        stbi_image_free(pixels);
+        throw;
+    }
+    stbi_image_free(pixels);
+    write_ktx2(cookedPath, cooked);
+}
@@ -0,0 +1,56 @@
+#ifndef VULKAN_COOK_TEXTURE_H_
+#define VULKAN_COOK_TEXTURE_H_
+#include <vulkan/vulkan.h>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/// A texture encoded to a block compressed (BCn) format along with its whole mip chain, level 0 first.
+/// Produced offline by cook_texture_file() and uploaded by TextureLoader without decoding anything.
+struct CookedTexture {
+    VkFormat format = VK_FORMAT_UNDEFINED;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    std::vector<std::vector<unsigned char>> levels;
+};
+
+/// Bytes per 4x4 block of the BC formats produced by the cook, or 0 for any other format.
+uint32_t bc_block_bytes(VkFormat format);
+/// Bytes of a 'width' x 'height' level of a BC format. Partial blocks at the edges are padded to whole blocks.
+size_t bc_level_bytes(VkFormat format, uint32_t width, uint32_t height);
+
+/// Box filters a level of 'channels' channel texels down to the next mip level. Color channels are averaged in
+/// linear space when 'srgb' is set, alpha (the last channel of two and four channel texels) never is.
+std::vector<unsigned char> downsample_texels(const std::vector<unsigned char>& texels, uint32_t width, uint32_t height, int channels, bool srgb);
+
+/// Picks a format for 'rgba', width*height RGBA texels decoded from an image with 'numChannels' channels.
+/// One and two channel data go to BC4 and BC5, opaque color to BC1 and color with varying alpha to BC3.
+/// BC4 and BC5 have no sRGB variants, so grey color images use BC1 and BC3 instead.
+VkFormat select_bc_format(const unsigned char* rgba, uint32_t width, uint32_t height, int numChannels, bool srgb);
+
+/// Block encoders. 'rgba' holds a 4x4 block of RGBA texels in row order.
+void encode_bc1_block(const unsigned char* rgba, unsigned char* out);
+void encode_bc3_block(const unsigned char* rgba, unsigned char* out);
+/// Encodes 'channel' (0 to 3) of the block, which BC4 stores as red.
+void encode_bc4_block(const unsigned char* rgba, int channel, unsigned char* out);
+/// Encodes the grey (red) channel as red and alpha as green, the layout stb decodes two channel images to.
+void encode_bc5_block(const unsigned char* rgba, unsigned char* out);
+
+/// Encodes 'rgba' into 'format' with a full mip chain generated on the CPU, gamma correctly for sRGB formats.
+/// The blocks of every level are encoded on the shared thread pool.
+CookedTexture cook_texture(const unsigned char* rgba, uint32_t width, uint32_t height, VkFormat format);
+
+/// Writes 'texture' as a KTX2 file without supercompression. Throws std::runtime_error on failure.
+void write_ktx2(const std::string& path, const CookedTexture& texture);
+/// Reads a KTX2 file holding a single 2D BC texture, as written by write_ktx2(). Throws std::runtime_error on failure.
+CookedTexture read_ktx2(const std::string& path);
+
+/// Cooked cache of the image file at 'sourcePath', kept alongside it with ".ktx2" appended.
+std::string cooked_texture_path(const std::string& sourcePath);
+/// True if 'sourcePath' has a cooked cache which is at least as new as the source.
+bool has_current_cooked_texture(const std::string& sourcePath);
+/// Decodes the image file at 'sourcePath' and writes it cooked to 'cookedPath'.
+void cook_texture_file(const std::string& sourcePath, const std::string& cookedPath, bool srgb);
+
+#endif
@@ -0,0 +1,111 @@
+#ifndef KJY_GEOMETRY_POOL_H_
+#define KJY_GEOMETRY_POOL_H_
+#include "vkutils/VulkanDevices.h"
+#include "RangeAllocator.h"
+#include <vulkan/vulkan.h>
+#include <vk_mem_alloc.h>
+#include <unordered_map>
+#include <vector>
+#include <stdexcept>
+
+/** Packs the vertices and indices of many meshes into one shared device local vertex buffer and one
+ * shared index buffer. Each mesh is drawn from the shared buffers with the 'vertexOffset' and 'firstIndex'
+ * of its MeshRange, so the buffers only need to be bound once for the whole scene.
+ * 
+ * Space is handed out from a free-list, so meshes may be added and removed at runtime. When a mesh does
+ * not fit, the affected buffer is replaced by one with at least double the capacity and the old contents
+ * are copied over during the next recordUploadTransferCommand(). Replaced buffers stay alive until
+ * freeStagingBuffer(), which must only be called once the transfer has completed. */
+template<typename VertexType, typename IndexType = uint32_t>
+class GeometryPool
+{
+ public:
+    using vertex_t = VertexType;
+    using index_t = IndexType;
+    using mesh_id_t = uint32_t;
+
+    /// Location of a mesh within the shared buffers, in units of vertices and indices.
+    struct MeshRange{
+        uint32_t mVertexOffset;
+        uint32_t mVertexCount;
+        uint32_t mFirstIndex;
+        uint32_t mIndexCount;
+    };
+
+    const static VkDeviceSize sDefaultVertexCapacity = 1U << 16;
+    const static VkDeviceSize sDefaultIndexCapacity = 1U << 18;
+
+    GeometryPool(VkDeviceSize aVertexCapacity = sDefaultVertexCapacity, VkDeviceSize aIndexCapacity = sDefaultIndexCapacity)
+    : mVertexRanges(aVertexCapacity), mIndexRanges(aIndexCapacity) {}
+
+    virtual void initDevice(const VulkanDeviceBundle& aDeviceBundle);
+
+    /// Reserve space for a mesh and stage its data for the next upload. Indices are relative to the mesh's
+    /// own vertices; offset them at draw time with MeshRange::mVertexOffset.
+    virtual mesh_id_t addMesh(const std::vector<VertexType>& aVertices, const std::vector<IndexType>& aIndices);
+    /// Return the space of a mesh to the free-list. The device must no longer be reading from the mesh.
+    virtual void removeMesh(mesh_id_t aMeshId);
+
+    virtual const MeshRange& getMesh(mesh_id_t aMeshId) const;
+    virtual size_t meshCount() const {return(mMeshes.size());}
+
+    virtual bool awaitingUploadTransfer() const {return(!mPendingCopies.empty() || mVertexBuffer.mSize < mVertexRanges.capacity() * sizeof(VertexType) || mIndexBuffer.mSize < mIndexRanges.capacity() * sizeof(IndexType));}
+
+    /// Records copies of all data staged since the last upload, and of the old buffer contents if the
+    /// buffers had to grow. Recorded into 'aCmdBuffer'.
+    virtual void recordUploadTransferCommand(const VkCommandBuffer& aCmdBuffer);
+
+    virtual const VkBuffer& getVertexBuffer() const {return(mVertexBuffer.mBuffer);}
+    virtual const VkBuffer& getIndexBuffer() const {return(mIndexBuffer.mBuffer);}
+
+    /// Free the staging buffer and any buffers which were replaced by larger ones during the last upload.
+    virtual void freeStagingBuffer();
+    /// Free all device resources and forget all meshes. The device remains set.
+    virtual void freeAndReset();
+
+ protected:
+    struct PooledBuffer{
+        VkBuffer mBuffer = VK_NULL_HANDLE;
+        VmaAllocation mAllocation = VK_NULL_HANDLE;
+        VkDeviceSize mSize = 0U;
+    };
+
+    struct PendingCopy{
+        VkDeviceSize mStagingOffset;
+        VkDeviceSize mDstOffset;
+        VkDeviceSize mSize;
+        bool mIndexData;
+    };
+
+    /// Allocate 'aCount' units from 'aRanges', growing it if needed.
+    static RangeAllocator::size_type allocateOrGrow(RangeAllocator& aRanges, RangeAllocator::size_type aCount);
+
+    /// Create a device local buffer for 'aUsage' of at least 'aSize' bytes and copy the contents of 'aBuffer'
+    /// into it. The old buffer is retired until freeStagingBuffer().
+    void growBuffer(const VkCommandBuffer& aCmdBuffer, PooledBuffer& aBuffer, VkDeviceSize aSize, VkBufferUsageFlags aUsage);
+    void createBuffer(PooledBuffer& aBuffer, VkDeviceSize aSize, VkBufferUsageFlags aUsage, bool aHostVisible);
+    void destroyBuffer(PooledBuffer& aBuffer);
+
+    void stageBytes(const void* aData, VkDeviceSize aSize, VkDeviceSize aDstOffset, bool aIndexData);
+    /// Forget the pending copies, and their staging bytes, that write inside the given range of the vertex or index buffer.
+    void dropPendingCopies(VkDeviceSize aDstOffset, VkDeviceSize aSize, bool aIndexData);
+
+    VulkanDeviceHandlePair mCurrentDevice {VK_NULL_HANDLE, VK_NULL_HANDLE};
+
+    RangeAllocator mVertexRanges;
+    RangeAllocator mIndexRanges;
+    std::unordered_map<mesh_id_t, MeshRange> mMeshes;
+    mesh_id_t mNextMeshId = 0;
+
+    PooledBuffer mVertexBuffer;
+    PooledBuffer mIndexBuffer;
+    PooledBuffer mStagingBuffer;
+    std::vector<PooledBuffer> mRetiredBuffers;
+
+    std::vector<uint8_t> mPendingData;
+    std::vector<PendingCopy> mPendingCopies;
+};
+
+#include "GeometryPool.inl"
+
+#endif
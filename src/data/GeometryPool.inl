@@ -0,0 +1,237 @@
+#include "GeometryPool.h"
+#include "vkutils/VmaHost.h"
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <string>
+
+template<typename VertexType, typename IndexType>
+void GeometryPool<VertexType, IndexType>::initDevice(const VulkanDeviceBundle& aDeviceBundle){
+    if(aDeviceBundle.isValid() && mCurrentDevice != aDeviceBundle){
+        freeAndReset();
+        mCurrentDevice = VulkanDeviceHandlePair(aDeviceBundle);
+    }
+
+    if(!mCurrentDevice.isValid()){
+        throw std::runtime_error("GeometryPool could not be initialized due to having an invalid device!");
+    }
+}
+
+template<typename VertexType, typename IndexType>
+typename GeometryPool<VertexType, IndexType>::mesh_id_t GeometryPool<VertexType, IndexType>::addMesh(const std::vector<VertexType>& aVertices, const std::vector<IndexType>& aIndices){
+    if(aVertices.empty() || aIndices.empty()){
+        throw std::runtime_error("GeometryPool: Cannot add a mesh without vertices or indices!");
+    }
+
+    MeshRange mesh;
+    {
+        mesh.mVertexOffset = static_cast<uint32_t>(allocateOrGrow(mVertexRanges, aVertices.size()));
+        mesh.mVertexCount = static_cast<uint32_t>(aVertices.size());
+        mesh.mFirstIndex = static_cast<uint32_t>(allocateOrGrow(mIndexRanges, aIndices.size()));
+        mesh.mIndexCount = static_cast<uint32_t>(aIndices.size());
+    }
+
+    stageBytes(aVertices.data(), aVertices.size() * sizeof(VertexType), mesh.mVertexOffset * sizeof(VertexType), false);
+    stageBytes(aIndices.data(), aIndices.size() * sizeof(IndexType), mesh.mFirstIndex * sizeof(IndexType), true);
+
+    mesh_id_t meshId = mNextMeshId++;
+    mMeshes.emplace(meshId, mesh);
+    return(meshId);
+}
+
+template<typename VertexType, typename IndexType>
+void GeometryPool<VertexType, IndexType>::removeMesh(mesh_id_t aMeshId){
+    const MeshRange& mesh = getMesh(aMeshId);
+    // A mesh removed before its upload must not leave copies behind that overlap whatever reuses its space
+    dropPendingCopies(mesh.mVertexOffset * sizeof(VertexType), mesh.mVertexCount * sizeof(VertexType), false);
+    dropPendingCopies(mesh.mFirstIndex * sizeof(IndexType), mesh.mIndexCount * sizeof(IndexType), true);
+    mVertexRanges.free(mesh.mVertexOffset, mesh.mVertexCount);
+    mIndexRanges.free(mesh.mFirstIndex, mesh.mIndexCount);
+    mMeshes.erase(aMeshId);
+}
+
+template<typename VertexType, typename IndexType>
+const typename GeometryPool<VertexType, IndexType>::MeshRange& GeometryPool<VertexType, IndexType>::getMesh(mesh_id_t aMeshId) const {
+    auto finder = mMeshes.find(aMeshId);
+    if(finder == mMeshes.end()){
+        throw std::runtime_error("GeometryPool: Mesh " + std::to_string(aMeshId) + " does not exist!");
+    }
+    return(finder->second);
+}
+
+template<typename VertexType, typename IndexType>
+void GeometryPool<VertexType, IndexType>::recordUploadTransferCommand(const VkCommandBuffer& aCmdBuffer){
+    if(!mCurrentDevice.isValid()){
+        throw std::runtime_error("GeometryPool used with null device!");
+    }
+
+    bool grew = false;
+    if(mVertexBuffer.mSize < mVertexRanges.capacity() * sizeof(VertexType)){
+        growBuffer(aCmdBuffer, mVertexBuffer, mVertexRanges.capacity() * sizeof(VertexType), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+        grew = true;
+    }
+    if(mIndexBuffer.mSize < mIndexRanges.capacity() * sizeof(IndexType)){
+        growBuffer(aCmdBuffer, mIndexBuffer, mIndexRanges.capacity() * sizeof(IndexType), VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
+        grew = true;
+    }
+
+    if(mPendingCopies.empty()) return;
+
+    // New meshes may land in space that the copy of the old contents also writes
+    if(grew){
+        VkMemoryBarrier barrier;
+        {
+            barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+            barrier.pNext = nullptr;
+            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        }
+        vkCmdPipelineBarrier(aCmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+    }
+
+    destroyBuffer(mStagingBuffer);
+    createBuffer(mStagingBuffer, mPendingData.size(), VK_BUFFER_USAGE_TRANSFER_SRC_BIT, true);
+
+    VmaAllocator allocator = VmaHost::getAllocator(mCurrentDevice);
+    void* rawptr = nullptr;
+    if(vmaMapMemory(allocator, mStagingBuffer.mAllocation, &rawptr) != VK_SUCCESS || rawptr == nullptr){
+        throw std::runtime_error("GeometryPool: Mapping to staging buffer failed!");
+    }
+    memcpy(rawptr, mPendingData.data(), mPendingData.size());
+    vmaFlushAllocation(allocator, mStagingBuffer.mAllocation, 0, VK_WHOLE_SIZE);
+    vmaUnmapMemory(allocator, mStagingBuffer.mAllocation);
+    rawptr = nullptr;
+
+    std::vector<VkBufferCopy> vertexCopies;
+    std::vector<VkBufferCopy> indexCopies;
+    for(const PendingCopy& copy : mPendingCopies){
+        (copy.mIndexData ? indexCopies : vertexCopies).emplace_back(VkBufferCopy{copy.mStagingOffset, copy.mDstOffset, copy.mSize});
+    }
+    if(!vertexCopies.empty()){
+        vkCmdCopyBuffer(aCmdBuffer, mStagingBuffer.mBuffer, mVertexBuffer.mBuffer, static_cast<uint32_t>(vertexCopies.size()), vertexCopies.data());
+    }
+    if(!indexCopies.empty()){
+        vkCmdCopyBuffer(aCmdBuffer, mStagingBuffer.mBuffer, mIndexBuffer.mBuffer, static_cast<uint32_t>(indexCopies.size()), indexCopies.data());
+    }
+
+    mPendingData.clear();
+    mPendingCopies.clear();
+}
+
+template<typename VertexType, typename IndexType>
+void GeometryPool<VertexType, IndexType>::freeStagingBuffer(){
+    destroyBuffer(mStagingBuffer);
+    for(PooledBuffer& retired : mRetiredBuffers){
+        destroyBuffer(retired);
+    }
+    mRetiredBuffers.clear();
+}
+
+template<typename VertexType, typename IndexType>
+void GeometryPool<VertexType, IndexType>::freeAndReset(){
+    freeStagingBuffer();
+    destroyBuffer(mVertexBuffer);
+    destroyBuffer(mIndexBuffer);
+
+    // Keep the previous capacities so the next set of meshes doesn't start over from a small buffer
+    RangeAllocator::size_type vertexCapacity = mVertexRanges.capacity();
+    RangeAllocator::size_type indexCapacity = mIndexRanges.capacity();
+    mVertexRanges.reset();
+    mVertexRanges.grow(vertexCapacity);
+    mIndexRanges.reset();
+    mIndexRanges.grow(indexCapacity);
+
+    mMeshes.clear();
+    mPendingData.clear();
+    mPendingCopies.clear();
+}
+
+template<typename VertexType, typename IndexType>
+RangeAllocator::size_type GeometryPool<VertexType, IndexType>::allocateOrGrow(RangeAllocator& aRanges, RangeAllocator::size_type aCount){
+    std::optional<RangeAllocator::size_type> offset = aRanges.allocate(aCount);
+    if(!offset.has_value()){
+        aRanges.grow(std::max(aRanges.capacity() * 2, aRanges.capacity() + aCount));
+        offset = aRanges.allocate(aCount);
+    }
+    assert(offset.has_value());
+    return(*offset);
+}
+
+template<typename VertexType, typename IndexType>
+void GeometryPool<VertexType, IndexType>::growBuffer(const VkCommandBuffer& aCmdBuffer, PooledBuffer& aBuffer, VkDeviceSize aSize, VkBufferUsageFlags aUsage){
+    PooledBuffer oldBuffer = aBuffer;
+    createBuffer(aBuffer, aSize, aUsage | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, false);
+
+    if(oldBuffer.mBuffer != VK_NULL_HANDLE){
+        VkBufferCopy copyRegion = {0U, 0U, oldBuffer.mSize};
+        vkCmdCopyBuffer(aCmdBuffer, oldBuffer.mBuffer, aBuffer.mBuffer, 1, &copyRegion);
+        mRetiredBuffers.emplace_back(oldBuffer);
+    }
+}
+
+template<typename VertexType, typename IndexType>
+void GeometryPool<VertexType, IndexType>::createBuffer(PooledBuffer& aBuffer, VkDeviceSize aSize, VkBufferUsageFlags aUsage, bool aHostVisible){
+    VmaAllocator allocator = VmaHost::getAllocator(mCurrentDevice);
+
+    VkBufferCreateInfo bufferInfo;
+    {
+        bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        bufferInfo.pNext = nullptr;
+        bufferInfo.flags = 0;
+        bufferInfo.size = aSize;
+        bufferInfo.usage = aUsage;
+        bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        bufferInfo.queueFamilyIndexCount = 0;
+        bufferInfo.pQueueFamilyIndices = nullptr;
+    }
+
+    VmaAllocationCreateInfo allocInfo = {};
+    if(aHostVisible){
+        allocInfo.requiredFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+        allocInfo.preferredFlags = VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+        allocInfo.usage = VMA_MEMORY_USAGE_CPU_TO_GPU;
+    }else{
+        allocInfo.requiredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+        allocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+    }
+
+    if(vmaCreateBuffer(allocator, &bufferInfo, &allocInfo, &aBuffer.mBuffer, &aBuffer.mAllocation, nullptr) != VK_SUCCESS){
+        throw std::runtime_error("VMA based creation of geometry pool buffer failed!");
+    }
+    aBuffer.mSize = aSize;
+}
+
+template<typename VertexType, typename IndexType>
+void GeometryPool<VertexType, IndexType>::destroyBuffer(PooledBuffer& aBuffer){
+    if(aBuffer.mBuffer != VK_NULL_HANDLE){
+        vmaDestroyBuffer(VmaHost::getAllocator(mCurrentDevice), aBuffer.mBuffer, aBuffer.mAllocation);
+    }
+    aBuffer = PooledBuffer();
+}
+
+template<typename VertexType, typename IndexType>
+void GeometryPool<VertexType, IndexType>::stageBytes(const void* aData, VkDeviceSize aSize, VkDeviceSize aDstOffset, bool aIndexData){
+    VkDeviceSize stagingOffset = mPendingData.size();
+    mPendingData.resize(stagingOffset + aSize);
+    memcpy(mPendingData.data() + stagingOffset, aData, aSize);
+    mPendingCopies.emplace_back(PendingCopy{stagingOffset, aDstOffset, aSize, aIndexData});
+}
+
+template<typename VertexType, typename IndexType>
+void GeometryPool<VertexType, IndexType>::dropPendingCopies(VkDeviceSize aDstOffset, VkDeviceSize aSize, bool aIndexData){
+    // Compact the surviving copies and their staging bytes in place, keeping their order
+    VkDeviceSize stagingEnd = 0U;
+    size_t kept = 0U;
+    for(const PendingCopy& copy : mPendingCopies){
+        if(copy.mIndexData == aIndexData && copy.mDstOffset >= aDstOffset && copy.mDstOffset + copy.mSize <= aDstOffset + aSize){
+            continue;
+        }
+        if(copy.mStagingOffset != stagingEnd){
+            memmove(mPendingData.data() + stagingEnd, mPendingData.data() + copy.mStagingOffset, copy.mSize);
+        }
+        mPendingCopies[kept++] = PendingCopy{stagingEnd, copy.mDstOffset, copy.mSize, copy.mIndexData};
+        stagingEnd += copy.mSize;
+    }
+    mPendingCopies.resize(kept);
+    mPendingData.resize(stagingEnd);
+}
@@ -4,6 +4,8 @@
 #include <cstring>
 #include <string>
 #include <iostream>
+#include <limits>
+#include <vector>
 
 using instance_index_t = MultiInstanceUniformBuffer::instance_index_t;
 
@@ -31,20 +33,29 @@ MultiInstanceUniformBuffer::MultiInstanceUniformBuffer(
     const UniformDataLayoutSet& aUniformDataLayouts, // Set of uniform data layouts describing the uniform buffer data
     instance_index_t aInstanceCount, // Initial number of instances for which to allocate space.
     instance_index_t aCapacityHint, // Optional: Suggested total capacity to allocate. Must be >= instance count. 0 is automatic and sets capcity equal to instance count 
-    VkShaderStageFlags aShaderStages // Optional: Shader stage flags to enable for this uniform buffer. Defaults to vertex and fragment. 
+    VkShaderStageFlags aShaderStages, // Optional: Shader stage flags to enable for this uniform buffer. Defaults to vertex and fragment. 
+    BufferMode aMode // Optional: Layout of instance data. Defaults to dynamic uniform buffers.
 ) 
-:   mCurrentDevice(aDeviceBundle),
+:   mMode(aMode),
+    mCurrentDevice(aDeviceBundle),
     mInstanceCount(aInstanceCount),
     mCapacity(std::max(aInstanceCount,
     aCapacityHint)),
     mBoundLayouts(aUniformDataLayouts),
-    mBufferAlignmentSize(aDeviceBundle.physicalDevice.mProperties.limits.minUniformBufferOffsetAlignment),
+    mBufferAlignmentSize(aMode == BufferMode::INSTANCE_STORAGE ? 
+        aDeviceBundle.physicalDevice.mProperties.limits.minStorageBufferOffsetAlignment :
+        aDeviceBundle.physicalDevice.mProperties.limits.minUniformBufferOffsetAlignment
+    ),
     mPaddedBlockSize(sLayoutSetAlignedSize(mBoundLayouts, mBufferAlignmentSize))
 {
     // Will probably crash before hitting this check due to init of mBufferAlignmentSize
     if(!aDeviceBundle.isValid()){
         throw std::runtime_error("MultiInstanceUniformBuffer may not be constructed with an invalid or partially valid device bundle!");
     }
+    // Pending bindings of each frame slot are tracked as a 32 bit mask per instance
+    if(mBoundLayouts.size() > std::numeric_limits<uint32_t>::digits){
+        throw std::runtime_error("MultiInstanceUniformBuffer supports at most 32 bound layouts!");
+    }
 
     for(const std::pair<uint32_t, UniformDataLayoutPtr>& entry : mBoundLayouts){
         uint32_t binding = entry.first;
@@ -53,14 +64,16 @@ MultiInstanceUniformBuffer::MultiInstanceUniformBuffer(
         
         mLayoutBindings.emplace_back(VkDescriptorSetLayoutBinding{
             /* binding = */ binding,
-            /* descriptorType = */ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+            /* descriptorType = */ getDescriptorType(),
             /* descriptorCount = */ 1,
             /* stageFlags = */ aShaderStages,
             /* pImmutableSamplers = */ nullptr
         });
     }
 
-    createBuffer(mPaddedBlockSize * mCapacity);
+    updatePlacements();
+    createBuffer(getFrameSlotStride());
+    resetFrameSlots();
     createDescriptorSetLayout();
     updateOffsets();
     mDeviceSyncState = DEVICE_IN_SYNC;
@@ -122,19 +135,32 @@ void MultiInstanceUniformBuffer::freeInstanceDataInterfaces(instance_index_t aIn
 void MultiInstanceUniformBuffer::setCapcity(instance_index_t aCapacity){
     if(aCapacity == mCapacity) return;
     mCapacity = aCapacity > mCapacity ? aCapacity : std::max(aCapacity, mInstanceCount);
-    resizeBuffer(mCapacity * mPaddedBlockSize);
+    resizeBuffer(getFrameSlotStride() * mFrameSlots.size());
 }
 
 void MultiInstanceUniformBuffer::resizeToFit(){
     if(mCapacity != mInstanceCount){
         mCapacity = mInstanceCount;
-        resizeBuffer(mCapacity * mPaddedBlockSize);
+        resizeBuffer(getFrameSlotStride() * mFrameSlots.size());
     }
 }
 
+void MultiInstanceUniformBuffer::setFrameSlotCount(uint32_t aSlotCount){
+    if(aSlotCount == 0){
+        throw std::runtime_error("MultiInstanceUniformBuffer requires at least one frame slot!");
+    }
+    if(aSlotCount == mFrameSlots.size()) return;
+    mFrameSlots.resize(aSlotCount);
+    resizeBuffer(getFrameSlotStride() * mFrameSlots.size());
+}
+
 bool MultiInstanceUniformBuffer::isBoundDataDirty() const{
     if(mDeviceSyncState != DEVICE_IN_SYNC) return true;
 
+    for(const FrameSlot& slot : mFrameSlots){
+        if(!slot.mPendingInstances.empty()) return true;
+    }
+
     for(const std::pair<instance_index_t, UniformDataInterfaceSet>& mapEntry : mBoundDataInterfaces){
         for(const std::pair<uint32_t, UniformDataInterfacePtr>& setEntry : mapEntry.second){
             if(setEntry.second->isDataDirty()) return true;
@@ -144,6 +170,12 @@ bool MultiInstanceUniformBuffer::isBoundDataDirty() const{
 }
 
 void MultiInstanceUniformBuffer::pollBoundData() const{
+    for(const FrameSlot& slot : mFrameSlots){
+        if(!slot.mPendingInstances.empty()){
+            mDeviceSyncState = DEVICE_OUT_OF_SYNC;
+            return;
+        }
+    }
     for(const std::pair<instance_index_t, UniformDataInterfaceSet>& mapEntry : mBoundDataInterfaces){
         for(const std::pair<uint32_t, UniformDataInterfacePtr>& setEntry : mapEntry.second){
             if(setEntry.second->isDataDirty()){
@@ -155,28 +187,45 @@ void MultiInstanceUniformBuffer::pollBoundData() const{
 }
 
 void MultiInstanceUniformBuffer::updateDevice() {
-    std::vector<UniformDataInterfacePtr> cleanedPtrs;
-    cleanedPtrs.reserve(mBoundDataInterfaces.size() * mBoundLayouts.size());
-
-    for(const std::pair<instance_index_t, UniformDataInterfaceSet>& mapEntry : mBoundDataInterfaces){
-        for(const std::pair<uint32_t, UniformDataInterfacePtr>& setEntry : mapEntry.second){
-            if(setEntry.second->isDataDirty()){
-                updateSingleBinding(mapEntry.first, setEntry.first, setEntry.second);
-                cleanedPtrs.emplace_back(setEntry.second);
-            }
-        }
+    collectDirtyBindings();
+    for(uint32_t slot = 0; slot < mFrameSlots.size(); ++slot){
+        writeFrameSlot(slot);
     }
-    std::for_each(cleanedPtrs.begin(), cleanedPtrs.end(), [](const UniformDataInterfacePtr& aPtr){aPtr->flagAsClean();});
     mDeviceSyncState = DEVICE_IN_SYNC;
 }
 
+void MultiInstanceUniformBuffer::updateDevice(uint32_t aSlot) {
+    if(aSlot >= mFrameSlots.size()){
+        throw std::runtime_error("MultiInstanceUniformBuffer: Frame slot " + std::to_string(aSlot) + " is out of bounds ( >= " + std::to_string(mFrameSlots.size()) + ")");
+    }
+    collectDirtyBindings();
+    writeFrameSlot(aSlot);
+
+    // The other slots may still have data waiting on their own update
+    bool anyPending = std::any_of(mFrameSlots.begin(), mFrameSlots.end(), [](const FrameSlot& aFrameSlot){return(!aFrameSlot.mPendingInstances.empty());});
+    mDeviceSyncState = anyPending ? DEVICE_OUT_OF_SYNC : DEVICE_IN_SYNC;
+}
+
 size_t MultiInstanceUniformBuffer::getBoundDataOffset(uint32_t aBindPoint) const{
-    return(mBoundLayouts.getBoundDataOffset(aBindPoint, mBufferAlignmentSize));
+    return(mBindingPlacements.at(aBindPoint).mBase);
 }
 
 size_t MultiInstanceUniformBuffer::getBoundDataOffset(uint32_t aBindPoint, instance_index_t aInstanceIndex) const{
     assertInstanceInbounds(aInstanceIndex);
-    return(mPaddedBlockSize*aInstanceIndex + getBoundDataOffset(aBindPoint));
+    const BindingPlacement& placement = mBindingPlacements.at(aBindPoint);
+    return(placement.mBase + placement.mInstanceStride * aInstanceIndex);
+}
+
+VkDeviceSize MultiInstanceUniformBuffer::getFrameSlotStride() const{
+    if(mMode == BufferMode::DYNAMIC_UNIFORM){
+        return(mPaddedBlockSize * mCapacity);
+    }
+
+    VkDeviceSize stride = 0;
+    for(const std::pair<const uint32_t, UniformDataLayoutPtr>& setEntry : mBoundLayouts){
+        stride += sAlignData(setEntry.second->getPaddedDataSize(sStorageElementAlignment) * mCapacity, mBufferAlignmentSize);
+    }
+    return(stride);
 }
 
 const std::vector<VkDescriptorSetLayoutBinding>& MultiInstanceUniformBuffer::getDescriptorSetLayoutBindings() const{
@@ -184,15 +233,15 @@ const std::vector<VkDescriptorSetLayoutBinding>& MultiInstanceUniformBuffer::get
 }
 
 // TODO: Use flyweight or warn about cost of excessive use. 
-std::map<uint32_t, VkDescriptorBufferInfo> MultiInstanceUniformBuffer::getDescriptorBufferInfos() const{
+std::map<uint32_t, VkDescriptorBufferInfo> MultiInstanceUniformBuffer::getDescriptorBufferInfos(uint32_t aSlot) const{
     std::map<uint32_t, VkDescriptorBufferInfo> infos;
-    for(const std::pair<uint32_t, UniformDataLayoutPtr>& setEntry : mBoundLayouts){
+    for(const std::pair<const uint32_t, BindingPlacement>& placement : mBindingPlacements){
         infos.emplace(
-            setEntry.first,
+            placement.first,
             VkDescriptorBufferInfo{
                 mUniformBuffer,
-                mBoundLayouts.getBoundDataOffset(setEntry.first, mBufferAlignmentSize),
-                setEntry.second->getDataSize()
+                getFrameSlotStride() * aSlot + placement.second.mBase,
+                placement.second.mRange
             });
         
     }
@@ -226,7 +275,7 @@ void MultiInstanceUniformBuffer::createBuffer(size_t aNewSize){
         bufferInfo.pNext = nullptr;
         bufferInfo.flags = 0;
         bufferInfo.size = aNewSize;
-        bufferInfo.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+        bufferInfo.usage = mMode == BufferMode::INSTANCE_STORAGE ? VK_BUFFER_USAGE_STORAGE_BUFFER_BIT : VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
         bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
         bufferInfo.queueFamilyIndexCount = 0U;
         bufferInfo.pQueueFamilyIndices = nullptr;
@@ -234,6 +283,8 @@ void MultiInstanceUniformBuffer::createBuffer(size_t aNewSize){
 
     VmaAllocationCreateInfo allocInfo = {};
     {
+        // Keep the buffer mapped for its whole lifetime instead of mapping on every update.
+        allocInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
         allocInfo.usage = VMA_MEMORY_USAGE_CPU_TO_GPU;
         allocInfo.requiredFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
     }
@@ -241,6 +292,9 @@ void MultiInstanceUniformBuffer::createBuffer(size_t aNewSize){
     if(vmaCreateBuffer(allocator, &bufferInfo, &allocInfo, &mUniformBuffer, &mBufferAllocation, &mAllocInfo) != VK_SUCCESS){
         throw std::runtime_error("Failed to allocate host visible memory for MultiInstanceUniformBuffer!");
     }
+    if(mAllocInfo.pMappedData == nullptr){
+        throw std::runtime_error("MultiInstanceUniformBuffer: Mapping to uniform buffer failed!");
+    }
 
     mDeviceSyncState = DEVICE_OUT_OF_SYNC;
 }
@@ -251,7 +305,7 @@ void MultiInstanceUniformBuffer::autoGrowCapcity(instance_index_t aNewMinimumCap
     #else
         mCapacity = aNewMinimumCapacity;
     #endif
-    resizeBuffer(mPaddedBlockSize * mCapacity);
+    resizeBuffer(getFrameSlotStride() * mFrameSlots.size());
 }
 
 void MultiInstanceUniformBuffer::resizeBuffer(size_t aNewSize){
@@ -260,7 +314,14 @@ void MultiInstanceUniformBuffer::resizeBuffer(size_t aNewSize){
         vmaDestroyBuffer(allocator, mUniformBuffer, mBufferAllocation);
         mUniformBuffer = VK_NULL_HANDLE;
     }
+    updatePlacements();
     createBuffer(aNewSize);
+    resetFrameSlots();
+
+    // The new buffer starts out empty, so every bound interface must be written again. 
+    for(const std::pair<instance_index_t, UniformDataInterfaceSet>& mapEntry : mBoundDataInterfaces){
+        std::for_each(mapEntry.second.begin(), mapEntry.second.end(), [](const auto& entry){entry.second->flagAsDirty();});
+    }
     updateDevice();
 }
 
@@ -273,27 +334,139 @@ void MultiInstanceUniformBuffer::updateOffsets(){
     }
 }
 
-void MultiInstanceUniformBuffer::updateSingleBinding(instance_index_t aInstance, uint32_t aBinding, const UniformDataInterfacePtr aInterface){
-    VmaAllocator allocator = VmaHost::getAllocator(mCurrentDevice);
+void MultiInstanceUniformBuffer::updatePlacements(){
+    mBindingPlacements.clear();
+    VkDeviceSize storageOffset = 0;
+    for(const std::pair<const uint32_t, UniformDataLayoutPtr>& setEntry : mBoundLayouts){
+        if(mMode == BufferMode::INSTANCE_STORAGE){
+            // Bindings are consecutive arrays, each large enough to hold every instance
+            VkDeviceSize elementStride = setEntry.second->getPaddedDataSize(sStorageElementAlignment);
+            mBindingPlacements[setEntry.first] = BindingPlacement{storageOffset, elementStride, elementStride * mCapacity};
+            storageOffset += sAlignData(elementStride * mCapacity, mBufferAlignmentSize);
+        }else{
+            mBindingPlacements[setEntry.first] = BindingPlacement{
+                mBoundLayouts.getBoundDataOffset(setEntry.first, mBufferAlignmentSize),
+                mPaddedBlockSize,
+                setEntry.second->getDataSize()
+            };
+        }
+    }
+}
 
-    size_t bufferOffset = mPaddedBlockSize * aInstance;
-    size_t blockOffset = mBoundLayouts.getBoundDataOffset(aBinding, mBufferAlignmentSize);
-    size_t offset = bufferOffset + blockOffset;
+void MultiInstanceUniformBuffer::mergeDirtyRanges(){
+    if(mDirtyRanges.empty()) return;
 
-    void* rawptr = nullptr;
-    VkResult mapResult = vmaMapMemory(allocator, mBufferAllocation, &rawptr);
+    // Interleaved blocks are written in increasing order already. Storage arrays are not, since
+    // each instance writes into several arrays. 
+    if(!std::is_sorted(mDirtyRanges.begin(), mDirtyRanges.end(), [](const DirtyRange& a, const DirtyRange& b){return(a.begin < b.begin);})){
+        std::sort(mDirtyRanges.begin(), mDirtyRanges.end(), [](const DirtyRange& a, const DirtyRange& b){return(a.begin < b.begin);});
+    }
 
-    if(mapResult == VK_SUCCESS && rawptr != nullptr){
-        uint8_t* dst = reinterpret_cast<uint8_t*>(rawptr) + offset;
-        memcpy(dst, aInterface->getData(), aInterface->getDataSize());
-        vmaFlushAllocation(allocator, mBufferAllocation, 0, VK_WHOLE_SIZE);
-        vmaUnmapMemory(allocator, mBufferAllocation);
-        rawptr = nullptr;
-    }else{
-        throw std::runtime_error("MultiInstanceUniformBuffer: Mapping to uniform buffer failed!");
+    size_t merged = 0;
+    for(size_t i = 1; i < mDirtyRanges.size(); ++i){
+        if(mDirtyRanges[i].begin <= mDirtyRanges[merged].end + mBufferAlignmentSize){
+            mDirtyRanges[merged].end = std::max(mDirtyRanges[merged].end, mDirtyRanges[i].end);
+        }else{
+            mDirtyRanges[++merged] = mDirtyRanges[i];
+        }
+    }
+    mDirtyRanges.resize(merged + 1);
+}
+
+void MultiInstanceUniformBuffer::collectDirtyBindings(){
+    for(const std::pair<const instance_index_t, UniformDataInterfaceSet>& mapEntry : mBoundDataInterfaces){
+        if(mapEntry.first >= mCapacity) continue;
+
+        uint32_t dirtyMask = 0U;
+        uint32_t layoutBit = 1U;
+        for(const std::pair<const uint32_t, UniformDataInterfacePtr>& setEntry : mapEntry.second){
+            if(setEntry.second->isDataDirty()){
+                dirtyMask |= layoutBit;
+                setEntry.second->flagAsClean();
+            }
+            layoutBit <<= 1;
+        }
+        if(dirtyMask == 0U) continue;
+
+        for(FrameSlot& slot : mFrameSlots){
+            uint32_t& pending = slot.mPendingMasks[mapEntry.first];
+            if(pending == 0U) slot.mPendingInstances.emplace_back(mapEntry.first);
+            pending |= dirtyMask;
+        }
     }
 }
 
+void MultiInstanceUniformBuffer::writeFrameSlot(uint32_t aSlot){
+    FrameSlot& slot = mFrameSlots[aSlot];
+
+    // Visit pending instances in increasing order so the dirty byte ranges mostly arrive sorted
+    std::sort(slot.mPendingInstances.begin(), slot.mPendingInstances.end());
+
+    mDirtyRanges.clear();
+    for(instance_index_t instance : slot.mPendingInstances){
+        uint32_t& pending = slot.mPendingMasks[instance];
+        const auto& finder = mBoundDataInterfaces.find(instance);
+        if(finder != mBoundDataInterfaces.end()){
+            uint32_t layoutBit = 1U;
+            for(const std::pair<const uint32_t, UniformDataInterfacePtr>& setEntry : finder->second){
+                if(pending & layoutBit){
+                    mDirtyRanges.emplace_back(updateSingleBinding(aSlot, instance, setEntry.first, setEntry.second));
+                }
+                layoutBit <<= 1;
+            }
+        }
+        pending = 0U;
+    }
+    slot.mPendingInstances.clear();
+    mergeDirtyRanges();
+
+    // Host coherent memory needs no flushes. Otherwise every merged range goes into one flush call, so sparse
+    // updates don't flush everything between them. Ranges are relative to the memory object, in whole atoms.
+    if(!mDirtyRanges.empty()){
+        VmaAllocator allocator = VmaHost::getAllocator(mCurrentDevice);
+        VkMemoryPropertyFlags memoryFlags = 0;
+        vmaGetMemoryTypeProperties(allocator, mAllocInfo.memoryType, &memoryFlags);
+        if(!(memoryFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)){
+            const VkPhysicalDeviceProperties* properties = nullptr;
+            vmaGetPhysicalDeviceProperties(allocator, &properties);
+            const VkDeviceSize atomSize = properties->limits.nonCoherentAtomSize;
+            const VkDeviceSize allocationEnd = mAllocInfo.offset + mAllocInfo.size;
+
+            std::vector<VkMappedMemoryRange> flushRanges;
+            flushRanges.reserve(mDirtyRanges.size());
+            for(const DirtyRange& range : mDirtyRanges){
+                VkDeviceSize begin = (mAllocInfo.offset + range.begin) / atomSize * atomSize;
+                VkDeviceSize end = std::min((mAllocInfo.offset + range.end + atomSize - 1) / atomSize * atomSize, allocationEnd);
+                flushRanges.push_back(VkMappedMemoryRange{
+                    /* sType = */ VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE,
+                    /* pNext = */ nullptr,
+                    /* memory = */ mAllocInfo.deviceMemory,
+                    /* offset = */ begin,
+                    // An unaligned end is only valid at the end of the memory block, which VK_WHOLE_SIZE covers
+                    /* size = */ end % atomSize == 0 ? end - begin : VK_WHOLE_SIZE
+                });
+            }
+            vkFlushMappedMemoryRanges(mCurrentDevice.device, static_cast<uint32_t>(flushRanges.size()), flushRanges.data());
+        }
+    }
+}
+
+void MultiInstanceUniformBuffer::resetFrameSlots(){
+    for(FrameSlot& slot : mFrameSlots){
+        slot.mPendingMasks.assign(mCapacity, 0U);
+        slot.mPendingInstances.clear();
+    }
+}
+
+MultiInstanceUniformBuffer::DirtyRange MultiInstanceUniformBuffer::updateSingleBinding(uint32_t aSlot, instance_index_t aInstance, uint32_t aBinding, const UniformDataInterfacePtr aInterface){
+    const BindingPlacement& placement = mBindingPlacements.at(aBinding);
+    size_t offset = getFrameSlotStride() * aSlot + placement.mBase + placement.mInstanceStride * aInstance;
+
+    uint8_t* dst = reinterpret_cast<uint8_t*>(mAllocInfo.pMappedData) + offset;
+    memcpy(dst, aInterface->getData(), aInterface->getDataSize());
+    return(DirtyRange{offset, offset + aInterface->getDataSize()});
+}
+
 void MultiInstanceUniformBuffer::setupDeviceUpload(VulkanDeviceHandlePair) {
     // Unused
 }
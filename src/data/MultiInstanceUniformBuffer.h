@@ -21,12 +21,22 @@ class MultiInstanceUniformBuffer : public DirectlySyncedBufferInterface
     /// (uint32_t) Index for an instance of uniform data within multi-instance uniform buffer
     using instance_index_t = uint32_t;
 
+    /// How instance data is laid out in the buffer and exposed to shaders
+    enum class BufferMode {
+        /// Instance blocks are interleaved and bound as dynamic uniform buffers, one bind per instance.
+        DYNAMIC_UNIFORM,
+        /// Each binding is a tightly packed std430 array bound once as a storage buffer.
+        /// Shaders index it with gl_InstanceIndex, which draws select through firstInstance.
+        INSTANCE_STORAGE
+    };
+
     explicit MultiInstanceUniformBuffer(
         const VulkanDeviceBundle& aDeviceBundle, // Device to create uniform buffer on
         const UniformDataLayoutSet& aUniformDataLayouts, // Set of uniform data layouts describing the uniform buffer data
         instance_index_t aInstanceCount, // Initial number of instances for which to allocate space.
         instance_index_t aCapacityHint = 0, // Optional: Suggested total capacity to allocate. Must be >= instance count. 0 is automatic and sets capcity equal to instance count 
-        VkShaderStageFlags aShaderStages = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT // Optional: Shader stage flags to enable for this uniform buffer. Defaults to vertex and fragment. 
+        VkShaderStageFlags aShaderStages = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, // Optional: Shader stage flags to enable for this uniform buffer. Defaults to vertex and fragment. 
+        BufferMode aMode = BufferMode::DYNAMIC_UNIFORM // Optional: Layout of instance data. Defaults to dynamic uniform buffers.
     );
 
     virtual ~MultiInstanceUniformBuffer() = default;
@@ -76,7 +86,12 @@ class MultiInstanceUniformBuffer : public DirectlySyncedBufferInterface
 
     size_t getPaddedInstanceDataSize() const {return(mBoundLayouts.getTotalPaddedSize(mBufferAlignmentSize));}
 
-    const size_t dynamicOffsetCount() const {return(mBoundLayouts.size());}
+    BufferMode getBufferMode() const {return(mMode);}
+    /// Descriptor type of every binding in this buffer
+    VkDescriptorType getDescriptorType() const {return(mMode == BufferMode::INSTANCE_STORAGE ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC);}
+
+    /// Number of dynamic offsets to bind with. Zero for INSTANCE_STORAGE buffers.
+    const size_t dynamicOffsetCount() const {return(mMode == BufferMode::INSTANCE_STORAGE ? 0U : mBoundLayouts.size());}
     const uint32_t* getDynamicOffsets(instance_index_t aInstance) const {return(mBlockOffsets[aInstance].data());}
 
     /// Returns true if any bound uniform data is dirtied.
@@ -86,12 +101,24 @@ class MultiInstanceUniformBuffer : public DirectlySyncedBufferInterface
 
     DeviceSyncStateEnum getDeviceSyncState() const override {pollBoundData(); return(mDeviceSyncState);}
 
-    /// Update the device with the uniform buffer contents only if the data is out of sync with the device
+    /// Update the device with the uniform buffer contents only if the data is out of sync with the device.
+    /// Writes every frame slot.
     virtual void updateDevice() override;
+    /// Write only the data dirtied since frame slot 'aSlot' was last written. Data for the other slots
+    /// stays pending until they are updated, so a slot still being read by the device is never touched.
+    void updateDevice(uint32_t aSlot);
+
+    /// Set the number of frame slots. Every slot holds a full copy of all instance blocks, so that each
+    /// frame in flight can read its own copy. Reallocates the buffer, so the device must be idle. 
+    void setFrameSlotCount(uint32_t aSlotCount);
+    uint32_t getFrameSlotCount() const {return(static_cast<uint32_t>(mFrameSlots.size()));}
+    /// Byte distance between the starts of consecutive frame slots
+    VkDeviceSize getFrameSlotStride() const;
 
     virtual VulkanDeviceHandlePair getCurrentDevice() const override {return(mCurrentDevice);}
 
     /// Get the offset of a particular binding point RELATIVE to the start of the instance block.
+    /// For INSTANCE_STORAGE buffers this is the start of the binding's array.
     size_t getBoundDataOffset(uint32_t aBindPoint) const;
 
     /// Get the offset of data bound at binding point 'aBindPoint' relative to instance 'aInstanceIndex'
@@ -107,7 +134,9 @@ class MultiInstanceUniformBuffer : public DirectlySyncedBufferInterface
     VkDescriptorSetLayout getDescriptorSetLayout() const {return(mDescriptorSetLayout);}
 
     /// Get list of binding info for the bound layouts
-    std::map<uint32_t, VkDescriptorBufferInfo> getDescriptorBufferInfos() const;
+    std::map<uint32_t, VkDescriptorBufferInfo> getDescriptorBufferInfos() const {return(getDescriptorBufferInfos(0));}
+    /// Get list of binding info for the bound layouts within frame slot 'aSlot'
+    std::map<uint32_t, VkDescriptorBufferInfo> getDescriptorBufferInfos(uint32_t aSlot) const;
     std::map<uint32_t, VkDescriptorImageInfo> getDescriptorImageInfos(TextureLoader& textureLoader) const;
     virtual const VkBuffer& getBuffer() const override {return(mUniformBuffer);}
     virtual size_t getBufferSize() const override {return(mAllocInfo.size);}
@@ -125,13 +154,38 @@ class MultiInstanceUniformBuffer : public DirectlySyncedBufferInterface
     void autoGrowCapcity(instance_index_t aNewMinimumCapacity);
     void resizeBuffer(size_t aNewSize);
     void updateOffsets();
-
-    void updateSingleBinding(
+    /// Recompute where each binding lives in a frame slot. Must be called whenever capacity changes.
+    void updatePlacements();
+    /// Merge 'mDirtyRanges' in place into sorted, non-overlapping ranges.
+    void mergeDirtyRanges();
+
+    /// Byte range [begin, end) of the buffer written during an update. 
+    struct DirtyRange {
+        VkDeviceSize begin;
+        VkDeviceSize end;
+    };
+
+    /// Copy the data of 'aInterface' into the persistently mapped buffer and return the range written. Does not flush.
+    DirtyRange updateSingleBinding(
+        uint32_t aSlot,
         instance_index_t aInstance,
         uint32_t aBinding,
         const UniformDataInterfacePtr aInterface
     );
 
+    /// Instance bindings which have changed since a frame slot was last written
+    struct FrameSlot {
+        std::vector<uint32_t> mPendingMasks; // Indexed by instance. Bit i is set if the i-th bound layout is pending.
+        std::vector<instance_index_t> mPendingInstances; // Instances with a non-zero pending mask
+    };
+
+    /// Move dirty interfaces into the pending set of every frame slot and flag them as clean.
+    void collectDirtyBindings();
+    /// Write and flush the pending bindings of frame slot 'aSlot'.
+    void writeFrameSlot(uint32_t aSlot);
+    /// Clear all pending bindings and size the frame slots to the current capacity.
+    void resetFrameSlots();
+
     virtual void setupDeviceUpload(VulkanDeviceHandlePair aDevicePair) override;
     virtual void uploadToDevice(VulkanDeviceHandlePair aDevicePair) override;
     virtual void finalizeDeviceUpload(VulkanDeviceHandlePair aDevicePair) override;
@@ -139,6 +193,17 @@ class MultiInstanceUniformBuffer : public DirectlySyncedBufferInterface
     void assertInstanceInbounds(instance_index_t aIndex) const;
     void assertLayoutMatches(const UniformDataInterfaceSet& aInterfaceSet) const;
 
+    /// Location of a binding within a frame slot. Instance i of the binding starts at mBase + i * mInstanceStride.
+    struct BindingPlacement {
+        VkDeviceSize mBase;
+        VkDeviceSize mInstanceStride;
+        VkDeviceSize mRange; // Range exposed through the descriptor
+    };
+
+    /// Array stride of storage buffer elements. Matches std430 for structs containing vec4 or mat4 members.
+    const static VkDeviceSize sStorageElementAlignment = 16U;
+
+    const BufferMode mMode;
     VulkanDeviceHandlePair mCurrentDevice = {VK_NULL_HANDLE, VK_NULL_HANDLE};
     instance_index_t mInstanceCount;
     instance_index_t mCapacity;
@@ -148,6 +213,7 @@ class MultiInstanceUniformBuffer : public DirectlySyncedBufferInterface
 
     // Maps binding point to descriptor set layout binding. 
     std::vector<VkDescriptorSetLayoutBinding> mLayoutBindings;
+    std::map<uint32_t, BindingPlacement> mBindingPlacements;
     std::vector<std::vector<uint32_t>> mBlockOffsets;
 
     // Map instance block indices to interfaces that can be used to modify uniform data in the block. 
@@ -163,6 +229,11 @@ class MultiInstanceUniformBuffer : public DirectlySyncedBufferInterface
     VkBuffer mUniformBuffer = VK_NULL_HANDLE;
     VmaAllocation mBufferAllocation = VK_NULL_HANDLE;
     VmaAllocationInfo mAllocInfo;
+
+    // Merged ranges written by the last frame slot update. Kept as a member to reuse its storage.
+    std::vector<DirtyRange> mDirtyRanges;
+
+    std::vector<FrameSlot> mFrameSlots = std::vector<FrameSlot>(1);
     
  private:
     void _cleanup(); 
@@ -0,0 +1,73 @@
+#include "RangeAllocator.h"
+#include <algorithm>
+#include <stdexcept>
+
+std::optional<RangeAllocator::size_type> RangeAllocator::allocate(size_type aCount){
+    if(aCount == 0) return(std::nullopt);
+
+    for(auto iter = mFreeRanges.begin(); iter != mFreeRanges.end(); ++iter){
+        if(iter->second < aCount) continue;
+
+        size_type offset = iter->first;
+        size_type remaining = iter->second - aCount;
+        mFreeRanges.erase(iter);
+        if(remaining > 0){
+            mFreeRanges.emplace(offset + aCount, remaining);
+        }
+        mUsed += aCount;
+        return(offset);
+    }
+    return(std::nullopt);
+}
+
+void RangeAllocator::free(size_type aOffset, size_type aCount){
+    if(aCount == 0) return;
+    if(aOffset + aCount > mCapacity || aCount > mUsed){
+        throw std::runtime_error("RangeAllocator: Attempted to free a range that was never allocated!");
+    }
+
+    size_type begin = aOffset;
+    size_type end = aOffset + aCount;
+
+    // Merge with the following free range
+    auto next = mFreeRanges.lower_bound(aOffset);
+    if(next != mFreeRanges.end()){
+        if(next->first < end) throw std::runtime_error("RangeAllocator: Attempted to free a range that is already free!");
+        if(next->first == end){
+            end += next->second;
+            next = mFreeRanges.erase(next);
+        }
+    }
+
+    // Merge with the preceding free range
+    if(next != mFreeRanges.begin()){
+        auto prev = std::prev(next);
+        size_type prevEnd = prev->first + prev->second;
+        if(prevEnd > begin) throw std::runtime_error("RangeAllocator: Attempted to free a range that is already free!");
+        if(prevEnd == begin){
+            begin = prev->first;
+            mFreeRanges.erase(prev);
+        }
+    }
+
+    mFreeRanges.emplace(begin, end - begin);
+    mUsed -= aCount;
+}
+
+void RangeAllocator::grow(size_type aNewCapacity){
+    if(aNewCapacity <= mCapacity) return;
+
+    size_type oldCapacity = mCapacity;
+    mCapacity = aNewCapacity;
+    // Freeing the new tail merges it into a trailing free range if there is one
+    mUsed += aNewCapacity - oldCapacity;
+    free(oldCapacity, aNewCapacity - oldCapacity);
+}
+
+RangeAllocator::size_type RangeAllocator::largestFreeRange() const {
+    size_type largest = 0;
+    for(const std::pair<const size_type, size_type>& range : mFreeRanges){
+        largest = std::max(largest, range.second);
+    }
+    return(largest);
+}
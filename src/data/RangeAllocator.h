@@ -0,0 +1,41 @@
+#ifndef KJY_RANGE_ALLOCATOR_H_
+#define KJY_RANGE_ALLOCATOR_H_
+#include <cstdint>
+#include <map>
+#include <optional>
+
+/** First-fit free-list allocator handing out [offset, offset + count) ranges of some externally
+ * owned array. Freed ranges are merged with their free neighbours so the space can be reused by
+ * larger requests. Units are whatever the caller indexes with (vertices, indices, bytes...). */
+class RangeAllocator
+{
+ public:
+    using size_type = uint64_t;
+
+    RangeAllocator() = default;
+    explicit RangeAllocator(size_type aCapacity) {grow(aCapacity);}
+
+    /// Returns the offset of a free range of 'aCount' units, or nullopt if no free range is large enough.
+    std::optional<size_type> allocate(size_type aCount);
+    /// Return the range starting at 'aOffset' to the free list. 'aCount' must match the allocation.
+    void free(size_type aOffset, size_type aCount);
+    /// Extend the managed array to 'aNewCapacity' units. The added space is free. Shrinking is not supported.
+    void grow(size_type aNewCapacity);
+    /// Forget all allocations and return to an empty allocator with no capacity.
+    void reset() {mFreeRanges.clear(); mCapacity = 0; mUsed = 0;}
+
+    size_type capacity() const {return(mCapacity);}
+    size_type used() const {return(mUsed);}
+    /// Number of disjoint free ranges. A fully coalesced allocator with free space has exactly one.
+    size_t freeRangeCount() const {return(mFreeRanges.size());}
+    /// Size of the largest free range, the biggest request allocate() can currently satisfy.
+    size_type largestFreeRange() const;
+
+ protected:
+    /// Free ranges keyed by offset, mapped to their length
+    std::map<size_type, size_type> mFreeRanges;
+    size_type mCapacity = 0;
+    size_type mUsed = 0;
+};
+
+#endif
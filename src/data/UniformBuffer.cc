@@ -2,6 +2,7 @@
 #include <iostream>
 #include <cstring>
 #include <algorithm>
+#include <string>
 
 size_t UniformDataLayoutSet::getBoundDataOffset(uint32_t aBindPoint, size_t aAlignSize) const{
     auto layoutIter = this->begin();
@@ -90,6 +91,65 @@ void UniformBuffer::updateDevice(){
     }
 }
 
+void UniformBuffer::updateDevice(uint32_t aSlot){
+    if(!mCurrentDevice.isValid()){
+        throw std::runtime_error("Attempting to updateDevice() from uniform buffer with no associated device!");
+    }
+    if(aSlot >= mFrameSlotCount){
+        throw std::runtime_error("Uniform buffer frame slot " + std::to_string(aSlot) + " is out of bounds ( >= " + std::to_string(mFrameSlotCount) + ")");
+    }
+
+    if(mDeviceSyncState == DEVICE_EMPTY || mLayoutOutOfDate){
+        updateDevice();
+        return;
+    }
+
+    // Data dirtied since the last update has to reach every slot, each in its own time
+    if(isBoundDataDirty()){
+        std::fill(mPendingSlots.begin(), mPendingSlots.end(), true);
+        for(const std::pair<const uint32_t, BoundUniformData>& boundData : mBoundUniformData){
+            boundData.second.mDataInterface->flagAsClean();
+        }
+    }
+
+    if(mPendingSlots[aSlot]){
+        writeFrameSlot(mCurrentDevice, aSlot);
+        mPendingSlots[aSlot] = false;
+    }
+    mDeviceSyncState = std::find(mPendingSlots.begin(), mPendingSlots.end(), true) == mPendingSlots.end() ? DEVICE_IN_SYNC : DEVICE_OUT_OF_SYNC;
+}
+
+void UniformBuffer::setFrameSlotCount(uint32_t aSlotCount){
+    if(aSlotCount == 0){
+        throw std::runtime_error("Uniform buffer requires at least one frame slot!");
+    }
+    if(aSlotCount == mFrameSlotCount) return;
+
+    mFrameSlotCount = aSlotCount;
+    mPendingSlots.assign(mFrameSlotCount, false);
+
+    // Buffer is recreated with the new size on the next update
+    if(mUniformBuffer != VK_NULL_HANDLE){
+        vkDestroyBuffer(mCurrentDevice.device, mUniformBuffer, nullptr);
+        mUniformBuffer = VK_NULL_HANDLE;
+    }
+    if(mUniformBufferMemory != VK_NULL_HANDLE){
+        vkFreeMemory(mCurrentDevice.device, mUniformBufferMemory, nullptr);
+        mUniformBufferMemory = VK_NULL_HANDLE;
+    }
+    mCurrentBufferSize = 0U;
+    _mCurrentDeviceAllocSize = 0U;
+    mDeviceSyncState = DEVICE_EMPTY;
+}
+
+size_t UniformBuffer::getFrameSlotStride() const {
+    size_t stride = 0;
+    for(const std::pair<const uint32_t, BoundUniformData>& boundData : mBoundUniformData){
+        stride += boundData.second.mDataInterface->getPaddedDataSize(mBufferAlignmentSize);
+    }
+    return(stride);
+}
+
 void UniformBuffer::updateDevice(const VulkanDeviceBundle& aDeviceBundle){
     if(aDeviceBundle.isValid() && aDeviceBundle != mCurrentDevice){
         _cleanup();
@@ -134,10 +194,10 @@ VkDescriptorSetLayout UniformBuffer::getDescriptorSetLayout() {
     return(mDescriptorSetLayout);
 }
 
-std::map<uint32_t, VkDescriptorBufferInfo> UniformBuffer::getDescriptorBufferInfos() const {
+std::map<uint32_t, VkDescriptorBufferInfo> UniformBuffer::getDescriptorBufferInfos(uint32_t aSlot) const {
     std::map<uint32_t, VkDescriptorBufferInfo> bufferInfos;
 
-    size_t offset = 0;
+    size_t offset = getFrameSlotStride() * aSlot;
     for(const std::pair<uint32_t, BoundUniformData>& boundData : mBoundUniformData){
         bufferInfos.emplace(
             boundData.first,
@@ -178,10 +238,7 @@ void UniformBuffer::createDescriptorSetLayout(){
 }
 
 void UniformBuffer::createUniformBuffer(){
-    size_t requiredBufferSize = 0;
-    for(const std::pair<uint32_t, BoundUniformData>& boundData : mBoundUniformData){
-        requiredBufferSize += boundData.second.mDataInterface->getPaddedDataSize(mBufferAlignmentSize);
-    }
+    size_t requiredBufferSize = getFrameSlotStride() * mFrameSlotCount;
 
     if(requiredBufferSize == 0){
         throw std::runtime_error(
@@ -256,11 +313,21 @@ void UniformBuffer::uploadToDevice(VulkanDeviceHandlePair aDevicePair){
         vkBindBufferMemory(aDevicePair.device, mUniformBuffer, mUniformBufferMemory, 0);
     }
 
+    for(uint32_t slot = 0; slot < mFrameSlotCount; ++slot){
+        writeFrameSlot(aDevicePair, slot);
+    }
+    std::fill(mPendingSlots.begin(), mPendingSlots.end(), false);
+    for(const std::pair<const uint32_t, BoundUniformData>& boundData : mBoundUniformData){
+        boundData.second.mDataInterface->flagAsClean();
+    }
+}
+
+void UniformBuffer::writeFrameSlot(VulkanDeviceHandlePair aDevicePair, uint32_t aSlot){
     void* mappedPtr = nullptr;
     VkResult mapResult = vkMapMemory(aDevicePair.device, mUniformBufferMemory, 0, _mCurrentDeviceAllocSize , 0, &mappedPtr);
     if(mapResult != VK_SUCCESS || mappedPtr == nullptr) throw std::runtime_error("Failed to map memory during uniform buffer upload!");
     {
-        size_t offset = 0;
+        size_t offset = getFrameSlotStride() * aSlot;
         uint8_t* mappedStart = reinterpret_cast<uint8_t*>(mappedPtr);
         for(const std::pair<uint32_t, BoundUniformData>& boundData : mBoundUniformData){
             uint8_t* start = mappedStart + offset;
@@ -270,7 +337,6 @@ void UniformBuffer::uploadToDevice(VulkanDeviceHandlePair aDevicePair){
             memcpy(start, data, cpySize);
 
             offset += boundData.second.mDataInterface->getPaddedDataSize(mBufferAlignmentSize);
-            boundData.second.mDataInterface->flagAsClean();
         }
 
         VkMappedMemoryRange mappedMemRange;
@@ -222,8 +222,21 @@ class UniformBuffer : public DirectlySyncedBufferInterface
     virtual void pollBoundData();
 
     virtual DeviceSyncStateEnum getDeviceSyncState() const override;
+    /** Write bound data into every frame slot */
     virtual void updateDevice() override;
     virtual void updateDevice(const VulkanDeviceBundle& aDevicePair);
+    /** Write bound data into frame slot 'aSlot' only if it changed since that slot was last written.
+     *  Falls back to updateDevice() when the buffer has not been created or its layout changed. 
+     */
+    virtual void updateDevice(uint32_t aSlot);
+
+    /** Set the number of frame slots. Each slot holds a full copy of the bound data so that every
+     *  frame in flight can read its own copy. Frees the buffer, which is recreated on the next update.
+     */
+    virtual void setFrameSlotCount(uint32_t aSlotCount);
+    virtual uint32_t getFrameSlotCount() const {return(mFrameSlotCount);}
+    /** Byte distance between the starts of consecutive frame slots */
+    virtual size_t getFrameSlotStride() const;
     virtual VulkanDeviceHandlePair getCurrentDevice() const override {return(mCurrentDevice);}
 
     virtual size_t getBoundDataOffset(uint32_t aBindPoint) const;
@@ -242,7 +255,8 @@ class UniformBuffer : public DirectlySyncedBufferInterface
      */
     virtual VkDescriptorSetLayout getDescriptorSetLayout() const {return(mDescriptorSetLayout);}
 
-    virtual std::map<uint32_t, VkDescriptorBufferInfo> getDescriptorBufferInfos() const;
+    virtual std::map<uint32_t, VkDescriptorBufferInfo> getDescriptorBufferInfos() const {return(getDescriptorBufferInfos(0));}
+    virtual std::map<uint32_t, VkDescriptorBufferInfo> getDescriptorBufferInfos(uint32_t aSlot) const;
     virtual std::vector<uint32_t> getBoundPoints() const; 
 
     virtual const VkBuffer& getBuffer() const override {return(mUniformBuffer);}
@@ -258,6 +272,9 @@ class UniformBuffer : public DirectlySyncedBufferInterface
     virtual void uploadToDevice(VulkanDeviceHandlePair aDevicePair) override;
     virtual void finalizeDeviceUpload(VulkanDeviceHandlePair aDevicePair) override;
 
+    /** Copy all bound data into frame slot 'aSlot' and flush it. */
+    virtual void writeFrameSlot(VulkanDeviceHandlePair aDevicePair, uint32_t aSlot);
+
     struct BoundUniformData{
         UniformDataInterfacePtr mDataInterface = nullptr;
         VkDescriptorSetLayoutBinding mLayoutBinding;
@@ -275,6 +292,10 @@ class UniformBuffer : public DirectlySyncedBufferInterface
     VulkanDeviceHandlePair mCurrentDevice = {VK_NULL_HANDLE, VK_NULL_HANDLE};
     VkDeviceSize mBufferAlignmentSize = 16U; 
 
+    uint32_t mFrameSlotCount = 1U;
+    // Slots which have not received the latest bound data yet
+    std::vector<bool> mPendingSlots = std::vector<bool>(1, false);
+
  private:
     void _cleanup(); 
 
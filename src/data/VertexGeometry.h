@@ -11,6 +11,9 @@
 #include <exception>
 #include <stdexcept>
 #include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <limits>
 #include <glm/glm.hpp>
 
 template<typename VertexType, typename IndexType = uint32_t>
@@ -33,7 +36,13 @@ class IndexedVertexGeometry : public virtual UploadTransferBackedBufferInterface
     template<typename IteratorType>
     void setIndices(IteratorType aBegin, IteratorType aEnd);
 
-    virtual bool awaitingUploadTransfer() const {return(mVertexBuffer.awaitingUploadTransfer() || mIndexBuffer.awaitingUploadTransfer());}
+    virtual bool awaitingUploadTransfer() const {
+        bool verticesUnstaged = mVertexBuffer.getBuffer() == VK_NULL_HANDLE && !mVertices.empty();
+        return(verticesUnstaged || mVertexBuffer.awaitingUploadTransfer() || mIndexBuffer.awaitingUploadTransfer());
+    }
+
+    /// Host copy of the vertices. Kept so the geometry can also be packed into a shared GeometryPool.
+    virtual const std::vector<VertexType>& getVertices() const {return(mVertices);}
 
     /// Records commands to upload both the index and attribute buffers to device local memory.
     /// Commands are recorded into aCmdBuffer. 
@@ -51,11 +60,21 @@ class IndexedVertexGeometry : public virtual UploadTransferBackedBufferInterface
     virtual void freeAndReset() override;
 
  protected:
+    std::vector<VertexType> mVertices;
     UploadTransferBackedBuffer mVertexBuffer;
     UploadTransferBackedBuffer mIndexBuffer;
     
 };
 
+/// Model space bounds of one shape of a MultiShapeGeometry
+struct ShapeBounds {
+    glm::vec3 mMin = glm::vec3(0.0f);
+    glm::vec3 mMax = glm::vec3(0.0f);
+    /// Bounding sphere centered on the box, enclosing every vertex of the shape
+    glm::vec3 mCenter = glm::vec3(0.0f);
+    float mRadius = 0.0f;
+};
+
 /// Triangle mesh geometry formed from a single set of vertex attributes, and one or more 
 /// 'shapes' specified as lists of vertex indices. 
 template<typename VertexType, typename IndexType = uint32_t>
@@ -99,11 +118,17 @@ class MultiShapeGeometry : public IndexedVertexGeometry<VertexType, IndexType>
     virtual void freeAndReset() override {super_t::freeAndReset(); mShapeIndexBufferOffsets.clear(); mIndicesConcat.clear();}
     const std::vector<glm::vec3> BBoxCenters() const { return mBBoxCenters; }
     void setBBoxCenters(std::vector<glm::vec3> centers) { mBBoxCenters = centers; }
+    /// Bounds of each shape, set by computeShapeBounds()
+    const std::vector<ShapeBounds>& shapeBounds() const {return(mShapeBounds);}
+    /// Compute the bounds of every shape from the vertices it indexes, along with BBoxCenters().
+    /// Call once the vertices and all shapes have been set. Shapes without indices get empty bounds at the origin.
+    void computeShapeBounds();
     std::vector<size_t> mShapeIndexBufferOffsets;
     std::vector<index_t> mIndicesConcat;
     
  protected:
     std::vector<glm::vec3> mBBoxCenters;
+    std::vector<ShapeBounds> mShapeBounds;
     std::vector<size_t> mDescriptorSetPositions = std::vector<size_t>();
 };
 
@@ -140,7 +140,11 @@ void IndexedVertexGeometry<VertexType, IndexType>::setDevice(const VulkanDeviceB
 
 template<typename VertexType, typename IndexType>
 void IndexedVertexGeometry<VertexType, IndexType>::setVertices(const std::vector<VertexType>& aVertices){
-    mVertexBuffer.stageDataForUpload(reinterpret_cast<const uint8_t*>(aVertices.data()), aVertices.size() * sizeof(VertexType));
+    // Staging is deferred to recordUploadTransferCommand() so geometry packed into a GeometryPool never allocates its own buffers
+    mVertices = aVertices;
+    if(mVertexBuffer.getBuffer() != VK_NULL_HANDLE){
+        mVertexBuffer.freeAndReset();
+    }
 }
 
 template<typename VertexType, typename IndexType>
@@ -164,6 +168,8 @@ template<typename IteratorType> void IndexedVertexGeometry<VertexType, IndexType
 /// Commands are recorded into aCmdBuffer. 
 template<typename VertexType, typename IndexType>
 void IndexedVertexGeometry<VertexType, IndexType>::recordUploadTransferCommand(const VkCommandBuffer& aCmdBuffer) {
+    if(mVertexBuffer.getBuffer() == VK_NULL_HANDLE)
+        mVertexBuffer.stageDataForUpload(reinterpret_cast<const uint8_t*>(mVertices.data()), mVertices.size() * sizeof(VertexType));
     mVertexBuffer.recordUploadTransferCommand(aCmdBuffer);
     mIndexBuffer.recordUploadTransferCommand(aCmdBuffer);
 }
@@ -181,6 +187,7 @@ void IndexedVertexGeometry<VertexType, IndexType>::freeStagingBuffer() {
 
 template<typename VertexType, typename IndexType>
 void IndexedVertexGeometry<VertexType, IndexType>::freeAndReset() {
+    mVertices.clear();
     mVertexBuffer.freeAndReset();
     mIndexBuffer.freeAndReset();
 }
@@ -191,3 +198,34 @@ void MultiShapeGeometry<VertexType, IndexType>::recordUploadTransferCommand(cons
         super_t::setIndices(mIndicesConcat);
     super_t::recordUploadTransferCommand(aCmdBuffer);
 }
+
+template<typename VertexType, typename IndexType>
+void MultiShapeGeometry<VertexType, IndexType>::computeShapeBounds() {
+    const std::vector<VertexType>& vertices = super_t::mVertices;
+    mShapeBounds.assign(shapeCount(), ShapeBounds());
+    mBBoxCenters.assign(shapeCount(), glm::vec3(0.0f));
+    for(size_t shapeIdx = 0; shapeIdx < shapeCount(); ++shapeIdx){
+        size_t first = getShapeOffset(shapeIdx);
+        size_t last = first + getShapeRange(shapeIdx);
+        if(first == last) continue;
+
+        ShapeBounds& bounds = mShapeBounds[shapeIdx];
+        bounds.mMin = glm::vec3(std::numeric_limits<float>::max());
+        bounds.mMax = glm::vec3(-std::numeric_limits<float>::max());
+        for(size_t i = first; i < last; ++i){
+            const glm::vec3& position = vertices[mIndicesConcat[i]].position;
+            bounds.mMin = glm::min(bounds.mMin, position);
+            bounds.mMax = glm::max(bounds.mMax, position);
+        }
+        bounds.mCenter = 0.5f * (bounds.mMin + bounds.mMax);
+
+        // Tighter than half the box diagonal whenever the shape doesn't fill the box's corners
+        float radiusSquared = 0.0f;
+        for(size_t i = first; i < last; ++i){
+            glm::vec3 offset = vertices[mIndicesConcat[i]].position - bounds.mCenter;
+            radiusSquared = std::max(radiusSquared, glm::dot(offset, offset));
+        }
+        bounds.mRadius = std::sqrt(radiusSquared);
+        mBBoxCenters[shapeIdx] = bounds.mCenter;
+    }
+}
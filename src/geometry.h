@@ -5,7 +5,9 @@
 #include <tiny_obj_loader.h>
 
 #include "data/VertexGeometry.h"
+#include "data/GeometryPool.h"
 #include "data/VertexInput.h"
+#include "utils/DedupTable.h"
 
 
 struct index_t : public tinyobj::index_t {
@@ -19,13 +21,11 @@ struct index_t : public tinyobj::index_t {
 template<>
 struct std::hash<index_t> {
     size_t operator()(const index_t& aIndexBundle) const noexcept {
-        return(
-            ((std::hash<int>()(aIndexBundle.vertex_index)
-                ^
-                (std::hash<int>()(aIndexBundle.normal_index) << 1)) >> 1)
-            ^
-            (std::hash<int>()(aIndexBundle.texcoord_index) << 1)
-            );
+        return(static_cast<size_t>(hash_index_triple(
+            static_cast<uint32_t>(aIndexBundle.vertex_index),
+            static_cast<uint32_t>(aIndexBundle.normal_index),
+            static_cast<uint32_t>(aIndexBundle.texcoord_index)
+        )));
     }
 };
 
@@ -53,6 +53,7 @@ struct ObjVertex {
 };
 
 using ObjMultiShapeGeometry = MultiShapeGeometry<ObjVertex, uint32_t>;
+using ObjGeometryPool = GeometryPool<ObjVertex, uint32_t>;
 using ObjVertexInput = VertexInputTemplate<ObjVertex>;
 
 
@@ -2,16 +2,61 @@
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 
 #include "load_gltf.h"
+#include "utils/ThreadPool.h"
 using namespace tinygltf;
 using namespace glm;
 using namespace std;
 
 
-ObjMultiShapeGeometry load_gltf_to_vulkan(const VulkanDeviceBundle& aDeviceBundle, std::string filename, bool isBinary) {
+//image loader callback which skips decoding. The geometry never reads pixels, so the encoded bytes are
+//only kept when the caller asked for them through 'userData', a std::vector<EncodedImage>*.
+static bool defer_image_data(Image* image, const int imageIndex, std::string* err, std::string* warn, int reqWidth, int reqHeight,
+                             const unsigned char* bytes, int size, void* userData) {
+    std::vector<EncodedImage>* imagesOut = static_cast<std::vector<EncodedImage>*>(userData);
+    if (imagesOut != nullptr) {
+        if (imagesOut->size() <= static_cast<size_t>(imageIndex)) {
+            imagesOut->resize(imageIndex + 1);
+        }
+        EncodedImage& encoded = (*imagesOut)[imageIndex];
+        encoded.name = image->name.empty() ? image->uri : image->name;
+        encoded.bytes.assign(bytes, bytes + size);
+    }
+    return true;
+}
+
+//images only referenced as normal, occlusion or metallic-roughness maps hold linear values, and must not be decoded as sRGB.
+static void mark_data_images(const Model& model, std::vector<EncodedImage>& images) {
+    std::vector<bool> isColor(images.size(), false);
+    std::vector<bool> isData(images.size(), false);
+    auto mark = [&model](std::vector<bool>& marks, int textureIndex) {
+        if (textureIndex >= 0 && textureIndex < static_cast<int>(model.textures.size())) {
+            int source = model.textures[textureIndex].source;
+            if (source >= 0 && source < static_cast<int>(marks.size())) {
+                marks[source] = true;
+            }
+        }
+    };
+    for (const Material& material : model.materials) {
+        mark(isColor, material.pbrMetallicRoughness.baseColorTexture.index);
+        mark(isColor, material.emissiveTexture.index);
+        mark(isData, material.pbrMetallicRoughness.metallicRoughnessTexture.index);
+        mark(isData, material.normalTexture.index);
+        mark(isData, material.occlusionTexture.index);
+    }
+    for (size_t i = 0; i < images.size(); i++) {
+        images[i].usage = (isData[i] && !isColor[i]) ? TextureUsage::DATA : TextureUsage::COLOR;
+    }
+}
+
+ObjMultiShapeGeometry load_gltf_to_vulkan(const VulkanDeviceBundle& aDeviceBundle, std::string filename, bool isBinary, std::vector<EncodedImage>* imagesOut) {
     Model model;
     TinyGLTF loader;
     std::string err;
     std::string warn;
+    if (imagesOut != nullptr) {
+        imagesOut->clear();
+    }
+    loader.SetImageLoader(defer_image_data, imagesOut);
     
     bool ret;
     if (isBinary) {
@@ -30,17 +75,30 @@ ObjMultiShapeGeometry load_gltf_to_vulkan(const VulkanDeviceBundle& aDeviceBundl
     if (!ret) {
         std::cout << "gltf loader: " << "failed to parse glTF" << std::endl;
     }
+    if (imagesOut != nullptr) {
+        imagesOut->resize(model.images.size()); //images whose data couldn't be found are left empty
+        mark_data_images(model, *imagesOut);
+    }
     ObjMultiShapeGeometry ivGeo(aDeviceBundle);
     process_gltf_contents(model, ivGeo);
 
     return ivGeo;
 }
 
-void process_vertices(const Model& model, const Accessor& accessor, std::vector<ObjVertex>& objVertices, int cumulativeIndexCount, glm::mat4 CTM) {
+/// A primitive of the scene placed in the output geometry. Its vertex range and index count are reserved
+/// before decoding, so every primitive can be decoded by its own task and written without locks.
+struct GltfPrimitiveJob {
+    const Primitive* primitive;
+    glm::mat4 CTM;
+    size_t firstVertex;
+    std::vector<ObjMultiShapeGeometry::index_t> indices;
+};
+
+void process_vertices(const Model& model, const Accessor& accessor, std::vector<ObjVertex>& objVertices, size_t cumulativeIndexCount, const glm::mat4& CTM) {
     assert(accessor.componentType == TINYGLTF_COMPONENT_TYPE_FLOAT);
     assert(accessor.type == TINYGLTF_TYPE_VEC3);
     
-    BufferView bufferView = model.bufferViews[accessor.bufferView];
+    const BufferView& bufferView = model.bufferViews[accessor.bufferView];
     int stride = accessor.ByteStride(bufferView);
     
     const uint8_t* memoryStart = model.buffers[bufferView.buffer].data.data() + accessor.byteOffset + bufferView.byteOffset;
@@ -48,15 +106,15 @@ void process_vertices(const Model& model, const Accessor& accessor, std::vector<
         //convince the compiler that data points to floating point data.
         const float* memoryLocation = reinterpret_cast<const float*>(memoryStart + (i * static_cast<size_t>(stride)));
         //read in the vec3.
-        objVertices.at(i + cumulativeIndexCount).position = CTM * glm::vec4(ptr_to_vec3(memoryLocation), 1.0f);
+        objVertices[i + cumulativeIndexCount].position = CTM * glm::vec4(ptr_to_vec3(memoryLocation), 1.0f);
     }
 }
 
-void process_normals(const Model& model, const Accessor& accessor, std::vector<ObjVertex>& objVertices, size_t cumulativeIndexCount, glm::mat4 CTM){
+void process_normals(const Model& model, const Accessor& accessor, std::vector<ObjVertex>& objVertices, size_t cumulativeIndexCount, const glm::mat4& CTM){
     assert(accessor.componentType == TINYGLTF_COMPONENT_TYPE_FLOAT);
     assert(accessor.type == TINYGLTF_TYPE_VEC3);
     
-    BufferView bufferView = model.bufferViews[accessor.bufferView];
+    const BufferView& bufferView = model.bufferViews[accessor.bufferView];
     int stride = accessor.ByteStride(bufferView);
     size_t offset = accessor.byteOffset + bufferView.byteOffset;
 
@@ -68,7 +126,7 @@ void process_normals(const Model& model, const Accessor& accessor, std::vector<O
         const float* memoryLocation = reinterpret_cast<const float*>(memoryStart + (i * static_cast<size_t>(stride)));
         //read in the vec3.
         //objVertices.emplace_back(ObjVertex{ glm::vec3(ptr_to_vec3(memoryLocation)) });
-        objVertices.at(i + cumulativeIndexCount).normal = glm::normalize(CTM * glm::vec4(ptr_to_vec3(memoryLocation), 0.0f));
+        objVertices[i + cumulativeIndexCount].normal = glm::normalize(CTM * glm::vec4(ptr_to_vec3(memoryLocation), 0.0f));
     }
 }
 
@@ -76,7 +134,7 @@ void process_texcoords(const Model& model, const Accessor& accessor, std::vector
     assert(accessor.componentType == TINYGLTF_COMPONENT_TYPE_FLOAT);
     assert(accessor.type == TINYGLTF_TYPE_VEC2);
     
-    BufferView bufferView = model.bufferViews[accessor.bufferView];
+    const BufferView& bufferView = model.bufferViews[accessor.bufferView];
     int stride = accessor.ByteStride(bufferView);
     
     const uint8_t* memoryStart = model.buffers[bufferView.buffer].data.data() + accessor.byteOffset + bufferView.byteOffset;
@@ -86,10 +144,11 @@ void process_texcoords(const Model& model, const Accessor& accessor, std::vector
         //read in the vec2.
         vec2 v = ptr_to_vec2(memoryLocation);
         v = vec2(v.s, -v.t); //deal with the fact that the obj format's texcoord.t is inverted, and the base code assumes the obj format.
-        objVertices.at(i + cumulativeIndexCount).texCoord = std::move(v);
+        objVertices[i + cumulativeIndexCount].texCoord = std::move(v);
     }
 }
 
+//'outputIndices' must already hold accessor.count elements.
 void process_indices(const Model& model, const Accessor& accessor, std::vector<ObjMultiShapeGeometry::index_t>& outputIndices, size_t cumulativeIndexCount) {
     assert(
         accessor.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT 
@@ -97,7 +156,7 @@ void process_indices(const Model& model, const Accessor& accessor, std::vector<O
         || accessor.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT);
     assert(accessor.type == TINYGLTF_TYPE_SCALAR);
     
-    BufferView bufferView = model.bufferViews[accessor.bufferView];
+    const BufferView& bufferView = model.bufferViews[accessor.bufferView];
     int stride = accessor.ByteStride(bufferView);
 
     const uint8_t* memoryStart = model.buffers[bufferView.buffer].data.data() + accessor.byteOffset + bufferView.byteOffset;
@@ -116,56 +175,163 @@ void process_indices(const Model& model, const Accessor& accessor, std::vector<O
             const unsigned int* memoryLocation = reinterpret_cast<const unsigned int*>(memoryStart + (i * static_cast<size_t>(stride)));
             val = *memoryLocation;
         }
-        outputIndices.push_back(val + cumulativeIndexCount);
+        outputIndices[i] = static_cast<ObjMultiShapeGeometry::index_t>(val + cumulativeIndexCount);
     }
 
 }
 
-//apply parent's transforms to the children
-mat4 TreeNode::computeCTM(){
-    if (!useEmbeddedTransforms) return mat4(1.0f);
-    mat4 builtCTM = CTM; //the node's CTM will still contain only the node-local transform.
-    shared_ptr<TreeNode> currentParent = parent;
-    while (currentParent != nullptr) {
-        builtCTM = currentParent->CTM * builtCTM;
-        currentParent = currentParent->parent;
+/// Decode all attributes and indices of one primitive into its reserved ranges
+void process_primitive(const Model& model, GltfPrimitiveJob& job, std::vector<ObjVertex>& objVertices) {
+    const Primitive& primitive = *job.primitive;
+    //assume the gltf files have vertex positions and indices.
+    process_vertices(model, model.accessors[primitive.attributes.at("POSITION")], objVertices, job.firstVertex, job.CTM);
+    process_indices(model, model.accessors[primitive.indices], job.indices, job.firstVertex);
+
+    //optionally find normal data and include it
+    auto normalAttr = primitive.attributes.find("NORMAL");
+    if (normalAttr != primitive.attributes.end()) {
+        process_normals(model, model.accessors[normalAttr->second], objVertices, job.firstVertex, job.CTM);
+    }
+
+    //optionally find texture data and include it
+    auto texAttr = primitive.attributes.find("TEXCOORD_0");
+    if (texAttr != primitive.attributes.end()) {
+        process_texcoords(model, model.accessors[texAttr->second], objVertices, job.firstVertex);
     }
-    return builtCTM; 
 }
 
-void SceneGraph::constructCTMTree(const tinygltf::Model& model, std::shared_ptr<tinygltf::Node> input, std::shared_ptr<TreeNode> parent) {
-    shared_ptr<TreeNode> node = make_shared<TreeNode>(*input, mat4(1.0f));//initialize a TreeNode with no matrix transforms.
-    //apply any individual transforms in order.
-    if (node->getNode().translation.size() == 3) {
-        node->CTM = glm::translate(node->CTM, vec3(node->getNode().translation[0], node->getNode().translation[1], node->getNode().translation[2]));
+void SceneGraph::build(const tinygltf::Model& model, int sceneIndex) {
+    const tinygltf::Scene& scene = model.scenes.at(sceneIndex);
+    const size_t nodeCount = model.nodes.size();
+    parents.clear();
+    meshes.clear();
+    sourceNodes.clear();
+    nodePositions.assign(nodeCount, -1);
+
+    //depth first traversal with an explicit stack, so parents are placed before their children
+    //and deep hierarchies can't overflow the call stack. Each entry is (gltf node, parent position).
+    std::vector<std::pair<int, int>> stack;
+    for (auto it = scene.nodes.rbegin(); it != scene.nodes.rend(); ++it) {
+        stack.emplace_back(*it, NO_PARENT);
     }
-    if (node->getNode().rotation.size() == 4) {
-        quat q = quat(node->getNode().rotation[3], node->getNode().rotation[0], node->getNode().rotation[1], node->getNode().rotation[2]);
-        node->CTM *= mat4(q);
+    while (!stack.empty()) {
+        std::pair<int, int> entry = stack.back();
+        stack.pop_back();
+        if (entry.first < 0 || static_cast<size_t>(entry.first) >= nodeCount) {
+            throw std::runtime_error("glTF scene references invalid node " + std::to_string(entry.first));
+        }
+        if (nodePositions[entry.first] != -1) {
+            throw std::runtime_error("glTF node " + std::to_string(entry.first) + " has more than one parent");
+        }
+        const int position = static_cast<int>(parents.size());
+        nodePositions[entry.first] = position;
+        parents.push_back(entry.second);
+        meshes.push_back(model.nodes[entry.first].mesh);
+        sourceNodes.push_back(entry.first);
+
+        const std::vector<int>& children = model.nodes[entry.first].children;
+        for (auto it = children.rbegin(); it != children.rend(); ++it) {
+            stack.emplace_back(*it, position);
+        }
     }
-    if (node->getNode().scale.size() == 3) {
-        node->CTM = glm::scale(node->CTM, vec3(node->getNode().scale[0], node->getNode().scale[1], node->getNode().scale[2]));
+
+    const size_t count = parents.size();
+    //subtrees are contiguous, so a subtree ends where the last of its descendants ends.
+    subtreeEnds.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        subtreeEnds[i] = i + 1;
     }
-    //There's also a completed matrix transform option, so if the file has that, override the CTM with this new matrix.
-    if (node->getNode().matrix.size() == 16) {
-        node->CTM = glm::make_mat4x4(node->getNode().matrix.data());
-        
+    for (size_t i = count; i-- > 0;) {
+        if (parents[i] != NO_PARENT) {
+            subtreeEnds[parents[i]] = std::max(subtreeEnds[parents[i]], subtreeEnds[i]);
+        }
     }
-    //if the node has children
-    if (!node->getNode().children.empty()) {
-        for (size_t i = 0; i < node->getNode().children.size(); i++) {
-            //construct a new TreeNode that has the child node, and the CTM of the parent
-            shared_ptr<Node> childNode = make_shared<Node>(model.nodes[node->getNode().children[i]]);
-            //call this function again.
-            constructCTMTree(model, childNode, node);
+
+    translations.assign(count, vec3(0.0f));
+    rotations.assign(count, quat(1.0f, 0.0f, 0.0f, 0.0f));
+    scales.assign(count, vec3(1.0f));
+    localTransforms.resize(count);
+    worldTransforms.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        const Node& node = model.nodes[sourceNodes[i]];
+        if (node.translation.size() == 3) {
+            translations[i] = vec3(node.translation[0], node.translation[1], node.translation[2]);
+        }
+        if (node.rotation.size() == 4) {
+            rotations[i] = quat(node.rotation[3], node.rotation[0], node.rotation[1], node.rotation[2]);
+        }
+        if (node.scale.size() == 3) {
+            scales[i] = vec3(node.scale[0], node.scale[1], node.scale[2]);
+        }
+        rebuildLocalFromTRS(i);
+        //There's also a completed matrix transform option, so if the file has that, it overrides the TRS.
+        if (node.matrix.size() == 16) {
+            localTransforms[i] = glm::make_mat4x4(node.matrix.data());
         }
     }
-    node->parent = parent;
-    if (parent != nullptr) { //this is a child of some other node.
-        parent->children.push_back(node);
+
+    dirty.assign(count, 1);
+    anyDirty = count > 0;
+    updateWorldTransforms();
+}
+
+int SceneGraph::find(int gltfNode) const {
+    if (gltfNode < 0 || static_cast<size_t>(gltfNode) >= nodePositions.size()) {
+        return -1;
     }
-    sceneGraph.push_back(node);
-    
+    return nodePositions[gltfNode];
+}
+
+void SceneGraph::setTranslation(size_t node, const glm::vec3& translation) {
+    translations[node] = translation;
+    rebuildLocalFromTRS(node);
+    markDirty(node);
+}
+
+void SceneGraph::setRotation(size_t node, const glm::quat& rotation) {
+    rotations[node] = rotation;
+    rebuildLocalFromTRS(node);
+    markDirty(node);
+}
+
+void SceneGraph::setScale(size_t node, const glm::vec3& scale) {
+    scales[node] = scale;
+    rebuildLocalFromTRS(node);
+    markDirty(node);
+}
+
+void SceneGraph::setLocalTransform(size_t node, const glm::mat4& local) {
+    localTransforms[node] = local;
+    markDirty(node);
+}
+
+void SceneGraph::rebuildLocalFromTRS(size_t node) {
+    localTransforms[node] = glm::translate(mat4(1.0f), translations[node]) * mat4(rotations[node]) * glm::scale(mat4(1.0f), scales[node]);
+}
+
+void SceneGraph::markDirty(size_t node) {
+    dirty[node] = 1;
+    anyDirty = true;
+}
+
+void SceneGraph::updateWorldTransforms() {
+    if (!anyDirty) return;
+    size_t i = 0;
+    while (i < parents.size()) {
+        if (!dirty[i]) {
+            i++;
+            continue;
+        }
+        //the whole subtree below a changed node is re-evaluated. Parents precede children,
+        //so each parent's world transform is already final when its children read it.
+        const size_t end = subtreeEnds[i];
+        for (size_t j = i; j < end; j++) {
+            worldTransforms[j] = parents[j] == NO_PARENT ? localTransforms[j] : worldTransforms[parents[j]] * localTransforms[j];
+            dirty[j] = 0;
+        }
+        i = end;
+    }
+    anyDirty = false;
 }
 
 //gltf buffers may have many interleaved buffers, and the main objects that
@@ -184,111 +350,39 @@ void process_gltf_contents(Model& model, ObjMultiShapeGeometry& ivGeoOut) {
     //verify assumption about gltf data
 
 
-    int vertexIndex = -1;
-    int normalIndex = -1;
-    int textureIndex = -1;
-
-    size_t totalIndices = 0;
-    //count the maximum number of vertices needed for this model
-    for (const auto& mesh : model.meshes) {//meshes in scene
-        for (const auto& primitive : mesh.primitives) {//shapes in mesh
-            size_t numIndices = model.accessors[primitive.indices].count; //indices in shape
-            totalIndices += numIndices;
-        }
-    }
-
     SceneGraph graph;
-
-    //for (const auto& node : model.nodes) {
-    //    graph.constructCTMTree(model, node, nullptr);
-    //}
-    tinygltf::Scene defaultScene = model.scenes[model.defaultScene];
-    for (int i = 0; i < defaultScene.nodes.size(); i++) {
-        graph.constructCTMTree(model, make_shared<tinygltf::Node>(model.nodes[defaultScene.nodes[i]]), nullptr);
-    }
+    graph.build(model, model.defaultScene >= 0 ? model.defaultScene : 0);
     // Loop over shapes in the gltf file
 
     //the gltf format's individual primitive indices all start from 0. 
     //This is incompatible with the way the .obj format stores its shape data, where the first index of the next shape starts where the previous shape left off.
     //To make the format consistent, this adds the previous vertex index number to the shape. 
     //E.g. if shape 0 has 30, shape 1 has 60 indices, then shape 2's indices will start from 90 instead of 0.
-    std::vector<ObjVertex> objVertices;
-    size_t cumulativeIndexCount = 0;
-    for (auto& treeNode : graph.data()) {
-        //construct the CTM from the node's data.
-        glm::mat4 currentTransformMatrix = treeNode->computeCTM();//constructCTM(model, TreeNode(node, mat4(1.0f)));
-        if (treeNode->getNode().mesh == -1) {
+    //Every primitive's vertex range is reserved up front, and the primitives are then decoded in parallel.
+    std::vector<GltfPrimitiveJob> jobs;
+    size_t vertexCount = 0;
+    for (size_t node = 0; node < graph.size(); node++) {
+        if (graph.mesh(node) == -1) {
             continue; //skip this node if it contains no meshes. This should be pretty rare.
         }
-        for (const auto& primitive : model.meshes[treeNode->getNode().mesh].primitives) {//shapes in mesh
+        const glm::mat4& currentTransformMatrix = graph.worldTransform(node);
+        for (const auto& primitive : model.meshes[graph.mesh(node)].primitives) {//shapes in mesh
             assert(primitive.mode == TINYGLTF_MODE_TRIANGLES); //only work with triangle data for now.
-            std::vector<ObjMultiShapeGeometry::index_t> outputIndices;
-            std::vector<std::future<void>> futures; //vertices, indices, normals if they exist, texcoords if they exist
-            //determine where our data is
-            auto attrMap = primitive.attributes;
-            //assume the gltf files have vertex positions and indices.
-            vertexIndex = attrMap["POSITION"];
-            Accessor vertAcc = model.accessors[vertexIndex];
-            cumulativeIndexCount = objVertices.size(); //add in the amount of vertices we added, so the next shape's index starts where we left off.
-            objVertices.resize(cumulativeIndexCount + vertAcc.count);
-            futures.emplace_back(std::async(launch::async, [&] {process_vertices(model, vertAcc, objVertices, cumulativeIndexCount, currentTransformMatrix); }));
-            //process_vertices(model, vertAcc, objVertices, currentTransformMatrix);
-
-            Accessor indexAcc = model.accessors[primitive.indices];
-            futures.emplace_back(std::async(launch::async, [&] {process_indices(model, indexAcc, outputIndices, cumulativeIndexCount); }));
-
-
-            //optionally find normal data and include it
-            if (attrMap.find("NORMAL") != attrMap.end()) {
-                normalIndex = attrMap["NORMAL"];
-                Accessor normAcc = model.accessors[normalIndex];
-                futures.emplace_back(async(launch::async, [&] {process_normals(model, normAcc, objVertices, cumulativeIndexCount, currentTransformMatrix); }));
-            }
-
-            //optionally find texture data and include it
-            if (attrMap.find("TEXCOORD_0") != attrMap.end()) {
-                textureIndex = attrMap["TEXCOORD_0"];
-                Accessor texAcc = model.accessors[textureIndex];
-                futures.emplace_back(async(launch::async, [&] {process_texcoords(model, texAcc, objVertices, cumulativeIndexCount); }));
-            }
-            for (auto& fut : futures) {
-                fut.wait();
-            }
-            ivGeoOut.addShape(outputIndices);
+            GltfPrimitiveJob job{&primitive, currentTransformMatrix, vertexCount, {}};
+            job.indices.resize(model.accessors[primitive.indices].count);
+            vertexCount += model.accessors[primitive.attributes.at("POSITION")].count; //the next shape's index starts where we left off.
+            jobs.emplace_back(std::move(job));
         }
     }
-    ivGeoOut.setVertices(objVertices);
-    // return a vector containing a vec3 describing the center of each shape's bounding box, for every shape in a multishape object.
-
-    std::vector<glm::vec3> centers;
-    auto offsets = ivGeoOut.mShapeIndexBufferOffsets;
-    auto indices = ivGeoOut.mIndicesConcat;
-    for (int i = 0; i < ivGeoOut.shapeCount(); ++i) {
-        size_t offset = ivGeoOut.getShapeOffset(i);
-        size_t range = ivGeoOut.getShapeRange(i);
-
 
-        float minX, minY, minZ;
-        float maxX, maxY, maxZ;
-        minX = minY = minZ = FLT_MAX;
-        maxX = maxY = maxZ = -FLT_MAX;
-        for (int j = offset; j < range; ++j) {
-            if (objVertices[indices[j]].position.x < minX) minX = objVertices[indices[j]].position.x;
-            if (objVertices[indices[j]].position.x > maxX) maxX = objVertices[indices[j]].position.x;
-
-            if (objVertices[indices[j]].position.y < minY) minY = objVertices[indices[j]].position.y;
-            if (objVertices[indices[j]].position.y > maxY) maxY = objVertices[indices[j]].position.y;
-
-            if (objVertices[indices[j]].position.z < minZ) minZ = objVertices[indices[j]].position.z;
-            if (objVertices[indices[j]].position.z > maxZ) maxZ = objVertices[indices[j]].position.z;
-        }
-        centers.emplace_back(
-            glm::vec3(
-                (minX + maxX) / 2,
-                (minY + maxY) / 2,
-                (minZ + maxZ) / 2
-            )
-        );
+    std::vector<ObjVertex> objVertices(vertexCount);
+    ThreadPool::shared().parallelFor(jobs.size(), [&](size_t jobIndex) {
+        process_primitive(model, jobs[jobIndex], objVertices);
+    });
+    for (const GltfPrimitiveJob& job : jobs) {
+        ivGeoOut.addShape(job.indices);
     }
-    ivGeoOut.setBBoxCenters(centers);
+    ivGeoOut.setVertices(objVertices);
+    // Box, sphere and box center of every shape, used for culling and by hierarchies posed around the centers
+    ivGeoOut.computeShapeBounds();
 }
\ No newline at end of file
@@ -7,9 +7,9 @@
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/gtx/string_cast.hpp>
 #include <memory>
-#include <future>
 
 #include "geometry.h"
+#include "load_texture.h"
 #include "tiny_gltf.h"
 
 enum e_ACCESSOR_TYPE
@@ -17,34 +17,68 @@ enum e_ACCESSOR_TYPE
     VERTEX, NORMAL, TEXTURE
 };
 
-class TreeNode
+/// The node hierarchy of one glTF scene, flattened into arrays indexed by node position.
+/// Nodes are stored depth first, so every parent comes before its children and each subtree
+/// occupies one contiguous range. World transforms are evaluated in a single linear pass, and
+/// after the first pass only subtrees whose local transform changed are re-evaluated.
+class SceneGraph
 {
 public:
-    TreeNode(tinygltf::Node node, glm::mat4 CTM) : node(node), CTM(CTM), parent(nullptr), useEmbeddedTransforms(true) {};
-    tinygltf::Node& getNode() { return node; }
-    glm::mat4 computeCTM();
+    /// Parent position of root nodes
+    const static int NO_PARENT = -1;
 
-    glm::mat4 CTM;
-    std::shared_ptr<TreeNode> parent;
-    std::vector<std::shared_ptr<TreeNode>> children;
-private:
-    tinygltf::Node node;
-    bool useEmbeddedTransforms;
-};
+    /// Flatten the nodes reachable from 'sceneIndex' and evaluate their world transforms.
+    void build(const tinygltf::Model& model, int sceneIndex);
+
+    size_t size() const { return parents.size(); }
+    /// Position of the node's parent, or NO_PARENT
+    int parent(size_t node) const { return parents[node]; }
+    /// Index into model.meshes, or -1 if the node holds no mesh
+    int mesh(size_t node) const { return meshes[node]; }
+    /// Index of the node in model.nodes
+    int sourceNode(size_t node) const { return sourceNodes[node]; }
+    /// One past the last position of the node's subtree
+    size_t subtreeEnd(size_t node) const { return subtreeEnds[node]; }
+    /// Position of model.nodes['gltfNode'], or -1 if it is not part of the scene
+    int find(int gltfNode) const;
+
+    /// Replace the node's local TRS. The local matrix is rebuilt as translation * rotation * scale.
+    void setTranslation(size_t node, const glm::vec3& translation);
+    void setRotation(size_t node, const glm::quat& rotation);
+    void setScale(size_t node, const glm::vec3& scale);
+    /// Replace the node's local matrix directly, as glTF nodes with a 'matrix' property do.
+    void setLocalTransform(size_t node, const glm::mat4& local);
+
+    /// Recompute the world transform of every subtree changed since the last update.
+    void updateWorldTransforms();
+    bool isDirty() const { return anyDirty; }
+
+    const glm::mat4& localTransform(size_t node) const { return localTransforms[node]; }
+    /// Valid after updateWorldTransforms() has been called for the latest local changes.
+    const glm::mat4& worldTransform(size_t node) const { return worldTransforms[node]; }
 
-class SceneGraph
-{
-public:
-    void constructCTMTree(const tinygltf::Model& model, std::shared_ptr<tinygltf::Node> input, std::shared_ptr<TreeNode> parent);
-    
-    std::vector<std::shared_ptr<TreeNode>>& data() { return sceneGraph; }
 private:
-    std::vector<std::shared_ptr<TreeNode>> sceneGraph;
-};
+    void rebuildLocalFromTRS(size_t node);
+    void markDirty(size_t node);
 
-//a node in the scene graph tree. Wraps tinygltf::Node with some tree traversal and extracts CTM data from tinygltf::model.
+    std::vector<int> parents;
+    std::vector<int> meshes;
+    std::vector<int> sourceNodes;
+    std::vector<size_t> subtreeEnds;
+    std::vector<glm::vec3> translations;
+    std::vector<glm::quat> rotations;
+    std::vector<glm::vec3> scales;
+    std::vector<glm::mat4> localTransforms;
+    std::vector<glm::mat4> worldTransforms;
+    std::vector<uint8_t> dirty;
+    std::vector<int> nodePositions;
+    bool anyDirty = false;
+};
 
 
-ObjMultiShapeGeometry load_gltf_to_vulkan(const VulkanDeviceBundle& aDeviceBundle, std::string filename, bool isBinary);
+/// Images embedded in or referenced by the file are never decoded here. If 'imagesOut' is given, it receives
+/// the encoded bytes of every image, indexed like model.images, so they can be decoded once by TextureLoader::createTextures().
+/// Images the materials only use as normal, occlusion or metallic-roughness maps are marked TextureUsage::DATA.
+ObjMultiShapeGeometry load_gltf_to_vulkan(const VulkanDeviceBundle& aDeviceBundle, std::string filename, bool isBinary, std::vector<EncodedImage>* imagesOut = nullptr);
 void process_gltf_contents(tinygltf::Model& model, ObjMultiShapeGeometry& ivGeoOut);
 #endif 
\ No newline at end of file
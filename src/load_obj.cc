@@ -1,6 +1,8 @@
 #include "load_obj.h"
+#include "utils/MappedFile.h"
 #define TINYOBJLOADER_IMPLEMENTATION
 #include <tiny_obj_loader.h>
+#include <cassert>
 #include <fstream>
 #include <algorithm>
 #include <numeric>
@@ -16,13 +18,23 @@ static void process_obj_contents(const tinyobj::attrib_t& attributes, const std:
 
 
 ObjMultiShapeGeometry load_obj_to_vulkan(const VulkanDeviceBundle& aDeviceBundle, const std::string& aObjPath){
-    std::ifstream objFileStream = std::ifstream(aObjPath);
-    if(!objFileStream.is_open()){
+    MappedFile objFile;
+    try{
+        objFile.open(aObjPath);
+    }catch(const std::runtime_error&){
         perror(aObjPath.c_str());
-        throw new ObjFileException(aObjPath);
+        throw ObjFileException(aObjPath);
     }
 
-    return(load_obj_to_vulkan(aDeviceBundle, objFileStream));
+    tinyobj::attrib_t attributes;
+    std::vector<tinyobj::shape_t> shapes;
+    parse_obj_parallel(objFile.data(), objFile.data() + objFile.size(), attributes, shapes);
+    objFile.close();
+
+    ObjMultiShapeGeometry ivGeo(aDeviceBundle);
+    process_obj_contents(attributes, shapes, ivGeo);
+
+    return(ivGeo);
 }
 
 ObjMultiShapeGeometry load_obj_to_vulkan(const VulkanDeviceBundle& aDeviceBundle, std::istream& aObjContents){
@@ -58,7 +70,7 @@ static void process_obj_contents(const tinyobj::attrib_t& attributes, const std:
     // Count the maximum number of vertices needed for this model
     using tinyobj::shape_t;
     size_t totalIndices = std::accumulate(
-        shapes.begin(), shapes.end(), 0,
+        shapes.begin(), shapes.end(), size_t(0),
         [](size_t t, const shape_t& shape){
             return(t + shape.mesh.indices.size());
         }
@@ -68,8 +80,9 @@ static void process_obj_contents(const tinyobj::attrib_t& attributes, const std:
     std::vector<ObjVertex> objVertices;
     objVertices.reserve(totalIndices/3);
 
-    // Map allows us to avoid duplicating vertices by ignoring combinations of attributes we've already seen. 
-    std::unordered_map<index_t, size_t> seenIndices;
+    // Table allows us to avoid duplicating vertices by ignoring combinations of attributes we've already seen.
+    // Sized for the same estimate of unique vertices as objVertices.
+    DedupTable<index_t> seenIndices(totalIndices/3);
 
     // Loop over shapes in the obj file
     for(const tinyobj::shape_t& shape : shapes){
@@ -86,11 +99,11 @@ static void process_obj_contents(const tinyobj::attrib_t& attributes, const std:
             // Loop over the three vertices of a triangle. 
             for(int i = 0; i < 3; ++i){
                 const index_t& indexBundle = *indexIter++;
-                auto findExistingVert = seenIndices.find(indexBundle);
-                if(findExistingVert != seenIndices.end()){
-                    outputIndices.push_back(static_cast<uint32_t>(findExistingVert->second));
-                }else{
-                    outputIndices.emplace_back(objVertices.size());
+                // Ids are handed out in insertion order, so a new id is also the index of the next vertex
+                std::pair<DedupTable<index_t>::id_t, bool> vertexId = seenIndices.findOrInsert(indexBundle);
+                outputIndices.push_back(vertexId.first);
+                if(vertexId.second){
+                    assert(vertexId.first == objVertices.size());
                     
                     objVertices.emplace_back(ObjVertex{
                         ptr_to_vec3(&attributes.vertices[indexBundle.vertex_index*3]),
@@ -114,38 +127,7 @@ static void process_obj_contents(const tinyobj::attrib_t& attributes, const std:
 
     // Add all vertices to output object
     ivGeoOut.setVertices(objVertices);
-    // return a vector containing a vec3 describing the center of each shape's bounding box, for every shape in a multishape object.
-
-    std::vector<glm::vec3> centers;
-    auto offsets = ivGeoOut.mShapeIndexBufferOffsets;
-    auto indices = ivGeoOut.mIndicesConcat;
-    for (int i = 0; i < ivGeoOut.shapeCount(); ++i) {
-        size_t offset = ivGeoOut.getShapeOffset(i);
-        size_t range = offset + ivGeoOut.getShapeRange(i);
-
-
-        float minX, minY, minZ;
-        float maxX, maxY, maxZ;
-        minX = minY = minZ = FLT_MAX;
-        maxX = maxY = maxZ = -FLT_MAX;
-        for (int j = offset; j < range; ++j) {
-            if (objVertices[indices[j]].position.x < minX) minX = objVertices[indices[j]].position.x;
-            if (objVertices[indices[j]].position.x > maxX) maxX = objVertices[indices[j]].position.x;
-
-            if (objVertices[indices[j]].position.y < minY) minY = objVertices[indices[j]].position.y;
-            if (objVertices[indices[j]].position.y > maxY) maxY = objVertices[indices[j]].position.y;
-
-            if (objVertices[indices[j]].position.z < minZ) minZ = objVertices[indices[j]].position.z;
-            if (objVertices[indices[j]].position.z > maxZ) maxZ = objVertices[indices[j]].position.z;
-        }
-        centers.emplace_back(
-            glm::vec3(
-                (minX + maxX) / 2,
-                (minY + maxY) / 2,
-                (minZ + maxZ) / 2
-            )
-        );
-    }
-    ivGeoOut.setBBoxCenters(centers);
+    // Box, sphere and box center of every shape, used for culling and by hierarchies posed around the centers
+    ivGeoOut.computeShapeBounds();
     // Done
 }
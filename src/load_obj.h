@@ -1,6 +1,7 @@
 #ifndef VULKAN_LOAD_OBJ_H_
 #define VULKAN_LOAD_OBJ_H_
 #include "geometry.h"
+#include "load_obj_parallel.h"
 #include <glm/glm.hpp>
 #include <string>
 #include <istream>
@@ -28,7 +29,9 @@ class TinyObjFailureException : public std::exception{
 
 
 
+/// Loads the file at 'aObjPath' through a memory mapping using parse_obj_parallel()
 ObjMultiShapeGeometry load_obj_to_vulkan(const VulkanDeviceBundle& aDeviceBundle, const std::string& aObjPath);
+/// Loads OBJ text from a stream using tinyobj
 ObjMultiShapeGeometry load_obj_to_vulkan(const VulkanDeviceBundle& aDeviceBundle, std::istream& aObjContents);
 
 #endif 
\ No newline at end of file
@@ -0,0 +1,288 @@
+#include "load_obj_parallel.h"
+#include "utils/ThreadPool.h"
+#include <algorithm>
+#include <charconv>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+namespace {
+
+enum class ObjLineType {POSITION, NORMAL, TEXCOORD, FACE, GROUP, OBJECT, OTHER};
+
+/// Faces following a 'g' or 'o' statement, or following the start of a chunk
+struct ObjChunkSegment {
+    bool mStartsShape = false;
+    std::string mName;
+    std::vector<tinyobj::index_t> mIndices;
+};
+
+struct ObjChunk {
+    const char* mBegin = nullptr;
+    const char* mEnd = nullptr;
+
+    size_t mPositionCount = 0;
+    size_t mNormalCount = 0;
+    size_t mTexcoordCount = 0;
+
+    std::vector<ObjChunkSegment> mSegments;
+};
+
+inline bool is_obj_space(char c) {return(c == ' ' || c == '\t');}
+
+/// Calls 'aFunc(lineBegin, lineEnd)' for every non-empty line in [aBegin, aEnd), with leading whitespace and line endings removed
+template<typename FuncType>
+void for_each_obj_line(const char* aBegin, const char* aEnd, FuncType&& aFunc){
+    const char* line = aBegin;
+    while(line < aEnd){
+        const char* lineEnd = static_cast<const char*>(memchr(line, '\n', aEnd - line));
+        if(lineEnd == nullptr) lineEnd = aEnd;
+        const char* nextLine = lineEnd < aEnd ? lineEnd + 1 : aEnd;
+
+        if(lineEnd > line && lineEnd[-1] == '\r') --lineEnd;
+        while(line < lineEnd && is_obj_space(*line)) ++line;
+        if(line < lineEnd) aFunc(line, lineEnd);
+
+        line = nextLine;
+    }
+}
+
+ObjLineType classify_obj_line(const char* aBegin, const char* aEnd){
+    size_t length = aEnd - aBegin;
+    switch(aBegin[0]){
+        case 'v':
+            if(length > 1 && is_obj_space(aBegin[1])) return(ObjLineType::POSITION);
+            if(length > 2 && aBegin[1] == 'n' && is_obj_space(aBegin[2])) return(ObjLineType::NORMAL);
+            if(length > 2 && aBegin[1] == 't' && is_obj_space(aBegin[2])) return(ObjLineType::TEXCOORD);
+            break;
+        case 'f':
+            if(length > 1 && is_obj_space(aBegin[1])) return(ObjLineType::FACE);
+            break;
+        case 'g':
+            if(length > 1 && is_obj_space(aBegin[1])) return(ObjLineType::GROUP);
+            break;
+        case 'o':
+            if(length > 1 && is_obj_space(aBegin[1])) return(ObjLineType::OBJECT);
+            break;
+    }
+    return(ObjLineType::OTHER);
+}
+
+/// Parse the next whitespace separated float, or 0 if it is missing or malformed. 
+float parse_obj_float(const char*& aCursor, const char* aEnd){
+    while(aCursor < aEnd && is_obj_space(*aCursor)) ++aCursor;
+    const char* tokenEnd = aCursor;
+    while(tokenEnd < aEnd && !is_obj_space(*tokenEnd)) ++tokenEnd;
+
+    const char* numberBegin = aCursor < tokenEnd && *aCursor == '+' ? aCursor + 1 : aCursor;
+    float value = 0.0f;
+#if defined(__cpp_lib_to_chars)
+    if(std::from_chars(numberBegin, tokenEnd, value).ec != std::errc()){
+        value = 0.0f;
+    }
+#else
+    // Standard libraries without floating point from_chars (libc++) fall back to strtof, which needs a terminated copy
+    char token[64];
+    size_t length = std::min(static_cast<size_t>(tokenEnd - numberBegin), sizeof(token) - 1);
+    memcpy(token, numberBegin, length);
+    token[length] = '\0';
+    char* parsedEnd = nullptr;
+    value = std::strtof(token, &parsedEnd);
+    if(parsedEnd == token){
+        value = 0.0f;
+    }
+#endif
+    aCursor = tokenEnd;
+    return(value);
+}
+
+/// Parse one index of a face vertex and convert it to a zero based index the same way tinyobj does.
+/// 'aCount' is the number of elements declared so far, which negative indices are relative to.
+int parse_obj_index(const char*& aCursor, const char* aEnd, size_t aCount){
+    const char* numberBegin = aCursor < aEnd && *aCursor == '+' ? aCursor + 1 : aCursor;
+    int value = 0;
+    if(std::from_chars(numberBegin, aEnd, value).ec != std::errc()){
+        value = 0;
+    }
+    while(aCursor < aEnd && *aCursor != '/' && !is_obj_space(*aCursor)) ++aCursor;
+
+    if(value > 0) return(value - 1);
+    if(value == 0) return(0);
+    return(static_cast<int>(aCount) + value);
+}
+
+/// First word after the statement keyword, which is what tinyobj uses as the name of 'g' and 'o' shapes
+std::string parse_obj_name(const char* aCursor, const char* aEnd){
+    while(aCursor < aEnd && is_obj_space(*aCursor)) ++aCursor;
+    const char* nameEnd = aCursor;
+    while(nameEnd < aEnd && !is_obj_space(*nameEnd)) ++nameEnd;
+    return(std::string(aCursor, nameEnd));
+}
+
+void count_obj_chunk(ObjChunk& aChunk){
+    for_each_obj_line(aChunk.mBegin, aChunk.mEnd, [&aChunk](const char* aLine, const char* aLineEnd){
+        switch(classify_obj_line(aLine, aLineEnd)){
+            case ObjLineType::POSITION: ++aChunk.mPositionCount; break;
+            case ObjLineType::NORMAL: ++aChunk.mNormalCount; break;
+            case ObjLineType::TEXCOORD: ++aChunk.mTexcoordCount; break;
+            default: break;
+        }
+    });
+}
+
+/// Parse a chunk whose attributes start at the given global element offsets. Attributes are written directly into 'aAttributes',
+/// which must already be sized for the whole file. Faces are collected in the chunk's segments.
+void parse_obj_chunk(ObjChunk& aChunk, size_t aPositionBase, size_t aNormalBase, size_t aTexcoordBase, tinyobj::attrib_t& aAttributes){
+    size_t positionCount = aPositionBase;
+    size_t normalCount = aNormalBase;
+    size_t texcoordCount = aTexcoordBase;
+
+    aChunk.mSegments.emplace_back();
+    std::vector<tinyobj::index_t> face;
+
+    for_each_obj_line(aChunk.mBegin, aChunk.mEnd, [&](const char* aLine, const char* aLineEnd){
+        const char* cursor = aLine + 1;
+        switch(classify_obj_line(aLine, aLineEnd)){
+            case ObjLineType::POSITION: {
+                float* position = &aAttributes.vertices[3 * positionCount++];
+                for(int i = 0; i < 3; ++i) position[i] = parse_obj_float(cursor, aLineEnd);
+            } break;
+            case ObjLineType::NORMAL: {
+                ++cursor;
+                float* normal = &aAttributes.normals[3 * normalCount++];
+                for(int i = 0; i < 3; ++i) normal[i] = parse_obj_float(cursor, aLineEnd);
+            } break;
+            case ObjLineType::TEXCOORD: {
+                ++cursor;
+                float* texcoord = &aAttributes.texcoords[2 * texcoordCount++];
+                for(int i = 0; i < 2; ++i) texcoord[i] = parse_obj_float(cursor, aLineEnd);
+            } break;
+            case ObjLineType::FACE: {
+                // Formats: v, v/vt, v//vn and v/vt/vn
+                face.clear();
+                while(cursor < aLineEnd && is_obj_space(*cursor)) ++cursor;
+                while(cursor < aLineEnd){
+                    tinyobj::index_t vertex;
+                    vertex.vertex_index = parse_obj_index(cursor, aLineEnd, positionCount);
+                    vertex.normal_index = -1;
+                    vertex.texcoord_index = -1;
+                    if(cursor < aLineEnd && *cursor == '/'){
+                        ++cursor;
+                        if(cursor < aLineEnd && *cursor == '/'){
+                            ++cursor;
+                            vertex.normal_index = parse_obj_index(cursor, aLineEnd, normalCount);
+                        }else{
+                            vertex.texcoord_index = parse_obj_index(cursor, aLineEnd, texcoordCount);
+                            if(cursor < aLineEnd && *cursor == '/'){
+                                ++cursor;
+                                vertex.normal_index = parse_obj_index(cursor, aLineEnd, normalCount);
+                            }
+                        }
+                    }
+                    face.emplace_back(vertex);
+                    while(cursor < aLineEnd && is_obj_space(*cursor)) ++cursor;
+                }
+
+                // Triangle fan, matching tinyobj's triangulation
+                std::vector<tinyobj::index_t>& indices = aChunk.mSegments.back().mIndices;
+                for(size_t k = 2; k < face.size(); ++k){
+                    indices.emplace_back(face[0]);
+                    indices.emplace_back(face[k - 1]);
+                    indices.emplace_back(face[k]);
+                }
+            } break;
+            case ObjLineType::GROUP:
+            case ObjLineType::OBJECT: {
+                ObjChunkSegment segment;
+                segment.mStartsShape = true;
+                segment.mName = parse_obj_name(cursor, aLineEnd);
+                aChunk.mSegments.emplace_back(std::move(segment));
+            } break;
+            default: break;
+        }
+    });
+}
+
+/// Run 'aFunc(chunk, chunkIndex)' for each chunk on the shared thread pool
+template<typename FuncType>
+void for_each_obj_chunk(std::vector<ObjChunk>& aChunks, FuncType&& aFunc){
+    ThreadPool::shared().parallelFor(aChunks.size(), [&aChunks, &aFunc](size_t aIndex){aFunc(aChunks[aIndex], aIndex);});
+}
+
+}
+
+void parse_obj_parallel(
+    const char* aBegin, const char* aEnd,
+    tinyobj::attrib_t& aAttributesOut, std::vector<tinyobj::shape_t>& aShapesOut,
+    unsigned aThreadCount, size_t aMinChunkBytes
+){
+    aAttributesOut = tinyobj::attrib_t();
+    aShapesOut.clear();
+
+    size_t totalBytes = aEnd - aBegin;
+    size_t threadCount = aThreadCount > 0 ? aThreadCount : ThreadPool::shared().threadCount() + 1;
+    size_t chunkCount = std::clamp<size_t>(totalBytes / std::max<size_t>(aMinChunkBytes, 1U), 1U, threadCount);
+
+    // Split into roughly equal chunks, moving each split forward to the next line
+    std::vector<ObjChunk> chunks(chunkCount);
+    const char* chunkBegin = aBegin;
+    for(size_t i = 0; i < chunkCount; ++i){
+        const char* chunkEnd = aEnd;
+        if(i + 1 < chunkCount){
+            chunkEnd = std::max(chunkBegin, aBegin + totalBytes * (i + 1) / chunkCount);
+            const char* newline = static_cast<const char*>(memchr(chunkEnd, '\n', aEnd - chunkEnd));
+            chunkEnd = newline != nullptr ? newline + 1 : aEnd;
+        }
+        chunks[i].mBegin = chunkBegin;
+        chunks[i].mEnd = chunkEnd;
+        chunkBegin = chunkEnd;
+    }
+
+    // Counting first gives every chunk its global attribute offsets, which resolves relative
+    // indices and lets attributes be written in place.
+    for_each_obj_chunk(chunks, [](ObjChunk& aChunk, size_t){count_obj_chunk(aChunk);});
+
+    std::vector<size_t> positionBases(chunkCount), normalBases(chunkCount), texcoordBases(chunkCount);
+    size_t positionCount = 0, normalCount = 0, texcoordCount = 0;
+    for(size_t i = 0; i < chunkCount; ++i){
+        positionBases[i] = positionCount;
+        normalBases[i] = normalCount;
+        texcoordBases[i] = texcoordCount;
+        positionCount += chunks[i].mPositionCount;
+        normalCount += chunks[i].mNormalCount;
+        texcoordCount += chunks[i].mTexcoordCount;
+    }
+    aAttributesOut.vertices.resize(3 * positionCount);
+    aAttributesOut.normals.resize(3 * normalCount);
+    aAttributesOut.texcoords.resize(2 * texcoordCount);
+
+    for_each_obj_chunk(chunks, [&](ObjChunk& aChunk, size_t aIndex){
+        parse_obj_chunk(aChunk, positionBases[aIndex], normalBases[aIndex], texcoordBases[aIndex], aAttributesOut);
+    });
+
+    // Merge segments in file order. Like tinyobj, shapes without faces are dropped.
+    tinyobj::shape_t shape;
+    auto finishShape = [&aShapesOut, &shape](){
+        if(!shape.mesh.indices.empty()){
+            size_t faceCount = shape.mesh.indices.size() / 3;
+            shape.mesh.num_face_vertices.assign(faceCount, 3);
+            shape.mesh.material_ids.assign(faceCount, -1);
+            aShapesOut.emplace_back(std::move(shape));
+        }
+        shape = tinyobj::shape_t();
+    };
+    for(ObjChunk& chunk : chunks){
+        for(ObjChunkSegment& segment : chunk.mSegments){
+            if(segment.mStartsShape){
+                finishShape();
+                shape.name = std::move(segment.mName);
+            }
+            if(shape.mesh.indices.empty()){
+                shape.mesh.indices = std::move(segment.mIndices);
+            }else{
+                shape.mesh.indices.insert(shape.mesh.indices.end(), segment.mIndices.begin(), segment.mIndices.end());
+            }
+        }
+    }
+    finishShape();
+}
@@ -0,0 +1,20 @@
+#ifndef VULKAN_LOAD_OBJ_PARALLEL_H_
+#define VULKAN_LOAD_OBJ_PARALLEL_H_
+#include <tiny_obj_loader.h>
+#include <cstddef>
+#include <vector>
+
+/// Files smaller than this are parsed by a single thread
+const static size_t OBJ_PARSE_MIN_CHUNK_BYTES = 1U << 20;
+
+/** Parses the OBJ text in [aBegin, aEnd) into the same geometry tinyobj::LoadObj() produces with triangulation
+ * and without materials. The text is split into up to 'aThreadCount' line aligned chunks (0 for one per thread of
+ * the shared ThreadPool, counting the caller) which are parsed in parallel. Chunks are merged in file order, so the output does not depend on
+ * the number of threads. Floats are parsed with std::from_chars and may differ from tinyobj in the last bit. */
+void parse_obj_parallel(
+    const char* aBegin, const char* aEnd,
+    tinyobj::attrib_t& aAttributesOut, std::vector<tinyobj::shape_t>& aShapesOut,
+    unsigned aThreadCount = 0, size_t aMinChunkBytes = OBJ_PARSE_MIN_CHUNK_BYTES
+);
+
+#endif
@@ -6,14 +6,30 @@
 #include "load_texture.h"
 #include "VulkanGraphicsApp.h"
 #include "vkutils/VmaHost.h"
+#include "utils/ThreadPool.h"
+#include "utils/DedupTable.h"
+#include "utils/MappedFile.h"
+#include <algorithm>
+#include <chrono>
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
 
 using namespace std;
 
+//true if 'path' names a cooked texture rather than an image file
+static bool is_cooked_path(const std::string& path) {
+    const std::string extension = ".ktx2";
+    return path.size() >= extension.size() && path.compare(path.size() - extension.size(), extension.size(), extension) == 0;
+}
+
+//the cooked texture uploaded in place of the image file at 'path'
+static std::string cooked_source_path(const std::string& path) {
+    return is_cooked_path(path) ? path : cooked_texture_path(path);
+}
+
 TextureLoader::TextureLoader(VulkanDeviceBundle deviceBundle) :
-    deviceBundle(deviceBundle), commandPool(VK_NULL_HANDLE){}
+    deviceBundle(deviceBundle), commandPool(VK_NULL_HANDLE), samplerCache(deviceBundle.logicalDevice.handle()){}
 
 TextureLoader::TextureLoader() : 
     deviceBundle(),
@@ -28,7 +44,7 @@ std::vector<VkDescriptorSetLayoutBinding> TextureLoader::getDescriptorSetLayoutB
     
     VkDescriptorSetLayoutBinding samplerBinding{};
     samplerBinding.binding = bindingNum;
-    samplerBinding.descriptorCount = TEXTURE_ARRAY_SIZE;
+    samplerBinding.descriptorCount = capacity();
     samplerBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
     samplerBinding.pImmutableSamplers = nullptr;
     samplerBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
@@ -96,82 +112,430 @@ const Texture* TextureLoader::getTexture(uint32_t index) const
     return &textures[index];
 }
 
-std::array<VkDescriptorImageInfo, TextureLoader::TEXTURE_ARRAY_SIZE> TextureLoader::getDescriptorImageInfos(){
-    std::array<VkDescriptorImageInfo, TEXTURE_ARRAY_SIZE> infos;
-    for (uint32_t i = 0; i < textures.size(); i++) {
+std::vector<VkDescriptorImageInfo> TextureLoader::getDescriptorImageInfos(){
+    //a bindless table is partially bound, so it only needs the textures that exist.
+    //A fixed array must be fully written, so the remainder points at the debug texture.
+    std::vector<VkDescriptorImageInfo> infos(bindless ? textures.size() : TEXTURE_ARRAY_SIZE);
+    for (uint32_t i = 0; i < infos.size(); i++) {
+        //textures evicted by streaming have no image until their levels are loaded again
+        const Texture& texture = textures[i < textures.size() && textures[i].image != VK_NULL_HANDLE ? i : 0];
         VkDescriptorImageInfo imageInfo{};
         imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-        imageInfo.imageView = textures[i].imageView;
-        imageInfo.sampler = textures[i].sampler;
+        imageInfo.imageView = texture.imageView;
+        imageInfo.sampler = texture.sampler;
 
         infos[i] = imageInfo;
     }
-    for (uint32_t i = textures.size(); i < TEXTURE_ARRAY_SIZE; i++) {
-        VkDescriptorImageInfo imageInfo{};
-        imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-        imageInfo.imageView = textures[0].imageView;
-        imageInfo.sampler = textures[0].sampler;
+    return(infos);
+}
 
-        infos[i] = imageInfo;
+uint32_t TextureLoader::capacity() const {
+    if (!bindless) {
+        return TEXTURE_ARRAY_SIZE;
     }
-    return(infos);
+    const VkPhysicalDeviceDescriptorIndexingPropertiesEXT& limits = deviceBundle.physicalDevice.mDescriptorIndexingProperties;
+    return std::min({
+        BINDLESS_TEXTURE_CAPACITY,
+        limits.maxPerStageDescriptorUpdateAfterBindSampledImages,
+        limits.maxPerStageDescriptorUpdateAfterBindSamplers,
+        limits.maxDescriptorSetUpdateAfterBindSampledImages,
+        limits.maxDescriptorSetUpdateAfterBindSamplers
+    });
+}
+
+void TextureLoader::initDescriptorTable(size_t tableCount){
+    std::vector<VkDescriptorSetLayoutBinding> bindings = getDescriptorSetLayoutBindings(0);
+
+    VkDescriptorBindingFlagsEXT bindingFlags = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT
+        | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT
+        | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT_EXT;
+    VkDescriptorSetLayoutBindingFlagsCreateInfoEXT bindingFlagsInfo{};
+    bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT;
+    bindingFlagsInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+    bindingFlagsInfo.pBindingFlags = &bindingFlags;
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.pNext = bindless ? &bindingFlagsInfo : nullptr;
+    layoutInfo.flags = bindless ? VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT : 0;
+    layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+    layoutInfo.pBindings = bindings.data();
+    if (VK_SUCCESS != vkCreateDescriptorSetLayout(deviceBundle.logicalDevice.handle(), &layoutInfo, nullptr, &descriptorSetLayout)) {
+        throw TextureLoaderException("failed to create texture table descriptor set layout");
+    }
+
+    allocateTables(tableCount);
+}
+
+void TextureLoader::setTableCount(size_t tableCount){
+    if (tableCount == descriptorSets.size()) {
+        return;
+    }
+    //nothing reads the old tables or retired images once the device is idle
+    releaseRetired(true);
+    allocateTables(tableCount);
 }
 
-void TextureLoader::createTexture(string imagePath){
+void TextureLoader::allocateTables(size_t tableCount){
+    if (descriptorPool != VK_NULL_HANDLE) {
+        vkDestroyDescriptorPool(deviceBundle.logicalDevice.handle(), descriptorPool, nullptr);
+        descriptorPool = VK_NULL_HANDLE;
+    }
+
+    VkDescriptorPoolSize poolSize{VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, capacity() * static_cast<uint32_t>(tableCount)};
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.flags = bindless ? VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT : 0;
+    poolInfo.maxSets = static_cast<uint32_t>(tableCount);
+    poolInfo.poolSizeCount = 1;
+    poolInfo.pPoolSizes = &poolSize;
+    if (VK_SUCCESS != vkCreateDescriptorPool(deviceBundle.logicalDevice.handle(), &poolInfo, nullptr, &descriptorPool)) {
+        throw TextureLoaderException("failed to create texture table descriptor pool");
+    }
+
+    std::vector<VkDescriptorSetLayout> layouts(tableCount, descriptorSetLayout);
+    descriptorSets.assign(tableCount, VK_NULL_HANDLE);
+    VkDescriptorSetAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = descriptorPool;
+    allocInfo.descriptorSetCount = static_cast<uint32_t>(tableCount);
+    allocInfo.pSetLayouts = layouts.data();
+    if (VK_SUCCESS != vkAllocateDescriptorSets(deviceBundle.logicalDevice.handle(), &allocInfo, descriptorSets.data())) {
+        throw TextureLoaderException("failed to allocate texture table descriptor sets");
+    }
+
+    //every table starts out with the current textures
+    staleEntries.assign(tableCount, {});
+    writtenDescriptorCount = 0;
+    updateDescriptorTable();
+}
+
+void TextureLoader::updateDescriptorTable(){
+    if (descriptorSets.empty()) {
+        throw TextureLoaderException("TextureLoader::initDescriptorTable() must be called before updating the texture table.");
+    }
+    uploadPendingTextures();
+    if (writtenDescriptorCount != 0 && writtenDescriptorCount == textures.size()) {
+        return;
+    }
+
+    std::vector<VkDescriptorImageInfo> infos = getDescriptorImageInfos();
+    uint32_t firstElement = 0;
+    if (bindless) {
+        //only the new textures are written. Elements a pending frame may read are left untouched.
+        firstElement = static_cast<uint32_t>(writtenDescriptorCount);
+        infos.erase(infos.begin(), infos.begin() + writtenDescriptorCount);
+    }
+    else if (writtenDescriptorCount != 0) {
+        //a fixed array can't change while submitted frames might still read it
+        vkDeviceWaitIdle(deviceBundle.logicalDevice.handle());
+        releaseRetired(true);
+    }
+
+    std::vector<VkWriteDescriptorSet> writes;
+    for (VkDescriptorSet descriptorSet : descriptorSets) {
+        VkWriteDescriptorSet write{};
+        write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write.dstSet = descriptorSet;
+        write.dstBinding = 0;
+        write.dstArrayElement = firstElement;
+        write.descriptorCount = static_cast<uint32_t>(infos.size());
+        write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        write.pImageInfo = infos.data();
+        writes.push_back(write);
+    }
+    vkUpdateDescriptorSets(deviceBundle.logicalDevice.handle(), static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+    if (!bindless) {
+        //the whole array was written, including any swapped entries
+        for (std::vector<size_t>& stale : staleEntries) {
+            stale.clear();
+        }
+    }
+    writtenDescriptorCount = textures.size();
+}
+
+uint32_t TextureLoader::createTexture(string imagePath, TextureUsage usage){
+    return createTextures(std::vector<std::string>{imagePath}, usage)[0];
+}
+
+uint32_t TextureLoader::createTexture(const EncodedImage& image){
+    return createTextures(std::vector<EncodedImage>{image})[0];
+}
+
+//an image file on disk or an encoded image in memory, readable by stb_image
+struct TextureLoader::ImageSource {
+    const std::string* path = nullptr;
+    const EncodedImage* encoded = nullptr;
+    TextureUsage usage = TextureUsage::COLOR;
+
+    std::string name() const { return path ? *path : encoded->name; }
+    //reads only the image header
+    bool info(int* width, int* height, int* numChannels) const {
+        if (path) {
+            return stbi_info(path->c_str(), width, height, numChannels) != 0;
+        }
+        return stbi_info_from_memory(encoded->bytes.data(), static_cast<int>(encoded->bytes.size()), width, height, numChannels) != 0;
+    }
+    //stb converts the image to 'desiredChannels' channels, which is how many its texture's format stores
+    stbi_uc* decode(int* width, int* height, int* numChannels, int desiredChannels) const {
+        if (path) {
+            return stbi_load(path->c_str(), width, height, numChannels, desiredChannels);
+        }
+        return stbi_load_from_memory(encoded->bytes.data(), static_cast<int>(encoded->bytes.size()), width, height, numChannels, desiredChannels);
+    }
+};
+
+std::vector<uint32_t> TextureLoader::createTextures(const std::vector<std::string>& imagePaths, TextureUsage usage){
+    std::vector<ImageSource> sources(imagePaths.size());
+    for (size_t i = 0; i < imagePaths.size(); i++) {
+        sources[i].path = &imagePaths[i];
+        sources[i].usage = usage;
+    }
+    return createTexturesByContent(sources);
+}
+
+std::vector<uint32_t> TextureLoader::createTextures(const std::vector<EncodedImage>& images){
+    std::vector<ImageSource> sources(images.size());
+    for (size_t i = 0; i < images.size(); i++) {
+        sources[i].encoded = &images[i];
+        sources[i].usage = images[i].usage;
+    }
+    return createTexturesByContent(sources);
+}
+
+TextureLoader::ContentKey TextureLoader::contentKey(const ImageSource& source){
+    if (source.encoded) {
+        const std::vector<unsigned char>& bytes = source.encoded->bytes;
+        return ContentKey(hash_bytes(bytes.data(), bytes.size()), bytes.size(), source.usage);
+    }
+    MappedFile file;
+    try {
+        file.open(*source.path);
+    }
+    catch (const std::runtime_error&) {
+        throw TextureLoaderException("failed to load texture: " + *source.path);
+    }
+    return ContentKey(hash_bytes(file.data(), file.size()), file.size(), source.usage);
+}
+
+std::vector<uint32_t> TextureLoader::createTexturesByContent(const std::vector<ImageSource>& sources){
+    std::vector<ContentKey> keys(sources.size());
+    ThreadPool::shared().parallelFor(sources.size(), [&sources, &keys](size_t i) {
+        keys[i] = contentKey(sources[i]);
+    });
+
+    //sources matching an existing texture take its index, the first of several identical sources creates one for all
+    const uint32_t firstTexture = static_cast<uint32_t>(textures.size());
+    std::vector<uint32_t> indices(sources.size());
+    std::vector<ImageSource> unique;
+    std::map<ContentKey, uint32_t> created;
+    for (size_t i = 0; i < sources.size(); i++) {
+        std::map<ContentKey, uint32_t>::const_iterator existing = contentIndices.find(keys[i]);
+        if (existing != contentIndices.end()) {
+            indices[i] = existing->second;
+            continue;
+        }
+        std::pair<std::map<ContentKey, uint32_t>::iterator, bool> inserted = created.emplace(keys[i], firstTexture + static_cast<uint32_t>(unique.size()));
+        if (inserted.second) {
+            unique.push_back(sources[i]);
+        }
+        indices[i] = inserted.first->second;
+    }
+
+    createTexturesPipelined(unique);
+    contentIndices.insert(created.begin(), created.end());
+
+    dedupStats.misses += unique.size();
+    dedupStats.hits += sources.size() - unique.size();
+    std::vector<bool> counted(textures.size(), false);
+    for (uint32_t index : indices) {
+        if (index < firstTexture || counted[index]) {
+            //streaming may have dropped levels of the shared texture, the saving counts all of them
+            const Texture& texture = textures[index];
+            const StreamSource* source = streamSources[index].get();
+            std::vector<uint64_t> levelBytes = source ? levelByteSizes(texture.format, source->width, source->height, source->mipLevels)
+                : levelByteSizes(texture.format, texture.width, texture.height, texture.mipLevels);
+            for (uint64_t bytes : levelBytes) {
+                dedupStats.savedBytes += bytes;
+            }
+        }
+        counted[index] = true;
+    }
+    return indices;
+}
+
+void TextureLoader::createTexturesPipelined(const std::vector<ImageSource>& sources){
     if (commandPool == VK_NULL_HANDLE) {
         throw TextureLoaderException( "TextureLoader::setup() must be called with a valid command pool, before creating texture images.");
     }
-    if (textures.size() == TEXTURE_ARRAY_SIZE) {
-        throw TextureLoaderException("TextureLoader::createTexture has created the maximum amount of textures for the internal texture array,"
-            " including the debug texture at location 0. Increase the size of the texture array. (defined in TextureLoader::TEXTURE_ARRAY_SIZE)");
+    if (textures.size() + sources.size() > capacity()) {
+        throw TextureLoaderException("TextureLoader::createTextures would exceed the maximum amount of textures for the texture table."
+            " Without bindless texture support the table holds TextureLoader::TEXTURE_ARRAY_SIZE textures.");
     }
-    textures.emplace_back(Texture(deviceBundle.logicalDevice.handle()));
-    stbi_uc* pixels = stbi_load(
-        imagePath.c_str(), //the path of the image
-        &textures.back().width, //width of the image
-        &textures.back().height, //height of the image
-        &textures.back().numTextureChannels, //the actual number of channels in the raw image
-        STBI_rgb_alpha); //adds an alpha channel to the image for formatting consistency
-    if (!pixels) {
-        cerr << "failed to load texture: " << imagePath << endl; //TODO maybe throw exception here
-        exit(1);
+    if (sources.empty()) {
+        return;
     }
-    VkDeviceSize imageSize = (VkDeviceSize)textures.back().width * textures.back().height * STBI_rgb_alpha;
-    
+
+    //only the headers are read up front, so the staging buffer can be sized before anything is decoded.
+    //cooked textures are read whole instead, since they need no decoding.
+    struct ImageHeader {
+        int width;
+        int height;
+        int numChannels;
+        TextureFormat format;
+        std::shared_ptr<CookedTexture> cooked;
+    };
+    std::vector<ImageHeader> headers(sources.size());
+    std::vector<std::vector<VkDeviceSize>> levelOffsets(sources.size());
+    std::vector<VkDeviceSize> stagedBytes(sources.size(), 0);
+    VkDeviceSize stagingSize = 0;
+    for (size_t i = 0; i < sources.size(); i++) {
+        headers[i].cooked = loadCookedTexture(sources[i]);
+        if (headers[i].cooked) {
+            const CookedTexture& cooked = *headers[i].cooked;
+            headers[i].width = static_cast<int>(cooked.width);
+            headers[i].height = static_cast<int>(cooked.height);
+            headers[i].numChannels = 4;
+            headers[i].format = TextureFormat::fromBlockCompressed(cooked.format);
+            const VkDeviceSize alignment = copyAlignment(headers[i].format);
+            for (const std::vector<unsigned char>& level : cooked.levels) {
+                stagingSize = (stagingSize + alignment - 1) / alignment * alignment;
+                levelOffsets[i].push_back(stagingSize);
+                stagingSize += level.size();
+                stagedBytes[i] += level.size();
+            }
+            continue;
+        }
+        if (!sources[i].info(&headers[i].width, &headers[i].height, &headers[i].numChannels)) {
+            throw TextureLoaderException("failed to load texture: " + sources[i].name());
+        }
+        headers[i].format = selectFormat(headers[i].numChannels, sources[i].usage);
+        const VkDeviceSize alignment = copyAlignment(headers[i].format);
+        stagingSize = (stagingSize + alignment - 1) / alignment * alignment;
+        levelOffsets[i].push_back(stagingSize);
+        stagedBytes[i] = static_cast<VkDeviceSize>(headers[i].width) * headers[i].height * headers[i].format.channels;
+        stagingSize += stagedBytes[i];
+    }
+
+    VkBuffer stagingBuffer;
+    VkDeviceMemory stagingBufferMemory;
     createBuffer(
-        imageSize,
+        stagingSize,
         VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-        textures.back().stagingBuffer,
-        textures.back().stagingBufferMemory);
-
+        stagingBuffer,
+        stagingBufferMemory);
+    //stays mapped while the workers copy decoded pixels into their own ranges of it
     void* data;
-    vkMapMemory(deviceBundle.logicalDevice.handle(), textures.back().stagingBufferMemory, 0, imageSize, 0, &data);
-        memcpy(data, pixels, static_cast<size_t>(imageSize));
-    vkUnmapMemory(deviceBundle.logicalDevice.handle(), textures.back().stagingBufferMemory);
-    stbi_image_free(pixels);
+    vkMapMemory(deviceBundle.logicalDevice.handle(), stagingBufferMemory, 0, stagingSize, 0, &data);
+    unsigned char* stagingData = static_cast<unsigned char*>(data);
 
-    textures.back().createImage(deviceBundle);
-    transitionImageLayout(textures.back().image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-        copyBufferToImage(textures.back().stagingBuffer, textures.back().image, static_cast<uint32_t>(textures.back().width), static_cast<uint32_t>(textures.back().height));
-    transitionImageLayout(textures.back().image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    std::vector<std::future<void>> decodes;
+    //the workers write into the locals above and the staging buffer, so every one of them must finish before
+    //this function returns, even when creating the images or recording the uploads throws
+    struct DecodeWaiter {
+        std::vector<std::future<void>>& decodes;
+        ~DecodeWaiter() {
+            for (std::future<void>& decode : decodes) {
+                if (decode.valid()) decode.wait();
+            }
+        }
+    } decodeWaiter{decodes};
+    decodes.reserve(sources.size());
+    for (size_t i = 0; i < sources.size(); i++) {
+        decodes.emplace_back(ThreadPool::shared().submit([&sources, &headers, &levelOffsets, stagingData, i]() {
+            if (headers[i].cooked) {
+                const std::vector<std::vector<unsigned char>>& levels = headers[i].cooked->levels;
+                for (size_t level = 0; level < levels.size(); level++) {
+                    memcpy(stagingData + levelOffsets[i][level], levels[level].data(), levels[level].size());
+                }
+                return;
+            }
+            int width, height, numChannels;
+            stbi_uc* pixels = sources[i].decode(&width, &height, &numChannels, headers[i].format.channels);
+            if (!pixels) {
+                throw TextureLoaderException("failed to decode texture: " + sources[i].name());
+            }
+            if (width != headers[i].width || height != headers[i].height) {
+                stbi_image_free(pixels);
+                throw TextureLoaderException("decoded size doesn't match the header of texture: " + sources[i].name());
+            }
+            memcpy(stagingData + levelOffsets[i][0], pixels, static_cast<size_t>(width) * height * headers[i].format.channels);
+            stbi_image_free(pixels);
+        }));
+    }
 
-    vkDestroyBuffer(deviceBundle.logicalDevice.handle(), textures.back().stagingBuffer, nullptr);
-    vkFreeMemory(deviceBundle.logicalDevice.handle(), textures.back().stagingBufferMemory, nullptr);
+    //the images are created while the workers decode
+    const size_t firstTexture = textures.size();
+    for (const ImageHeader& header : headers) {
+        addTexture(header.width, header.height, header.numChannels, header.format, header.cooked ? static_cast<uint32_t>(header.cooked->levels.size()) : 0);
+    }
 
-    textures.back().createImageView();
-    textures.back().createSampler();
-    mInstanceCount++;
-}
+    //decoded images are uploaded in groups as soon as they are ready, so the GPU copies overlap the remaining decodes.
+    std::vector<std::pair<VkCommandBuffer, VkFence>> submissions;
+    std::vector<StagedTexture> group;
+    VkDeviceSize groupBytes = 0;
+    std::exception_ptr failure = nullptr;
+    for (size_t i = 0; i < sources.size(); i++) {
+        try {
+            decodes[i].get();
+            if (failure) {
+                continue; //keep waiting, the remaining workers still write into the staging buffer
+            }
+            group.push_back(StagedTexture{firstTexture + i, levelOffsets[i]});
+            groupBytes += stagedBytes[i];
+            if (groupBytes >= UPLOAD_GROUP_BYTES || i + 1 == sources.size()) {
+                VkCommandBuffer commandBuffer = beginUploadCommands();
+                recordStagedCopies(commandBuffer, stagingBuffer, group);
+                submissions.emplace_back(commandBuffer, submitUploadCommands(commandBuffer));
+                group.clear();
+                groupBytes = 0;
+            }
+        }
+        catch (...) {
+            if (!failure) failure = std::current_exception();
+        }
+    }
 
-void TextureLoader::createDebugTexture() {
-    if (commandPool == VK_NULL_HANDLE) {
-        throw TextureLoaderException("TextureLoader::setup() must be called with a valid command pool, before creating texture images.");
+    for (const std::pair<VkCommandBuffer, VkFence>& submission : submissions) {
+        finishUploadCommands(submission.first, submission.second);
     }
+    vkUnmapMemory(deviceBundle.logicalDevice.handle(), stagingBufferMemory);
+    vkDestroyBuffer(deviceBundle.logicalDevice.handle(), stagingBuffer, nullptr);
+    vkFreeMemory(deviceBundle.logicalDevice.handle(), stagingBufferMemory, nullptr);
 
-    textures.emplace_back(Texture(deviceBundle.logicalDevice.handle()));
+    if (failure) {
+        for (size_t i = firstTexture; i < textures.size(); i++) {
+            textures[i].destroy();
+        }
+        mInstanceCount -= static_cast<uint32_t>(textures.size() - firstTexture);
+        textures.erase(textures.begin() + firstTexture, textures.end());
+        streamSources.erase(streamSources.begin() + firstTexture, streamSources.end());
+        std::rethrow_exception(failure);
+    }
+
+    //remember where every texture was read from, so its levels can be read again after they are evicted
+    for (size_t i = 0; i < sources.size(); i++) {
+        const Texture& texture = textures[firstTexture + i];
+        std::shared_ptr<StreamSource> source = std::make_shared<StreamSource>();
+        source->cooked = headers[i].cooked != nullptr;
+        if (sources[i].path) {
+            source->path = source->cooked ? cooked_source_path(*sources[i].path) : *sources[i].path;
+        }
+        else {
+            source->encoded = std::make_shared<const EncodedImage>(*sources[i].encoded);
+        }
+        source->width = texture.width;
+        source->height = texture.height;
+        source->mipLevels = texture.mipLevels;
+        streamSources[firstTexture + i] = source;
+        residency.addTexture(firstTexture + i, levelByteSizes(texture.format, texture.width, texture.height, texture.mipLevels));
+    }
+}
+
+void TextureLoader::createDebugTexture() {
     int height = 2, width = 2, channels = 4;
-    stbi_uc* pixels = new unsigned char[height * width * channels]; //height, width, channel number
+    std::vector<stbi_uc> pixels(height * width * channels); //height, width, channel number
     for (int i = 0; i < height * width * channels;) {
         //purple
         pixels[i++] = 255;
@@ -179,80 +543,503 @@ void TextureLoader::createDebugTexture() {
         pixels[i++] = 255;
         pixels[i++] = 255;
     }
+    createTextureFromPixels(pixels.data(), width, height, STBI_rgb_alpha);
+}
+
+void TextureLoader::createTextureFromPixels(const unsigned char* pixels, int width, int height, int numChannels) {
+    if (commandPool == VK_NULL_HANDLE) {
+        throw TextureLoaderException( "TextureLoader::setup() must be called with a valid command pool, before creating texture images.");
+    }
+    if (textures.size() == capacity()) {
+        throw TextureLoaderException("TextureLoader::createTexture has created the maximum amount of textures for the texture table,"
+            " including the debug texture at location 0. Without bindless texture support the table holds TextureLoader::TEXTURE_ARRAY_SIZE textures.");
+    }
+    size_t imageSize = static_cast<size_t>(width) * height * STBI_rgb_alpha;
+    TextureFormat format = selectFormat(STBI_rgb_alpha, TextureUsage::COLOR);
+    pendingUploads.push_back(PendingUpload{addTexture(width, height, numChannels, format), std::vector<unsigned char>(pixels, pixels + imageSize)});
+}
+
+size_t TextureLoader::addTexture(int width, int height, int numChannels, const TextureFormat& format, uint32_t mipLevels) {
+    textures.emplace_back(Texture(deviceBundle.logicalDevice.handle()));
     textures.back().width = width;
     textures.back().height = height;
-    textures.back().numTextureChannels = STBI_rgb_alpha;
-    VkDeviceSize imageSize = (VkDeviceSize)textures.back().width * textures.back().height * STBI_rgb_alpha;
+    textures.back().numTextureChannels = numChannels;
+    textures.back().format = format;
+    if (mipLevels == 0) {
+        mipLevels = supportsMipGeneration(format.format) ? Texture::fullMipLevelCount(width, height) : 1;
+    }
+    textures.back().mipLevels = mipLevels;
+    textures.back().createImage(deviceBundle);
+    textures.back().createImageView();
+    textures.back().sampler = samplerCache.getSampler(Texture::initVkSamplerCreateInfo());
+    streamSources.push_back(nullptr);
+    mInstanceCount++;
+    return textures.size() - 1;
+}
 
-    createBuffer(
-        imageSize,
-        VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-        textures.back().stagingBuffer,
-        textures.back().stagingBufferMemory);
+bool TextureLoader::supportsMipGeneration(VkFormat format) {
+    //mips are blitted with linear filtering, which not every device supports for every format
+    const VkFormatFeatureFlags required = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+    return (getFormatFeatures(format) & required) == required;
+}
 
-    void* data;
-    vkMapMemory(deviceBundle.logicalDevice.handle(), textures.back().stagingBufferMemory, 0, imageSize, 0, &data);
-    memcpy(data, pixels, static_cast<size_t>(imageSize));
-    vkUnmapMemory(deviceBundle.logicalDevice.handle(), textures.back().stagingBufferMemory);
+VkFormatFeatureFlags TextureLoader::getFormatFeatures(VkFormat format) {
+    std::map<VkFormat, VkFormatFeatureFlags>::const_iterator finder = formatFeatures.find(format);
+    if (finder != formatFeatures.end()) {
+        return finder->second;
+    }
+    VkFormatProperties properties;
+    vkGetPhysicalDeviceFormatProperties(deviceBundle.physicalDevice.handle(), format, &properties);
+    formatFeatures[format] = properties.optimalTilingFeatures;
+    return properties.optimalTilingFeatures;
+}
+
+TextureFormat TextureLoader::selectFormat(int numChannels, TextureUsage usage) {
+    //a format storing more channels than the source can hold it too, stb fills the extra channels on decode.
+    //Three channel and sRGB one or two channel formats are optional, so those are the usual fallbacks.
+    const VkFormatFeatureFlags required = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+    for (int channels = std::max(numChannels, 1); channels < 4; channels++) {
+        TextureFormat candidate = TextureFormat::fromChannels(channels, usage);
+        if ((getFormatFeatures(candidate.format) & required) == required) {
+            return candidate;
+        }
+    }
+    return TextureFormat::fromChannels(4, usage);
+}
+
+TextureFormat TextureFormat::fromBlockCompressed(VkFormat format) {
+    TextureFormat result;
+    result.format = format;
+    result.channels = 0;
+    if (format == VK_FORMAT_BC4_UNORM_BLOCK) {
+        result.components = fromChannels(1, TextureUsage::DATA).components;
+    }
+    else if (format == VK_FORMAT_BC5_UNORM_BLOCK) {
+        result.components = fromChannels(2, TextureUsage::DATA).components;
+    }
+    return result;
+}
+
+std::shared_ptr<CookedTexture> TextureLoader::loadCookedTexture(const ImageSource& source) {
+    if (!source.path) {
+        return nullptr;
+    }
+    const std::string& path = *source.path;
+    const bool isCooked = is_cooked_path(path);
+    if (!isCooked && !has_current_cooked_texture(path)) {
+        return nullptr;
+    }
+
+    //a cache that can't be used falls back to decoding its source, only a cooked file given directly must load
+    std::shared_ptr<CookedTexture> cooked;
+    try {
+        cooked = std::make_shared<CookedTexture>(read_ktx2(cooked_source_path(path)));
+    }
+    catch (const std::runtime_error& e) {
+        if (isCooked) {
+            throw TextureLoaderException(e.what());
+        }
+        cerr << e.what() << ", decoding " << path << " instead" << endl;
+        return nullptr;
+    }
+    if (!(getFormatFeatures(cooked->format) & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT)) {
+        if (isCooked) {
+            throw TextureLoaderException("the device can't sample the block compressed texture: " + path);
+        }
+        return nullptr;
+    }
+    return cooked;
+}
+
+TextureFormat TextureFormat::fromChannels(int channels, TextureUsage usage) {
+    const bool srgb = usage == TextureUsage::COLOR;
+    TextureFormat result;
+    result.channels = channels;
+    switch (channels) {
+    case 1:
+        //grey, read as opaque grey
+        result.format = srgb ? VK_FORMAT_R8_SRGB : VK_FORMAT_R8_UNORM;
+        result.components = {VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_ONE};
+        break;
+    case 2:
+        //grey and alpha
+        result.format = srgb ? VK_FORMAT_R8G8_SRGB : VK_FORMAT_R8G8_UNORM;
+        result.components = {VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_G};
+        break;
+    case 3:
+        //alpha is missing from the format, so it reads as 1
+        result.format = srgb ? VK_FORMAT_R8G8B8_SRGB : VK_FORMAT_R8G8B8_UNORM;
+        break;
+    default:
+        result.channels = 4;
+        result.format = srgb ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM;
+        break;
+    }
+    return result;
+}
+
+uint32_t Texture::fullMipLevelCount(int width, int height) {
+    uint32_t levels = 1;
+    for (int size = std::max(width, height); size > 1; size /= 2) {
+        levels++;
+    }
+    return levels;
+}
+
+VkDeviceSize TextureLoader::copyAlignment(const TextureFormat& format) {
+    //copies must start on a whole block, or on a multiple of both the texel size and 4 bytes
+    if (bc_block_bytes(format.format) != 0) {
+        return bc_block_bytes(format.format);
+    }
+    return format.channels == 3 ? 12 : 4;
+}
+
+std::vector<uint64_t> TextureLoader::levelByteSizes(const TextureFormat& format, int width, int height, uint32_t mipLevels) {
+    std::vector<uint64_t> sizes(mipLevels);
+    for (uint32_t level = 0; level < mipLevels; level++) {
+        const uint32_t levelWidth = std::max(static_cast<uint32_t>(width) >> level, 1u);
+        const uint32_t levelHeight = std::max(static_cast<uint32_t>(height) >> level, 1u);
+        if (bc_block_bytes(format.format) != 0) {
+            sizes[level] = bc_level_bytes(format.format, levelWidth, levelHeight);
+        }
+        else {
+            sizes[level] = static_cast<uint64_t>(levelWidth) * levelHeight * format.channels;
+        }
+    }
+    return sizes;
+}
+
+std::vector<std::vector<unsigned char>> TextureLoader::readLevels(const StreamSource& source, const TextureFormat& format, uint32_t firstLevel, uint32_t endLevel) {
+    std::vector<std::vector<unsigned char>> levels;
+    if (source.cooked) {
+        CookedTexture cooked = read_ktx2(source.path);
+        if (cooked.format != format.format || cooked.levels.size() < endLevel) {
+            throw TextureLoaderException("cooked texture changed since it was uploaded: " + source.path);
+        }
+        levels.assign(std::make_move_iterator(cooked.levels.begin() + firstLevel), std::make_move_iterator(cooked.levels.begin() + endLevel));
+        return levels;
+    }
+
+    ImageSource image;
+    image.path = source.encoded ? nullptr : &source.path;
+    image.encoded = source.encoded.get();
+    int width, height, numChannels;
+    stbi_uc* pixels = image.decode(&width, &height, &numChannels, format.channels);
+    if (!pixels) {
+        throw TextureLoaderException("failed to decode texture: " + image.name());
+    }
+    if (width != source.width || height != source.height) {
+        stbi_image_free(pixels);
+        throw TextureLoaderException("texture changed since it was uploaded: " + image.name());
+    }
+    std::vector<unsigned char> level(pixels, pixels + static_cast<size_t>(width) * height * format.channels);
     stbi_image_free(pixels);
 
-    textures.back().createImage(deviceBundle);
-    transitionImageLayout(textures.back().image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-    copyBufferToImage(textures.back().stagingBuffer, textures.back().image, static_cast<uint32_t>(textures.back().width), static_cast<uint32_t>(textures.back().height));
-    transitionImageLayout(textures.back().image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    //the levels the upload generated with blits are downsampled on the CPU instead
+    const bool srgb = format.format == TextureFormat::fromChannels(format.channels, TextureUsage::COLOR).format;
+    for (uint32_t i = 0; i < endLevel; i++) {
+        if (i >= firstLevel) {
+            levels.push_back(level);
+        }
+        if (i + 1 < endLevel) {
+            level = downsample_texels(level, std::max(static_cast<uint32_t>(width) >> i, 1u), std::max(static_cast<uint32_t>(height) >> i, 1u), format.channels, srgb);
+        }
+    }
+    return levels;
+}
 
-    vkDestroyBuffer(deviceBundle.logicalDevice.handle(), textures.back().stagingBuffer, nullptr);
-    vkFreeMemory(deviceBundle.logicalDevice.handle(), textures.back().stagingBufferMemory, nullptr);
+void TextureLoader::requestTexture(uint32_t index, float screenPixels) {
+    if (index >= streamSources.size() || !streamSources[index]) {
+        return;
+    }
+    const StreamSource& source = *streamSources[index];
+    residency.markUsed(index, TextureResidency::mipForScreenSize(source.width, source.height, screenPixels));
+}
 
-    textures.back().createImageView();
-    textures.back().createSampler();
-    mInstanceCount++;
+bool TextureLoader::updateResidency() {
+    //evictions are swapped in right away, levels to load are read on the thread pool first
+    std::vector<ResidencySwap> swaps;
+    for (const TextureResidency::Change& change : residency.endFrame()) {
+        const Texture& texture = textures[change.texture];
+        if (change.baseMip > texture.baseMip) {
+            swaps.push_back(ResidencySwap{change.texture, change.baseMip, {}});
+            continue;
+        }
+        std::shared_ptr<const StreamSource> source = streamSources[change.texture];
+        const TextureFormat format = texture.format;
+        const uint32_t firstLevel = change.baseMip;
+        const uint32_t endLevel = texture.baseMip;
+        std::shared_ptr<std::vector<std::vector<unsigned char>>> levels = std::make_shared<std::vector<std::vector<unsigned char>>>();
+        std::shared_future<void> done = ThreadPool::shared().submit([source, format, firstLevel, endLevel, levels]() {
+            *levels = readLevels(*source, format, firstLevel, endLevel);
+        }).share();
+        levelLoads.push_back(LevelLoad{change.texture, change.baseMip, levels, done});
+    }
+
+    for (size_t i = 0; i < levelLoads.size();) {
+        LevelLoad& load = levelLoads[i];
+        if (load.done.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+            i++;
+            continue;
+        }
+        try {
+            load.done.get();
+            swaps.push_back(ResidencySwap{load.textureIndex, load.baseMip, std::move(*load.levels)});
+        }
+        catch (const std::exception& e) {
+            //stop streaming the texture, keeping whichever levels are resident
+            cerr << "failed to stream texture " << load.textureIndex << ": " << e.what() << endl;
+            residency.addTexture(load.textureIndex, {});
+            streamSources[load.textureIndex] = nullptr;
+        }
+        levelLoads.erase(levelLoads.begin() + i);
+    }
+    if (swaps.empty()) {
+        return false;
+    }
+
+    //frames in flight keep reading the old images, which are retired until every table is refreshed
+    swapResidentLevels(swaps);
+
+    for (const ResidencySwap& swap : swaps) {
+        residency.setResident(swap.textureIndex, swap.baseMip);
+        //textures past writtenDescriptorCount are written by the next updateDescriptorTable()
+        if (swap.textureIndex >= writtenDescriptorCount) {
+            continue;
+        }
+        for (std::vector<size_t>& stale : staleEntries) {
+            if (std::find(stale.begin(), stale.end(), swap.textureIndex) == stale.end()) {
+                stale.push_back(swap.textureIndex);
+            }
+        }
+    }
+    return true;
+}
+
+bool TextureLoader::refreshTable(size_t table) {
+    std::vector<size_t>& stale = staleEntries[table];
+    const bool written = !stale.empty();
+    if (written) {
+        writeDescriptors(table, stale);
+        stale.clear();
+    }
+    //the frames which last bound this table have finished, so none of them still read a retired image
+    for (RetiredTextures& swap : retired) {
+        swap.pendingTables[table] = false;
+    }
+    releaseRetired(false);
+    return written;
+}
+
+void TextureLoader::releaseRetired(bool deviceIdle) {
+    for (size_t i = 0; i < retired.size();) {
+        RetiredTextures& swap = retired[i];
+        const bool referenced = std::find(swap.pendingTables.begin(), swap.pendingTables.end(), true) != swap.pendingTables.end();
+        if (!deviceIdle && (referenced || vkGetFenceStatus(deviceBundle.logicalDevice.handle(), swap.uploadFence) != VK_SUCCESS)) {
+            i++;
+            continue;
+        }
+        finishUploadCommands(swap.commandBuffer, swap.uploadFence);
+        if (swap.stagingBuffer != VK_NULL_HANDLE) {
+            vkDestroyBuffer(deviceBundle.logicalDevice.handle(), swap.stagingBuffer, nullptr);
+            vkFreeMemory(deviceBundle.logicalDevice.handle(), swap.stagingBufferMemory, nullptr);
+        }
+        for (Texture& old : swap.textures) {
+            old.destroy();
+        }
+        retired.erase(retired.begin() + i);
+    }
+}
+
+void TextureLoader::swapResidentLevels(std::vector<ResidencySwap>& swaps) {
+    //loaded levels share one staging buffer, the levels already resident are copied between images
+    std::vector<Texture> oldTextures;
+    std::vector<StagedTexture> staged;
+    VkDeviceSize stagingSize = 0;
+    for (ResidencySwap& swap : swaps) {
+        Texture& texture = textures[swap.textureIndex];
+        const StreamSource& source = *streamSources[swap.textureIndex];
+        oldTextures.push_back(texture);
+
+        texture.baseMip = swap.baseMip;
+        texture.image = VK_NULL_HANDLE;
+        texture.imageView = VK_NULL_HANDLE;
+        texture.allocation = VK_NULL_HANDLE;
+        if (swap.baseMip >= source.mipLevels) {
+            texture.mipLevels = 0;
+            staged.push_back(StagedTexture{swap.textureIndex, {}});
+            continue;
+        }
+        texture.width = std::max(source.width >> swap.baseMip, 1);
+        texture.height = std::max(source.height >> swap.baseMip, 1);
+        texture.mipLevels = source.mipLevels - swap.baseMip;
+        texture.createImage(deviceBundle);
+        texture.createImageView();
+
+        const VkDeviceSize alignment = copyAlignment(texture.format);
+        std::vector<VkDeviceSize> levelOffsets;
+        for (const std::vector<unsigned char>& level : swap.levels) {
+            stagingSize = (stagingSize + alignment - 1) / alignment * alignment;
+            levelOffsets.push_back(stagingSize);
+            stagingSize += level.size();
+        }
+        staged.push_back(StagedTexture{swap.textureIndex, levelOffsets});
+    }
+
+    VkBuffer stagingBuffer = VK_NULL_HANDLE;
+    VkDeviceMemory stagingBufferMemory = VK_NULL_HANDLE;
+    if (stagingSize != 0) {
+        createBuffer(
+            stagingSize,
+            VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            stagingBuffer,
+            stagingBufferMemory);
+        void* data;
+        vkMapMemory(deviceBundle.logicalDevice.handle(), stagingBufferMemory, 0, stagingSize, 0, &data);
+        for (size_t i = 0; i < swaps.size(); i++) {
+            for (size_t level = 0; level < swaps[i].levels.size(); level++) {
+                memcpy(static_cast<unsigned char*>(data) + staged[i].levelOffsets[level], swaps[i].levels[level].data(), swaps[i].levels[level].size());
+            }
+        }
+        vkUnmapMemory(deviceBundle.logicalDevice.handle(), stagingBufferMemory);
+    }
+
+    std::vector<ImageLevels> newImages;
+    std::vector<ImageLevels> keptLevels;
+    for (size_t i = 0; i < swaps.size(); i++) {
+        const Texture& texture = textures[swaps[i].textureIndex];
+        const Texture& old = oldTextures[i];
+        if (texture.image != VK_NULL_HANDLE) {
+            newImages.push_back(ImageLevels{texture.image, 0, texture.mipLevels});
+        }
+        const uint32_t firstKept = std::max(texture.baseMip, old.baseMip);
+        if (texture.image != VK_NULL_HANDLE && old.image != VK_NULL_HANDLE && firstKept - old.baseMip < old.mipLevels) {
+            keptLevels.push_back(ImageLevels{old.image, firstKept - old.baseMip, old.mipLevels - (firstKept - old.baseMip)});
+        }
+    }
+
+    VkCommandBuffer commandBuffer = beginUploadCommands();
+    recordLayoutTransitions(commandBuffer, newImages, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+    recordLayoutTransitions(commandBuffer, keptLevels, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+    for (size_t i = 0; i < swaps.size(); i++) {
+        const Texture& texture = textures[swaps[i].textureIndex];
+        const Texture& old = oldTextures[i];
+        if (texture.image == VK_NULL_HANDLE) {
+            continue;
+        }
+        //loaded levels are the new image's first levels
+        for (uint32_t level = 0; level < staged[i].levelOffsets.size(); level++) {
+            VkBufferImageCopy region{};
+            region.bufferOffset = staged[i].levelOffsets[level];
+            region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1 };
+            region.imageOffset = { 0,0,0 };
+            region.imageExtent = { std::max(static_cast<uint32_t>(texture.width) >> level, 1u), std::max(static_cast<uint32_t>(texture.height) >> level, 1u), 1 };
+            vkCmdCopyBufferToImage(commandBuffer, stagingBuffer, texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+        }
+        //the rest were resident in the old image
+        if (old.image == VK_NULL_HANDLE) {
+            continue;
+        }
+        for (uint32_t fullLevel = std::max(texture.baseMip, old.baseMip); fullLevel < old.baseMip + old.mipLevels; fullLevel++) {
+            const uint32_t srcLevel = fullLevel - old.baseMip;
+            const uint32_t dstLevel = fullLevel - texture.baseMip;
+            VkImageCopy region{};
+            region.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, srcLevel, 0, 1 };
+            region.srcOffset = { 0,0,0 };
+            region.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, dstLevel, 0, 1 };
+            region.dstOffset = { 0,0,0 };
+            region.extent = { std::max(static_cast<uint32_t>(texture.width) >> dstLevel, 1u), std::max(static_cast<uint32_t>(texture.height) >> dstLevel, 1u), 1 };
+            vkCmdCopyImage(commandBuffer,
+                old.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                1, &region);
+        }
+    }
+    recordLayoutTransitions(commandBuffer, newImages, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+    //the upload is queued behind the frames in flight, which its barriers wait for. Nothing here waits on it.
+    RetiredTextures swapped;
+    swapped.textures = std::move(oldTextures);
+    swapped.stagingBuffer = stagingBuffer;
+    swapped.stagingBufferMemory = stagingBufferMemory;
+    swapped.commandBuffer = commandBuffer;
+    swapped.uploadFence = submitUploadCommands(commandBuffer);
+    swapped.pendingTables.assign(descriptorSets.size(), true);
+    retired.push_back(std::move(swapped));
+}
+
+void TextureLoader::writeDescriptors(size_t table, const std::vector<size_t>& indices) {
+    std::vector<VkDescriptorImageInfo> infos = getDescriptorImageInfos();
+    std::vector<VkWriteDescriptorSet> writes;
+    for (size_t index : indices) {
+        if (index >= writtenDescriptorCount || index >= infos.size()) {
+            continue;
+        }
+        VkWriteDescriptorSet write{};
+        write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write.dstSet = descriptorSets[table];
+        write.dstBinding = 0;
+        write.dstArrayElement = static_cast<uint32_t>(index);
+        write.descriptorCount = 1;
+        write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        write.pImageInfo = &infos[index];
+        writes.push_back(write);
+    }
+    vkUpdateDescriptorSets(deviceBundle.logicalDevice.handle(), static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
 }
 
 void TextureLoader::setup(VkCommandPool commandPool){
     this->commandPool = commandPool;
+    bindless = deviceBundle.physicalDevice.supportsBindlessTextures();
     //Consider using a fallback texture, like this transparent image. Or bright solid white, depending on the background.
     createDebugTexture();
 }
 
 void TextureLoader::cleanup(){
-    
+    pendingUploads.clear();
+    //loads still running only hold their own sources and results
+    levelLoads.clear();
+    streamSources.clear();
+    residency = TextureResidency(residency.getBudget());
+    releaseRetired(true);
+    vkDestroyDescriptorPool(deviceBundle.logicalDevice.handle(), descriptorPool, nullptr);
+    vkDestroyDescriptorSetLayout(deviceBundle.logicalDevice.handle(), descriptorSetLayout, nullptr);
+    descriptorPool = VK_NULL_HANDLE;
+    descriptorSetLayout = VK_NULL_HANDLE;
+    descriptorSets.clear();
+    staleEntries.clear();
+    writtenDescriptorCount = 0;
     
     //free texture data
-    for (auto tex : textures) {
-        vkDestroySampler(tex.device, tex.sampler, nullptr);
-        //free the texture image view, must be done before freeing the image itself
-        vkDestroyImageView(tex.device, tex.imageView, nullptr);
-        //free the texture image
-        vkDestroyImage(tex.device, tex.image, nullptr);
-        vkFreeMemory(tex.device, tex.imageMemory, nullptr);
+    for (Texture& tex : textures) {
+        tex.destroy();
     }
+    samplerCache.destroy();
 }
 
 Texture::~Texture(){
     
 }
 
+void Texture::destroy(){
+    //free the texture image view, must be done before freeing the image itself
+    vkDestroyImageView(device, imageView, nullptr);
+    //free the texture image along with its allocation
+    vmaDestroyImage(allocator, image, allocation);
+}
+
 void Texture::createImage(VulkanDeviceBundle deviceBundle) {
     VkImageCreateInfo info = initVkImageCreateInfo();
-    if (VK_SUCCESS != vkCreateImage(deviceBundle.logicalDevice.handle(), &info, nullptr, &image)) {
+    //suballocated from the device's shared allocator, so textures count toward the same memory statistics as buffers
+    VmaAllocationCreateInfo allocInfo = {};
+    allocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+
+    allocator = VmaHost::getAllocator(deviceBundle);
+    if (VK_SUCCESS != vmaCreateImage(allocator, &info, &allocInfo, &image, &allocation, nullptr)) {
         cerr << "failed to create texture image" << endl;
         exit(1);
     }
-    
-    VkMemoryRequirements memRequirements;
-    vkGetImageMemoryRequirements(deviceBundle.logicalDevice.handle(), image, &memRequirements);
-    VkMemoryAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize = memRequirements.size;
-    allocInfo.memoryTypeIndex = findMemoryType(deviceBundle, memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-    if (VK_SUCCESS != vkAllocateMemory(deviceBundle.logicalDevice.handle(), &allocInfo, nullptr, &imageMemory)) {
-        cerr << "failed to allocate image memory" << endl;
-        exit(1);
-    }
-
-    vkBindImageMemory(deviceBundle.logicalDevice.handle(), image, imageMemory, 0);
 }
 
 //takes a created image (from createImage) and creates an image view from it
@@ -261,10 +1048,11 @@ void Texture::createImageView(){
     imageViewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
     imageViewInfo.image = image;
     imageViewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-    imageViewInfo.format = VK_FORMAT_R8G8B8A8_SRGB;
+    imageViewInfo.format = format.format;
+    imageViewInfo.components = format.components;
     imageViewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
     imageViewInfo.subresourceRange.baseMipLevel = 0;
-    imageViewInfo.subresourceRange.levelCount = 1;
+    imageViewInfo.subresourceRange.levelCount = mipLevels;
     imageViewInfo.subresourceRange.baseArrayLayer = 0;
     imageViewInfo.subresourceRange.layerCount = 1;
 
@@ -274,13 +1062,13 @@ void Texture::createImageView(){
     }
 }
 
-//for now, use a pretty generic sampler for all textures. Can overload to provide more options, and potentially move a set of common
-//samplers into the TextureLoader class.
-void Texture::createSampler(){
+//for now, use a pretty generic sampler for all textures. Textures needing other sampler states can look them up in
+//the TextureLoader's sampler cache.
+VkSamplerCreateInfo Texture::initVkSamplerCreateInfo(){
     VkSamplerCreateInfo samplerInfo{};
     samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
     samplerInfo.magFilter = VK_FILTER_NEAREST; //No filtering. Other option is VK_FILTER_LINEAR for bilinear filtering
-    samplerInfo.minFilter = VK_FILTER_NEAREST; //No filtering, Other option is VK_FILTER_LINEAR for anisotropic filtering
+    samplerInfo.minFilter = VK_FILTER_LINEAR; //Bilinear filtering within each mip level when minified
     samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
     samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
     samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
@@ -299,15 +1087,50 @@ void Texture::createSampler(){
     samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
     samplerInfo.mipLodBias = 0.0f;
     samplerInfo.minLod = 0.0f;
-    samplerInfo.maxLod = 0.0f;
-    
-    if (VK_SUCCESS != vkCreateSampler(device, &samplerInfo, nullptr, &sampler)) {
-        cerr << "failed to create texture sampler" << endl;
-        exit(1);
+    //sampling is already limited to the levels in each texture's image view
+    samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+    return samplerInfo;
+}
+
+void TextureLoader::uploadPendingTextures(){
+    if (pendingUploads.empty()) {
+        return;
+    }
+
+    //every texture gets its own range of one staging buffer. Offsets are kept texel aligned for vkCmdCopyBufferToImage.
+    std::vector<StagedTexture> staged(pendingUploads.size());
+    VkDeviceSize stagingSize = 0;
+    for (size_t i = 0; i < pendingUploads.size(); i++) {
+        staged[i] = StagedTexture{pendingUploads[i].textureIndex, {stagingSize}};
+        stagingSize += (pendingUploads[i].pixels.size() + STBI_rgb_alpha - 1) / STBI_rgb_alpha * STBI_rgb_alpha;
+    }
+
+    VkBuffer stagingBuffer;
+    VkDeviceMemory stagingBufferMemory;
+    createBuffer(
+        stagingSize,
+        VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        stagingBuffer,
+        stagingBufferMemory);
+
+    void* data;
+    vkMapMemory(deviceBundle.logicalDevice.handle(), stagingBufferMemory, 0, stagingSize, 0, &data);
+    for (size_t i = 0; i < pendingUploads.size(); i++) {
+        memcpy(static_cast<unsigned char*>(data) + staged[i].levelOffsets[0], pendingUploads[i].pixels.data(), pendingUploads[i].pixels.size());
     }
+    vkUnmapMemory(deviceBundle.logicalDevice.handle(), stagingBufferMemory);
+
+    VkCommandBuffer commandBuffer = beginUploadCommands();
+    recordStagedCopies(commandBuffer, stagingBuffer, staged);
+    finishUploadCommands(commandBuffer, submitUploadCommands(commandBuffer));
+
+    vkDestroyBuffer(deviceBundle.logicalDevice.handle(), stagingBuffer, nullptr);
+    vkFreeMemory(deviceBundle.logicalDevice.handle(), stagingBufferMemory, nullptr);
+    pendingUploads.clear();
 }
 
-VkCommandBuffer TextureLoader::beginSingleTimeCommands(){
+VkCommandBuffer TextureLoader::beginUploadCommands(){
     VkCommandBufferAllocateInfo allocInfo{};
     allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
     allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
@@ -315,61 +1138,138 @@ VkCommandBuffer TextureLoader::beginSingleTimeCommands(){
     allocInfo.commandBufferCount = 1;
 
     VkCommandBuffer commandBuffer;
-    vkAllocateCommandBuffers(deviceBundle.logicalDevice.handle(), &allocInfo, &commandBuffer);
+    if (VK_SUCCESS != vkAllocateCommandBuffers(deviceBundle.logicalDevice.handle(), &allocInfo, &commandBuffer)) {
+        throw TextureLoaderException("failed to allocate texture upload command buffer");
+    }
 
     VkCommandBufferBeginInfo beginInfo{};
     beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
     beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-
     vkBeginCommandBuffer(commandBuffer, &beginInfo);
 
     return commandBuffer;
 }
 
-void TextureLoader::endSingleTimeCommands(VkCommandBuffer commandBuffer){
+void TextureLoader::recordStagedCopies(VkCommandBuffer commandBuffer, VkBuffer stagingBuffer, const std::vector<StagedTexture>& staged){
+    std::vector<ImageLevels> allLevels;
+    std::vector<ImageLevels> copiedOnly;
+    std::vector<StagedTexture> generated;
+    uint32_t maxMipLevels = 1;
+    for (const StagedTexture& stagedTexture : staged) {
+        const Texture& texture = textures[stagedTexture.textureIndex];
+        allLevels.push_back(ImageLevels{texture.image, 0, texture.mipLevels});
+        if (stagedTexture.levelOffsets.size() < texture.mipLevels) {
+            generated.push_back(stagedTexture);
+            maxMipLevels = std::max(maxMipLevels, texture.mipLevels);
+        }
+        else {
+            copiedOnly.push_back(ImageLevels{texture.image, 0, texture.mipLevels});
+        }
+    }
+    recordLayoutTransitions(commandBuffer, allLevels, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+
+    for (const StagedTexture& stagedTexture : staged) {
+        const Texture& texture = textures[stagedTexture.textureIndex];
+        for (uint32_t level = 0; level < stagedTexture.levelOffsets.size(); level++) {
+            VkBufferImageCopy region{};
+            region.bufferOffset = stagedTexture.levelOffsets[level];
+            region.bufferRowLength = 0;
+            region.bufferImageHeight = 0;
+            region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            region.imageSubresource.mipLevel = level;
+            region.imageSubresource.baseArrayLayer = 0;
+            region.imageSubresource.layerCount = 1;
+            region.imageOffset = { 0,0,0 };
+            region.imageExtent = { std::max(static_cast<uint32_t>(texture.width) >> level, 1u), std::max(static_cast<uint32_t>(texture.height) >> level, 1u), 1 };
+
+            vkCmdCopyBufferToImage(commandBuffer, stagingBuffer, texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+        }
+    }
+    //textures which had every level staged, such as cooked ones, are done
+    recordLayoutTransitions(commandBuffer, copiedOnly, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+    //generate the remaining mip chains level by level, so the barriers of all textures are batched per level.
+    //Each level is downsampled from the previous one, which then becomes readable by shaders.
+    for (uint32_t level = 1; level < maxMipLevels; level++) {
+        std::vector<ImageLevels> sources;
+        for (const StagedTexture& stagedTexture : generated) {
+            const Texture& texture = textures[stagedTexture.textureIndex];
+            if (level < texture.mipLevels) {
+                sources.push_back(ImageLevels{texture.image, level - 1, 1});
+            }
+        }
+        recordLayoutTransitions(commandBuffer, sources, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+
+        for (const StagedTexture& stagedTexture : generated) {
+            const Texture& texture = textures[stagedTexture.textureIndex];
+            if (level >= texture.mipLevels) {
+                continue;
+            }
+            int32_t srcWidth = std::max(texture.width >> (level - 1), 1);
+            int32_t srcHeight = std::max(texture.height >> (level - 1), 1);
+            VkImageBlit blit{};
+            blit.srcOffsets[0] = { 0, 0, 0 };
+            blit.srcOffsets[1] = { srcWidth, srcHeight, 1 };
+            blit.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level - 1, 0, 1 };
+            blit.dstOffsets[0] = { 0, 0, 0 };
+            blit.dstOffsets[1] = { std::max(srcWidth / 2, 1), std::max(srcHeight / 2, 1), 1 };
+            blit.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1 };
+
+            vkCmdBlitImage(commandBuffer,
+                texture.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                1, &blit, VK_FILTER_LINEAR);
+        }
+
+        recordLayoutTransitions(commandBuffer, sources, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    }
+
+    //the last level of each generated chain was only written to
+    std::vector<ImageLevels> lastLevels;
+    for (const StagedTexture& stagedTexture : generated) {
+        const Texture& texture = textures[stagedTexture.textureIndex];
+        lastLevels.push_back(ImageLevels{texture.image, texture.mipLevels - 1, 1});
+    }
+    recordLayoutTransitions(commandBuffer, lastLevels, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+}
+
+VkFence TextureLoader::submitUploadCommands(VkCommandBuffer commandBuffer){
     vkEndCommandBuffer(commandBuffer);
 
+    VkFenceCreateInfo fenceInfo{};
+    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    VkFence uploadFence;
+    if (VK_SUCCESS != vkCreateFence(deviceBundle.logicalDevice.handle(), &fenceInfo, nullptr, &uploadFence)) {
+        throw TextureLoaderException("failed to create texture upload fence");
+    }
+
     VkSubmitInfo submitInfo{};
     submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
     submitInfo.commandBufferCount = 1;
     submitInfo.pCommandBuffers = &commandBuffer;
-    vkQueueSubmit(deviceBundle.logicalDevice.getGraphicsQueue(), 1, &submitInfo, VK_NULL_HANDLE);
-    vkQueueWaitIdle(deviceBundle.logicalDevice.getGraphicsQueue());
-
-    vkFreeCommandBuffers(deviceBundle.logicalDevice.handle(), commandPool, 1, &commandBuffer);
+    if (VK_SUCCESS != vkQueueSubmit(deviceBundle.logicalDevice.getGraphicsQueue(), 1, &submitInfo, uploadFence)) {
+        throw TextureLoaderException("failed to submit texture uploads");
+    }
+    return uploadFence;
 }
 
-void TextureLoader::copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height){
-    VkCommandBuffer commandBuffer = beginSingleTimeCommands();
-    VkBufferImageCopy region{};
-    region.bufferOffset = 0;
-    region.bufferRowLength = 0;
-    region.bufferImageHeight = 0;
-    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    region.imageSubresource.mipLevel = 0;
-    region.imageSubresource.baseArrayLayer = 0;
-    region.imageSubresource.layerCount = 1;
-    region.imageOffset = { 0,0,0 };
-    region.imageExtent = { width, height, 1 };
-
-    vkCmdCopyBufferToImage(commandBuffer, buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
-
-    endSingleTimeCommands(commandBuffer);
+void TextureLoader::finishUploadCommands(VkCommandBuffer commandBuffer, VkFence uploadFence){
+    vkWaitForFences(deviceBundle.logicalDevice.handle(), 1, &uploadFence, VK_TRUE, UINT64_MAX);
+    vkDestroyFence(deviceBundle.logicalDevice.handle(), uploadFence, nullptr);
+    vkFreeCommandBuffers(deviceBundle.logicalDevice.handle(), commandPool, 1, &commandBuffer);
 }
 
-void TextureLoader::transitionImageLayout(VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout){
-    VkCommandBuffer commandBuffer = beginSingleTimeCommands();
-    
+void TextureLoader::recordLayoutTransitions(VkCommandBuffer commandBuffer, const std::vector<ImageLevels>& images, VkImageLayout oldLayout, VkImageLayout newLayout){
+    if (images.empty()) {
+        return;
+    }
     VkImageMemoryBarrier barrier{};
     barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER; //pipeline barrier
     barrier.oldLayout = oldLayout;
     barrier.newLayout = newLayout;
     barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
     barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    barrier.image = image;
     barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    barrier.subresourceRange.baseMipLevel = 0;
-    barrier.subresourceRange.levelCount = 1;
     barrier.subresourceRange.baseArrayLayer = 0;
     barrier.subresourceRange.layerCount = 1;
 
@@ -383,6 +1283,21 @@ void TextureLoader::transitionImageLayout(VkImage image, VkImageLayout oldLayout
         sourceStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
         destinationStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
     }
+    else if (oldLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL && newLayout == VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL) {
+        //a level was written by a copy or blit, and is now read by the blit to the next level
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+        sourceStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+        destinationStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+    }
+    else if (oldLayout == VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL && newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) {
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+        sourceStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+        destinationStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+    }
     else if (oldLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL && newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) {
         barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
         barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
@@ -390,20 +1305,34 @@ void TextureLoader::transitionImageLayout(VkImage image, VkImageLayout oldLayout
         sourceStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
         destinationStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
     }
+    else if (oldLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL && newLayout == VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL) {
+        //levels kept by streaming are copied out of a texture's old image
+        barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+        sourceStage = VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+        destinationStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+    }
     else {
         throw std::invalid_argument("unsupported layout transition!");
     }
 
+    //one barrier per image, all issued by a single pipeline barrier command
+    std::vector<VkImageMemoryBarrier> barriers(images.size(), barrier);
+    for (size_t i = 0; i < images.size(); i++) {
+        barriers[i].image = images[i].image;
+        barriers[i].subresourceRange.baseMipLevel = images[i].baseMipLevel;
+        barriers[i].subresourceRange.levelCount = images[i].levelCount;
+    }
+
     vkCmdPipelineBarrier(
         commandBuffer,
         sourceStage, destinationStage,
         0,
         0, nullptr,
         0, nullptr,
-        1, &barrier
+        static_cast<uint32_t>(barriers.size()), barriers.data()
     );
-
-    endSingleTimeCommands(commandBuffer);
 }
 
 VkImageCreateInfo Texture::initVkImageCreateInfo() {
@@ -413,13 +1342,14 @@ VkImageCreateInfo Texture::initVkImageCreateInfo() {
     imageInfo.extent.width = static_cast<uint32_t>(width);
     imageInfo.extent.height = static_cast<uint32_t>(height);
     imageInfo.extent.depth = 1;
-    imageInfo.mipLevels = 1;
+    imageInfo.mipLevels = mipLevels;
     imageInfo.arrayLayers = 1;
-    imageInfo.format = VK_FORMAT_R8G8B8A8_SRGB;
+    imageInfo.format = format.format;
     imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
     imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
     imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    //each mip level is blitted from the previous one, so the image is also a transfer source
+    imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
     imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
     return imageInfo;
 }
@@ -10,6 +10,12 @@
 #include <map>
 #include <exception>
 #include "vkutils/vkutils.h"
+#include "vkutils/SamplerCache.h"
+#include "cook_texture.h"
+#include "TextureResidency.h"
+#include <future>
+#include <tuple>
+#include <vk_mem_alloc.h>
 //vulkan types
 #include <vulkan/vulkan.h>
 //stb_image.h
@@ -18,32 +24,73 @@
 
 class TextureLoaderException : public std::exception {
 	public:
-    TextureLoaderException(const std::string& msg) : msg(msg){}
+    TextureLoaderException(const std::string& msg) : msg(msg), whatstr(msg){}
     virtual const char* what() const noexcept override {return(whatstr.c_str());}
 
     const std::string msg;
  protected:
     const std::string whatstr;
 };
-class Texture { //TODO add support for mipmapping
+/// What a texture's values mean, which decides between sRGB and UNORM formats.
+enum class TextureUsage {
+	COLOR, //sRGB encoded colors, such as base color or emissive maps
+	DATA   //linear values, such as normal, roughness or mask maps
+};
+
+/// An image file's encoded bytes (PNG, JPEG, ...) which haven't been decoded yet.
+/// Produced by loaders which defer decoding, such as load_gltf_to_vulkan().
+struct EncodedImage {
+	std::string name;
+	std::vector<unsigned char> bytes;
+	TextureUsage usage = TextureUsage::COLOR;
+};
+
+/// A format able to hold a texture, along with how its channels reach shaders.
+struct TextureFormat {
+	VkFormat format = VK_FORMAT_R8G8B8A8_SRGB;
+	//bytes per texel, which is also the channel count images are decoded to. 0 for block compressed formats.
+	int channels = 4;
+	//expands one and two channel formats, so shaders always sample grey as rgb and the second channel as alpha
+	VkComponentMapping components = {VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY};
+
+	//the 8 bit format storing 'channels' channels, with sRGB encoding for color textures
+	static TextureFormat fromChannels(int channels, TextureUsage usage);
+	//a BC format written by the texture cook, swizzled like the uncompressed format with the same channels
+	static TextureFormat fromBlockCompressed(VkFormat format);
+};
+
+class Texture {
 public:
 	VkDevice device;
 	int width = 0;
 	int height = 0;
 	int numTextureChannels = 0;
-	VkBuffer stagingBuffer;
-	VkDeviceMemory stagingBufferMemory;
+	//may store fewer channels than RGBA, in which case the view's swizzle fills the rest
+	TextureFormat format;
+	//levels in the image's mip chain, all generated from level 0 during upload
+	uint32_t mipLevels = 1;
+	//levels of the full mip chain dropped by texture streaming. width, height and mipLevels describe the resident levels,
+	//and a texture evicted completely has no image.
+	uint32_t baseMip = 0;
 	VkImage image;
 	VkImageView imageView;
-	VkDeviceMemory imageMemory;
+	//suballocation of the image's memory, owned by 'allocator'
+	VmaAllocator allocator;
+	VmaAllocation allocation;
+	//shared with every texture sampled the same way. Owned by the TextureLoader's sampler cache.
 	VkSampler sampler;
-	Texture() : device(VK_NULL_HANDLE), stagingBuffer(VK_NULL_HANDLE), stagingBufferMemory(VK_NULL_HANDLE), image(VK_NULL_HANDLE), imageMemory(VK_NULL_HANDLE), imageView(VK_NULL_HANDLE), sampler(VK_NULL_HANDLE) {};
-	Texture(VkDevice device) : device(device), stagingBuffer(VK_NULL_HANDLE), stagingBufferMemory(VK_NULL_HANDLE), image(VK_NULL_HANDLE), imageMemory(VK_NULL_HANDLE), imageView(VK_NULL_HANDLE), sampler(VK_NULL_HANDLE) {};
+	Texture() : device(VK_NULL_HANDLE), image(VK_NULL_HANDLE), imageView(VK_NULL_HANDLE), allocator(VK_NULL_HANDLE), allocation(VK_NULL_HANDLE), sampler(VK_NULL_HANDLE) {};
+	Texture(VkDevice device) : device(device), image(VK_NULL_HANDLE), imageView(VK_NULL_HANDLE), allocator(VK_NULL_HANDLE), allocation(VK_NULL_HANDLE), sampler(VK_NULL_HANDLE) {};
 	~Texture();
+	//destroys the view and image, and frees the image's allocation. The sampler is left to its cache.
+	void destroy();
 	void createImage(VulkanDeviceBundle deviceBundle);
 	void createImageView();
-	void createSampler();
 	VkImageCreateInfo initVkImageCreateInfo();
+	//a pretty generic sampler: trilinear, repeating, and not clamped to any texture's mip count so all textures can share it
+	static VkSamplerCreateInfo initVkSamplerCreateInfo();
+	//levels needed to reduce a width x height image down to 1x1
+	static uint32_t fullMipLevelCount(int width, int height);
 };
 
 class TextureLoader
@@ -53,13 +100,78 @@ public:
 	TextureLoader();
 	~TextureLoader();
 	
+	//size of the texture table on devices without bindless texture support
 	static const int TEXTURE_ARRAY_SIZE = 16;
-	//given a textureName mnemonic, and a path to an image file, constructs a VkImage, allocates device memory and staging buffer memory.
-	void createTexture(std::string imagePath);
+	//upper bound on the size of a bindless texture table
+	static const uint32_t BINDLESS_TEXTURE_CAPACITY = 4096;
+	//decoded bytes collected before createTextures() submits an upload
+	static const VkDeviceSize UPLOAD_GROUP_BYTES = 32 << 20;
+	//given a path to an image file, constructs a VkImage and allocates its device memory, and returns its table index.
+	//The image format keeps only the channels the file has, see selectFormat().
+	//A current cooked cache of the file (see cook_texture_file()) is uploaded instead when the device can sample it,
+	//and paths ending in ".ktx2" are always read as cooked textures.
+	//An image whose bytes match a texture created before with the same usage shares that texture, see getDedupStats().
+	uint32_t createTexture(std::string imagePath, TextureUsage usage = TextureUsage::COLOR);
+	//constructs a texture from an encoded image held in memory
+	uint32_t createTexture(const EncodedImage& image);
+	//constructs textures for all image files in order, returning the table index of each. Images are decoded on the
+	//shared thread pool and each worker copies its pixels into mapped staging memory, which is uploaded in groups
+	//while the remaining images are still decoding. Identical images are decoded and uploaded once, and share one index.
+	std::vector<uint32_t> createTextures(const std::vector<std::string>& imagePaths, TextureUsage usage = TextureUsage::COLOR);
+	//constructs textures for all encoded images in order, like createTextures(imagePaths). Each image has its own usage.
+	std::vector<uint32_t> createTextures(const std::vector<EncodedImage>& images);
+
+	//images which were identical to an existing texture and shared it, those which created a new texture,
+	//and the device memory the shared ones would have taken with all of their levels
+	struct DedupStats {
+		size_t hits = 0;
+		size_t misses = 0;
+		uint64_t savedBytes = 0;
+	};
+	const DedupStats& getDedupStats() const { return dedupStats; }
 	
 	
+	//uploads the pixels of every texture created since the last upload. All textures share one staging buffer,
+	//and their transitions and copies are recorded into one command buffer, submitted once and waited on with a fence.
+	void uploadPendingTextures();
+	size_t pendingUploadCount() const { return pendingUploads.size(); }
+
+	//creates 'tableCount' descriptor sets holding every texture, and writes the textures created so far. Each frame
+	//resource slot, such as a swapchain image, gets its own table so streaming can rewrite one while others are in use.
+	//With bindless support the tables are partially bound and update-after-bind, so textures can be added while they're in use.
+	//Otherwise each is a fixed array of TEXTURE_ARRAY_SIZE, padded with the debug texture.
+	void initDescriptorTable(size_t tableCount = 1);
+	//reallocates the tables when their count changes, writing every texture again. The device must be idle.
+	void setTableCount(size_t tableCount);
+	//uploads pending textures and writes every texture created since the last update into all tables.
+	//Without bindless support this waits for the device to go idle, and command buffers binding the tables must be re-recorded.
+	void updateDescriptorTable();
+	VkDescriptorSetLayout getDescriptorSetLayout() const { return descriptorSetLayout; }
+	VkDescriptorSet getDescriptorSet(size_t table = 0) const { return descriptorSets[table]; }
+	size_t tableCount() const { return descriptorSets.size(); }
+	bool isBindless() const { return bindless; }
+	//number of textures the table can hold. Shaders size their sampler array with this through specialization constant 0.
+	uint32_t capacity() const;
+
+	//budget in bytes for the levels of textures created from image files, 0 for no limit. When it's exceeded the most
+	//detailed levels of the least recently drawn textures are evicted. Evicted textures sample the debug texture instead.
+	void setResidencyBudget(uint64_t bytes) { residency.setBudget(bytes); }
+	const TextureResidency& getResidency() const { return residency; }
+	//records that the current frame draws texture 'index' covering about 'screenPixels' pixels, so the levels that
+	//sharp should be resident
+	void requestTexture(uint32_t index, float screenPixels);
+	//call once per frame while no frame is being recorded. Evicts levels over the budget, starts loading requested levels
+	//on the shared thread pool, and swaps in the levels that finished loading. Frames in flight keep reading the old
+	//images, so the swapped entries are only written into each table by refreshTable(). Returns true if anything was swapped.
+	bool updateResidency();
+	//writes the entries swapped since table 'table' was last refreshed. Call before submitting a frame binding the table,
+	//once the frames which last used it have finished. Old images are destroyed once every table stopped referring to them.
+	//Returns true if the table was written, which requires re-recording command buffers binding it when it isn't bindless.
+	bool refreshTable(size_t table);
+
 	const Texture* getTexture(uint32_t index) const;
-	std::array<VkDescriptorImageInfo, TEXTURE_ARRAY_SIZE> getDescriptorImageInfos();
+	//textures which aren't resident are replaced by the debug texture
+	std::vector<VkDescriptorImageInfo> getDescriptorImageInfos();
 	std::vector<VkDescriptorSetLayoutBinding> getDescriptorSetLayoutBindings(int bindingNum) const; 
 	void createDebugTexture();
 	void setup(VkCommandPool commandPool);
@@ -68,12 +180,89 @@ public:
 private:
 	VulkanDeviceBundle deviceBundle; //TODO provide functions to update device bundle, if necessary in the future
 	VkCommandPool commandPool = VK_NULL_HANDLE; //TODO provide functions to update command pool, if necessary in the future
-	//this sampler will be used for all texture images/imageviews. Adding custom samplers for different textures could be done by giving each texture a unique sampler, or making this a vector of samplers.
-	
+	//samplers for all texture images/imageviews, one per distinct sampler state
+	SamplerCache samplerCache;
 	
 	uint32_t mInstanceCount = 0;
 	std::vector<Texture> textures;
 
+	bool bindless = false;
+	VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+	VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+	std::vector<VkDescriptorSet> descriptorSets;
+	//textures already written into every table
+	size_t writtenDescriptorCount = 0;
+	//entries of each table swapped by streaming which the table doesn't refer to yet
+	std::vector<std::vector<size_t>> staleEntries;
+
+	//pixels of a texture waiting for uploadPendingTextures()
+	struct PendingUpload {
+		size_t textureIndex;
+		std::vector<unsigned char> pixels;
+	};
+	std::vector<PendingUpload> pendingUploads;
+
+	//a texture whose first levels are in a staging buffer. Levels past those are generated by blits.
+	struct StagedTexture {
+		size_t textureIndex;
+		std::vector<VkDeviceSize> levelOffsets;
+	};
+	struct ImageSource;
+	//mip levels [baseMipLevel, baseMipLevel + levelCount) of an image
+	struct ImageLevels {
+		VkImage image;
+		uint32_t baseMipLevel;
+		uint32_t levelCount;
+	};
+	//optimal tiling features of every format queried so far
+	std::map<VkFormat, VkFormatFeatureFlags> formatFeatures;
+
+	//textures created from image bytes, keyed by the hash and size of the encoded bytes and the usage
+	typedef std::tuple<uint64_t, uint64_t, TextureUsage> ContentKey;
+	std::map<ContentKey, uint32_t> contentIndices;
+	DedupStats dedupStats;
+
+	//where a texture's levels can be read again after they are evicted. Textures created from pixels have none.
+	struct StreamSource {
+		std::string path;
+		bool cooked = false;
+		std::shared_ptr<const EncodedImage> encoded;
+		//size of the full mip chain
+		int width = 0;
+		int height = 0;
+		uint32_t mipLevels = 0;
+	};
+	//indexed like textures
+	std::vector<std::shared_ptr<StreamSource>> streamSources;
+	TextureResidency residency;
+	//levels [baseMip, current base) of a texture being read on the thread pool
+	struct LevelLoad {
+		size_t textureIndex;
+		uint32_t baseMip;
+		std::shared_ptr<std::vector<std::vector<unsigned char>>> levels;
+		//shared so the loader stays copyable
+		std::shared_future<void> done;
+	};
+	std::vector<LevelLoad> levelLoads;
+	//a texture whose resident levels become those from 'baseMip' on. 'levels' holds the ones that weren't resident.
+	struct ResidencySwap {
+		size_t textureIndex;
+		uint32_t baseMip;
+		std::vector<std::vector<unsigned char>> levels;
+	};
+	//images replaced by one swap, with the upload copying out of them. Destroyed by releaseRetired() once the upload
+	//finished and every table has been refreshed, since a frame reading them must have finished before its table is.
+	struct RetiredTextures {
+		std::vector<Texture> textures;
+		VkBuffer stagingBuffer = VK_NULL_HANDLE;
+		VkDeviceMemory stagingBufferMemory = VK_NULL_HANDLE;
+		VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+		VkFence uploadFence = VK_NULL_HANDLE;
+		//tables which haven't been refreshed since the swap
+		std::vector<bool> pendingTables;
+	};
+	std::vector<RetiredTextures> retired;
+
 	//texture data, held in a map and accessed by a user-provided string mnemonic
 	
 	//used to synchronize data with MultiUniformBuffer
@@ -81,12 +270,50 @@ private:
 
 
 	//private helper functions
+	//constructs a VkImage for 'pixels', which must be width*height RGBA texels, and queues the pixels for upload.
+	//The format is picked at runtime by selectFormat() from the four channels and color usage, like decoded files.
+	void createTextureFromPixels(const unsigned char* pixels, int width, int height, int numChannels);
+	//hashes the encoded bytes of 'source', reading the whole file for paths
+	static ContentKey contentKey(const ImageSource& source);
+	//creates textures for the sources which don't match an existing texture or an earlier source, and returns
+	//the table index of every source
+	std::vector<uint32_t> createTexturesByContent(const std::vector<ImageSource>& sources);
+	void createTexturesPipelined(const std::vector<ImageSource>& sources);
+	//constructs an image and view for a texture with undefined contents, looks up its sampler, and returns its index.
+	//A 'mipLevels' of 0 gives the texture a full mip chain when it can be generated.
+	size_t addTexture(int width, int height, int numChannels, const TextureFormat& format, uint32_t mipLevels = 0);
+	//offsets of copies into an image of 'format' must be multiples of this
+	static VkDeviceSize copyAlignment(const TextureFormat& format);
+	static std::vector<uint64_t> levelByteSizes(const TextureFormat& format, int width, int height, uint32_t mipLevels);
+	//reads levels [firstLevel, endLevel) of the full mip chain of 'source' stored as 'format'
+	static std::vector<std::vector<unsigned char>> readLevels(const StreamSource& source, const TextureFormat& format, uint32_t firstLevel, uint32_t endLevel);
+	//replaces the image of every swapped texture by one holding its new resident levels. Levels resident before and
+	//after are copied on the device by an upload which isn't waited on. The old images are moved to 'retired'.
+	void swapResidentLevels(std::vector<ResidencySwap>& swaps);
+	//rewrites the entries of 'indices' in table 'table'
+	void writeDescriptors(size_t table, const std::vector<size_t>& indices);
+	//(re)creates the pool holding 'tableCount' tables and writes every texture into them
+	void allocateTables(size_t tableCount);
+	//destroys retired images which are no longer read, or all of them once the device is idle
+	void releaseRetired(bool deviceIdle);
+	//reads the cooked texture to upload for 'source', or returns nullptr to decode the source instead
+	std::shared_ptr<CookedTexture> loadCookedTexture(const ImageSource& source);
+	//the narrowest format holding an image with 'numChannels' source channels which the device can sample.
+	//Falls back to wider formats, ending at RGBA8 which every device supports.
+	TextureFormat selectFormat(int numChannels, TextureUsage usage);
+	VkFormatFeatureFlags getFormatFeatures(VkFormat format);
 	void createBuffer(VkDeviceSize size, VkBufferUsageFlags bufferUsage, VkMemoryPropertyFlags propertyFlags, VkBuffer& buffer, VkDeviceMemory& bufferMemory);
-	VkCommandBuffer beginSingleTimeCommands();
-	void endSingleTimeCommands(VkCommandBuffer commandBuffer);
-	void copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height);
-	//consider learning about and using vkutils::QueueClosure();
-	void transitionImageLayout(VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout);
+	VkCommandBuffer beginUploadCommands();
+	//records the transitions and copies uploading every staged texture, followed by the blits generating their mips
+	void recordStagedCopies(VkCommandBuffer commandBuffer, VkBuffer stagingBuffer, const std::vector<StagedTexture>& staged);
+	//ends and submits the command buffer, returning a fence signaled once it completes
+	VkFence submitUploadCommands(VkCommandBuffer commandBuffer);
+	//waits for the fence, then frees it along with the command buffer
+	void finishUploadCommands(VkCommandBuffer commandBuffer, VkFence uploadFence);
+	//records a barrier moving the given levels of every image from oldLayout to newLayout
+	void recordLayoutTransitions(VkCommandBuffer commandBuffer, const std::vector<ImageLevels>& images, VkImageLayout oldLayout, VkImageLayout newLayout);
+	//true if images of 'format' can be blitted with linear filtering, which mip generation relies on
+	bool supportsMipGeneration(VkFormat format);
 	
 };
 
@@ -8,9 +8,14 @@
 #include "load_obj.h"
 #include "load_gltf.h"
 #include "load_texture.h"
+#include "cook_texture.h"
+#include "vkutils/VmaHost.h"
 #include "MatrixStack.h"
 #include "Timer.h"
 
+#include <algorithm>
+#include <cctype>
+#include <cmath>
 #include <filesystem>
 #include <iostream>
 #include <limits>
@@ -60,12 +65,22 @@ vector<MatrixNode> createVectorOfMatrixNodes(int size, vector<glm::vec3> boxes)
 class Application : public VulkanGraphicsApp
 {
  public:
+    Application() = default;
+    explicit Application(PresentationMode aMode) : VulkanGraphicsApp(aMode) {}
+
     void init();
     void run();
     void updateView(float frametime);
     void updatePerspective();
     void cleanup();
 
+    /// Animation time in seconds. Advances at a fixed 60 frames per second when headless so runs are repeatable.
+    double getTime() const {return(isHeadless() ? getFrameNumber() / 60.0 : glfwGetTime());}
+    /// Number of frames to render before exiting when running headless.
+    size_t mHeadlessFrameCount = 1000;
+    /// Read per-shape data from storage buffers indexed by instance instead of binding dynamic uniforms per shape.
+    bool mInstanceStorage = false;
+
     //updates shading based on key holds
     void observeCurrentShadingLayer();
     //records the original shading.
@@ -78,6 +93,8 @@ class Application : public VulkanGraphicsApp
     void loadShapeFilesFromPath(string path);
     void initGeometry();
     void addMultiShapeObjects();
+    /// Add a grid of CROWD_SIZE * CROWD_SIZE copies of 'aObject' drawn with one instanced draw per shape
+    void addCrowd(const ObjMultiShapeGeometry& aObject);
     void initShaders();
     void initUniforms();
     void initHierarchies();
@@ -87,15 +104,29 @@ class Application : public VulkanGraphicsApp
     void shooterLegRender(shared_ptr<MatrixStack> Model, bool isRight);
     shared_ptr<MatrixStack> rHandAnchor = make_shared<MatrixStack>();
     void render(double dt);
+    /// Tell the texture loader which textures this frame draws, and how large they appear on screen.
+    void requestDrawnTextures();
     inline void setModel(int index, shared_ptr<MatrixStack> Model);
     //names of the loaded shapefiles.
     std::vector<string> mObjectNames;
+    //encoded images of each loaded glTF file, indexed like its model.images. Uploaded by initGltfTextures().
+    std::unordered_map<std::string, std::vector<EncodedImage>> mGltfImages;
+    //texture table index of each of a glTF file's images. The debug texture's index 0 stands in for images that couldn't be found.
+    std::unordered_map<std::string, std::vector<uint32_t>> mGltfTextures;
+    //decode and upload the images collected in mGltfImages, once textureLoader is able to create textures.
+    void initGltfTextures();
     //holds the original state of each of the object's shading layer
     std::unordered_map<std::string, vector<ShadingLayer>> mKeyCallbackHolds;
     
     //used to describe a user-defined hierarchy of a multishape object.
     std::unordered_map<std::string, vector<MatrixNode>> mObjectHierarchies;
 
+    /// Copies of the bunny along each side of the crowd added with '--instanced'
+    const static size_t CROWD_SIZE = 8;
+    /// Uniform data of the crowd, ordered by shape and then instance
+    vector<UniformTransformDataPtr> mCrowdTransforms;
+    vector<UniformAnimShadeDataPtr> mCrowdAnimShade;
+
     /// An wrapped instance of struct WorldInfo made available automatically as uniform data in our shaders.
     UniformWorldInfoPtr mWorldInfo = nullptr;
 
@@ -281,9 +312,78 @@ void Application::keyCallback(GLFWwindow* aWindow, int key, int scancode, int ac
 }
 
 
-int main(){
-    Application app;
+/// Pass '--headless [frame count]' to render offscreen without a window, e.g. for benchmarking.
+/// Pass '--instanced' to use storage buffer instance data and the debug_instanced shaders, and add a crowd of instanced bunnies.
+/// Pass '--cook <images>' or '--cook-data <images>' to write block compressed caches of color or data images
+/// alongside them and exit. The texture loader uploads those caches instead of decoding the images.
+/// Pass '--texture-budget <MiB>' to keep the mip levels of loaded textures within that much device memory.
+/// Pass '--cull' to record commands every frame, drawing only the shapes within the view frustum.
+/// Pass '--parallel-record' to record commands every frame, split across worker threads.
+/// Pass '--gpu-cull' with '--instanced' to cull every instance against the view frustum in a compute pass.
+/// Pass '--occlusion' with '--instanced' to also cull instances hidden behind the depth drawn first. Implies '--gpu-cull'.
+/// Pass '--cpu-occlusion' to also skip shapes hidden behind the others, rasterized on the CPU. Implies '--cull'.
+int main(int argc, char** argv){
+    bool headless = false;
+    bool instanced = false;
+    size_t headlessFrameCount = 0;
+    uint64_t textureBudget = 0;
+    bool cull = false;
+    bool parallelRecord = false;
+    bool gpuCull = false;
+    bool occlusion = false;
+    bool cpuOcclusion = false;
+    std::vector<std::pair<std::string, bool>> cookJobs; // Image path and whether it holds sRGB color
+    for(int i = 1; i < argc; ++i){
+        std::string arg(argv[i]);
+        if(arg == "--cook" || arg == "--cook-data"){
+            while(i + 1 < argc && std::string(argv[i + 1]).rfind("--", 0) != 0){
+                cookJobs.emplace_back(argv[++i], arg == "--cook");
+            }
+        }else if(arg == "--headless"){
+            headless = true;
+            if(i + 1 < argc && std::isdigit(argv[i + 1][0])){
+                headlessFrameCount = std::stoul(argv[++i]);
+            }
+        }else if(arg == "--instanced"){
+            instanced = true;
+        }else if(arg == "--texture-budget" && i + 1 < argc){
+            textureBudget = std::stoull(argv[++i]) << 20;
+        }else if(arg == "--cull"){
+            cull = true;
+        }else if(arg == "--parallel-record"){
+            parallelRecord = true;
+        }else if(arg == "--gpu-cull"){
+            gpuCull = true;
+        }else if(arg == "--occlusion"){
+            gpuCull = true;
+            occlusion = true;
+        }else if(arg == "--cpu-occlusion"){
+            cull = true;
+            cpuOcclusion = true;
+        }
+    }
+
+    if(!cookJobs.empty()){
+        for(const std::pair<std::string, bool>& job : cookJobs){
+            std::string cookedPath = cooked_texture_path(job.first);
+            cook_texture_file(job.first, cookedPath, job.second);
+            std::cout << "Cooked " << cookedPath << std::endl;
+        }
+        return(0);
+    }
+
+    Application app(headless ? VulkanGraphicsApp::PresentationMode::HEADLESS : VulkanGraphicsApp::PresentationMode::WINDOWED);
+    if(headlessFrameCount > 0){
+        app.mHeadlessFrameCount = headlessFrameCount;
+    }
+    app.mInstanceStorage = instanced;
+    app.setFrustumCulling(cull);
+    app.setParallelRecording(parallelRecord);
+    app.setGpuCulling(gpuCull);
+    app.setOcclusionCulling(occlusion);
+    app.setOcclusionRasterizing(cpuOcclusion);
     app.init();
+    app.textureLoader.setResidencyBudget(textureBudget);
     app.run();
     app.cleanup();
 
@@ -341,9 +441,11 @@ void Application::initHierarchies() {
 void Application::init(){
 
     // Set glfw callbacks
-    glfwSetWindowSizeCallback(getWindowPtr(), resizeCallback);
-    glfwSetScrollCallback(getWindowPtr(), scrollCallback);
-    glfwSetKeyCallback(getWindowPtr(), keyCallback);
+    if(!isHeadless()){
+        glfwSetWindowSizeCallback(getWindowPtr(), resizeCallback);
+        glfwSetScrollCallback(getWindowPtr(), scrollCallback);
+        glfwSetKeyCallback(getWindowPtr(), keyCallback);
+    }
 
     // Initialize uniform variables
     initUniforms();
@@ -356,17 +458,44 @@ void Application::init(){
 
     // Initialize graphics pipeline and render setup 
     VulkanGraphicsApp::init();
+
+    initGltfTextures();
+}
+
+void Application::initGltfTextures(){
+    for(const std::pair<const std::string, std::vector<EncodedImage>>& file : mGltfImages){
+        std::vector<EncodedImage> found;
+        for(const EncodedImage& image : file.second){
+            if(!image.bytes.empty()) found.push_back(image);
+        }
+        //images shared with files loaded by initTextures(), such as the Lantern's, reuse their textures
+        std::vector<uint32_t> indices = found.empty() ? std::vector<uint32_t>() : textureLoader.createTextures(found);
+        std::vector<uint32_t>& textures = mGltfTextures[file.first];
+        auto nextIndex = indices.begin();
+        for(const EncodedImage& image : file.second){
+            textures.push_back(image.bytes.empty() ? 0 : *nextIndex++);
+        }
+    }
+    //the encoded bytes are no longer needed once decoded
+    mGltfImages.clear();
+    commitTextures();
 }
 
 void Application::run(){
     FpsTimer globalRenderTimer(0);
+    size_t visibleShapeTotal = 0;
+    size_t culledShapeTotal = 0;
+    size_t occludedTotal = 0;
+    size_t occludedShapeTotal = 0;
 
     GLFWwindow* window = getWindowPtr();
 
-    // Run until the application is closed
-    while(!glfwWindowShouldClose(window)){
+    // Run until the application is closed, or the requested number of frames have been rendered when headless
+    while(isHeadless() ? getFrameNumber() < mHeadlessFrameCount : !glfwWindowShouldClose(window)){
         // Poll for window events, keyboard and mouse button presses, ect...
-        glfwPollEvents();
+        if(!isHeadless()){
+            glfwPollEvents();
+        }
         //set shading layers based on polled events
         observeCurrentShadingLayer();
         // Update view matrix
@@ -376,6 +505,10 @@ void Application::run(){
         globalRenderTimer.frameStart();
         render(globalRenderTimer.lastStepTime()*1e-6);
         globalRenderTimer.frameFinish();
+        visibleShapeTotal += getCullStats().mVisible;
+        culledShapeTotal += getCullStats().mCulled;
+        occludedTotal += getOcclusionStats().mOccluded;
+        occludedShapeTotal += getCullStats().mOccluded;
 
         // Adjust the viewport if window is resized
         if(smResizeFlag){
@@ -384,6 +517,27 @@ void Application::run(){
     }
 
     std::cout << "Average Performance: " << globalRenderTimer.getReportString() << std::endl;
+    const TextureLoader::DedupStats& textureStats = textureLoader.getDedupStats();
+    std::cout << "Texture dedup: " << textureStats.hits << " shared, " << textureStats.misses << " unique, "
+              << (textureStats.savedBytes >> 20) << " MiB saved" << std::endl;
+    // Textures and buffers are suballocated from the same allocator, so this covers both
+    VmaStats memoryStats;
+    vmaCalculateStats(VmaHost::getAllocator(getPrimaryDeviceBundle()), &memoryStats);
+    std::cout << "Device memory: " << memoryStats.total.allocationCount << " allocations in " << memoryStats.total.blockCount
+              << " blocks, " << (memoryStats.total.usedBytes >> 20) << " MiB used, " << (memoryStats.total.unusedBytes >> 20)
+              << " MiB unused" << std::endl;
+    if(isFrustumCulling() && getFrameNumber() > 0){
+        std::cout << "Frustum culling: " << static_cast<double>(visibleShapeTotal) / getFrameNumber() << " visible, "
+                  << static_cast<double>(culledShapeTotal) / getFrameNumber() << " culled shapes per frame" << std::endl;
+    }
+    if(isOcclusionRasterizing() && getFrameNumber() > 0){
+        std::cout << "Occlusion rasterizing: " << static_cast<double>(occludedShapeTotal) / getFrameNumber()
+                  << " of the culled shapes occluded per frame" << std::endl;
+    }
+    if(isOcclusionCulling() && getFrameNumber() > 0){
+        std::cout << "Occlusion culling: " << static_cast<double>(occludedTotal) / getFrameNumber() << " of "
+                  << getOcclusionStats().mInstances << " instances occluded per frame" << std::endl;
+    }
     
     // Make sure the GPU is done rendering before exiting. 
     vkDeviceWaitIdle(VulkanGraphicsApp::getPrimaryDeviceBundle().logicalDevice.handle());
@@ -396,9 +550,11 @@ void Application::updateView(float frametime){
     constexpr float thetaLimit = glm::radians(89.99f);
     static glm::dvec2 lastPos = glm::dvec2(std::numeric_limits<double>::quiet_NaN());
     
-    glm::dvec2 pos;
+    glm::dvec2 pos = glm::dvec2(0.0);
     
-    glfwGetCursorPos(getWindowPtr(), &pos.x, &pos.y);
+    if(!isHeadless()){
+        glfwGetCursorPos(getWindowPtr(), &pos.x, &pos.y);
+    }
     glm::vec2 delta = pos - lastPos;
     
     // If this is the first frame, set delta to zero. 
@@ -449,14 +605,14 @@ void Application::shooterLegRender(shared_ptr<MatrixStack> Model, bool isRight)
     Model->pushMatrix();
     glm::vec3 pivotRPelvis = mObjects["dummy"].BBoxCenters()[5 + offset];//getCenterOfBBox(dummy->at(5 + offset));
     Model->translate(pivotRPelvis);
-    Model->rotate(flip * 0.5 * cos(2 * glm::pi<double>() * glfwGetTime()), glm::vec3(0, 1, 0));
+    Model->rotate(flip * 0.5 * cos(2 * glm::pi<double>() * getTime()), glm::vec3(0, 1, 0));
     Model->translate(-pivotRPelvis);
     setModel(4 + offset, Model);
     setModel(5 + offset, Model);
     Model->pushMatrix();
     glm::vec3 pivotRKnee = mObjects["dummy"].BBoxCenters()[3 + offset];//getCenterOfBBox(dummy->at(3 + offset));
     Model->translate(pivotRKnee);
-    Model->rotate(flip * 0.25 * cos(2 * glm::pi<double>() * glfwGetTime()) + glm::pi<float>() / 8, glm::vec3(0, 1, 0));
+    Model->rotate(flip * 0.25 * cos(2 * glm::pi<double>() * getTime()) + glm::pi<float>() / 8, glm::vec3(0, 1, 0));
     Model->translate(-pivotRKnee);
     
     setModel(2 + offset, Model);
@@ -478,7 +634,7 @@ void Application::shooterRightArmRender(std::shared_ptr<MatrixStack> Model) {
     using namespace glm;
     int mirror = 1;
     int armIndex = 15;
-    float shoulderRot = cos(pi<double>() * glfwGetTime());
+    float shoulderRot = cos(pi<double>() * getTime());
     float elbowRot = cos(2 * pi<double>());
     Model->pushMatrix();
     vec3 pivotTorso = mObjects["dummy"].BBoxCenters()[14];
@@ -507,7 +663,7 @@ void Application::shooterRightArmRender(std::shared_ptr<MatrixStack> Model) {
     Model->pushMatrix();
     vec3 rWrist = mObjects["dummy"].BBoxCenters()[armIndex + 4]; //getCenterOfBBox(dummy->at(armIndex + 4));
     Model->translate(rWrist); //center of wrist
-    Model->rotate(-0.5 * pi<float>() / 2 * cos(pi<double>() * glfwGetTime()) + pi<float>() / 2, vec3(0, -1, 0));
+    Model->rotate(-0.5 * pi<float>() / 2 * cos(pi<double>() * getTime()) + pi<float>() / 2, vec3(0, -1, 0));
     
     Model->translate(-rWrist);
     Model->translate(mObjects["dummy"].BBoxCenters()[armIndex + 5]); //move the ctm to the hand
@@ -587,8 +743,8 @@ void Application::shooterRender(float frametime) {
     Model->pushMatrix();
     glm::vec3 pivotBelly = mObjects["dummy"].BBoxCenters()[13];//getCenterOfBBox(dummy->at(13));
     Model->translate(pivotBelly);
-    Model->rotate(0.5 * cos(glm::pi<double>() * glfwGetTime()), glm::vec3(0, 0, 1));
-    Model->rotate(0.2 * cos(glm::pi<double>() * glfwGetTime()), glm::vec3(0, 1, 0));
+    Model->rotate(0.5 * cos(glm::pi<double>() * getTime()), glm::vec3(0, 0, 1));
+    Model->rotate(0.2 * cos(glm::pi<double>() * getTime()), glm::vec3(0, 1, 0));
     Model->translate(-pivotBelly);
     
     setModel(14,Model);
@@ -600,8 +756,8 @@ void Application::shooterRender(float frametime) {
     Model->pushMatrix();
     glm::vec3 pivotNeck = mObjects["dummy"].BBoxCenters()[27];
     Model->translate(pivotNeck);
-    Model->rotate(0.5 * cos(glm::pi<double>() * glfwGetTime()), glm::vec3(0, 0, -1));
-    Model->rotate(0.2 * cos(glm::pi<double>() * glfwGetTime()), glm::vec3(0, -1, 0));
+    Model->rotate(0.5 * cos(glm::pi<double>() * getTime()), glm::vec3(0, 0, -1));
+    Model->rotate(0.2 * cos(glm::pi<double>() * getTime()), glm::vec3(0, -1, 0));
     Model->translate(-pivotNeck);
     
     for (size_t i = 27; i < mObjectTransforms["dummy"].size(); i++) {
@@ -613,6 +769,30 @@ void Application::shooterRender(float frametime) {
 }
 
 
+void Application::requestDrawnTextures(){
+    const glm::mat4& V = mWorldInfo->getStruct().View;
+    // Pixels covered by one unit at a distance of one unit
+    const float pixelsPerUnit = std::abs(mWorldInfo->getStruct().Perspective[1][1]) * 0.5f * static_cast<float>(getFramebufferSize().height);
+    auto requestShape = [&](const AnimShadeData& shade, const glm::mat4& M){
+        if(shade.shadingLayer != TEXTURE_MAP && shade.shadingLayer != TEXTURED_FLAT && shade.shadingLayer != TEXTURED_SHADED){
+            return;
+        }
+        // Shapes are assumed to span about two units before their model transform scales them
+        float scale = std::max({glm::length(glm::vec3(M[0])), glm::length(glm::vec3(M[1])), glm::length(glm::vec3(M[2]))});
+        float distance = std::max(-(V * M[3]).z, 0.01f);
+        // Texture 0 is the debug texture, which shaders index as textureIndex + 1
+        textureLoader.requestTexture(shade.textureIndex + 1, 2.0f * scale * pixelsPerUnit / distance);
+    };
+    for(const auto& object : mObjectAnimShade){
+        for(size_t i = 0; i < object.second.size(); ++i){
+            requestShape(object.second[i]->getStruct(), mObjectTransforms[object.first][i]->getStruct().Model);
+        }
+    }
+    for(size_t i = 0; i < mCrowdAnimShade.size(); ++i){
+        requestShape(mCrowdAnimShade[i]->getStruct(), mCrowdTransforms[i]->getStruct().Model);
+    }
+}
+
 inline void Application::setModel(int index, shared_ptr<MatrixStack> Model){
     mObjectTransforms["dummy"][index]->getStruct().Model = Model->topMatrix(); };
 
@@ -623,7 +803,7 @@ void Application::render(double dt){
     using glm::cos;
     using glm::vec3;
     // Global time
-    float gt = static_cast<float>(glfwGetTime());
+    float gt = static_cast<float>(getTime());
     
     //use this to set all transform data for all shapes in a given multi-shape object.
     auto setAllObjectTransformData = [this](string name, glm::mat4 M) {
@@ -658,6 +838,16 @@ void Application::render(double dt){
     setAllObjectTransformData("bunny", glm::rotate(-float(gt), vec3(0.0, 1.0, 0.0)) * glm::translate(radius * vec3(cos(angle * 1), .2f * sin(gt * 4.0f + angle * 1), sin(angle * 1))) * glm::rotate(2.0f * float(gt), vec3(0.0, 1.0, 0.0)));
     setAllObjectTransformData("teapot", glm::rotate(-float(gt), vec3(0.0, 1.0, 0.0)) * glm::translate(radius * vec3(cos(angle * 2), .2f * sin(gt * 4.0f + angle * 2), sin(angle * 2))) * glm::rotate(2.0f * float(gt), vec3(0.0, 1.0, 0.0)));
     
+    // Bob the crowd up and down in a grid behind the scene
+    for(size_t i = 0; i < mCrowdTransforms.size(); ++i){
+        size_t instance = i % (CROWD_SIZE * CROWD_SIZE);
+        float x = 2.0f * (float(instance % CROWD_SIZE) - 0.5f * float(CROWD_SIZE - 1));
+        float z = -10.0f - 2.0f * float(instance / CROWD_SIZE);
+        mCrowdTransforms[i]->getStruct().Model = glm::translate(vec3(x, -6.0f + 0.3f * sin(gt * 4.0f + float(instance)), z)) * glm::rotate(float(gt), vec3(0.0, 1.0, 0.0));
+    }
+    
+    requestDrawnTextures();
+    setCullingViewProjection(mWorldInfo->getStruct().Perspective * mWorldInfo->getStruct().View);
     // Tell the GPU to render a frame. 
     VulkanGraphicsApp::render(currentRenderPipeline);
 } 
@@ -706,7 +896,7 @@ void Application::loadShapeFilesFromPath(string dir) {
             if (isGLTF(entry.path())) {
                 cout << "loading .gltf file: " << entry.path() << endl;
                 //timer.start();
-                mObjects[filenameNoExt] = load_gltf_to_vulkan(getPrimaryDeviceBundle(), entry.path().string(), false);
+                mObjects[filenameNoExt] = load_gltf_to_vulkan(getPrimaryDeviceBundle(), entry.path().string(), false, &mGltfImages[filenameNoExt]);
                 //int ms = timer.stop();
                 //cout << "loading .gltf file took " << ms << " milliseconds." << endl;
                 mObjectNames.push_back(filenameNoExt);
@@ -714,7 +904,7 @@ void Application::loadShapeFilesFromPath(string dir) {
             else if (isGLB(entry.path())) {
                 cout << "loading .glb file: " << entry.path() << endl;
                 //timer.start();
-                mObjects[filenameNoExt] = load_gltf_to_vulkan(getPrimaryDeviceBundle(), entry.path().string(), true);
+                mObjects[filenameNoExt] = load_gltf_to_vulkan(getPrimaryDeviceBundle(), entry.path().string(), true, &mGltfImages[filenameNoExt]);
                 //int ms = timer.stop();
                 //cout << "loading .glb file took " << ms << " milliseconds." << endl;
                 mObjectNames.push_back(filenameNoExt);
@@ -785,6 +975,9 @@ void Application::initGeometry(){
 }
 
 void Application::addMultiShapeObjects() {
+    // The crowd takes its own copy of the bunny before the scene's copy is given descriptor set positions
+    const bool addsCrowd = mInstanceStorage && mObjects.count("bunny") > 0;
+    ObjMultiShapeGeometry crowdObject = addsCrowd ? mObjects["bunny"] : ObjMultiShapeGeometry();
     
     size_t totalShapesAdded = 0;
     size_t previousDescriptorSetPosition = 0;
@@ -803,6 +996,25 @@ void Application::addMultiShapeObjects() {
         //our insertion helper vector "sets" gets destroyed every loop, hence the +=.
         VulkanGraphicsApp::addMultiShapeObject(mObjects[name], sets);
     }
+
+    if(addsCrowd){
+        addCrowd(crowdObject);
+    }
+}
+
+void Application::addCrowd(const ObjMultiShapeGeometry& aObject){
+    const uint32_t instanceCount = static_cast<uint32_t>(CROWD_SIZE * CROWD_SIZE);
+    vector<UniformDataInterfaceSet> sets;
+    for(size_t shapeIdx = 0; shapeIdx < aObject.shapeCount(); ++shapeIdx){
+        for(uint32_t instance = 0; instance < instanceCount; ++instance){
+            mCrowdTransforms.emplace_back(UniformTransformData::create());
+            mCrowdAnimShade.emplace_back(UniformAnimShadeData::create());
+            // Neighbours use different textures, so a single draw samples several entries of the texture table
+            mCrowdAnimShade.back()->setStruct(AnimShadeData(TEXTURED_SHADED, instance % 3));
+            sets.push_back({{1, mCrowdTransforms.back()}, {2, mCrowdAnimShade.back()}});
+        }
+    }
+    VulkanGraphicsApp::addInstancedMultiShapeObject(aObject, instanceCount, sets);
 }
 
 /// Initialize our shaders
@@ -811,14 +1023,20 @@ void Application::initShaders(){
     VkDevice logicalDevice = VulkanGraphicsApp::getPrimaryDeviceBundle().logicalDevice;
 
     // Load the compiled shader code from disk. 
-    VkShaderModule vertShader = vkutils::load_shader_module(logicalDevice, STRIFY(SHADER_DIR) "/debug.vert.spv");
-    VkShaderModule fragShader = vkutils::load_shader_module(logicalDevice, STRIFY(SHADER_DIR) "/debug.frag.spv");
+    // The instanced shaders read per-shape data from storage buffers instead of dynamic uniforms
+    VkShaderModule vertShader = mInstanceStorage ? 
+        vkutils::load_shader_module(logicalDevice, STRIFY(SHADER_DIR) "/debug_instanced.vert.spv") :
+        vkutils::load_shader_module(logicalDevice, STRIFY(SHADER_DIR) "/debug.vert.spv");
+    // Instances index the texture table with their own texture, which a bindless table allows directly
+    bool nonUniformIndexing = VulkanGraphicsApp::getPrimaryDeviceBundle().physicalDevice.supportsBindlessTextures();
+    string fragShaderName = !mInstanceStorage ? "debug.frag" : nonUniformIndexing ? "debug_instanced_nonuniform.frag" : "debug_instanced.frag";
+    VkShaderModule fragShader = vkutils::load_shader_module(logicalDevice, STRIFY(SHADER_DIR) "/" + fragShaderName + ".spv");
     
     assert(vertShader != VK_NULL_HANDLE);
     assert(fragShader != VK_NULL_HANDLE);
 
-    VulkanGraphicsApp::setVertexShader("debug.vert", vertShader);
-    VulkanGraphicsApp::setFragmentShader("debug.frag", fragShader);
+    VulkanGraphicsApp::setVertexShader(mInstanceStorage ? "debug_instanced.vert" : "debug.vert", vertShader);
+    VulkanGraphicsApp::setFragmentShader(fragShaderName, fragShader);
 }
 
 
@@ -836,7 +1054,10 @@ void Application::initUniforms(){
         {2, UniformAnimShadeData::sGetLayout()} // Blinn-Phong data on binding point #2
     };
     
-    VulkanGraphicsApp::initMultis(mUniformLayoutSet);
+    VulkanGraphicsApp::initMultis(mUniformLayoutSet, mInstanceStorage ? 
+        MultiInstanceUniformBuffer::BufferMode::INSTANCE_STORAGE : 
+        MultiInstanceUniformBuffer::BufferMode::DYNAMIC_UNIFORM
+    );
     
     updateView(0);
     updatePerspective();
@@ -0,0 +1,110 @@
+#ifndef KJY_DEDUP_TABLE_H_
+#define KJY_DEDUP_TABLE_H_
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <functional>
+#include <utility>
+#include <vector>
+
+/// 64 bit finalizer from SplitMix64. Every input bit affects every output bit, so keys that differ
+/// only in a few low bits still land in unrelated slots.
+inline uint64_t hash_mix64(uint64_t aValue){
+    aValue ^= aValue >> 30;
+    aValue *= 0xbf58476d1ce4e5b9ULL;
+    aValue ^= aValue >> 27;
+    aValue *= 0x94d049bb133111ebULL;
+    aValue ^= aValue >> 31;
+    return(aValue);
+}
+
+/// Hash of a triple of 32 bit indices, e.g. the (position, normal, texcoord) indices of a vertex
+inline uint64_t hash_index_triple(uint32_t aA, uint32_t aB, uint32_t aC){
+    return(hash_mix64((static_cast<uint64_t>(aA) << 32 | aB) ^ hash_mix64(aC)));
+}
+
+/// Hash of 'aSize' bytes at 'aData', 8 bytes at a time, e.g. to find identical files. Not meant to resist
+/// deliberately colliding inputs.
+inline uint64_t hash_bytes(const void* aData, size_t aSize, uint64_t aSeed = 0){
+    const unsigned char* bytes = static_cast<const unsigned char*>(aData);
+    uint64_t hash = hash_mix64(aSeed ^ aSize);
+    size_t i = 0;
+    for(; i + sizeof(uint64_t) <= aSize; i += sizeof(uint64_t)){
+        uint64_t word;
+        std::memcpy(&word, bytes + i, sizeof(word));
+        hash = hash_mix64(hash ^ word);
+    }
+    uint64_t tail = 0;
+    for(size_t shift = 0; i < aSize; ++i, shift += 8){
+        tail |= static_cast<uint64_t>(bytes[i]) << shift;
+    }
+    return(hash_mix64(hash ^ tail));
+}
+
+/** Assigns sequential ids to unique keys, for welding vertices that share the same attribute indices.
+ * Keys and ids are stored inline in one flat array probed linearly, so inserting doesn't allocate
+ * per key and lookups touch a single cache line in the common case. The table doubles once it is
+ * more than 'sMaxLoadPercent' full, so pre-size it with a good estimate of the unique key count. */
+template<typename KeyType, typename HashType = std::hash<KeyType>>
+class DedupTable
+{
+ public:
+    using id_t = uint32_t;
+
+    explicit DedupTable(size_t aExpectedKeys = 0) {rehash(capacityFor(aExpectedKeys));}
+
+    /// Returns the id of 'aKey' and whether it was inserted by this call. New keys are given id size().
+    std::pair<id_t, bool> findOrInsert(const KeyType& aKey){
+        size_t slot = static_cast<size_t>(mHasher(aKey)) & mMask;
+        while(mSlots[slot].mId != sEmptyId){
+            if(mSlots[slot].mKey == aKey) return(std::make_pair(mSlots[slot].mId, false));
+            slot = (slot + 1) & mMask;
+        }
+
+        id_t id = static_cast<id_t>(mSize++);
+        mSlots[slot] = Slot{aKey, id};
+        if(mSize * 100 > mSlots.size() * sMaxLoadPercent){
+            rehash(mSlots.size() * 2);
+        }
+        return(std::make_pair(id, true));
+    }
+
+    size_t size() const {return(mSize);}
+    size_t capacity() const {return(mSlots.size());}
+
+    void clear() {mSlots.assign(mSlots.size(), Slot()); mSize = 0;}
+
+ protected:
+    const static id_t sEmptyId = ~id_t(0);
+    const static size_t sMaxLoadPercent = 70;
+
+    struct Slot{
+        KeyType mKey = KeyType();
+        id_t mId = sEmptyId;
+    };
+
+    static size_t capacityFor(size_t aKeyCount){
+        size_t capacity = 16;
+        while(capacity * sMaxLoadPercent < aKeyCount * 100) capacity *= 2;
+        return(capacity);
+    }
+
+    void rehash(size_t aCapacity){
+        std::vector<Slot> oldSlots(aCapacity);
+        oldSlots.swap(mSlots);
+        mMask = aCapacity - 1;
+        for(const Slot& old : oldSlots){
+            if(old.mId == sEmptyId) continue;
+            size_t slot = static_cast<size_t>(mHasher(old.mKey)) & mMask;
+            while(mSlots[slot].mId != sEmptyId) slot = (slot + 1) & mMask;
+            mSlots[slot] = old;
+        }
+    }
+
+    std::vector<Slot> mSlots;
+    size_t mMask = 0;
+    size_t mSize = 0;
+    HashType mHasher;
+};
+
+#endif
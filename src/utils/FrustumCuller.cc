@@ -0,0 +1,88 @@
+#include "FrustumCuller.h"
+#include <cmath>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define KJY_FRUSTUM_CULLER_SSE
+#include <xmmintrin.h>
+#endif
+
+void FrustumCuller::setViewProjection(const float* aMatrix){
+    // Row r of the column major matrix is (m[r], m[4 + r], m[8 + r], m[12 + r]). A point is inside when
+    // -w <= x, y, z <= w, so each plane is the w row plus or minus another row. (Gribb and Hartmann)
+    const static int sRows[6] = {0, 0, 1, 1, 2, 2};
+    const static float sSigns[6] = {1.0f, -1.0f, 1.0f, -1.0f, 1.0f, -1.0f};
+    for(int plane = 0; plane < 6; ++plane){
+        for(int column = 0; column < 4; ++column){
+            mPlanes[plane][column] = aMatrix[column * 4 + 3] + sSigns[plane] * aMatrix[column * 4 + sRows[plane]];
+        }
+        float length = std::sqrt(mPlanes[plane][0] * mPlanes[plane][0] + mPlanes[plane][1] * mPlanes[plane][1] + mPlanes[plane][2] * mPlanes[plane][2]);
+        if(length > 0.0f){
+            for(float& coefficient : mPlanes[plane]){
+                coefficient /= length;
+            }
+        }
+    }
+}
+
+void FrustumCuller::reserve(size_t aCount){
+    mX.reserve(aCount);
+    mY.reserve(aCount);
+    mZ.reserve(aCount);
+    mRadius.reserve(aCount);
+}
+
+size_t FrustumCuller::addSphere(float aX, float aY, float aZ, float aRadius){
+    mX.push_back(aX);
+    mY.push_back(aY);
+    mZ.push_back(aZ);
+    mRadius.push_back(aRadius);
+    return(mX.size() - 1);
+}
+
+size_t FrustumCuller::cull(std::vector<uint8_t>& aVisibleOut) const{
+    aVisibleOut.resize(mX.size());
+    size_t visibleCount = 0;
+    size_t i = 0;
+
+#ifdef KJY_FRUSTUM_CULLER_SSE
+    // Four spheres at a time. A sphere is outside once its center is further than its radius behind any plane.
+    __m128 planes[6][4];
+    for(int plane = 0; plane < 6; ++plane){
+        for(int coefficient = 0; coefficient < 4; ++coefficient){
+            planes[plane][coefficient] = _mm_set1_ps(mPlanes[plane][coefficient]);
+        }
+    }
+    for(; i + 4 <= mX.size(); i += 4){
+        __m128 x = _mm_loadu_ps(&mX[i]);
+        __m128 y = _mm_loadu_ps(&mY[i]);
+        __m128 z = _mm_loadu_ps(&mZ[i]);
+        __m128 negativeRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(&mRadius[i]));
+        __m128 inside = _mm_cmpeq_ps(_mm_setzero_ps(), _mm_setzero_ps()); // all lanes set
+        for(int plane = 0; plane < 6; ++plane){
+            __m128 distance = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(planes[plane][0], x), _mm_mul_ps(planes[plane][1], y)),
+                _mm_add_ps(_mm_mul_ps(planes[plane][2], z), planes[plane][3])
+            );
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negativeRadius));
+        }
+        int mask = _mm_movemask_ps(inside);
+        for(int lane = 0; lane < 4; ++lane){
+            uint8_t visible = static_cast<uint8_t>((mask >> lane) & 1);
+            aVisibleOut[i + lane] = visible;
+            visibleCount += visible;
+        }
+    }
+#endif
+
+    // Whatever is left over from the groups of four, or everything without SSE
+    for(; i < mX.size(); ++i){
+        bool inside = true;
+        for(int plane = 0; plane < 6 && inside; ++plane){
+            float distance = mPlanes[plane][0] * mX[i] + mPlanes[plane][1] * mY[i] + mPlanes[plane][2] * mZ[i] + mPlanes[plane][3];
+            inside = distance >= -mRadius[i];
+        }
+        aVisibleOut[i] = inside ? 1 : 0;
+        visibleCount += inside ? 1 : 0;
+    }
+    return(visibleCount);
+}
@@ -0,0 +1,39 @@
+#ifndef KJY_FRUSTUM_CULLER_H_
+#define KJY_FRUSTUM_CULLER_H_
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/** Tests batches of world space bounding spheres against a view frustum. Spheres are kept as separate
+ * x, y, z and radius arrays so four of them are tested against a plane at once with SSE, or one at a time
+ * where SSE isn't available. The test is conservative: spheres crossing a corner of the frustum outside
+ * every plane still count as visible. */
+class FrustumCuller
+{
+ public:
+    /// Extract the frustum planes from a column major view-projection matrix, as laid out by glm::value_ptr().
+    /// The near plane is taken at clip space z = -w, which also holds every point in front of the near plane
+    /// of projections mapping depth to [0, 1].
+    void setViewProjection(const float* aMatrix);
+
+    void clear() {mX.clear(); mY.clear(); mZ.clear(); mRadius.clear();}
+    void reserve(size_t aCount);
+    /// Queue a sphere for the next cull() and return its index
+    size_t addSphere(float aX, float aY, float aZ, float aRadius);
+    size_t size() const {return(mX.size());}
+
+    /// Set 'aVisibleOut[i]' to 1 if sphere i intersects the frustum and 0 otherwise. Returns the visible count.
+    size_t cull(std::vector<uint8_t>& aVisibleOut) const;
+
+    /// Plane i as (a, b, c, d) with a*x + b*y + c*z + d >= 0 inside, normalized so d is a distance
+    const float* getPlane(size_t aIndex) const {return(mPlanes[aIndex]);}
+
+ protected:
+    float mPlanes[6][4] = {};
+    std::vector<float> mX;
+    std::vector<float> mY;
+    std::vector<float> mZ;
+    std::vector<float> mRadius;
+};
+
+#endif
@@ -0,0 +1,121 @@
+#include "MappedFile.h"
+#include <stdexcept>
+#include <utility>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile(MappedFile&& aOther) noexcept {
+    *this = std::move(aOther);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& aOther) noexcept {
+    if(this != &aOther){
+        close();
+        std::swap(mData, aOther.mData);
+        std::swap(mSize, aOther.mSize);
+        std::swap(mOpen, aOther.mOpen);
+#ifdef _WIN32
+        std::swap(mFileHandle, aOther.mFileHandle);
+        std::swap(mMappingHandle, aOther.mMappingHandle);
+#endif
+    }
+    return(*this);
+}
+
+#ifdef _WIN32
+
+void MappedFile::open(const std::string& aPath){
+    close();
+
+    HANDLE file = CreateFileA(aPath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if(file == INVALID_HANDLE_VALUE){
+        throw std::runtime_error("Failed to open '" + aPath + "' for mapping!");
+    }
+    mFileHandle = file;
+    mOpen = true;
+
+    LARGE_INTEGER fileSize;
+    if(!GetFileSizeEx(file, &fileSize)){
+        close();
+        throw std::runtime_error("Failed to query size of '" + aPath + "'!");
+    }
+    mSize = static_cast<size_t>(fileSize.QuadPart);
+    if(mSize == 0) return; // Empty files can't be mapped
+
+    mMappingHandle = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if(mMappingHandle == nullptr){
+        close();
+        throw std::runtime_error("Failed to map '" + aPath + "'!");
+    }
+    mData = static_cast<const char*>(MapViewOfFile(mMappingHandle, FILE_MAP_READ, 0, 0, 0));
+    if(mData == nullptr){
+        close();
+        throw std::runtime_error("Failed to map '" + aPath + "'!");
+    }
+}
+
+void MappedFile::close(){
+    if(mData != nullptr) UnmapViewOfFile(mData);
+    if(mMappingHandle != nullptr) CloseHandle(mMappingHandle);
+    if(mFileHandle != nullptr) CloseHandle(mFileHandle);
+    mData = nullptr;
+    mMappingHandle = nullptr;
+    mFileHandle = nullptr;
+    mSize = 0;
+    mOpen = false;
+}
+
+#else
+
+void MappedFile::open(const std::string& aPath){
+    close();
+
+    int fd = ::open(aPath.c_str(), O_RDONLY);
+    if(fd < 0){
+        throw std::runtime_error("Failed to open '" + aPath + "' for mapping!");
+    }
+
+    struct stat fileStat;
+    if(fstat(fd, &fileStat) != 0){
+        ::close(fd);
+        throw std::runtime_error("Failed to query size of '" + aPath + "'!");
+    }
+    mSize = static_cast<size_t>(fileStat.st_size);
+    mOpen = true;
+
+    if(mSize > 0){
+        void* mapping = mmap(nullptr, mSize, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(mapping == MAP_FAILED){
+            ::close(fd);
+            mSize = 0;
+            mOpen = false;
+            throw std::runtime_error("Failed to map '" + aPath + "'!");
+        }
+        // Files are mapped to be parsed in full, so start paging everything in
+        madvise(mapping, mSize, MADV_WILLNEED);
+        mData = static_cast<const char*>(mapping);
+    }
+    // The mapping keeps its own reference to the file
+    ::close(fd);
+}
+
+void MappedFile::close(){
+    if(mData != nullptr){
+        munmap(const_cast<char*>(mData), mSize);
+    }
+    mData = nullptr;
+    mSize = 0;
+    mOpen = false;
+}
+
+#endif
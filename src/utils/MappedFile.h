@@ -0,0 +1,37 @@
+#ifndef KJY_MAPPED_FILE_H_
+#define KJY_MAPPED_FILE_H_
+#include <string>
+#include <cstddef>
+
+/// Read-only memory mapping of an entire file. The mapping is released on destruction.
+class MappedFile
+{
+ public:
+    MappedFile() = default;
+    /// Map 'aPath', throwing std::runtime_error if it can't be opened or mapped. 
+    explicit MappedFile(const std::string& aPath) {open(aPath);}
+    ~MappedFile() {close();}
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile&& aOther) noexcept;
+    MappedFile& operator=(MappedFile&& aOther) noexcept;
+
+    void open(const std::string& aPath);
+    void close();
+
+    bool isOpen() const {return(mOpen);}
+    const char* data() const {return(mData);}
+    size_t size() const {return(mSize);}
+
+ protected:
+    const char* mData = nullptr;
+    size_t mSize = 0;
+    bool mOpen = false;
+#ifdef _WIN32
+    void* mFileHandle = nullptr;
+    void* mMappingHandle = nullptr;
+#endif
+};
+
+#endif
@@ -0,0 +1,269 @@
+#include "OcclusionRasterizer.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define KJY_OCCLUSION_RASTERIZER_SSE
+#include <xmmintrin.h>
+#endif
+
+/// Transform the point 'aPoint' by the column major matrix 'aMatrix' into 'aClipOut'
+static void transform_point(const float* aMatrix, const float* aPoint, float aClipOut[4]){
+    for(int row = 0; row < 4; ++row){
+        aClipOut[row] = aMatrix[row] * aPoint[0] + aMatrix[4 + row] * aPoint[1] + aMatrix[8 + row] * aPoint[2] + aMatrix[12 + row];
+    }
+}
+
+/// Clamp a screen coordinate to just outside a buffer of size 'aSize' before it's converted to an integer
+static float clamp_coordinate(float aValue, uint32_t aSize){
+    return(std::min(std::max(aValue, -1.0f), static_cast<float>(aSize)));
+}
+
+OcclusionRasterizer::OccluderMesh OcclusionRasterizer::simplifyOccluder(const float* aPositions, const uint32_t* aIndices, size_t aIndexCount, size_t aMaxTriangles){
+    size_t triangleCount = aIndexCount / 3;
+    std::vector<float> areas(triangleCount);
+    std::vector<size_t> order(triangleCount);
+    uint32_t vertexCount = 0;
+    for(size_t tri = 0; tri < triangleCount; ++tri){
+        const float* a = &aPositions[aIndices[tri * 3] * 3];
+        const float* b = &aPositions[aIndices[tri * 3 + 1] * 3];
+        const float* c = &aPositions[aIndices[tri * 3 + 2] * 3];
+        float ab[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+        float ac[3] = {c[0] - a[0], c[1] - a[1], c[2] - a[2]};
+        float cross[3] = {ab[1] * ac[2] - ab[2] * ac[1], ab[2] * ac[0] - ab[0] * ac[2], ab[0] * ac[1] - ab[1] * ac[0]};
+        // Twice the area, which orders the same
+        areas[tri] = std::sqrt(cross[0] * cross[0] + cross[1] * cross[1] + cross[2] * cross[2]);
+        order[tri] = tri;
+        for(int corner = 0; corner < 3; ++corner){
+            vertexCount = std::max(vertexCount, aIndices[tri * 3 + corner] + 1);
+        }
+    }
+    if(triangleCount > aMaxTriangles){
+        std::nth_element(order.begin(), order.begin() + aMaxTriangles, order.end(), [&areas](size_t aLeft, size_t aRight){
+            return(areas[aLeft] > areas[aRight]);
+        });
+        order.resize(aMaxTriangles);
+    }
+
+    // Copy over only the positions the kept triangles use
+    OccluderMesh mesh;
+    std::vector<uint32_t> remap(vertexCount, UINT32_MAX);
+    mesh.mIndices.reserve(order.size() * 3);
+    for(size_t tri : order){
+        for(int corner = 0; corner < 3; ++corner){
+            uint32_t index = aIndices[tri * 3 + corner];
+            if(remap[index] == UINT32_MAX){
+                remap[index] = static_cast<uint32_t>(mesh.mPositions.size() / 3);
+                mesh.mPositions.insert(mesh.mPositions.end(), &aPositions[index * 3], &aPositions[index * 3] + 3);
+            }
+            mesh.mIndices.push_back(remap[index]);
+        }
+    }
+    return(mesh);
+}
+
+void OcclusionRasterizer::resize(uint32_t aWidth, uint32_t aHeight){
+    mWidth = std::max((aWidth + TILE_SIZE - 1) / TILE_SIZE * TILE_SIZE, TILE_SIZE);
+    mHeight = std::max((aHeight + TILE_SIZE - 1) / TILE_SIZE * TILE_SIZE, TILE_SIZE);
+    clear();
+}
+
+void OcclusionRasterizer::clear(){
+    mDepth.assign(static_cast<size_t>(mWidth) * mHeight, FLT_MAX);
+    mTileMax.assign(static_cast<size_t>(mWidth / TILE_SIZE) * (mHeight / TILE_SIZE), FLT_MAX);
+    mTriangles.clear();
+}
+
+void OcclusionRasterizer::addOccluder(const float* aModelViewProjection, const float* aPositions, const uint32_t* aIndices, size_t aIndexCount){
+    for(size_t first = 0; first + 3 <= aIndexCount; first += 3){
+        float screen[3][3];
+        bool clipped = false;
+        for(int corner = 0; corner < 3 && !clipped; ++corner){
+            float clip[4];
+            transform_point(aModelViewProjection, &aPositions[aIndices[first + corner] * 3], clip);
+            // The device clips depth below zero, so this holds for either depth range of the projection
+            clipped = clip[3] <= 0.0f || clip[2] < 0.0f;
+            screen[corner][0] = (clip[0] / clip[3] * 0.5f + 0.5f) * mWidth;
+            screen[corner][1] = (clip[1] / clip[3] * 0.5f + 0.5f) * mHeight;
+            screen[corner][2] = clip[2] / clip[3];
+        }
+        if(clipped){
+            continue;
+        }
+
+        // Edge i runs from corner i to the next, and is zero at the corner opposite it scaled by the signed area
+        Triangle triangle;
+        for(int edge = 0; edge < 3; ++edge){
+            const float* a = screen[edge];
+            const float* b = screen[(edge + 1) % 3];
+            triangle.mEdges[edge][0] = a[1] - b[1];
+            triangle.mEdges[edge][1] = b[0] - a[0];
+            triangle.mEdges[edge][2] = a[0] * b[1] - a[1] * b[0];
+        }
+        float area = triangle.mEdges[0][0] * screen[2][0] + triangle.mEdges[0][1] * screen[2][1] + triangle.mEdges[0][2];
+        if(std::fabs(area) < 1e-6f){
+            continue;
+        }
+
+        // Interpolate depth with the edge functions of the edges opposite each corner
+        for(int coefficient = 0; coefficient < 3; ++coefficient){
+            triangle.mDepth[coefficient] = (triangle.mEdges[1][coefficient] * screen[0][2] + triangle.mEdges[2][coefficient] * screen[1][2] +
+                                            triangle.mEdges[0][coefficient] * screen[2][2]) / area;
+        }
+        // Keep the farthest depth within each pixel rather than the one at its center
+        triangle.mDepth[2] += (std::fabs(triangle.mDepth[0]) + std::fabs(triangle.mDepth[1])) * 0.5f;
+        // Either winding is an occluder
+        if(area < 0.0f){
+            for(float* edge : triangle.mEdges){
+                edge[0] = -edge[0];
+                edge[1] = -edge[1];
+                edge[2] = -edge[2];
+            }
+        }
+
+        // Pixels whose centers could be inside
+        float minX = std::min({screen[0][0], screen[1][0], screen[2][0]});
+        float maxX = std::max({screen[0][0], screen[1][0], screen[2][0]});
+        float minY = std::min({screen[0][1], screen[1][1], screen[2][1]});
+        float maxY = std::max({screen[0][1], screen[1][1], screen[2][1]});
+        triangle.mMinX = std::max(static_cast<int32_t>(std::ceil(clamp_coordinate(minX - 0.5f, mWidth))), 0);
+        triangle.mMaxX = std::min(static_cast<int32_t>(std::floor(clamp_coordinate(maxX - 0.5f, mWidth))), static_cast<int32_t>(mWidth) - 1);
+        triangle.mMinY = std::max(static_cast<int32_t>(std::ceil(clamp_coordinate(minY - 0.5f, mHeight))), 0);
+        triangle.mMaxY = std::min(static_cast<int32_t>(std::floor(clamp_coordinate(maxY - 0.5f, mHeight))), static_cast<int32_t>(mHeight) - 1);
+        if(triangle.mMinX > triangle.mMaxX || triangle.mMinY > triangle.mMaxY){
+            continue;
+        }
+        mTriangles.push_back(triangle);
+    }
+}
+
+void OcclusionRasterizer::rasterize(ThreadPool* aPool){
+    size_t tileRows = mHeight / TILE_SIZE;
+    if(aPool != nullptr){
+        aPool->parallelFor(tileRows, [this](size_t aTileRow){rasterizeTileRow(aTileRow);});
+    }else{
+        for(size_t tileRow = 0; tileRow < tileRows; ++tileRow){
+            rasterizeTileRow(tileRow);
+        }
+    }
+}
+
+void OcclusionRasterizer::rasterizeTileRow(size_t aTileRow){
+    int32_t rowStart = static_cast<int32_t>(aTileRow * TILE_SIZE);
+    int32_t rowEnd = rowStart + static_cast<int32_t>(TILE_SIZE) - 1;
+    for(const Triangle& triangle : mTriangles){
+        int32_t firstY = std::max(triangle.mMinY, rowStart);
+        int32_t lastY = std::min(triangle.mMaxY, rowEnd);
+        for(int32_t y = firstY; y <= lastY; ++y){
+            float centerY = static_cast<float>(y) + 0.5f;
+            float* depthRow = &mDepth[static_cast<size_t>(y) * mWidth];
+#ifdef KJY_OCCLUSION_RASTERIZER_SSE
+            // Four pixels at a time from a multiple of four, which the width always is
+            const __m128 laneOffsets = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+            const __m128 zero = _mm_setzero_ps();
+            __m128 edgeX[3];
+            __m128 edgeRow[3];
+            for(int edge = 0; edge < 3; ++edge){
+                edgeX[edge] = _mm_set1_ps(triangle.mEdges[edge][0]);
+                edgeRow[edge] = _mm_set1_ps(triangle.mEdges[edge][1] * centerY + triangle.mEdges[edge][2]);
+            }
+            __m128 depthX = _mm_set1_ps(triangle.mDepth[0]);
+            __m128 depthRowBase = _mm_set1_ps(triangle.mDepth[1] * centerY + triangle.mDepth[2]);
+            for(int32_t x = triangle.mMinX & ~3; x <= triangle.mMaxX; x += 4){
+                __m128 centerX = _mm_add_ps(_mm_set1_ps(static_cast<float>(x)), laneOffsets);
+                __m128 inside = _mm_and_ps(
+                    _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeX[0], centerX), edgeRow[0]), zero),
+                    _mm_and_ps(
+                        _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeX[1], centerX), edgeRow[1]), zero),
+                        _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeX[2], centerX), edgeRow[2]), zero)
+                    )
+                );
+                __m128 depth = _mm_add_ps(_mm_mul_ps(depthX, centerX), depthRowBase);
+                __m128 current = _mm_loadu_ps(&depthRow[x]);
+                __m128 nearer = _mm_and_ps(inside, _mm_cmplt_ps(depth, current));
+                _mm_storeu_ps(&depthRow[x], _mm_or_ps(_mm_and_ps(nearer, depth), _mm_andnot_ps(nearer, current)));
+            }
+#else
+            for(int32_t x = triangle.mMinX; x <= triangle.mMaxX; ++x){
+                float centerX = static_cast<float>(x) + 0.5f;
+                bool inside = true;
+                for(int edge = 0; edge < 3 && inside; ++edge){
+                    inside = triangle.mEdges[edge][0] * centerX + triangle.mEdges[edge][1] * centerY + triangle.mEdges[edge][2] >= 0.0f;
+                }
+                float depth = triangle.mDepth[0] * centerX + triangle.mDepth[1] * centerY + triangle.mDepth[2];
+                if(inside && depth < depthRow[x]){
+                    depthRow[x] = depth;
+                }
+            }
+#endif
+        }
+    }
+
+    uint32_t tilesPerRow = mWidth / TILE_SIZE;
+    for(uint32_t tile = 0; tile < tilesPerRow; ++tile){
+        float farthest = 0.0f;
+        for(uint32_t y = 0; y < TILE_SIZE; ++y){
+            const float* depthRow = &mDepth[(static_cast<size_t>(rowStart) + y) * mWidth + tile * TILE_SIZE];
+            farthest = std::max(farthest, *std::max_element(depthRow, depthRow + TILE_SIZE));
+        }
+        mTileMax[aTileRow * tilesPerRow + tile] = farthest;
+    }
+}
+
+bool OcclusionRasterizer::isOccluded(const float* aModelViewProjection, const float aMin[3], const float aMax[3]) const{
+    float minX = FLT_MAX;
+    float minY = FLT_MAX;
+    float maxX = -FLT_MAX;
+    float maxY = -FLT_MAX;
+    float nearest = FLT_MAX;
+    for(int corner = 0; corner < 8; ++corner){
+        float point[3] = {(corner & 1) ? aMax[0] : aMin[0], (corner & 2) ? aMax[1] : aMin[1], (corner & 4) ? aMax[2] : aMin[2]};
+        float clip[4];
+        transform_point(aModelViewProjection, point, clip);
+        if(clip[3] <= 0.0f || clip[2] < 0.0f){
+            return(false);
+        }
+        float x = (clip[0] / clip[3] * 0.5f + 0.5f) * mWidth;
+        float y = (clip[1] / clip[3] * 0.5f + 0.5f) * mHeight;
+        minX = std::min(minX, x);
+        maxX = std::max(maxX, x);
+        minY = std::min(minY, y);
+        maxY = std::max(maxY, y);
+        nearest = std::min(nearest, clip[2] / clip[3]);
+    }
+    // The box is within its corners, and so is its depth as depth only grows with distance along a view ray
+    return(isRectOccluded(minX, minY, maxX, maxY, nearest));
+}
+
+bool OcclusionRasterizer::isRectOccluded(float aMinX, float aMinY, float aMaxX, float aMaxY, float aDepth) const{
+    int32_t firstX = std::max(static_cast<int32_t>(std::floor(clamp_coordinate(aMinX, mWidth))), 0);
+    int32_t lastX = std::min(static_cast<int32_t>(std::floor(clamp_coordinate(aMaxX, mWidth))), static_cast<int32_t>(mWidth) - 1);
+    int32_t firstY = std::max(static_cast<int32_t>(std::floor(clamp_coordinate(aMinY, mHeight))), 0);
+    int32_t lastY = std::min(static_cast<int32_t>(std::floor(clamp_coordinate(aMaxY, mHeight))), static_cast<int32_t>(mHeight) - 1);
+    if(firstX > lastX || firstY > lastY){
+        return(false); // Off screen, which is for the frustum to decide
+    }
+
+    uint32_t tilesPerRow = mWidth / TILE_SIZE;
+    for(int32_t tileY = firstY / TILE_SIZE; tileY <= lastY / static_cast<int32_t>(TILE_SIZE); ++tileY){
+        for(int32_t tileX = firstX / TILE_SIZE; tileX <= lastX / static_cast<int32_t>(TILE_SIZE); ++tileX){
+            if(mTileMax[tileY * tilesPerRow + tileX] < aDepth){
+                continue; // Everything in the tile is nearer
+            }
+            int32_t startY = std::max(firstY, tileY * static_cast<int32_t>(TILE_SIZE));
+            int32_t endY = std::min(lastY, (tileY + 1) * static_cast<int32_t>(TILE_SIZE) - 1);
+            int32_t startX = std::max(firstX, tileX * static_cast<int32_t>(TILE_SIZE));
+            int32_t endX = std::min(lastX, (tileX + 1) * static_cast<int32_t>(TILE_SIZE) - 1);
+            for(int32_t y = startY; y <= endY; ++y){
+                for(int32_t x = startX; x <= endX; ++x){
+                    if(mDepth[static_cast<size_t>(y) * mWidth + x] >= aDepth){
+                        return(false);
+                    }
+                }
+            }
+        }
+    }
+    return(true);
+}
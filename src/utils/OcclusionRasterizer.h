@@ -0,0 +1,77 @@
+#ifndef KJY_OCCLUSION_RASTERIZER_H_
+#define KJY_OCCLUSION_RASTERIZER_H_
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class ThreadPool;
+
+/** Software rasterizer for coarse occlusion culling on the CPU. Simplified occluder meshes are rasterized into a
+ * small depth buffer split into TILE_SIZE square tiles, four pixels at a time with SSE where available, and the
+ * screen space bounds of each candidate are then tested against it. Depth is clip space z / w, smaller is nearer.
+ * Occluders are sampled at pixel centers, so at this resolution something peeking out less than a pixel past an
+ * occluder edge may still be reported as occluded. Nothing crossing the near plane is rasterized or culled. */
+class OcclusionRasterizer
+{
+ public:
+    const static uint32_t TILE_SIZE = 8;
+
+    /// Triangles of an occluder as xyz position triples and three indices each
+    struct OccluderMesh {
+        std::vector<float> mPositions;
+        std::vector<uint32_t> mIndices;
+    };
+
+    /// Keep the 'aMaxTriangles' largest triangles of a mesh as its occluder, along with only the positions they use.
+    /// A subset of the surface never hides more than the whole of it, so the occluder stays conservative.
+    static OccluderMesh simplifyOccluder(const float* aPositions, const uint32_t* aIndices, size_t aIndexCount, size_t aMaxTriangles);
+
+    /// The dimensions are rounded up to a multiple of TILE_SIZE
+    OcclusionRasterizer(uint32_t aWidth = 256, uint32_t aHeight = 128) {resize(aWidth, aHeight);}
+
+    void resize(uint32_t aWidth, uint32_t aHeight);
+    uint32_t width() const {return(mWidth);}
+    uint32_t height() const {return(mHeight);}
+
+    /// Drop the queued occluders and empty the depth buffer
+    void clear();
+    /// Queue the triangles of an occluder for the next rasterize(), transformed by a column major model-view-projection
+    /// matrix as laid out by glm::value_ptr(). Triangles reaching behind the near plane are skipped.
+    void addOccluder(const float* aModelViewProjection, const float* aPositions, const uint32_t* aIndices, size_t aIndexCount);
+    void addOccluder(const float* aModelViewProjection, const OccluderMesh& aMesh) {addOccluder(aModelViewProjection, aMesh.mPositions.data(), aMesh.mIndices.data(), aMesh.mIndices.size());}
+    size_t triangleCount() const {return(mTriangles.size());}
+
+    /// Rasterize the queued occluders, splitting the rows of tiles across 'aPool' if given
+    void rasterize(ThreadPool* aPool = nullptr);
+
+    /// True if the model space box from 'aMin' to 'aMax' is behind the rasterized occluders everywhere it covers
+    bool isOccluded(const float* aModelViewProjection, const float aMin[3], const float aMax[3]) const;
+    /// True if every pixel touching the rectangle from ('aMinX', 'aMinY') to ('aMaxX', 'aMaxY') is nearer than 'aDepth'
+    bool isRectOccluded(float aMinX, float aMinY, float aMaxX, float aMaxY, float aDepth) const;
+
+    /// Rasterized depth of a pixel, FLT_MAX where nothing was drawn
+    float depthAt(uint32_t aX, uint32_t aY) const {return(mDepth[aY * mWidth + aX]);}
+
+ protected:
+    /// Edge functions a*x + b*y + c, non-negative inside, and the depth plane of a screen space triangle
+    struct Triangle {
+        float mEdges[3][3];
+        float mDepth[3];
+        int32_t mMinX;
+        int32_t mMinY;
+        int32_t mMaxX;
+        int32_t mMaxY;
+    };
+
+    /// Rasterize every triangle into the rows of tile row 'aTileRow', then update the maximum depth of its tiles
+    void rasterizeTileRow(size_t aTileRow);
+
+    uint32_t mWidth = 0;
+    uint32_t mHeight = 0;
+    std::vector<float> mDepth;
+    /// Farthest depth of each tile, FLT_MAX unless the tile is covered
+    std::vector<float> mTileMax;
+    std::vector<Triangle> mTriangles;
+};
+
+#endif
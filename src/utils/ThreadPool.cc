@@ -0,0 +1,105 @@
+#include "ThreadPool.h"
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <memory>
+
+ThreadPool::ThreadPool(size_t aThreadCount){
+    if(aThreadCount == 0){
+        aThreadCount = std::max(1U, std::thread::hardware_concurrency()) - 1;
+    }
+    mWorkers.reserve(aThreadCount);
+    for(size_t i = 0; i < aThreadCount; ++i){
+        mWorkers.emplace_back(&ThreadPool::workerLoop, this);
+    }
+}
+
+ThreadPool::~ThreadPool(){
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStopping = true;
+    }
+    mTaskAvailable.notify_all();
+    for(std::thread& worker : mWorkers){
+        worker.join();
+    }
+}
+
+ThreadPool& ThreadPool::shared(){
+    static ThreadPool sPool;
+    return(sPool);
+}
+
+std::future<void> ThreadPool::submit(std::function<void()> aTask){
+    std::packaged_task<void()> task(std::move(aTask));
+    std::future<void> result = task.get_future();
+
+    if(mWorkers.empty()){
+        task();
+        return(result);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mTasks.emplace_back(std::move(task));
+    }
+    mTaskAvailable.notify_one();
+    return(result);
+}
+
+void ThreadPool::parallelFor(size_t aCount, const std::function<void(size_t)>& aFunc){
+    if(aCount == 0) return;
+
+    // Helpers may still be queued after the caller returns, so shared progress lives on the heap.
+    // A helper only touches 'aFunc' while it holds an unclaimed index, which the caller waits for.
+    struct ForState {
+        std::atomic<size_t> mNext {0};
+        size_t mCompleted = 0;
+        std::exception_ptr mError = nullptr;
+        std::mutex mMutex;
+        std::condition_variable mDone;
+    };
+    std::shared_ptr<ForState> state = std::make_shared<ForState>();
+    const std::function<void(size_t)>* func = &aFunc;
+
+    auto runIndices = [state, func, aCount](){
+        for(size_t i = state->mNext++; i < aCount; i = state->mNext++){
+            std::exception_ptr error = nullptr;
+            try{
+                (*func)(i);
+            }catch(...){
+                error = std::current_exception();
+            }
+
+            std::lock_guard<std::mutex> lock(state->mMutex);
+            if(error != nullptr && state->mError == nullptr) state->mError = error;
+            if(++state->mCompleted == aCount) state->mDone.notify_all();
+        }
+    };
+
+    size_t helperCount = std::min(aCount - 1, mWorkers.size());
+    for(size_t i = 0; i < helperCount; ++i){
+        submit(runIndices);
+    }
+    runIndices();
+
+    std::unique_lock<std::mutex> lock(state->mMutex);
+    state->mDone.wait(lock, [&state, aCount](){return(state->mCompleted == aCount);});
+    if(state->mError != nullptr){
+        std::rethrow_exception(state->mError);
+    }
+}
+
+void ThreadPool::workerLoop(){
+    while(true){
+        std::packaged_task<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mTaskAvailable.wait(lock, [this](){return(mStopping || !mTasks.empty());});
+            if(mStopping && mTasks.empty()) return;
+            task = std::move(mTasks.front());
+            mTasks.pop_front();
+        }
+        task();
+    }
+}
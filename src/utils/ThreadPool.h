@@ -0,0 +1,46 @@
+#ifndef KJY_THREAD_POOL_H_
+#define KJY_THREAD_POOL_H_
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/** Fixed set of worker threads which run submitted tasks in FIFO order. Loaders share one pool through
+ * shared() instead of starting a thread per task, which costs more than the work for small tasks. */
+class ThreadPool
+{
+ public:
+    /// 'aThreadCount' of 0 creates one worker per hardware thread, less the calling thread
+    explicit ThreadPool(size_t aThreadCount = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /// Pool shared by the whole application, created on first use
+    static ThreadPool& shared();
+
+    size_t threadCount() const {return(mWorkers.size());}
+
+    /// Queue 'aTask'. The returned future rethrows anything the task throws. 
+    std::future<void> submit(std::function<void()> aTask);
+
+    /** Calls 'aFunc(i)' for every i in [0, aCount), spread across the workers and the calling thread,
+     * and returns once all calls have finished. Rethrows the first exception thrown by 'aFunc'.
+     * Safe to call from inside a task, since the caller keeps taking indices itself. */
+    void parallelFor(size_t aCount, const std::function<void(size_t)>& aFunc);
+
+ protected:
+    void workerLoop();
+
+    std::vector<std::thread> mWorkers;
+    std::deque<std::packaged_task<void()>> mTasks;
+    std::mutex mMutex;
+    std::condition_variable mTaskAvailable;
+    bool mStopping = false;
+};
+
+#endif
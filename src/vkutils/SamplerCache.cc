@@ -0,0 +1,37 @@
+#include "SamplerCache.h"
+#include <stdexcept>
+
+VkSampler SamplerCache::getSampler(const VkSamplerCreateInfo& aInfo){
+    if(aInfo.pNext != nullptr){
+        throw std::runtime_error("SamplerCache can't key samplers created with a pNext chain");
+    }
+
+    key_t key = makeKey(aInfo);
+    std::map<key_t, VkSampler>::const_iterator finder = mSamplers.find(key);
+    if(finder != mSamplers.end()){
+        return(finder->second);
+    }
+
+    VkSampler sampler = VK_NULL_HANDLE;
+    if(vkCreateSampler(mDevice, &aInfo, nullptr, &sampler) != VK_SUCCESS){
+        throw std::runtime_error("Failed to create sampler");
+    }
+    mSamplers.insert({key, sampler});
+    return(sampler);
+}
+
+void SamplerCache::destroy(){
+    for(const std::pair<const key_t, VkSampler>& entry : mSamplers){
+        vkDestroySampler(mDevice, entry.second, nullptr);
+    }
+    mSamplers.clear();
+}
+
+SamplerCache::key_t SamplerCache::makeKey(const VkSamplerCreateInfo& aInfo){
+    return(key_t(
+        aInfo.flags, aInfo.magFilter, aInfo.minFilter, aInfo.mipmapMode,
+        aInfo.addressModeU, aInfo.addressModeV, aInfo.addressModeW,
+        aInfo.mipLodBias, aInfo.anisotropyEnable, aInfo.maxAnisotropy, aInfo.compareEnable, aInfo.compareOp,
+        aInfo.minLod, aInfo.maxLod, aInfo.borderColor, aInfo.unnormalizedCoordinates
+    ));
+}
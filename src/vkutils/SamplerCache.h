@@ -0,0 +1,35 @@
+#ifndef KJY_SAMPLER_CACHE_H_
+#define KJY_SAMPLER_CACHE_H_
+#include <vulkan/vulkan.h>
+#include <map>
+#include <tuple>
+
+/// Hands out one VkSampler per distinct sampler state. Devices cap the number of live samplers
+/// (maxSamplerAllocationCount, as low as 4000), so textures sampled the same way must share them.
+class SamplerCache
+{
+ public:
+    SamplerCache() = default;
+    explicit SamplerCache(VkDevice aDevice) : mDevice(aDevice) {}
+
+    /// Returns the sampler created from 'aInfo', creating it on the first request for that state.
+    /// The pNext chain of 'aInfo' is not part of the key and must be empty.
+    VkSampler getSampler(const VkSamplerCreateInfo& aInfo);
+
+    size_t size() const {return(mSamplers.size());}
+    /// Destroys every sampler handed out so far. They must no longer be in use.
+    void destroy();
+
+ protected:
+    using key_t = std::tuple<
+        VkSamplerCreateFlags, VkFilter, VkFilter, VkSamplerMipmapMode,
+        VkSamplerAddressMode, VkSamplerAddressMode, VkSamplerAddressMode,
+        float, VkBool32, float, VkBool32, VkCompareOp, float, float, VkBorderColor, VkBool32
+    >;
+    static key_t makeKey(const VkSamplerCreateInfo& aInfo);
+
+    VkDevice mDevice = VK_NULL_HANDLE;
+    std::map<key_t, VkSampler> mSamplers;
+};
+
+#endif
@@ -1,6 +1,7 @@
 #include "VulkanDevices.h"
 #include <set>
 #include <algorithm>
+#include <cstring>
 
 QueueFamily::QueueFamily(const VkQueueFamilyProperties& aFamily, uint32_t aIndex) 
 : mIndex(aIndex),
@@ -15,11 +16,84 @@ QueueFamily::QueueFamily(const VkQueueFamilyProperties& aFamily, uint32_t aIndex
   mProtected(aFamily.queueFlags | VK_QUEUE_PROTECTED_BIT)
 {}
 
-VulkanPhysicalDevice::VulkanPhysicalDevice(VkPhysicalDevice aDevice) : mHandle(aDevice) {
+VulkanPhysicalDevice::VulkanPhysicalDevice(VkPhysicalDevice aDevice, VkInstance aInstance) : mHandle(aDevice) {
     vkGetPhysicalDeviceProperties(aDevice, &mProperties);
     vkGetPhysicalDeviceFeatures(aDevice, &mFeatures);
     _initExtensionProps();
     _initQueueFamilies();
+    _initDescriptorIndexing(aInstance);
+    _initDrawIndirectCount();
+}
+
+void VulkanPhysicalDevice::_initDescriptorIndexing(VkInstance aInstance){
+    mDescriptorIndexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+    mDescriptorIndexingProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES_EXT;
+    if(!_hasExtension(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME)) return;
+
+    // Extension features can only be queried through the *2 entry points, which are core since Vulkan 1.1
+    PFN_vkGetPhysicalDeviceFeatures2KHR getFeatures2 = nullptr;
+    PFN_vkGetPhysicalDeviceProperties2KHR getProperties2 = nullptr;
+#ifdef VULKAN_BASE_VK_API_VERSION
+    if(VULKAN_BASE_VK_API_VERSION >= VK_API_VERSION_1_1 && mProperties.apiVersion >= VK_API_VERSION_1_1){
+        getFeatures2 = vkGetPhysicalDeviceFeatures2;
+        getProperties2 = vkGetPhysicalDeviceProperties2;
+    }
+#endif
+    // On Vulkan 1.0 they come from VK_KHR_get_physical_device_properties2, which is null unless the instance enabled it.
+    // The descriptor indexing extension then also needs VK_KHR_maintenance3 on the device.
+    if(getFeatures2 == nullptr && aInstance != VK_NULL_HANDLE && _hasExtension(VK_KHR_MAINTENANCE3_EXTENSION_NAME)){
+        getFeatures2 = reinterpret_cast<PFN_vkGetPhysicalDeviceFeatures2KHR>(vkGetInstanceProcAddr(aInstance, "vkGetPhysicalDeviceFeatures2KHR"));
+        getProperties2 = reinterpret_cast<PFN_vkGetPhysicalDeviceProperties2KHR>(vkGetInstanceProcAddr(aInstance, "vkGetPhysicalDeviceProperties2KHR"));
+    }
+    if(getFeatures2 == nullptr || getProperties2 == nullptr) return;
+
+    VkPhysicalDeviceFeatures2KHR features = {};
+    {
+        features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR;
+        features.pNext = &mDescriptorIndexingFeatures;
+    }
+    getFeatures2(mHandle, &features);
+
+    VkPhysicalDeviceProperties2KHR properties = {};
+    {
+        properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2_KHR;
+        properties.pNext = &mDescriptorIndexingProperties;
+    }
+    getProperties2(mHandle, &properties);
+
+    mDescriptorIndexingFeatures.pNext = nullptr;
+    mDescriptorIndexingProperties.pNext = nullptr;
+}
+
+void VulkanPhysicalDevice::_initDrawIndirectCount(){
+    // Drivers may report the feature without the extension once it became core in Vulkan 1.2
+#if defined(VULKAN_BASE_VK_API_VERSION) && defined(VK_API_VERSION_1_2)
+    if(VULKAN_BASE_VK_API_VERSION >= VK_API_VERSION_1_2 && mProperties.apiVersion >= VK_API_VERSION_1_2){
+        VkPhysicalDeviceVulkan12Features vulkan12Features = {};
+        vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+        VkPhysicalDeviceFeatures2 features = {};
+        {
+            features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+            features.pNext = &vulkan12Features;
+        }
+        vkGetPhysicalDeviceFeatures2(mHandle, &features);
+        mDrawIndirectCountCore = vulkan12Features.drawIndirectCount == VK_TRUE;
+    }
+#endif
+}
+
+bool VulkanPhysicalDevice::_hasExtension(const char* aExtensionName) const{
+    for(const VkExtensionProperties& extension : mAvailableExtensions){
+        if(std::strcmp(extension.extensionName, aExtensionName) == 0) return(true);
+    }
+    return(false);
+}
+
+bool VulkanPhysicalDevice::supportsBindlessTextures() const{
+    return(mDescriptorIndexingFeatures.descriptorBindingPartiallyBound
+        && mDescriptorIndexingFeatures.descriptorBindingSampledImageUpdateAfterBind
+        && mDescriptorIndexingFeatures.descriptorBindingUpdateUnusedWhilePending
+        && mDescriptorIndexingFeatures.shaderSampledImageArrayNonUniformIndexing);
 }
 
 void VulkanPhysicalDevice::_initExtensionProps(){
@@ -111,18 +185,63 @@ VulkanLogicalDevice VulkanPhysicalDevice::createLogicalDevice(VkQueueFlags aQueu
     }
     struct VkPhysicalDeviceFeatures features = {};
     features.fillModeNonSolid = 1;
+    // Optional features used for indirect drawing when available
+    features.multiDrawIndirect = mFeatures.multiDrawIndirect;
+    features.drawIndirectFirstInstance = mFeatures.drawIndirectFirstInstance;
+    // Optional feature used for block compressed textures cooked offline when available
+    features.textureCompressionBC = mFeatures.textureCompressionBC;
+    // Optional features used for a bindless texture table when available
+    std::vector<const char*> extensions = aExtensions;
+    VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures = {};
+    indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+    if(supportsBindlessTextures()){
+        indexingFeatures.descriptorBindingPartiallyBound = VK_TRUE;
+        indexingFeatures.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+        indexingFeatures.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+        indexingFeatures.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+        bool requested = std::any_of(extensions.begin(), extensions.end(), [](const char* aName){
+            return(std::strcmp(aName, VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME) == 0);
+        });
+        if(!requested) extensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+        // Required by descriptor indexing before Vulkan 1.1, where it became core
+        bool maintenanceRequested = std::any_of(extensions.begin(), extensions.end(), [](const char* aName){
+            return(std::strcmp(aName, VK_KHR_MAINTENANCE3_EXTENSION_NAME) == 0);
+        });
+        if(!maintenanceRequested && _hasExtension(VK_KHR_MAINTENANCE3_EXTENSION_NAME)) extensions.push_back(VK_KHR_MAINTENANCE3_EXTENSION_NAME);
+    }
+    const void* featureChain = supportsBindlessTextures() ? &indexingFeatures : nullptr;
+#if defined(VULKAN_BASE_VK_API_VERSION) && defined(VK_API_VERSION_1_2)
+    // The Vulkan 1.2 features can't be chained along with the descriptor indexing features, so they take over those too
+    VkPhysicalDeviceVulkan12Features vulkan12Features = {};
+    vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    if(mDrawIndirectCountCore){
+        vulkan12Features.drawIndirectCount = VK_TRUE;
+        vulkan12Features.descriptorBindingPartiallyBound = indexingFeatures.descriptorBindingPartiallyBound;
+        vulkan12Features.descriptorBindingSampledImageUpdateAfterBind = indexingFeatures.descriptorBindingSampledImageUpdateAfterBind;
+        vulkan12Features.descriptorBindingUpdateUnusedWhilePending = indexingFeatures.descriptorBindingUpdateUnusedWhilePending;
+        vulkan12Features.shaderSampledImageArrayNonUniformIndexing = indexingFeatures.shaderSampledImageArrayNonUniformIndexing;
+        featureChain = &vulkan12Features;
+    }
+#endif
+    // Optional extension letting indirect draws take a count written on the device, unless it is enabled as a core feature
+    if(supportsDrawIndirectCount() && !mDrawIndirectCountCore){
+        bool requested = std::any_of(extensions.begin(), extensions.end(), [](const char* aName){
+            return(std::strcmp(aName, VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME) == 0);
+        });
+        if(!requested) extensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+    }
     VkDeviceCreateInfo createInfo;
     {
         createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
-        createInfo.pNext = nullptr;
+        createInfo.pNext = featureChain;
         createInfo.pEnabledFeatures = &features;
         createInfo.flags = 0;
         createInfo.ppEnabledLayerNames = nullptr;
         createInfo.enabledLayerCount = 0;
         createInfo.pQueueCreateInfos = queueCreateInfos.data();
         createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
-        createInfo.ppEnabledExtensionNames = aExtensions.data();
-        createInfo.enabledExtensionCount = static_cast<uint32_t>(aExtensions.size());
+        createInfo.ppEnabledExtensionNames = extensions.data();
+        createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
     }
 
     VkDevice deviceHandle = VK_NULL_HANDLE;
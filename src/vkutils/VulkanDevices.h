@@ -80,7 +80,8 @@ class VulkanPhysicalDevice
 {
  public:
    VulkanPhysicalDevice(){}
-   VulkanPhysicalDevice(VkPhysicalDevice aDevice);
+   /// 'aInstance' is used to query extension features on Vulkan 1.0, where they need VK_KHR_get_physical_device_properties2
+   VulkanPhysicalDevice(VkPhysicalDevice aDevice, VkInstance aInstance = VK_NULL_HANDLE);
 
    inline VkPhysicalDevice handle() const {return(mHandle);}
    inline bool isValid() const {return(mHandle != VK_NULL_HANDLE);}
@@ -102,8 +103,21 @@ class VulkanPhysicalDevice
       return(createLogicalDevice(VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT | VK_QUEUE_TRANSFER_BIT, aExtensions, aSurface));
    }
 
+   /// True if a texture table can be partially bound, grown after binding, and indexed with values which differ
+   /// between invocations of a draw through VK_EXT_descriptor_indexing
+   bool supportsBindlessTextures() const;
+   /// True if indirect draws can read their draw count from a buffer, through Vulkan 1.2 or VK_KHR_draw_indirect_count
+   bool supportsDrawIndirectCount() const {return(mDrawIndirectCountCore || _hasExtension(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME));}
+
    VkPhysicalDeviceProperties mProperties;
    VkPhysicalDeviceFeatures mFeatures;
+   /// Queried through Vulkan 1.1, or through VK_KHR_get_physical_device_properties2 when the instance enabled it.
+   /// Left zeroed when neither is available.
+   VkPhysicalDeviceDescriptorIndexingFeaturesEXT mDescriptorIndexingFeatures = {};
+   VkPhysicalDeviceDescriptorIndexingPropertiesEXT mDescriptorIndexingProperties = {};
+   /// True if the instance and device are Vulkan 1.2 and the device has the core drawIndirectCount feature,
+   /// which vkCmdDrawIndexedIndirectCount then uses instead of the extension
+   bool mDrawIndirectCountCore = false;
    std::vector<QueueFamily> mQueueFamilies;
    std::vector<VkExtensionProperties> mAvailableExtensions;
 
@@ -121,6 +135,9 @@ class VulkanPhysicalDevice
  protected:
    void _initExtensionProps();
    void _initQueueFamilies();
+   void _initDescriptorIndexing(VkInstance aInstance);
+   void _initDrawIndirectCount();
+   bool _hasExtension(const char* aExtensionName) const;
 
    VkPhysicalDevice mHandle = VK_NULL_HANDLE;
 };
@@ -271,7 +271,7 @@ void VulkanBasicRasterPipelineBuilder::prepareRenderPass(GraphicsPipelineConstru
     }
 }
 
-VulkanDepthBundle VulkanBasicRasterPipelineBuilder::autoCreateDepthBuffer(const GraphicsPipelineConstructionSet& aCtorSet){
+VulkanDepthBundle VulkanBasicRasterPipelineBuilder::autoCreateDepthBuffer(const GraphicsPipelineConstructionSet& aCtorSet, VkImageUsageFlags aExtraUsage){
     VulkanDepthBundle bundle;
     if(aCtorSet.mSwapchainBundle == nullptr){
         std::cerr << "Error: 'autoCreateDepthBuffer()' requires that a swapchain bundle is attached to the construction set." << std::endl;
@@ -283,7 +283,7 @@ VulkanDepthBundle VulkanBasicRasterPipelineBuilder::autoCreateDepthBuffer(const
     VkImageCreateInfo imageInfo = {};
     {
         imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
-        imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+        imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | aExtraUsage;
         imageInfo.extent = VkExtent3D{aCtorSet.mSwapchainBundle->extent.width, aCtorSet.mSwapchainBundle->extent.height, 1};
         imageInfo.format = bundle.format;
         imageInfo.imageType = VK_IMAGE_TYPE_2D;
@@ -139,8 +139,9 @@ class VulkanBasicRasterPipelineBuilder : public VulkanRenderPipeline
     static void prepareRenderPass(GraphicsPipelineConstructionSet& aCtorSetInOut);
 
     /// Automatically select an appropriate depth buffer configuration based on aCtorSet and return the created depth buffer
+    /// 'aExtraUsage' is added to the depth attachment usage, e.g. to sample the depth buffer in later passes.
     /// NOTE: An swapchain bundle must be bound to the construction set. 
-    static VulkanDepthBundle autoCreateDepthBuffer(const GraphicsPipelineConstructionSet& aCtorSet);
+    static VulkanDepthBundle autoCreateDepthBuffer(const GraphicsPipelineConstructionSet& aCtorSet, VkImageUsageFlags aExtraUsage = 0);
     
     /// Automatically select an appropriate depth buffer configuration based on the internal construction set and return the created depth buffer
     /// NOTE: An swapchain bundle must be bound to the construction set. 
@@ -0,0 +1,93 @@
+#include "catch.hpp"
+#include "utils/DedupTable.h"
+#include <unordered_map>
+
+struct TestTriple{
+    int a, b, c;
+    friend bool operator==(const TestTriple& lhs, const TestTriple& rhs) {return(lhs.a == rhs.a && lhs.b == rhs.b && lhs.c == rhs.c);}
+};
+
+struct TestTripleHash{
+    size_t operator()(const TestTriple& aKey) const {
+        return(static_cast<size_t>(hash_index_triple(aKey.a, aKey.b, aKey.c)));
+    }
+};
+
+/// The xor/shift hash process_obj_contents used with std::unordered_map, kept for comparison
+struct WeakTestTripleHash{
+    size_t operator()(const TestTriple& aKey) const {
+        return(((std::hash<int>()(aKey.a) ^ (std::hash<int>()(aKey.b) << 1)) >> 1) ^ (std::hash<int>()(aKey.c) << 1));
+    }
+};
+
+TEST_CASE("Dedup Table Tests"){
+
+    SECTION("Sequential Ids"){
+        DedupTable<TestTriple, TestTripleHash> table;
+        REQUIRE(table.findOrInsert({0, 0, 0}) == std::make_pair(0U, true));
+        REQUIRE(table.findOrInsert({1, 0, 0}) == std::make_pair(1U, true));
+        REQUIRE(table.findOrInsert({0, 0, 0}) == std::make_pair(0U, false));
+        REQUIRE(table.findOrInsert({0, -1, -1}) == std::make_pair(2U, true));
+        REQUIRE(table.size() == 3);
+    }
+
+    SECTION("Growth Keeps Ids"){
+        // Start far too small to force several rehashes
+        DedupTable<TestTriple, TestTripleHash> table(4);
+        size_t initialCapacity = table.capacity();
+        for(int i = 0; i < 10000; ++i){
+            REQUIRE(table.findOrInsert({i, i / 3, -1}).first == static_cast<uint32_t>(i));
+        }
+        REQUIRE(table.capacity() > initialCapacity);
+        for(int i = 0; i < 10000; ++i){
+            REQUIRE(table.findOrInsert({i, i / 3, -1}) == std::make_pair(static_cast<uint32_t>(i), false));
+        }
+        REQUIRE(table.size() == 10000);
+    }
+
+    SECTION("Byte Hash"){
+        // 13 bytes, so the tail after the last whole word is hashed too
+        std::vector<unsigned char> bytes = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13};
+        std::vector<unsigned char> copy = bytes;
+        uint64_t hash = hash_bytes(bytes.data(), bytes.size());
+        REQUIRE(hash_bytes(copy.data(), copy.size()) == hash);
+        copy.back() ^= 1;
+        REQUIRE(hash_bytes(copy.data(), copy.size()) != hash);
+        copy = bytes;
+        copy.front() ^= 1;
+        REQUIRE(hash_bytes(copy.data(), copy.size()) != hash);
+        // A trailing zero byte changes the length
+        copy = bytes;
+        copy.push_back(0);
+        REQUIRE(hash_bytes(copy.data(), copy.size()) != hash);
+    }
+}
+
+// Hidden by default. Run with: VulkanOBJ.tests "[benchmark]"
+TEST_CASE("Dedup Table Benchmark", "[.][benchmark]"){
+    // Each unique vertex of a grid mesh is referenced about six times
+    const static int sSide = 1000;
+    std::vector<TestTriple> keys;
+    keys.reserve(sSide * sSide * 6);
+    for(int y = 0; y < sSide; ++y){
+        for(int x = 0; x < sSide; ++x){
+            int a = y * (sSide + 1) + x;
+            int b = a + 1, c = a + sSide + 1, d = c + 1;
+            for(int v : {a, b, d, a, d, c}) keys.push_back({v, 0, v});
+        }
+    }
+
+    BENCHMARK("std::unordered_map, xor/shift hash"){
+        std::unordered_map<TestTriple, size_t, WeakTestTripleHash> seen;
+        for(const TestTriple& key : keys){
+            seen.emplace(key, seen.size());
+        }
+    }
+
+    BENCHMARK("DedupTable"){
+        DedupTable<TestTriple, TestTripleHash> seen(keys.size() / 3);
+        for(const TestTriple& key : keys){
+            seen.findOrInsert(key);
+        }
+    }
+}
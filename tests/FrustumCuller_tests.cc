@@ -0,0 +1,54 @@
+#include "catch.hpp"
+#include "utils/FrustumCuller.h"
+#include <vector>
+
+/// Column major perspective projection with a 90 degree field of view, looking down -z from the origin
+static std::vector<float> test_projection(float aNear, float aFar){
+    std::vector<float> matrix(16, 0.0f);
+    matrix[0] = 1.0f;
+    matrix[5] = 1.0f;
+    matrix[10] = (aFar + aNear) / (aNear - aFar);
+    matrix[11] = -1.0f;
+    matrix[14] = 2.0f * aFar * aNear / (aNear - aFar);
+    return(matrix);
+}
+
+TEST_CASE("Frustum Culler Tests"){
+    FrustumCuller culler;
+    culler.setViewProjection(test_projection(1.0f, 100.0f).data());
+    std::vector<uint8_t> visible;
+
+    SECTION("Planes"){
+        // The left plane x >= z, normalized
+        REQUIRE(culler.getPlane(0)[0] == Approx(0.70710678f));
+        REQUIRE(culler.getPlane(0)[2] == Approx(-0.70710678f));
+        REQUIRE(culler.getPlane(0)[3] == Approx(0.0f).margin(1e-6));
+        // The far plane faces the camera, 100 units out
+        REQUIRE(culler.getPlane(5)[2] == Approx(1.0f));
+        REQUIRE(culler.getPlane(5)[3] == Approx(100.0f));
+    }
+
+    SECTION("Spheres"){
+        culler.addSphere(0.0f, 0.0f, -10.0f, 1.0f);   // straight ahead
+        culler.addSphere(0.0f, 0.0f, 10.0f, 1.0f);    // behind the camera
+        culler.addSphere(20.0f, 0.0f, -10.0f, 1.0f);  // far to the right
+        culler.addSphere(10.5f, 0.0f, -10.0f, 1.0f);  // straddles the right plane
+        culler.addSphere(0.0f, 0.0f, -200.0f, 1.0f);  // past the far plane
+        culler.addSphere(0.0f, -30.0f, -10.0f, 25.0f); // below, but large enough to reach in
+        culler.addSphere(0.0f, 12.0f, -10.0f, 1.0f);  // above
+        culler.addSphere(0.0f, 0.0f, -0.5f, 0.1f);    // between the camera and the near plane
+        culler.addSphere(-5.0f, 5.0f, -50.0f, 1.0f);  // ahead, off center
+        REQUIRE(culler.size() == 9);
+
+        // Nine spheres cover two full groups of four and one left over
+        REQUIRE(culler.cull(visible) == 4);
+        REQUIRE(visible == std::vector<uint8_t>{1, 0, 0, 1, 0, 1, 0, 0, 1});
+    }
+
+    SECTION("Clear"){
+        culler.addSphere(0.0f, 0.0f, 10.0f, 1.0f);
+        culler.clear();
+        REQUIRE(culler.cull(visible) == 0);
+        REQUIRE(visible.empty());
+    }
+}
@@ -0,0 +1,147 @@
+#include "catch.hpp"
+#include "load_obj_parallel.h"
+#include "utils/MappedFile.h"
+#include "utils/common.h"
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+static void load_with_tinyobj(std::istream& aContents, tinyobj::attrib_t& aAttributes, std::vector<tinyobj::shape_t>& aShapes){
+    std::vector<tinyobj::material_t> materials;
+    std::string err;
+    REQUIRE(tinyobj::LoadObj(&aAttributes, &aShapes, &materials, &err, &aContents));
+}
+
+/// Floats are allowed to differ in the last bits, since tinyobj's parser doesn't round exactly
+static bool nearly_equal(const std::vector<float>& aLhs, const std::vector<float>& aRhs){
+    if(aLhs.size() != aRhs.size()) return(false);
+    for(size_t i = 0; i < aLhs.size(); ++i){
+        if(std::abs(aLhs[i] - aRhs[i]) > 1e-6f * std::max(1.0f, std::abs(aLhs[i]))) return(false);
+    }
+    return(true);
+}
+
+static void require_same_geometry(const tinyobj::attrib_t& aAttributes, const std::vector<tinyobj::shape_t>& aShapes, const tinyobj::attrib_t& aExpectedAttributes, const std::vector<tinyobj::shape_t>& aExpectedShapes){
+    REQUIRE(nearly_equal(aAttributes.vertices, aExpectedAttributes.vertices));
+    REQUIRE(nearly_equal(aAttributes.normals, aExpectedAttributes.normals));
+    REQUIRE(nearly_equal(aAttributes.texcoords, aExpectedAttributes.texcoords));
+
+    REQUIRE(aShapes.size() == aExpectedShapes.size());
+    for(size_t i = 0; i < aShapes.size(); ++i){
+        CHECK(aShapes[i].name == aExpectedShapes[i].name);
+        REQUIRE(aShapes[i].mesh.indices.size() == aExpectedShapes[i].mesh.indices.size());
+        for(size_t j = 0; j < aShapes[i].mesh.indices.size(); ++j){
+            const tinyobj::index_t& index = aShapes[i].mesh.indices[j];
+            const tinyobj::index_t& expected = aExpectedShapes[i].mesh.indices[j];
+            REQUIRE(index.vertex_index == expected.vertex_index);
+            REQUIRE(index.normal_index == expected.normal_index);
+            REQUIRE(index.texcoord_index == expected.texcoord_index);
+        }
+        REQUIRE(aShapes[i].mesh.num_face_vertices == aExpectedShapes[i].mesh.num_face_vertices);
+    }
+}
+
+TEST_CASE("Parallel OBJ Parser Tests"){
+
+    SECTION("Statements And Chunking"){
+        // Groups, relative indices, polygons, CRLF endings and comments
+        const std::string contents =
+            "# comment\n"
+            "v 0 0 0\nv 1 0 0\nv 1 1 0\nv 0 1 0\n"
+            "vt 0 0\nvt 1 0\nvt 1 1\nvt 0 1\n"
+            "vn 0 0 1\n"
+            "f 1/1/1 2/2/1 3/3/1 4/4/1\n"
+            "g empty\n"
+            "o quad\r\n"
+            "v 0 0 1\r\nv 1.5e0 0 1\r\nv +1 1 1\r\n"
+            "  f -3//1 -2//1 -1//1\r\n"
+            "g second extra\n"
+            "f 5 6 7\n"
+            "f 1/2 2/3 3/4\n";
+
+        tinyobj::attrib_t expectedAttributes;
+        std::vector<tinyobj::shape_t> expectedShapes;
+        std::istringstream stream(contents);
+        load_with_tinyobj(stream, expectedAttributes, expectedShapes);
+        REQUIRE(expectedShapes.size() == 3);
+
+        for(size_t chunkBytes : {size_t(1), size_t(16), OBJ_PARSE_MIN_CHUNK_BYTES}){
+            tinyobj::attrib_t attributes;
+            std::vector<tinyobj::shape_t> shapes;
+            parse_obj_parallel(contents.data(), contents.data() + contents.size(), attributes, shapes, 4, chunkBytes);
+            require_same_geometry(attributes, shapes, expectedAttributes, expectedShapes);
+        }
+    }
+
+    SECTION("Asset Files"){
+        for(const char* name : {"bunny.obj", "teapot.obj", "suzanne.obj"}){
+            std::string path = std::string(STRIFY(ASSET_DIR) "/") + name;
+
+            tinyobj::attrib_t expectedAttributes;
+            std::vector<tinyobj::shape_t> expectedShapes;
+            std::ifstream stream(path);
+            REQUIRE(stream.is_open());
+            load_with_tinyobj(stream, expectedAttributes, expectedShapes);
+
+            MappedFile file(path);
+            tinyobj::attrib_t attributes;
+            std::vector<tinyobj::shape_t> shapes;
+            parse_obj_parallel(file.data(), file.data() + file.size(), attributes, shapes, 8, 4096);
+            require_same_geometry(attributes, shapes, expectedAttributes, expectedShapes);
+        }
+    }
+}
+
+/// Writes a grid of 'aCellsPerSide'^2 quads split into two triangles each, with positions, texture coordinates and normals.
+static void write_synthetic_obj(const std::string& aPath, size_t aCellsPerSide){
+    std::ofstream out(aPath);
+    size_t side = aCellsPerSide + 1;
+    for(size_t y = 0; y < side; ++y){
+        for(size_t x = 0; x < side; ++x){
+            out << "v " << x * 0.01f << ' ' << std::sin(x * 0.1f) * std::cos(y * 0.1f) << ' ' << y * 0.01f << '\n';
+            out << "vt " << float(x) / aCellsPerSide << ' ' << float(y) / aCellsPerSide << '\n';
+        }
+    }
+    out << "vn 0 1 0\n";
+    for(size_t y = 0; y < aCellsPerSide; ++y){
+        for(size_t x = 0; x < aCellsPerSide; ++x){
+            size_t a = y * side + x + 1;
+            size_t b = a + 1;
+            size_t c = a + side;
+            size_t d = c + 1;
+            out << "f " << a << '/' << a << "/1 " << b << '/' << b << "/1 " << d << '/' << d << "/1\n";
+            out << "f " << a << '/' << a << "/1 " << d << '/' << d << "/1 " << c << '/' << c << "/1\n";
+        }
+    }
+}
+
+// Hidden by default. Run with: VulkanOBJ.tests "[obj_benchmark]"
+TEST_CASE("OBJ Parser Benchmark", "[.][benchmark][obj_benchmark]"){
+    std::vector<std::string> paths = {
+        std::string(STRIFY(ASSET_DIR) "/bunny.obj"),
+        std::string(STRIFY(ASSET_DIR) "/teapot.obj")
+    };
+
+    // 2237^2 cells * 2 is just over 10M triangles
+    std::string syntheticPath = (std::filesystem::temp_directory_path() / "synthetic_10M.obj").string();
+    write_synthetic_obj(syntheticPath, 2237);
+    paths.emplace_back(syntheticPath);
+
+    for(const std::string& path : paths){
+        tinyobj::attrib_t attributes;
+        std::vector<tinyobj::shape_t> shapes;
+
+        BENCHMARK("tinyobj " + path){
+            std::ifstream stream(path);
+            load_with_tinyobj(stream, attributes, shapes);
+        }
+        BENCHMARK("parse_obj_parallel " + path){
+            MappedFile file(path);
+            parse_obj_parallel(file.data(), file.data() + file.size(), attributes, shapes);
+        }
+    }
+
+    std::filesystem::remove(syntheticPath);
+}
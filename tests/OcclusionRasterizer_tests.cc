@@ -0,0 +1,118 @@
+#include "catch.hpp"
+#include "utils/OcclusionRasterizer.h"
+#include "utils/ThreadPool.h"
+#include <cfloat>
+#include <vector>
+
+/// Column major perspective projection with a 90 degree field of view, looking down -z from the origin
+static std::vector<float> test_projection(float aNear, float aFar){
+    std::vector<float> matrix(16, 0.0f);
+    matrix[0] = 1.0f;
+    matrix[5] = 1.0f;
+    matrix[10] = (aFar + aNear) / (aNear - aFar);
+    matrix[11] = -1.0f;
+    matrix[14] = 2.0f * aFar * aNear / (aNear - aFar);
+    return(matrix);
+}
+
+/// Add a square facing the camera at depth 'aZ', from 'aMin' to 'aMax' along x and y
+static void add_square(OcclusionRasterizer& aRasterizer, const std::vector<float>& aMatrix, float aMin, float aMax, float aZ){
+    const float positions[] = {aMin, aMin, aZ, aMax, aMin, aZ, aMax, aMax, aZ, aMin, aMax, aZ};
+    const uint32_t indices[] = {0, 1, 2, 0, 2, 3};
+    aRasterizer.addOccluder(aMatrix.data(), positions, indices, 6);
+}
+
+TEST_CASE("Occlusion Rasterizer Tests"){
+    std::vector<float> projection = test_projection(1.0f, 100.0f);
+    OcclusionRasterizer rasterizer(60, 30);
+    REQUIRE(rasterizer.width() == 64);
+    REQUIRE(rasterizer.height() == 32);
+
+    SECTION("Rasterize"){
+        // Covers the middle half of the screen, 10 units out
+        add_square(rasterizer, projection, -5.0f, 5.0f, -10.0f);
+        REQUIRE(rasterizer.triangleCount() == 2);
+        rasterizer.rasterize();
+        REQUIRE(rasterizer.depthAt(32, 16) < 1.0f);
+        REQUIRE(rasterizer.depthAt(17, 9) < 1.0f);
+        REQUIRE(rasterizer.depthAt(46, 23) < 1.0f);
+        REQUIRE(rasterizer.depthAt(15, 16) == FLT_MAX);
+        REQUIRE(rasterizer.depthAt(32, 7) == FLT_MAX);
+        REQUIRE(rasterizer.depthAt(0, 0) == FLT_MAX);
+    }
+
+    SECTION("Occlusion"){
+        add_square(rasterizer, projection, -5.0f, 5.0f, -10.0f);
+        rasterizer.rasterize();
+
+        const float behindMin[3] = {-1.0f, -1.0f, -22.0f};
+        const float behindMax[3] = {1.0f, 1.0f, -20.0f};
+        REQUIRE(rasterizer.isOccluded(projection.data(), behindMin, behindMax));
+        // In front of the square
+        const float frontMin[3] = {-1.0f, -1.0f, -6.0f};
+        const float frontMax[3] = {1.0f, 1.0f, -4.0f};
+        REQUIRE_FALSE(rasterizer.isOccluded(projection.data(), frontMin, frontMax));
+        // Behind, but reaching past its edge
+        const float besideMin[3] = {4.0f, -1.0f, -22.0f};
+        const float besideMax[3] = {14.0f, 1.0f, -20.0f};
+        REQUIRE_FALSE(rasterizer.isOccluded(projection.data(), besideMin, besideMax));
+        // Passing through the square
+        const float throughMin[3] = {-1.0f, -1.0f, -12.0f};
+        const float throughMax[3] = {1.0f, 1.0f, -8.0f};
+        REQUIRE_FALSE(rasterizer.isOccluded(projection.data(), throughMin, throughMax));
+        // Reaching behind the camera
+        const float behindCameraMin[3] = {-1.0f, -1.0f, -22.0f};
+        const float behindCameraMax[3] = {1.0f, 1.0f, 5.0f};
+        REQUIRE_FALSE(rasterizer.isOccluded(projection.data(), behindCameraMin, behindCameraMax));
+    }
+
+    SECTION("Near Plane"){
+        // Spans the near plane, so it's skipped rather than clipped
+        const float positions[] = {-5.0f, -5.0f, -0.5f, 5.0f, -5.0f, -10.0f, 0.0f, 5.0f, -10.0f};
+        const uint32_t indices[] = {0, 1, 2};
+        rasterizer.addOccluder(projection.data(), positions, indices, 3);
+        REQUIRE(rasterizer.triangleCount() == 0);
+    }
+
+    SECTION("Threads"){
+        OcclusionRasterizer serial(60, 30);
+        for(OcclusionRasterizer* target : {&rasterizer, &serial}){
+            add_square(*target, projection, -5.0f, 5.0f, -10.0f);
+            add_square(*target, projection, -12.0f, -2.0f, -15.0f);
+        }
+        ThreadPool pool(3);
+        rasterizer.rasterize(&pool);
+        serial.rasterize();
+        for(uint32_t y = 0; y < rasterizer.height(); ++y){
+            for(uint32_t x = 0; x < rasterizer.width(); ++x){
+                REQUIRE(rasterizer.depthAt(x, y) == serial.depthAt(x, y));
+            }
+        }
+    }
+
+    SECTION("Clear"){
+        add_square(rasterizer, projection, -5.0f, 5.0f, -10.0f);
+        rasterizer.rasterize();
+        rasterizer.clear();
+        REQUIRE(rasterizer.triangleCount() == 0);
+        REQUIRE(rasterizer.depthAt(32, 16) == FLT_MAX);
+    }
+}
+
+TEST_CASE("Occluder Simplification Tests"){
+    // A large square from two triangles, with a sliver of a triangle using a vertex of its own
+    const float positions[] = {0.0f, 0.0f, 0.0f, 4.0f, 0.0f, 0.0f, 4.0f, 4.0f, 0.0f, 0.0f, 4.0f, 0.0f, 0.1f, 0.0f, 1.0f};
+    const uint32_t indices[] = {0, 1, 4, 0, 1, 2, 0, 2, 3};
+
+    OcclusionRasterizer::OccluderMesh mesh = OcclusionRasterizer::simplifyOccluder(positions, indices, 9, 2);
+    REQUIRE(mesh.mIndices.size() == 6);
+    REQUIRE(mesh.mPositions.size() == 12);
+    for(uint32_t index : mesh.mIndices){
+        REQUIRE(index < 4);
+        REQUIRE(mesh.mPositions[index * 3 + 2] == 0.0f);
+    }
+
+    OcclusionRasterizer::OccluderMesh whole = OcclusionRasterizer::simplifyOccluder(positions, indices, 9, 16);
+    REQUIRE(whole.mIndices.size() == 9);
+    REQUIRE(whole.mPositions.size() == 15);
+}
@@ -0,0 +1,58 @@
+#include "catch.hpp"
+#include "data/RangeAllocator.h"
+
+TEST_CASE("Range Allocator Tests"){
+
+    SECTION("Allocate And Free"){
+        RangeAllocator ranges(100);
+        REQUIRE(ranges.capacity() == 100);
+        REQUIRE(ranges.allocate(0) == std::nullopt);
+
+        REQUIRE(ranges.allocate(30) == 0);
+        REQUIRE(ranges.allocate(30) == 30);
+        REQUIRE(ranges.allocate(30) == 60);
+        REQUIRE(ranges.used() == 90);
+        REQUIRE(ranges.allocate(20) == std::nullopt);
+
+        // Freed space is reused first-fit
+        ranges.free(30, 30);
+        REQUIRE(ranges.freeRangeCount() == 2);
+        REQUIRE(ranges.allocate(10) == 30);
+        REQUIRE(ranges.allocate(25) == std::nullopt);
+        REQUIRE(ranges.largestFreeRange() == 20);
+    }
+
+    SECTION("Coalescing"){
+        RangeAllocator ranges(90);
+        REQUIRE(ranges.allocate(30) == 0);
+        REQUIRE(ranges.allocate(30) == 30);
+        REQUIRE(ranges.allocate(30) == 60);
+
+        ranges.free(0, 30);
+        ranges.free(60, 30);
+        REQUIRE(ranges.freeRangeCount() == 2);
+        ranges.free(30, 30);
+        REQUIRE(ranges.freeRangeCount() == 1);
+        REQUIRE(ranges.used() == 0);
+        REQUIRE(ranges.allocate(90) == 0);
+    }
+
+    SECTION("Grow"){
+        RangeAllocator ranges(10);
+        REQUIRE(ranges.allocate(5) == 0);
+        REQUIRE(ranges.allocate(10) == std::nullopt);
+
+        // The new space joins the free tail of the old capacity
+        ranges.grow(20);
+        REQUIRE(ranges.freeRangeCount() == 1);
+        REQUIRE(ranges.allocate(15) == 5);
+        REQUIRE(ranges.used() == 20);
+    }
+
+    SECTION("Invalid Free"){
+        RangeAllocator ranges(10);
+        REQUIRE(ranges.allocate(4) == 0);
+        REQUIRE_THROWS(ranges.free(4, 2));
+        REQUIRE_THROWS(ranges.free(8, 4));
+    }
+}
@@ -0,0 +1,63 @@
+#include "catch.hpp"
+#include "load_gltf.h"
+
+static glm::vec3 worldOrigin(const SceneGraph& aGraph, size_t aNode){
+    return(glm::vec3(aGraph.worldTransform(aNode) * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f)));
+}
+
+TEST_CASE("Scene Graph Tests"){
+    // root(0) -> {a(1) -> {c(3)}, b(2)}
+    tinygltf::Model model;
+    model.nodes.resize(4);
+    model.nodes[0].translation = {1.0, 0.0, 0.0};
+    model.nodes[0].children = {1, 2};
+    model.nodes[1].translation = {0.0, 2.0, 0.0};
+    model.nodes[1].children = {3};
+    model.nodes[2].scale = {2.0, 2.0, 2.0};
+    model.nodes[2].mesh = 0;
+    model.nodes[3].translation = {0.0, 0.0, 3.0};
+    model.scenes.resize(1);
+    model.scenes[0].nodes = {0};
+
+    SceneGraph graph;
+    graph.build(model, 0);
+
+    SECTION("Parents Precede Children"){
+        REQUIRE(graph.size() == 4);
+        REQUIRE(graph.sourceNode(0) == 0);
+        REQUIRE(graph.sourceNode(1) == 1);
+        REQUIRE(graph.sourceNode(2) == 3);
+        REQUIRE(graph.sourceNode(3) == 2);
+        REQUIRE(graph.parent(0) == SceneGraph::NO_PARENT);
+        for(size_t i = 1; i < graph.size(); ++i){
+            REQUIRE(graph.parent(i) < static_cast<int>(i));
+        }
+        REQUIRE(graph.subtreeEnd(0) == 4);
+        REQUIRE(graph.subtreeEnd(1) == 3);
+        REQUIRE(graph.mesh(graph.find(2)) == 0);
+        REQUIRE(graph.find(7) == -1);
+    }
+
+    SECTION("World Transforms"){
+        REQUIRE(worldOrigin(graph, graph.find(3)) == glm::vec3(1.0f, 2.0f, 3.0f));
+        REQUIRE(graph.worldTransform(graph.find(2))[0][0] == 2.0f);
+        REQUIRE_FALSE(graph.isDirty());
+    }
+
+    SECTION("Dirty Subtree Update"){
+        graph.setTranslation(graph.find(1), glm::vec3(0.0f, 5.0f, 0.0f));
+        REQUIRE(graph.isDirty());
+        graph.updateWorldTransforms();
+        REQUIRE(worldOrigin(graph, graph.find(3)) == glm::vec3(1.0f, 5.0f, 3.0f));
+        REQUIRE(worldOrigin(graph, graph.find(2)) == glm::vec3(1.0f, 0.0f, 0.0f));
+
+        graph.setLocalTransform(graph.find(0), glm::mat4(1.0f));
+        graph.updateWorldTransforms();
+        REQUIRE(worldOrigin(graph, graph.find(3)) == glm::vec3(0.0f, 5.0f, 3.0f));
+    }
+
+    SECTION("Invalid Nodes"){
+        model.nodes[3].children = {1};
+        REQUIRE_THROWS(graph.build(model, 0));
+    }
+}
@@ -0,0 +1,102 @@
+#include "catch.hpp"
+#include "cook_texture.h"
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+
+static void decodeColorBlock(const unsigned char* block, int texel, int* rgb){
+    uint16_t color0 = block[0] | (block[1] << 8);
+    uint16_t color1 = block[2] | (block[3] << 8);
+    int palette[4][3];
+    for(int p = 0; p < 2; ++p){
+        uint16_t packed = p == 0 ? color0 : color1;
+        palette[p][0] = ((packed >> 11) & 31) * 255 / 31;
+        palette[p][1] = ((packed >> 5) & 63) * 255 / 63;
+        palette[p][2] = (packed & 31) * 255 / 31;
+    }
+    for(int c = 0; c < 3; ++c){
+        palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+        palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+    }
+    uint32_t indices = block[4] | (block[5] << 8) | (block[6] << 16) | (static_cast<uint32_t>(block[7]) << 24);
+    int index = (indices >> (2 * texel)) & 3;
+    for(int c = 0; c < 3; ++c){
+        rgb[c] = palette[index][c];
+    }
+}
+
+static int decodeBC4Block(const unsigned char* block, int texel){
+    int palette[8] = {block[0], block[1]};
+    for(int k = 1; k <= 6; ++k){
+        palette[k + 1] = block[0] > block[1] ? ((7 - k) * block[0] + k * block[1]) / 7 : block[0];
+    }
+    uint64_t indices = 0;
+    for(int i = 0; i < 6; ++i){
+        indices |= static_cast<uint64_t>(block[2 + i]) << (8 * i);
+    }
+    return(palette[(indices >> (3 * texel)) & 7]);
+}
+
+TEST_CASE("Texture Cook Tests"){
+    // A horizontal gradient from black to white, with alpha falling along y
+    unsigned char block[64];
+    for(int i = 0; i < 16; ++i){
+        unsigned char value = static_cast<unsigned char>((i % 4) * 85);
+        block[i * 4] = block[i * 4 + 1] = block[i * 4 + 2] = value;
+        block[i * 4 + 3] = static_cast<unsigned char>(255 - (i / 4) * 60);
+    }
+
+    SECTION("BC1 Block"){
+        unsigned char out[8];
+        encode_bc1_block(block, out);
+        for(int i = 0; i < 16; ++i){
+            int rgb[3];
+            decodeColorBlock(out, i, rgb);
+            for(int c = 0; c < 3; ++c){
+                REQUIRE(std::abs(rgb[c] - block[i * 4 + c]) <= 8);
+            }
+        }
+    }
+
+    SECTION("BC3 and BC5 Blocks"){
+        // Values are within half of the widest interpolation step, 255 / 7
+        unsigned char out[16];
+        encode_bc3_block(block, out);
+        for(int i = 0; i < 16; ++i){
+            REQUIRE(std::abs(decodeBC4Block(out, i) - block[i * 4 + 3]) <= 19);
+        }
+        encode_bc5_block(block, out);
+        for(int i = 0; i < 16; ++i){
+            REQUIRE(std::abs(decodeBC4Block(out, i) - block[i * 4]) <= 19);
+            REQUIRE(std::abs(decodeBC4Block(out + 8, i) - block[i * 4 + 3]) <= 19);
+        }
+    }
+
+    SECTION("Format Selection"){
+        REQUIRE(select_bc_format(block, 4, 4, 1, false) == VK_FORMAT_BC4_UNORM_BLOCK);
+        REQUIRE(select_bc_format(block, 4, 4, 2, false) == VK_FORMAT_BC5_UNORM_BLOCK);
+        REQUIRE(select_bc_format(block, 4, 4, 3, true) == VK_FORMAT_BC1_RGB_SRGB_BLOCK);
+        REQUIRE(select_bc_format(block, 4, 4, 4, true) == VK_FORMAT_BC3_SRGB_BLOCK);
+        REQUIRE(select_bc_format(block, 4, 1, 4, false) == VK_FORMAT_BC1_RGB_UNORM_BLOCK);
+    }
+
+    SECTION("KTX2 Round Trip"){
+        // 6x3 is not a whole number of blocks, and its chain ends at 1x1
+        std::vector<unsigned char> rgba(6 * 3 * 4, 200);
+        CookedTexture cooked = cook_texture(rgba.data(), 6, 3, VK_FORMAT_BC3_SRGB_BLOCK);
+        REQUIRE(cooked.levels.size() == 3);
+        REQUIRE(cooked.levels[0].size() == bc_level_bytes(VK_FORMAT_BC3_SRGB_BLOCK, 6, 3));
+        REQUIRE(cooked.levels[0].size() == 2 * 16);
+
+        std::string path = (std::filesystem::temp_directory_path() / "TextureCook_tests.ktx2").string();
+        write_ktx2(path, cooked);
+        CookedTexture loaded = read_ktx2(path);
+        std::remove(path.c_str());
+        REQUIRE(loaded.format == cooked.format);
+        REQUIRE(loaded.width == 6);
+        REQUIRE(loaded.height == 3);
+        REQUIRE(loaded.levels == cooked.levels);
+
+        REQUIRE_THROWS(read_ktx2(path));
+    }
+}
@@ -0,0 +1,73 @@
+#include "catch.hpp"
+#include "TextureResidency.h"
+
+TEST_CASE("Texture Residency Tests"){
+    // Three textures of 4 levels: 64, 16, 4 and 1 bytes. All resident is 85 bytes each.
+    const std::vector<uint64_t> levels = {64, 16, 4, 1};
+    TextureResidency residency(200);
+    for(size_t i = 1; i <= 3; ++i){
+        residency.addTexture(i, levels, 4);
+    }
+    REQUIRE_FALSE(residency.isManaged(0));
+    REQUIRE(residency.residentBytes() == 0);
+
+    SECTION("Loads Wanted Levels"){
+        residency.markUsed(1, 2);
+        residency.markUsed(1, 1);
+        residency.markUsed(0, 0);
+        std::vector<TextureResidency::Change> changes = residency.endFrame();
+        REQUIRE(changes.size() == 1);
+        REQUIRE(changes[0].texture == 1);
+        REQUIRE(changes[0].baseMip == 1);
+        REQUIRE(residency.isPending(1));
+        REQUIRE(residency.endFrame().empty());
+
+        residency.setResident(1, 1);
+        REQUIRE(residency.residentBaseMip(1) == 1);
+        REQUIRE(residency.residentBytes() == 21);
+    }
+
+    SECTION("Evicts Least Recently Used"){
+        for(size_t i = 1; i <= 3; ++i){
+            residency.markUsed(i, 0);
+        }
+        // 255 bytes are wanted, so the largest drawn level gives way
+        std::vector<TextureResidency::Change> changes = residency.endFrame();
+        REQUIRE(changes.size() == 3);
+        for(const TextureResidency::Change& change : changes){
+            residency.setResident(change.texture, change.baseMip);
+        }
+        REQUIRE(residency.residentBytes() <= 200);
+
+        // Texture 1 stops being drawn, so it is the first to go once the budget shrinks
+        residency.markUsed(2, 0);
+        residency.markUsed(3, 0);
+        residency.endFrame();
+        residency.markUsed(2, 0);
+        residency.markUsed(3, 0);
+        residency.setBudget(170);
+        changes = residency.endFrame();
+        for(const TextureResidency::Change& change : changes){
+            residency.setResident(change.texture, change.baseMip);
+        }
+        REQUIRE(residency.residentBaseMip(1) == 4);
+        REQUIRE(residency.residentBaseMip(2) == 0);
+        REQUIRE(residency.residentBaseMip(3) == 0);
+        REQUIRE(residency.residentBytes() == 170);
+    }
+
+    SECTION("Limits Pending Loads"){
+        residency.setBudget(0);
+        residency.setMaxPendingLoads(2);
+        for(size_t i = 1; i <= 3; ++i){
+            residency.markUsed(i, 0);
+        }
+        REQUIRE(residency.endFrame().size() == 2);
+    }
+
+    SECTION("Screen Size"){
+        REQUIRE(TextureResidency::mipForScreenSize(1024, 512, 2048.0f) == 0);
+        REQUIRE(TextureResidency::mipForScreenSize(1024, 512, 256.0f) == 2);
+        REQUIRE(TextureResidency::mipForScreenSize(1024, 512, 0.0f) == 10);
+    }
+}
@@ -0,0 +1,31 @@
+#include "catch.hpp"
+#include "utils/ThreadPool.h"
+#include <atomic>
+#include <stdexcept>
+
+TEST_CASE("Thread Pool Tests"){
+    ThreadPool pool(3);
+
+    SECTION("Parallel For"){
+        std::vector<size_t> values(1000, 0);
+        pool.parallelFor(values.size(), [&values](size_t i){values[i] = i * 2;});
+        for(size_t i = 0; i < values.size(); ++i){
+            REQUIRE(values[i] == i * 2);
+        }
+    }
+
+    SECTION("Nested Parallel For"){
+        // Every worker blocking in an inner loop must not stall the pool
+        std::atomic<int> count {0};
+        pool.parallelFor(8, [&pool, &count](size_t){
+            pool.parallelFor(8, [&count](size_t){++count;});
+        });
+        REQUIRE(count == 64);
+    }
+
+    SECTION("Exceptions"){
+        REQUIRE_THROWS_AS(pool.parallelFor(10, [](size_t i){if(i == 5) throw std::runtime_error("task failed");}), std::runtime_error);
+        std::future<void> result = pool.submit([](){throw std::runtime_error("task failed");});
+        REQUIRE_THROWS_AS(result.get(), std::runtime_error);
+    }
+}
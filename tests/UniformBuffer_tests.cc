@@ -263,5 +263,165 @@ TEST_CASE("Multi Instance Uniform Buffer Tests"){
         buffer.freeAndReset();
     }
 
+    SECTION("Frame Slot Test"){
+        UniformDataLayoutPtr layoutA = UniformStructDataLayout<TestStructA>::create();
+        UniformDataLayoutPtr layoutB = UniformStructDataLayout<TestStructB>::create();
+        UniformDataLayoutSet layoutSet {
+            {0, layoutA},
+            {1, layoutB}
+        };
+
+        MultiInstanceUniformBuffer buffer(core->getPrimaryDeviceBundle(), layoutSet, 2);
+        buffer.setFrameSlotCount(2);
+        REQUIRE(buffer.getFrameSlotCount() == 2);
+        REQUIRE(buffer.getBufferSize() >= 2 * buffer.getFrameSlotStride());
+
+        std::shared_ptr<UniformStructData<TestStructA>> structInterfaceA = UniformStructData<TestStructA>::create();
+        std::shared_ptr<UniformStructData<TestStructB>> structInterfaceB = UniformStructData<TestStructB>::create();
+        structInterfaceA->getStruct().a = 3;
+        UniformDataInterfaceSet structInterfaceSet{
+            {0, structInterfaceA},
+            {1, structInterfaceB}
+        };
+        buffer.setInstanceDataInterfaces(1, structInterfaceSet);
+        buffer.updateDevice();
+        REQUIRE(buffer.getDeviceSyncState() == DEVICE_IN_SYNC);
+
+        // Only slot 0 is written, slot 1 keeps the old value until its own update
+        structInterfaceA->getStruct().a = 7;
+        buffer.updateDevice(0);
+        REQUIRE(buffer.mDirtyRanges.size() == 1);
+        REQUIRE(buffer.getDeviceSyncState() == DEVICE_OUT_OF_SYNC);
+
+        const uint8_t* data = reinterpret_cast<const uint8_t*>(buffer.mAllocInfo.pMappedData);
+        size_t instanceOffset = buffer.getBoundDataOffset(0, 1);
+        CHECK(reinterpret_cast<const int*>(data + instanceOffset)[0] == 7);
+        CHECK(reinterpret_cast<const int*>(data + buffer.getFrameSlotStride() + instanceOffset)[0] == 3);
+
+        buffer.updateDevice(1);
+        REQUIRE(buffer.getDeviceSyncState() == DEVICE_IN_SYNC);
+        CHECK(reinterpret_cast<const int*>(data + buffer.getFrameSlotStride() + instanceOffset)[0] == 7);
+
+        // Nothing is pending for slot 0 anymore
+        buffer.updateDevice(0);
+        CHECK(buffer.mDirtyRanges.empty());
+
+        std::map<uint32_t, VkDescriptorBufferInfo> slot1Infos = buffer.getDescriptorBufferInfos(1);
+        CHECK(slot1Infos[0].offset == buffer.getFrameSlotStride() + buffer.getBoundDataOffset(0));
+
+        buffer.freeAndReset();
+    }
+
+    SECTION("Instance Storage Test"){
+        UniformDataLayoutPtr layoutA = UniformStructDataLayout<TestStructA>::create();
+        UniformDataLayoutPtr layoutB = UniformStructDataLayout<TestStructB>::create();
+        UniformDataLayoutSet layoutSet {
+            {0, layoutA},
+            {1, layoutB}
+        };
+
+        MultiInstanceUniformBuffer buffer(
+            core->getPrimaryDeviceBundle(), layoutSet, 3, 0,
+            VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+            MultiInstanceUniformBuffer::BufferMode::INSTANCE_STORAGE
+        );
+        REQUIRE(buffer.getDescriptorType() == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+        REQUIRE(buffer.dynamicOffsetCount() == 0);
+
+        // Each binding is a packed array with a std430 element stride
+        size_t strideA = layoutA->getPaddedDataSize(16);
+        size_t strideB = layoutB->getPaddedDataSize(16);
+        REQUIRE(buffer.getBoundDataOffset(0) == 0);
+        REQUIRE(buffer.getBoundDataOffset(0, 2) == 2 * strideA);
+        REQUIRE(buffer.getBoundDataOffset(1, 1) == buffer.getBoundDataOffset(1) + strideB);
+
+        std::map<uint32_t, VkDescriptorBufferInfo> infos = buffer.getDescriptorBufferInfos();
+        CHECK(infos[0].range == 3 * strideA);
+        CHECK(infos[1].offset == buffer.getBoundDataOffset(1));
+
+        for(int instance = 1; instance <= 2; ++instance){
+            std::shared_ptr<UniformStructData<TestStructA>> structInterfaceA = UniformStructData<TestStructA>::create();
+            std::shared_ptr<UniformStructData<TestStructB>> structInterfaceB = UniformStructData<TestStructB>::create();
+            structInterfaceA->getStruct().a = 10 + instance;
+            structInterfaceB->getStruct().a[0] = static_cast<uint8_t>(0x10 + instance);
+            UniformDataInterfaceSet structInterfaceSet{
+                {0, structInterfaceA},
+                {1, structInterfaceB}
+            };
+            buffer.setInstanceDataInterfaces(instance, structInterfaceSet);
+        }
+        buffer.updateDevice();
+
+        // Ranges arrive by instance, so binding 1 of instance 1 comes before binding 0 of instance 2 and they must
+        // be sorted before merging. The neighbouring elements of each array then merge into one range per array.
+        VkDeviceSize slotBase = buffer.getFrameSlotStride() * (buffer.getFrameSlotCount() - 1);
+        VkDeviceSize beginA = slotBase + buffer.getBoundDataOffset(0, 1);
+        VkDeviceSize endA = slotBase + buffer.getBoundDataOffset(0, 2) + sizeof(TestStructA);
+        VkDeviceSize beginB = slotBase + buffer.getBoundDataOffset(1, 1);
+        VkDeviceSize endB = slotBase + buffer.getBoundDataOffset(1, 2) + sizeof(TestStructB);
+        REQUIRE(endA < beginB);
+        if(beginB <= endA + buffer.mBufferAlignmentSize){
+            // The arrays are close enough to merge with each other as well
+            REQUIRE(buffer.mDirtyRanges.size() == 1);
+            CHECK(buffer.mDirtyRanges[0].begin == beginA);
+            CHECK(buffer.mDirtyRanges[0].end == endB);
+        }else{
+            REQUIRE(buffer.mDirtyRanges.size() == 2);
+            CHECK(buffer.mDirtyRanges[0].begin == beginA);
+            CHECK(buffer.mDirtyRanges[0].end == endA);
+            CHECK(buffer.mDirtyRanges[1].begin == beginB);
+            CHECK(buffer.mDirtyRanges[1].end == endB);
+        }
+        const uint8_t* data = reinterpret_cast<const uint8_t*>(buffer.mAllocInfo.pMappedData);
+        CHECK(reinterpret_cast<const int*>(data + buffer.getBoundDataOffset(0, 2))[0] == 12);
+        CHECK((data + buffer.getBoundDataOffset(1, 1) + offsetof(TestStructB, a[0]))[0] == 0x11);
+
+        buffer.freeAndReset();
+    }
+
     core->cleanup();
-}
\ No newline at end of file
+}
+// Hidden by default. Run with: VulkanOBJ.tests "[benchmark]"
+TEST_CASE("Multi Instance Uniform Buffer Upload Benchmark", "[.][benchmark]"){
+    const static MultiInstanceUniformBuffer::instance_index_t sInstanceCount = 10000;
+
+    DummyVulkanApp app;
+    std::shared_ptr<VulkanSetupCore> core = app.mCoreProvider;
+
+    UniformDataLayoutSet layoutSet {
+        {0, UniformStructDataLayout<TestStructA>::create()},
+        {1, UniformStructDataLayout<TestStructB>::create()}
+    };
+
+    MultiInstanceUniformBuffer buffer(core->getPrimaryDeviceBundle(), layoutSet, 0, sInstanceCount);
+    std::vector<UniformDataInterfaceSet> interfaces;
+    interfaces.reserve(sInstanceCount);
+    for(MultiInstanceUniformBuffer::instance_index_t i = 0; i < sInstanceCount; ++i){
+        std::shared_ptr<UniformStructData<TestStructA>> structA = UniformStructData<TestStructA>::create();
+        structA->getStruct().a = static_cast<int>(i);
+        interfaces.emplace_back(UniformDataInterfaceSet{{0, structA}, {1, UniformStructData<TestStructB>::create()}});
+        buffer.pushBackInstance(interfaces.back());
+    }
+    buffer.updateDevice();
+    REQUIRE(buffer.getDeviceSyncState() == DEVICE_IN_SYNC);
+
+    BENCHMARK("10k instances, every binding dirty"){
+        for(const UniformDataInterfaceSet& set : interfaces){
+            set.at(0)->flagAsDirty();
+            set.at(1)->flagAsDirty();
+        }
+        buffer.updateDevice();
+    }
+    CHECK(buffer.mDirtyRanges.size() == 1);
+
+    BENCHMARK("10k instances, 1% of transforms dirty"){
+        for(size_t i = 0; i < interfaces.size(); i += 100){
+            interfaces[i].at(0)->flagAsDirty();
+        }
+        buffer.updateDevice();
+    }
+    CHECK(buffer.mDirtyRanges.size() == sInstanceCount / 100);
+
+    buffer.freeAndReset();
+    core->cleanup();
+}